@@ -37,10 +37,22 @@ bool IsA(const std::shared_ptr<U>& ptr) {
 
 int main(int argc, char** argv) {
   if (argc < 2) {
-    std::cerr << "USAGE: verifypgp <keys>" << std::endl;
+    std::cerr << "USAGE: verifypgp <keys> [<cache>]" << std::endl;
     return 1;
   }
 
+  // Outcomes are cached between runs if a cache file is given.
+  std::unique_ptr<parse4880::VerificationCache> cache;
+  if (argc > 2) {
+    try {
+      cache.reset(new parse4880::VerificationCache(argv[2], 1 << 24));
+    }
+    catch (const parse4880::parse4880_error& e) {
+      fprintf(stderr, "Cache error:\n\t%s\n", e.what());
+      return 1;
+    }
+  }
+
   std::list<std::shared_ptr<parse4880::PGPPacket>> key_packets;
   try {
     key_packets = parse_file(argv[1]);
@@ -84,12 +96,10 @@ int main(int argc, char** argv) {
                   key_ptr->str().c_str());
 
           try {
-            std::unique_ptr<parse4880::Key> key =
-                parse4880::Key::ParseKey(*key_ptr);
-
             fprintf(stderr, "Verification: %d\n",
                     parse4880::verify_uid_binding(*key_ptr, *uid_ptr,
-                                                  *key, *signature_ptr));
+                                                  *key_ptr, *signature_ptr,
+                                                  cache.get()));
 
           }
           catch (parse4880::parse4880_error e) {
@@ -103,7 +113,8 @@ int main(int argc, char** argv) {
           try {
             fprintf(stderr, "Verification: %d\n",
                     parse4880::verify_subkey_binding(*key_ptr, *subkey_ptr,
-                                                     *signature_ptr));
+                                                     *signature_ptr,
+                                                     cache.get()));
 
           }
           catch (parse4880::parse4880_error e) {
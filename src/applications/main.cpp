@@ -1,16 +1,20 @@
+#include <unistd.h>
+
 #include <cstdio>
+#include <cstring>
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <list>
 #include <memory>
 
 #include "parser.h"
 #include "packet.h"
 #include "exceptions.h"
+#include "mapped_file.h"
+#include "dump.h"
 
-void print_packets(std::list<std::shared_ptr<parse4880::PGPPacket>> packets,
+void print_packets(const std::list<std::shared_ptr<parse4880::PGPPacket>>&
+                       packets,
                    int level);
 void print_packet(const parse4880::PGPPacket& packet, int level);
 
@@ -24,7 +28,8 @@ void print_packet(const parse4880::PGPPacket& packet, int level) {
   print_packets(packet.subpackets(), level+1);
 }
 
-void print_packets(std::list<std::shared_ptr<parse4880::PGPPacket>> packets,
+void print_packets(const std::list<std::shared_ptr<parse4880::PGPPacket>>&
+                       packets,
                    int level) {
 
   for (auto i = packets.begin(); i != packets.end(); i++) {
@@ -33,25 +38,50 @@ void print_packets(std::list<std::shared_ptr<parse4880::PGPPacket>> packets,
 }
 
 int main(int argc, char** argv) {
-  if (argc < 2) {
-    std::cerr << "USAGE: parsepgp <file>" << std::endl;
+  bool dump = false;
+  parse4880::DumpFormat format = parse4880::kDumpJSONLines;
+  int file_argument = 1;
+  if (argc > 2 && 0 == strcmp(argv[1], "--json")) {
+    dump = true;
+    file_argument = 2;
+  }
+  else if (argc > 2 && 0 == strcmp(argv[1], "--binary")) {
+    dump = true;
+    format = parse4880::kDumpBinary;
+    file_argument = 2;
+  }
+  if (argc <= file_argument) {
+    std::cerr << "USAGE: parsepgp [--json | --binary] <file>" << std::endl;
     return 1;
   }
 
-  std::ifstream pgp_file;
-  pgp_file.open(argv[1]); // Flawfinder: ignore (give the user what they want)
-
-  std::stringstream str_stream;
-  str_stream << pgp_file.rdbuf();
-
   try {
-    std::string file_contents = str_stream.str();
-    parse4880::parse(
-        parse4880::ustring(file_contents.begin(), file_contents.end()),
-        [](std::shared_ptr<parse4880::PGPPacket> packet) -> bool {
-          print_packet(*packet, 0);
-          return true;
-        });
+    parse4880::MappedFile pgp_file(argv[file_argument]);
+    if (dump) {
+      parse4880::BufferedOutput out(STDOUT_FILENO);
+      parse4880::PacketDumper dumper(&out, format);
+      parse4880::ParseError error = parse4880::try_parse(
+          pgp_file.data(), pgp_file.size(), parse4880::TagMask::All(),
+          [&dumper](std::shared_ptr<parse4880::PGPPacket> packet) -> bool {
+            dumper.Dump(*packet);
+            return true;
+          });
+      out.Flush();
+      if (!error.ok()) {
+        parse4880::ThrowParseError(error);
+      }
+    }
+    else {
+      parse4880::ParseError error = parse4880::try_parse(
+          pgp_file.data(), pgp_file.size(), parse4880::TagMask::All(),
+          [](std::shared_ptr<parse4880::PGPPacket> packet) -> bool {
+            print_packet(*packet, 0);
+            return true;
+          });
+      if (!error.ok()) {
+        parse4880::ThrowParseError(error);
+      }
+    }
   }
   catch(const parse4880::parse4880_error& e) {
     fprintf(stderr, "Parse error:\n\t%s\n", e.what());
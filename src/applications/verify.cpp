@@ -1,10 +1,16 @@
+#include <unistd.h>
+
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <list>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "parser_types.h"
 #include "parser.h"
@@ -13,6 +19,10 @@
 #include "constants.h"
 #include "keys/key.h"
 #include "packets/keymaterial.h"
+#include "dump.h"
+#include "mapped_file.h"
+#include "keyring/key_index.h"
+#include "keyring/manifest.h"
 
 std::string read_file(std::string filename) {
   std::ifstream file;
@@ -32,9 +42,96 @@ std::list<std::shared_ptr<parse4880::PGPPacket>> parse_file(std::string file) {
 
 
 
+/**
+ * Verify every file in a manifest, writing one JSON object per file.
+ *
+ * @return The exit status: zero only if every signature is good.
+ */
+int verify_manifest_files(const char* manifest_path, const char* keys,
+                          std::size_t threads) {
+  std::vector<parse4880::ManifestEntry> entries;
+  if (0 == strcmp(manifest_path, "-")) {
+    entries = parse4880::read_manifest(std::cin);
+  }
+  else {
+    std::ifstream manifest;
+    manifest.open(manifest_path); // Flawfinder: ignore
+    if (!manifest) {
+      fprintf(stderr, "ERROR: could not read %s.\n", manifest_path);
+      return 1;
+    }
+    entries = parse4880::read_manifest(manifest);
+  }
+
+  std::unique_ptr<parse4880::KeyIndex> index;
+  try {
+    parse4880::MappedFile keyring(keys);
+    index.reset(new parse4880::KeyIndex(keyring.data(), keyring.size()));
+  }
+  catch (parse4880::parse4880_error& e) {
+    fprintf(stderr, "Parse error in keyring:\n\t%s\n", e.what());
+    return 1;
+  }
+
+  std::vector<parse4880::VerifyResponse> results =
+      parse4880::verify_manifest(*index, entries, threads);
+
+  std::size_t good = 0;
+  try {
+    parse4880::BufferedOutput out(STDOUT_FILENO);
+    // Paths need not be UTF-8, and nor need messages that quote them;
+    // those are written in hex under a name with a _hex suffix, as the
+    // dump does for user IDs.
+    auto write_field = [&out](const char* name, const std::string& text) {
+      parse4880::ByteView bytes(
+          reinterpret_cast<const uint8_t*>(text.data()), text.length());
+      out.Write("\"");
+      out.Write(name);
+      if (parse4880::is_utf8(bytes)) {
+        out.Write("\":");
+        parse4880::write_json_string(&out, bytes);
+      }
+      else {
+        out.Write("_hex\":\"");
+        out.WriteHex(bytes);
+        out.Write("\"");
+      }
+    };
+    for (std::size_t i = 0; i < results.size(); i++) {
+      if (parse4880::kVerifyGood == results[i].status) {
+        good++;
+      }
+      out.Write("{");
+      write_field("file", entries[i].file);
+      out.Write(",");
+      write_field("signature", entries[i].signature);
+      out.Write(",\"status\":\"");
+      out.Write(parse4880::verify_status_name(results[i].status));
+      out.Write("\",");
+      write_field("message", results[i].message);
+      out.Write("}\n");
+    }
+    out.Flush();
+  }
+  catch (const parse4880::write_error&) {
+    fprintf(stderr, "ERROR: could not write results.\n");
+    return 1;
+  }
+
+  fprintf(stderr, "Verified %zu of %zu files.\n", good, results.size());
+  return good == results.size() ? 0 : 1;
+}
+
 int main(int argc, char** argv) {
+  if (argc >= 4 && 0 == strcmp(argv[1], "--manifest")) {
+    return verify_manifest_files(
+        argv[2], argv[3], argc > 4 ? strtoul(argv[4], nullptr, 10) : 0);
+  }
+
   if (argc < 4) {
     std::cerr << "USAGE: verifypgp <file> <signature> <keys>" << std::endl;
+    std::cerr << "       verifypgp --manifest <manifest> <keys> [threads]"
+              << std::endl;
     return 1;
   }
 
@@ -0,0 +1,66 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "parser_types.h"
+#include "exceptions.h"
+#include "keyring/verify_service.h"
+
+std::string read_file(std::string filename) {
+  std::ifstream file;
+  file.open(filename); // Flawfinder: ignore (give the user what they want)
+
+  std::stringstream str_stream;
+  str_stream << file.rdbuf();
+
+  return str_stream.str();
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    fprintf(stderr, "USAGE: verifyc <file> <signature> <socket>\n");
+    return 1;
+  }
+
+  // Flawfinder: ignore (give the user what they want)
+  int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror(argv[1]);
+    return 1;
+  }
+  std::string signature = read_file(argv[2]);
+
+  parse4880::VerifyResponse response;
+  try {
+    parse4880::VerifyClient client(argv[3]);
+    response = client.Verify(
+        fd, parse4880::ustring(signature.begin(), signature.end()));
+  }
+  catch (parse4880::parse4880_error& e) {
+    fprintf(stderr, "Error contacting server:\n\t%s\n", e.what());
+    close(fd);
+    return 1;
+  }
+  close(fd);
+
+  switch (response.status) {
+    case parse4880::kVerifyGood:
+    case parse4880::kVerifyBad:
+      fprintf(stderr, "Found key: %s\n", response.message.c_str());
+      fprintf(stderr, "Verification: %d\n",
+              parse4880::kVerifyGood == response.status);
+      return 0;
+    case parse4880::kVerifyNoKey:
+      return 0;
+    case parse4880::kVerifyMalformed:
+      fprintf(stderr, "ERROR: %s\n", response.message.c_str());
+      return 1;
+    default:
+      fprintf(stderr, "ERROR: %s: %s\n", argv[1], response.message.c_str());
+      return 1;
+  }
+}
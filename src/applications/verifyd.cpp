@@ -0,0 +1,52 @@
+#include <signal.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "exceptions.h"
+#include "mapped_file.h"
+#include "keyring/key_index.h"
+#include "keyring/verify_service.h"
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "USAGE: verifyd <socket> <keys> [threads]\n");
+    return 1;
+  }
+  std::size_t threads = argc > 3 ? strtoul(argv[3], nullptr, 10) : 0;
+
+  std::shared_ptr<const parse4880::KeyIndex> index;
+  try {
+    parse4880::MappedFile keyring(argv[2]);
+    index = std::make_shared<const parse4880::KeyIndex>(keyring.data(),
+                                                        keyring.size());
+  }
+  catch (parse4880::parse4880_error& e) {
+    fprintf(stderr, "Error reading keyring:\n\t%s\n", e.what());
+    return 1;
+  }
+  fprintf(stderr, "Loaded %zu keys.\n", index->size());
+
+  // Block the signals before starting any threads, so that only sigwait()
+  // sees them.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  try {
+    parse4880::VerifyServer server(index, argv[1], threads);
+    server.Start();
+    int signal_number;
+    sigwait(&signals, &signal_number);
+    server.Stop();
+  }
+  catch (parse4880::parse4880_error& e) {
+    fprintf(stderr, "Error:\n\t%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include <string>
+
+#include <mbedtls/md.h>
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "digest.h"
+
+namespace parse4880 {
+
+ContentDigest DigestParts(std::initializer_list<const ustring*> parts) {
+  mbedtls_md_context_t md_ctx;
+  mbedtls_md_init(&md_ctx);
+  mbedtls_md_setup(&md_ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+  mbedtls_md_starts(&md_ctx);
+
+  for (auto part = parts.begin(); part != parts.end(); part++) {
+    mbedtls_md_update(&md_ctx, WriteInteger((*part)->length(), 8).c_str(), 8);
+    mbedtls_md_update(&md_ctx, (*part)->c_str(), (*part)->length());
+  }
+
+  ContentDigest digest;
+  mbedtls_md_finish(&md_ctx, digest.data());
+  mbedtls_md_free(&md_ctx);
+
+  return digest;
+}
+
+ContentDigest DigestPacket(const PGPPacket& packet) {
+  return DigestPacket(packet.tag(), packet.contents().data(),
+                      packet.contents().length());
+}
+
+ContentDigest DigestPacket(uint8_t tag, const uint8_t* contents,
+                           std::size_t length) {
+  // This must match DigestParts({tag, contents}).
+  mbedtls_md_context_t md_ctx;
+  mbedtls_md_init(&md_ctx);
+  mbedtls_md_setup(&md_ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+  mbedtls_md_starts(&md_ctx);
+
+  mbedtls_md_update(&md_ctx, WriteInteger(1, 8).c_str(), 8);
+  mbedtls_md_update(&md_ctx, &tag, 1);
+  mbedtls_md_update(&md_ctx, WriteInteger(length, 8).c_str(), 8);
+  mbedtls_md_update(&md_ctx, contents, length);
+
+  ContentDigest digest;
+  mbedtls_md_finish(&md_ctx, digest.data());
+  mbedtls_md_free(&md_ctx);
+
+  return digest;
+}
+
+}
@@ -0,0 +1,547 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <string>
+
+#ifdef INCLUDE_TESTS
+#include <cstdio>
+#include <gtest/gtest.h>
+#include "parser.h"
+#endif
+
+#include "exceptions.h"
+#include "hex.h"
+#include "packet.h"
+#include "parser_types.h"
+#include "dump.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+const char kDumpMagic[] = "P4880DP1";
+
+const char* PacketType(const PGPPacket& packet) {
+  if (nullptr != dynamic_cast<const SignaturePacket*>(&packet)) {
+    return "signature";
+  }
+  if (nullptr != dynamic_cast<const PublicSubkeyPacket*>(&packet)) {
+    return "public_subkey";
+  }
+  if (nullptr != dynamic_cast<const PublicKeyPacket*>(&packet)) {
+    return "public_key";
+  }
+  if (nullptr != dynamic_cast<const UserIDPacket*>(&packet)) {
+    return "user_id";
+  }
+  return "unknown";
+}
+
+}
+
+/// @endcond
+
+BufferedOutput::BufferedOutput(int fd, std::size_t capacity)
+    : fd_(fd), buffer_(capacity < 16 ? 16 : capacity), used_(0) {}
+
+BufferedOutput::~BufferedOutput() {
+  try {
+    Flush();
+  }
+  catch (const write_error&) {
+  }
+}
+
+void BufferedOutput::WriteSlow(const void* data, std::size_t length) {
+  Drain();
+  if (length < buffer_.size()) {
+    memcpy(&buffer_[0], data, length);
+    used_ = length;
+    return;
+  }
+
+  // Too big to be worth copying.
+  const char* position = static_cast<const char*>(data);
+  while (length > 0) {
+    ssize_t written = write(fd_, position, length);
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      throw write_error(errno);
+    }
+    position += written;
+    length -= written;
+  }
+}
+
+void BufferedOutput::WriteHex(ByteView data) {
+  while (!data.empty()) {
+    if (buffer_.size() - used_ < 2) {
+      Drain();
+    }
+    const std::size_t count =
+        std::min(data.length(), (buffer_.size() - used_) / 2);
+    hex_encode(data.data(), count, &buffer_[used_]);
+    used_ += 2 * count;
+    data = data.substr(count);
+  }
+}
+
+void BufferedOutput::WriteDecimal(int64_t value) {
+  char digits[20]; // Flawfinder: ignore (the longest int64_t has 19 digits)
+  char* end = digits + sizeof(digits);
+  char* start = end;
+  // Work with the magnitude as unsigned, so that the most negative
+  // value does not overflow.
+  uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+  do {
+    *--start = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value < 0) {
+    Put('-');
+  }
+  Write(start, end - start);
+}
+
+void BufferedOutput::Flush() {
+  Drain();
+}
+
+void BufferedOutput::Drain() {
+  std::size_t position = 0;
+  while (position < used_) {
+    ssize_t written = write(fd_, &buffer_[position], used_ - position);
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      // Drop what could not be written, so that the error is not
+      // raised again from the destructor.
+      used_ = 0;
+      throw write_error(errno);
+    }
+    position += written;
+  }
+  used_ = 0;
+}
+
+bool is_utf8(ByteView text) {
+  std::size_t i = 0;
+  while (i < text.length()) {
+    const uint8_t c = text[i];
+    std::size_t continuation;
+    uint32_t minimum;
+    uint32_t code_point;
+    if (c < 0x80) {
+      i++;
+      continue;
+    }
+    else if (0xC0 == (c & 0xE0)) {
+      continuation = 1;
+      minimum = 0x80;
+      code_point = c & 0x1F;
+    }
+    else if (0xE0 == (c & 0xF0)) {
+      continuation = 2;
+      minimum = 0x800;
+      code_point = c & 0x0F;
+    }
+    else if (0xF0 == (c & 0xF8)) {
+      continuation = 3;
+      minimum = 0x10000;
+      code_point = c & 0x07;
+    }
+    else {
+      return false;
+    }
+    if (text.length() - i - 1 < continuation) {
+      return false;
+    }
+    for (std::size_t j = 1; j <= continuation; j++) {
+      if (0x80 != (text[i + j] & 0xC0)) {
+        return false;
+      }
+      code_point = (code_point << 6) | (text[i + j] & 0x3F);
+    }
+    // Overlong forms, surrogates and values beyond Unicode are invalid.
+    if (code_point < minimum || code_point > 0x10FFFF
+        || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+      return false;
+    }
+    i += continuation + 1;
+  }
+  return true;
+}
+
+void write_json_string(BufferedOutput* out, ByteView text) {
+  out->Put('"');
+  // Copy runs of characters that need no escape in one go.
+  std::size_t run = 0;
+  for (std::size_t i = 0; i < text.length(); i++) {
+    const uint8_t c = text[i];
+    if (c >= 0x20 && '"' != c && '\\' != c && 0x7F != c) {
+      continue;
+    }
+    out->Write(text.data() + run, i - run);
+    run = i + 1;
+    char escaped[6] = {'\\', 'u', '0', '0', 0, 0};
+    switch (c) {
+      case '"':
+      case '\\':
+        escaped[1] = c;
+        out->Write(escaped, 2);
+        break;
+      case '\n':
+        out->Write("\\n", 2);
+        break;
+      case '\t':
+        out->Write("\\t", 2);
+        break;
+      default:
+        hex_encode(&c, 1, escaped + 4);
+        out->Write(escaped, 6);
+    }
+  }
+  out->Write(text.data() + run, text.length() - run);
+  out->Put('"');
+}
+
+PacketDumper::PacketDumper(BufferedOutput* out, DumpFormat format)
+    : out_(out), format_(format) {
+  if (kDumpBinary == format_) {
+    out_->Write(kDumpMagic, sizeof(kDumpMagic) - 1);
+  }
+}
+
+void PacketDumper::Dump(const PGPPacket& packet) {
+  if (kDumpJSONLines == format_) {
+    WriteJSON(packet, false, false);
+    out_->Put('\n');
+  }
+  else {
+    record_.clear();
+    AppendRecord(packet);
+    out_->Write(record_.data(), record_.length());
+  }
+}
+
+void PacketDumper::WriteJSON(const PGPPacket& packet, bool subpacket,
+                             bool hashed) {
+  out_->Write("{\"tag\":", 7);
+  if (subpacket) {
+    // The tag of a signature subpacket is its type, with the critical
+    // bit on top.
+    out_->WriteDecimal(packet.tag() & 0x7F);
+    out_->Write(",\"critical\":", 12);
+    WriteJSONBoolean(0 != (packet.tag() & 0x80));
+    out_->Write(",\"hashed\":", 10);
+    WriteJSONBoolean(hashed);
+  }
+  else {
+    out_->WriteDecimal(packet.tag());
+    WriteJSONKey("type");
+    write_json_string(out_, ByteView(reinterpret_cast<const uint8_t*>(
+        PacketType(packet)), strlen(PacketType(packet))));
+  }
+  WriteJSONInteger("length", packet.contents().length());
+
+  const SignaturePacket* signature =
+      dynamic_cast<const SignaturePacket*>(&packet);
+  const PublicKeyPacket* key = dynamic_cast<const PublicKeyPacket*>(&packet);
+  const UserIDPacket* user_id = dynamic_cast<const UserIDPacket*>(&packet);
+  if (subpacket) {
+    WriteJSONHex("contents", packet.contents());
+  }
+  else if (nullptr != signature) {
+    WriteJSONInteger("version", signature->version());
+    WriteJSONInteger("signature_type", signature->signature_type());
+    WriteJSONInteger("public_key_algorithm",
+                     signature->public_key_algorithm());
+    WriteJSONInteger("hash_algorithm", signature->hash_algorithm());
+    if (!signature->key_id().empty()) {
+      WriteJSONHex("key_id", signature->key_id());
+    }
+    WriteJSONTime("creation_time", signature->creation_time());
+    WriteJSONTime("signature_expiration_time",
+                  signature->signature_expiration_time());
+    WriteJSONTime("key_expiration_time", signature->key_expiration_time());
+    WriteJSONHex("hash_left_16bits",
+                 ByteView(signature->hash_left_16bits(), 2));
+    WriteJSONHex("signature", signature->signature());
+  }
+  else if (nullptr != key) {
+    WriteJSONInteger("version", key->version());
+    WriteJSONTime("creation_time", key->creation_time());
+    WriteJSONInteger("public_key_algorithm", key->public_key_algorithm());
+    WriteJSONHex("fingerprint", key->fingerprint());
+    // Only a v4 fingerprint contains the key ID.
+    if (4 == key->version() && key->fingerprint().length() == 20) {
+      WriteJSONHex("key_id", ByteView(key->fingerprint()).substr(12));
+    }
+    WriteJSONHex("key_material", key->key_material());
+  }
+  else if (nullptr != user_id) {
+    if (is_utf8(packet.contents())) {
+      WriteJSONKey("user_id");
+      write_json_string(out_, packet.contents());
+    }
+    else {
+      WriteJSONHex("user_id_hex", packet.contents());
+    }
+  }
+  else {
+    WriteJSONHex("contents", packet.contents());
+  }
+
+  const std::list<std::shared_ptr<PGPPacket>>& subpackets =
+      packet.subpackets();
+  if (!subpackets.empty()) {
+    const std::size_t hashed_count =
+        nullptr != signature ? signature->hashed_subpacket_count() : 0;
+    WriteJSONKey("subpackets");
+    out_->Put('[');
+    std::size_t n = 0;
+    for (auto i = subpackets.begin(); i != subpackets.end(); i++, n++) {
+      if (n > 0) {
+        out_->Put(',');
+      }
+      if (nullptr != signature) {
+        WriteJSON(**i, true, n < hashed_count);
+      }
+      else {
+        WriteJSON(**i, false, false);
+      }
+    }
+    out_->Put(']');
+  }
+  out_->Put('}');
+}
+
+void PacketDumper::WriteJSONKey(const char* name) {
+  out_->Put(',');
+  out_->Put('"');
+  out_->Write(name, strlen(name));
+  out_->Put('"');
+  out_->Put(':');
+}
+
+void PacketDumper::WriteJSONBoolean(bool value) {
+  if (value) {
+    out_->Write("true", 4);
+  }
+  else {
+    out_->Write("false", 5);
+  }
+}
+
+void PacketDumper::WriteJSONHex(const char* name, ByteView data) {
+  WriteJSONKey(name);
+  out_->Put('"');
+  out_->WriteHex(data);
+  out_->Put('"');
+}
+
+void PacketDumper::WriteJSONInteger(const char* name, int64_t value) {
+  WriteJSONKey(name);
+  out_->WriteDecimal(value);
+}
+
+void PacketDumper::WriteJSONTime(const char* name, int64_t value) {
+  WriteJSONKey(name);
+  // A signature without a creation time has one of -1.
+  if (value < 0) {
+    out_->Write("null", 4);
+  }
+  else {
+    out_->WriteDecimal(value);
+  }
+}
+
+void PacketDumper::AppendRecord(const PGPPacket& packet) {
+  record_.push_back(packet.tag());
+  const std::size_t length_offset = record_.length();
+  AppendU32(0);
+
+  const SignaturePacket* signature =
+      dynamic_cast<const SignaturePacket*>(&packet);
+  const PublicKeyPacket* key = dynamic_cast<const PublicKeyPacket*>(&packet);
+  const UserIDPacket* user_id = dynamic_cast<const UserIDPacket*>(&packet);
+  if (nullptr != signature) {
+    AppendInteger(kDumpFieldVersion, signature->version(), 1);
+    AppendInteger(kDumpFieldSignatureType, signature->signature_type(), 1);
+    AppendInteger(kDumpFieldPublicKeyAlgorithm,
+                  signature->public_key_algorithm(), 1);
+    AppendInteger(kDumpFieldHashAlgorithm, signature->hash_algorithm(), 1);
+    if (!signature->key_id().empty()) {
+      AppendField(kDumpFieldKeyID, signature->key_id());
+    }
+    AppendInteger(kDumpFieldCreationTime, signature->creation_time(), 8);
+    AppendInteger(kDumpFieldSignatureExpirationTime,
+                  signature->signature_expiration_time(), 8);
+    AppendInteger(kDumpFieldKeyExpirationTime,
+                  signature->key_expiration_time(), 8);
+    AppendField(kDumpFieldHashLeft16Bits,
+                ByteView(signature->hash_left_16bits(), 2));
+    AppendField(kDumpFieldSignature, signature->signature());
+  }
+  else if (nullptr != key) {
+    AppendInteger(kDumpFieldVersion, key->version(), 1);
+    AppendInteger(kDumpFieldCreationTime, key->creation_time(), 8);
+    AppendInteger(kDumpFieldPublicKeyAlgorithm,
+                  key->public_key_algorithm(), 1);
+    AppendField(kDumpFieldFingerprint, key->fingerprint());
+    AppendField(kDumpFieldKeyMaterial, key->key_material());
+  }
+  else if (nullptr != user_id) {
+    AppendField(kDumpFieldUserID, packet.contents());
+  }
+  else {
+    AppendField(kDumpFieldContents, packet.contents());
+  }
+
+  const std::size_t hashed_count =
+      nullptr != signature ? signature->hashed_subpacket_count() : 0;
+  std::size_t n = 0;
+  const std::list<std::shared_ptr<PGPPacket>>& subpackets =
+      packet.subpackets();
+  for (auto i = subpackets.begin(); i != subpackets.end(); i++, n++) {
+    DumpField field = kDumpFieldSubpacket;
+    if (nullptr != signature) {
+      field = n < hashed_count ? kDumpFieldHashedSubpacket
+                               : kDumpFieldUnhashedSubpacket;
+    }
+    record_.push_back(field);
+    const std::size_t field_length_offset = record_.length();
+    AppendU32(0);
+    AppendRecord(**i);
+    WriteU32At(field_length_offset);
+  }
+
+  WriteU32At(length_offset);
+}
+
+void PacketDumper::AppendField(DumpField field, ByteView value) {
+  record_.push_back(field);
+  AppendU32(value.length());
+  record_.append(value.data(), value.length());
+}
+
+void PacketDumper::AppendInteger(DumpField field, uint64_t value,
+                                 std::size_t length) {
+  record_.push_back(field);
+  AppendU32(length);
+  for (std::size_t i = length; i > 0; i--) {
+    record_.push_back(value >> (8 * (i - 1)));
+  }
+}
+
+void PacketDumper::AppendU32(uint32_t value) {
+  record_.push_back(value >> 24);
+  record_.push_back(value >> 16);
+  record_.push_back(value >> 8);
+  record_.push_back(value);
+}
+
+void PacketDumper::WriteU32At(std::size_t offset) {
+  // The length covers everything after the four octets themselves.
+  const uint32_t value = record_.length() - offset - 4;
+  record_[offset] = value >> 24;
+  record_[offset + 1] = value >> 16;
+  record_[offset + 2] = value >> 8;
+  record_[offset + 3] = value;
+}
+
+}
+
+#ifdef INCLUDE_TESTS
+
+namespace parse4880 {
+
+TEST(Dump, Formats) {
+  // A v4 signature with one hashed and one unhashed subpacket.
+  const ustring signature_data{
+    0x04, 0x00, 0x01, 0x08,
+    0x00, 0x06, 0x05, 0x02, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x0A, 0x09, 0x10, 1, 2, 3, 4, 5, 6, 7, 8,
+    0xAB, 0xCD, 0x00, 0x01, 0x01};
+  const std::string user_id = "A \"B\"\n\xC3\xA9";
+  std::list<std::shared_ptr<PGPPacket>> packets{
+    std::shared_ptr<PGPPacket>(new SignaturePacket(signature_data)),
+    std::shared_ptr<PGPPacket>(new UserIDPacket(
+        ustring(user_id.begin(), user_id.end()))),
+    std::shared_ptr<PGPPacket>(new UserIDPacket(ustring{0xFF})),
+    std::shared_ptr<PGPPacket>(new UnknownPGPPacket(61, ustring{0x00}))};
+
+  auto dump = [&packets](DumpFormat format) {
+    FILE* file = tmpfile();
+    {
+      BufferedOutput out(fileno(file), 16);
+      PacketDumper dumper(&out, format);
+      for (auto i = packets.begin(); i != packets.end(); i++) {
+        dumper.Dump(**i);
+      }
+      out.Flush();
+    }
+    std::string result;
+    rewind(file);
+    int c;
+    while (EOF != (c = fgetc(file))) {
+      result.push_back(c);
+    }
+    fclose(file);
+    return result;
+  };
+
+  ASSERT_EQ(dump(kDumpJSONLines),
+            "{\"tag\":2,\"type\":\"signature\",\"length\":29,\"version\":4,"
+            "\"signature_type\":0,\"public_key_algorithm\":1,"
+            "\"hash_algorithm\":8,\"key_id\":\"0102030405060708\","
+            "\"creation_time\":256,\"signature_expiration_time\":0,"
+            "\"key_expiration_time\":0,\"hash_left_16bits\":\"abcd\","
+            "\"signature\":\"000101\",\"subpackets\":["
+            "{\"tag\":2,\"critical\":false,\"hashed\":true,\"length\":4,"
+            "\"contents\":\"00000100\"},"
+            "{\"tag\":16,\"critical\":false,\"hashed\":false,\"length\":8,"
+            "\"contents\":\"0102030405060708\"}]}\n"
+            "{\"tag\":13,\"type\":\"user_id\",\"length\":8,"
+            "\"user_id\":\"A \\\"B\\\"\\n\xC3\xA9\"}\n"
+            "{\"tag\":13,\"type\":\"user_id\",\"length\":1,"
+            "\"user_id_hex\":\"ff\"}\n"
+            "{\"tag\":61,\"type\":\"unknown\",\"length\":1,"
+            "\"contents\":\"00\"}\n");
+
+  const std::string binary = dump(kDumpBinary);
+  ASSERT_EQ(binary.substr(0, 8), "P4880DP1");
+  // The user ID, the unknown packet, and a hashed subpacket.
+  ASSERT_NE(binary.find(std::string("\x0D\0\0\0\x0D\x10\0\0\0\x08", 10)
+                        + user_id), std::string::npos);
+  ASSERT_EQ(binary.substr(binary.length() - 11),
+            std::string("\x3D\0\0\0\x06\x11\0\0\0\x01\0", 11));
+  ASSERT_NE(binary.find(std::string("\x0D\0\0\0\x0E\x02\0\0\0\x09"
+                                    "\x11\0\0\0\x04\0\0\x01\0", 19)),
+            std::string::npos);
+}
+
+TEST(Dump, IsUTF8) {
+  ASSERT_TRUE(is_utf8(
+      ustring((const uint8_t*)"A \xC3\xA9 \xF0\x9F\x94\x91", 9)));
+  // A lone continuation, a truncated sequence, an overlong form and a
+  // surrogate.
+  ASSERT_FALSE(is_utf8(ustring{0x80}));
+  ASSERT_FALSE(is_utf8(ustring{'a', 0xC3}));
+  ASSERT_FALSE(is_utf8(ustring{0xC0, 0xAF}));
+  ASSERT_FALSE(is_utf8(ustring{0xED, 0xA0, 0x80}));
+}
+
+}
+
+#endif
@@ -1,4 +1,6 @@
+#include <cstring>
 #include <stdexcept>
+#include <string>
 
 #include <boost/format.hpp>
 
@@ -17,7 +19,7 @@ format_error::format_error(std::size_t position, std::string error)
       position_(position) {}
 
 
-std::size_t format_error::position() {
+std::size_t format_error::position() const {
   return position_;
 }
 
@@ -45,8 +47,119 @@ unsupported_feature_error::unsupported_feature_error(
 invalid_packet_error::invalid_packet_error(std::string problem)
     : format_error(-1, problem) {}
 
+limit_error::limit_error(std::size_t position, std::string limit)
+    : format_error(position, (format("%1% exceeded") % limit).str()) {}
+
 wrong_algorithm_error::wrong_algorithm_error()
     : std::logic_error("Wrong algorithm code.") {
 }
 
+read_error::read_error(std::string path, int error_number)
+    : std::runtime_error((format(
+          "Could not read %1%: %2%.") % path % strerror(error_number)).str()) {}
+
+write_error::write_error(int error_number)
+    : std::runtime_error((format(
+          "Write failed: %1%.") % strerror(error_number)).str()) {}
+
+unencodable_packet_error::unencodable_packet_error(std::string problem)
+    : std::logic_error((format(
+          "Cannot encode packet: %1%.") % problem).str()) {}
+
+socket_error::socket_error(std::string path, int error_number)
+    : std::runtime_error((format("Socket %1%: %2%.")
+                          % path
+                          % (0 == error_number ? "protocol error"
+                                               : strerror(error_number)))
+                         .str()) {}
+
+memory_budget_error::memory_budget_error(std::size_t position)
+    : std::runtime_error((format(
+          "Memory budget exceeded at position %1%.") % position).str()) {}
+
+std::string error_message(const parse4880_error& error) {
+  if (const std::runtime_error* runtime =
+          dynamic_cast<const std::runtime_error*>(&error)) {
+    return runtime->what();
+  }
+  if (const std::logic_error* logic =
+          dynamic_cast<const std::logic_error*>(&error)) {
+    return logic->what();
+  }
+  return "Unknown error.";
+}
+
+void ThrowParseError(const ParseError& error) {
+  switch (error.status) {
+    case kParseInvalidHeader:
+      throw invalid_header_error(error.position);
+    case kParseHeaderTooShort:
+      throw packet_header_length_error(error.position);
+    case kParsePacketTooShort:
+      throw packet_length_error(error.position,
+                                error.claimed_length, error.actual_length);
+    case kParseOldPacket:
+      throw old_packet_error(error.position);
+    case kParseUnsupportedFeature:
+      throw unsupported_feature_error(error.position, error.detail);
+    case kParseWrongAlgorithm:
+      throw wrong_algorithm_error();
+    case kParseMemoryBudgetExceeded:
+      throw memory_budget_error(error.position);
+    case kParseLimitExceeded:
+      throw limit_error(error.position, error.detail);
+    case kParseInvalidPacket:
+    default:
+      throw invalid_packet_error(error.detail);
+  }
+}
+
+ParseError ParseErrorFor(const parse4880_error& error) {
+  if (dynamic_cast<const wrong_algorithm_error*>(&error)) {
+    return ParseError(kParseWrongAlgorithm, 0, "wrong algorithm");
+  }
+  if (dynamic_cast<const memory_budget_error*>(&error)) {
+    return ParseError(kParseMemoryBudgetExceeded, 0, "memory budget exceeded");
+  }
+  const format_error* format = dynamic_cast<const format_error*>(&error);
+  if (nullptr == format) {
+    return ParseError(kParseInvalidPacket, 0, "invalid packet");
+  }
+  const std::size_t position = format->position();
+  if (dynamic_cast<const invalid_header_error*>(&error)) {
+    return ParseError(kParseInvalidHeader, position, "invalid packet header");
+  }
+  if (dynamic_cast<const packet_header_length_error*>(&error)) {
+    return ParseError(kParseHeaderTooShort, position,
+                      "packet header too short");
+  }
+  if (dynamic_cast<const packet_length_error*>(&error)) {
+    return ParseError(kParsePacketTooShort, position, "packet too short");
+  }
+  if (dynamic_cast<const old_packet_error*>(&error)) {
+    return ParseError(kParseOldPacket, position, "old-format packet");
+  }
+  if (dynamic_cast<const unsupported_feature_error*>(&error)) {
+    return ParseError(kParseUnsupportedFeature, position,
+                      "unsupported feature");
+  }
+  if (dynamic_cast<const limit_error*>(&error)) {
+    return ParseError(kParseLimitExceeded, position, "limit");
+  }
+  return ParseError(kParseInvalidPacket, position, "invalid packet");
+}
+
+cache_error::cache_error(std::string path)
+    : std::runtime_error((format(
+          "Could not write verification cache %1%.") % path).str()) {}
+
+index_error::index_error(std::string path)
+    : std::runtime_error((format(
+          "Invalid user ID index %1%.") % path).str()) {}
+
+crypto_error::crypto_error(std::string operation, int error_code)
+    : std::runtime_error((format(
+          "%1% failed with error -0x%2$04X.") % operation % -error_code)
+                         .str()) {}
+
 }
@@ -0,0 +1,67 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "exceptions.h"
+#include "mapped_file.h"
+
+namespace parse4880 {
+
+MappedFile::MappedFile(const std::string& path)
+    : data_(nullptr), size_(0) {
+  int fd = open(path.c_str(), O_RDONLY); // Flawfinder: ignore
+  if (fd < 0) {
+    throw read_error(path, errno);
+  }
+
+  try {
+    Map(fd, path);
+  }
+  catch (...) {
+    close(fd);
+    throw;
+  }
+  close(fd);
+}
+
+MappedFile::MappedFile(int fd)
+    : data_(nullptr), size_(0) {
+  Map(fd, (format("descriptor %1%") % fd).str());
+}
+
+void MappedFile::Map(int fd, const std::string& name) {
+  struct stat file_status;
+  if (fstat(fd, &file_status) < 0) {
+    throw read_error(name, errno);
+  }
+  size_ = file_status.st_size;
+
+  // An empty file cannot be mapped, but it has no data to be read anyway.
+  if (size_ > 0) {
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == mapping) {
+      throw read_error(name, errno);
+    }
+    data_ = static_cast<const uint8_t*>(mapping);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (nullptr != data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+}
+
+const uint8_t* MappedFile::data() const {
+  return data_;
+}
+
+std::size_t MappedFile::size() const {
+  return size_;
+}
+
+}
@@ -0,0 +1,250 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#include "exceptions.h"
+#include "packet.h"
+#include "parser.h"
+#endif
+
+#include "memory_accounting.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+// Packet tags are at most six bits long.
+const std::size_t kTagCount = 64;
+
+struct Account {
+  std::atomic<std::size_t> bytes;
+  std::atomic<std::size_t> objects;
+  std::atomic<std::size_t> peak_bytes;
+};
+
+// Zero-initialised, as these have static storage duration.
+Account subsystem_accounts[kMemorySubsystemCount];
+Account tag_accounts[kTagCount];
+Account total_account;
+std::atomic<std::size_t> budget(0);
+
+void Raise(std::atomic<std::size_t>* peak, std::size_t value) {
+  std::size_t current = peak->load(std::memory_order_relaxed);
+  while (current < value
+         && !peak->compare_exchange_weak(current, value,
+                                         std::memory_order_relaxed)) {
+  }
+}
+
+void Add(Account* account, std::size_t bytes) {
+  account->objects.fetch_add(1, std::memory_order_relaxed);
+  Raise(&account->peak_bytes,
+        account->bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void Subtract(Account* account, std::size_t bytes) {
+  account->objects.fetch_sub(1, std::memory_order_relaxed);
+  account->bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryUsage Read(const Account& account) {
+  MemoryUsage usage;
+  usage.bytes = account.bytes.load(std::memory_order_relaxed);
+  usage.objects = account.objects.load(std::memory_order_relaxed);
+  usage.peak_bytes = account.peak_bytes.load(std::memory_order_relaxed);
+  return usage;
+}
+
+void ResetPeak(Account* account) {
+  account->peak_bytes.store(account->bytes.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+}
+
+}
+
+/// @endcond
+
+MemoryUsage memory_usage(MemorySubsystem subsystem) {
+  return Read(subsystem_accounts[subsystem]);
+}
+
+MemoryUsage packet_memory_usage(uint8_t tag) {
+  return Read(tag_accounts[tag % kTagCount]);
+}
+
+MemoryUsage total_memory_usage() {
+  return Read(total_account);
+}
+
+void reset_memory_peaks() {
+  for (std::size_t i = 0; i < kMemorySubsystemCount; i++) {
+    ResetPeak(&subsystem_accounts[i]);
+  }
+  for (std::size_t i = 0; i < kTagCount; i++) {
+    ResetPeak(&tag_accounts[i]);
+  }
+  ResetPeak(&total_account);
+}
+
+void set_memory_budget(std::size_t bytes) {
+  budget.store(bytes, std::memory_order_relaxed);
+}
+
+std::size_t memory_budget() {
+  return budget.load(std::memory_order_relaxed);
+}
+
+bool memory_budget_exceeded() {
+  std::size_t limit = budget.load(std::memory_order_relaxed);
+  return 0 != limit
+      && total_account.bytes.load(std::memory_order_relaxed) > limit;
+}
+
+bool memory_budget_allows(std::size_t bytes) {
+  std::size_t limit = budget.load(std::memory_order_relaxed);
+  if (0 == limit) {
+    return true;
+  }
+  std::size_t total = total_account.bytes.load(std::memory_order_relaxed);
+  return total <= limit && bytes <= limit - total;
+}
+
+ScopedMemoryBudget::ScopedMemoryBudget(std::size_t bytes)
+    : previous_(memory_budget()) {
+  set_memory_budget(bytes);
+}
+
+ScopedMemoryBudget::~ScopedMemoryBudget() {
+  set_memory_budget(previous_);
+}
+
+MemoryCharge::MemoryCharge()
+    : subsystem_(kMemoryPackets), tag_(0), bytes_(0), charged_(false) {}
+
+MemoryCharge::MemoryCharge(const MemoryCharge& rhs) : MemoryCharge() {
+  *this = rhs;
+}
+
+MemoryCharge& MemoryCharge::operator=(const MemoryCharge& rhs) {
+  if (this != &rhs) {
+    if (rhs.charged_) {
+      Reset(rhs.subsystem_, rhs.tag_, rhs.bytes_);
+    }
+    else {
+      Release();
+    }
+  }
+  return *this;
+}
+
+MemoryCharge::~MemoryCharge() {
+  Release();
+}
+
+void MemoryCharge::Reset(MemorySubsystem subsystem, uint8_t tag,
+                         std::size_t bytes) {
+  Release();
+  subsystem_ = subsystem;
+  tag_ = tag % kTagCount;
+  bytes_ = bytes;
+  charged_ = true;
+
+  Add(&subsystem_accounts[subsystem_], bytes_);
+  if (kMemoryPackets == subsystem_) {
+    Add(&tag_accounts[tag_], bytes_);
+  }
+  Add(&total_account, bytes_);
+}
+
+void MemoryCharge::Release() {
+  if (!charged_) {
+    return;
+  }
+  Subtract(&subsystem_accounts[subsystem_], bytes_);
+  if (kMemoryPackets == subsystem_) {
+    Subtract(&tag_accounts[tag_], bytes_);
+  }
+  Subtract(&total_account, bytes_);
+  charged_ = false;
+}
+
+}
+
+#ifdef INCLUDE_TESTS
+
+namespace parse4880 {
+
+TEST(MemoryAccounting, ChargesAndBudget) {
+  const MemoryUsage packets_before = memory_usage(kMemoryPackets);
+  const MemoryUsage user_ids_before = packet_memory_usage(13);
+  const MemoryUsage total_before = total_memory_usage();
+  std::size_t user_id_bytes;
+  {
+    UserIDPacket user_id(ustring(100, 'a'));
+    const MemoryUsage user_ids = packet_memory_usage(13);
+    ASSERT_EQ(user_ids.objects, user_ids_before.objects + 1);
+    ASSERT_GE(user_ids.bytes, user_ids_before.bytes + 100);
+    ASSERT_GE(user_ids.peak_bytes, user_ids.bytes);
+    user_id_bytes = user_ids.bytes - user_ids_before.bytes;
+
+    UserIDPacket copy(user_id);
+    ASSERT_EQ(packet_memory_usage(13).objects, user_ids_before.objects + 2);
+    ASSERT_EQ(memory_usage(kMemoryPackets).objects,
+              packets_before.objects + 2);
+  }
+  ASSERT_EQ(packet_memory_usage(13).objects, user_ids_before.objects);
+  ASSERT_EQ(packet_memory_usage(13).bytes, user_ids_before.bytes);
+  ASSERT_EQ(total_memory_usage().bytes, total_before.bytes);
+
+  // Three user ID packets, the third of which would exceed the budget.
+  ustring data;
+  for (int i = 0; i < 3; i++) {
+    data += ustring{0xCD, 100};
+    data += ustring(100, 'a');
+  }
+  ASSERT_EQ(parse(data).size(), 3);
+
+  // Each packet's charge includes what holds it.
+  ASSERT_GE(user_id_bytes, 100 + kPacketHolderOverhead);
+
+  const std::size_t budget_before = memory_budget();
+  {
+    // Room for two packets, but not for the third's contents.
+    ScopedMemoryBudget budget(total_before.bytes + user_id_bytes * 2 + 50);
+    ASSERT_TRUE(memory_budget_allows(user_id_bytes * 2));
+    ASSERT_FALSE(memory_budget_allows(user_id_bytes * 3));
+    ParseResult<std::list<std::shared_ptr<PGPPacket>>> result =
+        try_parse(data);
+    ASSERT_EQ(result.error.status, kParseMemoryBudgetExceeded);
+    ASSERT_EQ(result.error.position, 204);
+    ASSERT_THROW(parse(data), memory_budget_error);
+  }
+  ASSERT_EQ(memory_budget(), budget_before);
+  ASSERT_EQ(parse(data).size(), 3);
+
+  // A packet too large for the budget is refused from its length
+  // header, without being copied.
+  ustring large{0xCD, 0xFF, 0, 0, 0x4E, 0x20};
+  large += ustring(20000, 'a');
+  reset_memory_peaks();
+  {
+    ScopedMemoryBudget budget(total_before.bytes + 10000);
+    ParseResult<std::list<std::shared_ptr<PGPPacket>>> result =
+        try_parse(large);
+    ASSERT_EQ(result.error.status, kParseMemoryBudgetExceeded);
+    ASSERT_EQ(result.error.position, 0);
+    ASSERT_EQ(try_parse(large, [](std::shared_ptr<PGPPacket>) {
+                return true;
+              }).status, kParseMemoryBudgetExceeded);
+  }
+  ASSERT_LT(total_memory_usage().peak_bytes, total_before.bytes + 10000);
+  ASSERT_EQ(memory_budget(), budget_before);
+}
+
+}
+
+#endif
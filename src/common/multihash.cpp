@@ -0,0 +1,490 @@
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <vector>
+
+#include <mbedtls/md.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PARSE4880_MULTIHASH_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef INCLUDE_TESTS
+#include <random>
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "multihash.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+const std::size_t kLanes = 8;
+const std::size_t kBlockLength = 64;
+
+const uint32_t kSHA1IV[5] = {
+  0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+const uint32_t kSHA256IV[8] = {
+  0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+  0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+const uint32_t kSHA256K[64] = {
+  0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1,
+  0x923F82A4, 0xAB1C5ED5, 0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+  0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174, 0xE49B69C1, 0xEFBE4786,
+  0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+  0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147,
+  0x06CA6351, 0x14292967, 0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+  0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85, 0xA2BFE8A1, 0xA81A664B,
+  0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+  0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A,
+  0x5B9CCA4F, 0x682E6FF3, 0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+  0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2};
+
+/**
+ * The number of blocks in a message once it has been padded.
+ *
+ * SHA-1 and SHA-256 both append a one bit and then the message length
+ * as a 64-bit integer, padding to a multiple of 64 octets.
+ */
+std::size_t BlockCount(uint64_t length) {
+  return (length + 8) / kBlockLength + 1;
+}
+
+/**
+ * Produce the padded blocks of a message held in segments.
+ */
+template <typename Segment>
+class BlockReader {
+ public:
+  BlockReader(const Segment* segments, std::size_t count, uint64_t length)
+      : segments_(segments), count_(count), length_(length),
+        segment_(0), offset_(0), padded_(false) {
+  }
+
+  /**
+   * Copy the next block of the padded message.
+   *
+   * @param block  Set to the next 64 octets of the padded message.
+   */
+  void Next(uint8_t* block) {
+    std::size_t filled = 0;
+    while (filled < kBlockLength && segment_ < count_) {
+      const Segment& segment = segments_[segment_];
+      const std::size_t n =
+          std::min(kBlockLength - filled, segment.length - offset_);
+      memcpy(block + filled, segment.data + offset_, n);
+      filled += n;
+      offset_ += n;
+      if (offset_ == segment.length) {
+        segment_++;
+        offset_ = 0;
+      }
+    }
+    if (filled == kBlockLength) {
+      return;
+    }
+
+    memset(block + filled, 0, kBlockLength - filled);
+    if (!padded_) {
+      block[filled++] = 0x80;
+      padded_ = true;
+    }
+    if (filled <= kBlockLength - 8) {
+      const uint64_t bits = length_ * 8;
+      for (int i = 0; i < 8; i++) {
+        block[kBlockLength - 1 - i] = static_cast<uint8_t>(bits >> (8*i));
+      }
+    }
+  }
+
+ private:
+  const Segment* segments_;
+  std::size_t    count_;
+  uint64_t       length_;
+  std::size_t    segment_;
+  std::size_t    offset_;
+  bool           padded_;
+};
+
+#ifdef PARSE4880_MULTIHASH_AVX2
+
+#define PARSE4880_TARGET_AVX2 __attribute__((target("avx2")))
+
+bool HaveAVX2() {
+  static const bool have_avx2 = __builtin_cpu_supports("avx2");
+  return have_avx2;
+}
+
+inline uint32_t ReadBigEndian32(const uint8_t* data) {
+  return (static_cast<uint32_t>(data[0]) << 24)
+      | (static_cast<uint32_t>(data[1]) << 16)
+      | (static_cast<uint32_t>(data[2]) << 8)
+      | static_cast<uint32_t>(data[3]);
+}
+
+/**
+ * Gather the same word of eight blocks, one per lane.
+ */
+PARSE4880_TARGET_AVX2
+inline __m256i LoadWord(const uint8_t* const blocks[kLanes], int word) {
+  return _mm256_setr_epi32(
+      ReadBigEndian32(blocks[0] + 4*word), ReadBigEndian32(blocks[1] + 4*word),
+      ReadBigEndian32(blocks[2] + 4*word), ReadBigEndian32(blocks[3] + 4*word),
+      ReadBigEndian32(blocks[4] + 4*word), ReadBigEndian32(blocks[5] + 4*word),
+      ReadBigEndian32(blocks[6] + 4*word), ReadBigEndian32(blocks[7] + 4*word));
+}
+
+PARSE4880_TARGET_AVX2
+inline __m256i RotateRight(__m256i x, int n) {
+  return _mm256_or_si256(_mm256_srli_epi32(x, n),
+                         _mm256_slli_epi32(x, 32 - n));
+}
+
+PARSE4880_TARGET_AVX2
+inline __m256i Add(__m256i a, __m256i b) {
+  return _mm256_add_epi32(a, b);
+}
+
+PARSE4880_TARGET_AVX2
+inline __m256i Xor(__m256i a, __m256i b, __m256i c) {
+  return _mm256_xor_si256(_mm256_xor_si256(a, b), c);
+}
+
+PARSE4880_TARGET_AVX2
+inline __m256i Choose(__m256i x, __m256i y, __m256i z) {
+  return _mm256_xor_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z));
+}
+
+PARSE4880_TARGET_AVX2
+inline __m256i Majority(__m256i x, __m256i y, __m256i z) {
+  return _mm256_or_si256(_mm256_and_si256(x, y),
+                         _mm256_and_si256(z, _mm256_or_si256(x, y)));
+}
+
+/**
+ * Apply the SHA-1 compression function to eight blocks.
+ *
+ * @param state   The chaining values, word by word and then lane by
+ *                lane.
+ * @param blocks  The block for each lane.
+ */
+PARSE4880_TARGET_AVX2
+void SHA1Compress8(uint32_t state[5][kLanes],
+                   const uint8_t* const blocks[kLanes]) {
+  __m256i w[16];
+  for (int t = 0; t < 16; t++) {
+    w[t] = LoadWord(blocks, t);
+  }
+
+  __m256i s[5];
+  for (int i = 0; i < 5; i++) {
+    s[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state[i]));
+  }
+  __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4];
+
+  for (int t = 0; t < 80; t++) {
+    if (t >= 16) {
+      w[t & 15] = RotateRight(
+          _mm256_xor_si256(Xor(w[(t - 3) & 15], w[(t - 8) & 15],
+                               w[(t - 14) & 15]), w[t & 15]), 31);
+    }
+    __m256i f;
+    uint32_t k;
+    if (t < 20) {
+      f = Choose(b, c, d);
+      k = 0x5A827999;
+    }
+    else if (t < 40) {
+      f = Xor(b, c, d);
+      k = 0x6ED9EBA1;
+    }
+    else if (t < 60) {
+      f = Majority(b, c, d);
+      k = 0x8F1BBCDC;
+    }
+    else {
+      f = Xor(b, c, d);
+      k = 0xCA62C1D6;
+    }
+    const __m256i temp = Add(Add(RotateRight(a, 27), f),
+                             Add(Add(e, w[t & 15]),
+                                 _mm256_set1_epi32(static_cast<int>(k))));
+    e = d;
+    d = c;
+    c = RotateRight(b, 2);
+    b = a;
+    a = temp;
+  }
+
+  s[0] = Add(s[0], a);
+  s[1] = Add(s[1], b);
+  s[2] = Add(s[2], c);
+  s[3] = Add(s[3], d);
+  s[4] = Add(s[4], e);
+  for (int i = 0; i < 5; i++) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[i]), s[i]);
+  }
+}
+
+/**
+ * Apply the SHA-256 compression function to eight blocks.
+ *
+ * @param state   The chaining values, word by word and then lane by
+ *                lane.
+ * @param blocks  The block for each lane.
+ */
+PARSE4880_TARGET_AVX2
+void SHA256Compress8(uint32_t state[8][kLanes],
+                     const uint8_t* const blocks[kLanes]) {
+  __m256i w[16];
+  for (int t = 0; t < 16; t++) {
+    w[t] = LoadWord(blocks, t);
+  }
+
+  __m256i s[8];
+  for (int i = 0; i < 8; i++) {
+    s[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state[i]));
+  }
+  __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+  __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+  for (int t = 0; t < 64; t++) {
+    if (t >= 16) {
+      const __m256i w2 = w[(t - 2) & 15];
+      const __m256i w15 = w[(t - 15) & 15];
+      const __m256i sigma1 = Xor(RotateRight(w2, 17), RotateRight(w2, 19),
+                                 _mm256_srli_epi32(w2, 10));
+      const __m256i sigma0 = Xor(RotateRight(w15, 7), RotateRight(w15, 18),
+                                 _mm256_srli_epi32(w15, 3));
+      w[t & 15] = Add(Add(sigma1, w[(t - 7) & 15]), Add(sigma0, w[t & 15]));
+    }
+    const __m256i sum1 = Xor(RotateRight(e, 6), RotateRight(e, 11),
+                             RotateRight(e, 25));
+    const __m256i sum0 = Xor(RotateRight(a, 2), RotateRight(a, 13),
+                             RotateRight(a, 22));
+    const __m256i t1 = Add(Add(Add(h, sum1), Choose(e, f, g)),
+                           Add(w[t & 15], _mm256_set1_epi32(
+                               static_cast<int>(kSHA256K[t]))));
+    const __m256i t2 = Add(sum0, Majority(a, b, c));
+    h = g;
+    g = f;
+    f = e;
+    e = Add(d, t1);
+    d = c;
+    c = b;
+    b = a;
+    a = Add(t1, t2);
+  }
+
+  s[0] = Add(s[0], a);
+  s[1] = Add(s[1], b);
+  s[2] = Add(s[2], c);
+  s[3] = Add(s[3], d);
+  s[4] = Add(s[4], e);
+  s[5] = Add(s[5], f);
+  s[6] = Add(s[6], g);
+  s[7] = Add(s[7], h);
+  for (int i = 0; i < 8; i++) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[i]), s[i]);
+  }
+}
+
+#else
+
+bool HaveAVX2() {
+  return false;
+}
+
+#endif  // PARSE4880_MULTIHASH_AVX2
+
+}  // namespace
+
+/// @endcond
+
+MultiHasher::MultiHasher(Algorithm algorithm) : algorithm_(algorithm) {
+}
+
+std::size_t MultiHasher::Begin() {
+  Message message = {segments_.size(), 0, 0};
+  messages_.push_back(message);
+  return messages_.size() - 1;
+}
+
+void MultiHasher::Update(const uint8_t* data, std::size_t length) {
+  if (0 == length) {
+    return;
+  }
+  Segment segment = {data, length};
+  segments_.push_back(segment);
+  messages_.back().segment_count++;
+  messages_.back().length += length;
+}
+
+std::size_t MultiHasher::size() const {
+  return messages_.size();
+}
+
+const char* MultiHasher::implementation() {
+  return HaveAVX2() ? "avx2" : "scalar";
+}
+
+std::vector<ustring> MultiHasher::Finish() {
+  std::vector<ustring> digests(messages_.size());
+
+#ifdef PARSE4880_MULTIHASH_AVX2
+  if (HaveAVX2() && messages_.size() > 1) {
+    const std::size_t words = kSHA1 == algorithm_ ? 5 : 8;
+    const uint32_t* iv = kSHA1 == algorithm_ ? kSHA1IV : kSHA256IV;
+
+    // Hash messages of similar lengths together, so that few lanes
+    // sit idle while the longest message in a group is finished.
+    std::vector<std::size_t> order(messages_.size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [this](std::size_t a, std::size_t b) {
+                       return messages_[a].length < messages_[b].length;
+                     });
+
+    uint8_t buffers[kLanes][kBlockLength];
+    memset(buffers, 0, sizeof(buffers));
+    const uint8_t* blocks[kLanes];
+    for (std::size_t lane = 0; lane < kLanes; lane++) {
+      blocks[lane] = buffers[lane];
+    }
+
+    for (std::size_t first = 0; first < order.size(); first += kLanes) {
+      const std::size_t lanes = std::min(kLanes, order.size() - first);
+      std::vector<BlockReader<Segment>> readers;
+      std::size_t block_counts[kLanes] = {0};
+      uint32_t state[8][kLanes];
+      for (std::size_t lane = 0; lane < lanes; lane++) {
+        const Message& message = messages_[order[first + lane]];
+        readers.push_back(BlockReader<Segment>(
+            segments_.data() + message.first_segment,
+            message.segment_count, message.length));
+        block_counts[lane] = BlockCount(message.length);
+      }
+      for (std::size_t word = 0; word < words; word++) {
+        for (std::size_t lane = 0; lane < kLanes; lane++) {
+          state[word][lane] = iv[word];
+        }
+      }
+
+      // Lanes that have finished go on hashing stale blocks, which is
+      // harmless since their digests have already been taken.
+      const std::size_t block_count = block_counts[lanes - 1];
+      for (std::size_t block = 0; block < block_count; block++) {
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+          if (block < block_counts[lane]) {
+            readers[lane].Next(buffers[lane]);
+          }
+        }
+        if (kSHA1 == algorithm_) {
+          SHA1Compress8(state, blocks);
+        }
+        else {
+          SHA256Compress8(state, blocks);
+        }
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+          if (block + 1 != block_counts[lane]) {
+            continue;
+          }
+          ustring& digest = digests[order[first + lane]];
+          digest.resize(4 * words);
+          for (std::size_t word = 0; word < words; word++) {
+            for (int i = 0; i < 4; i++) {
+              digest[4*word + i] =
+                  static_cast<uint8_t>(state[word][lane] >> (24 - 8*i));
+            }
+          }
+        }
+      }
+    }
+
+    segments_.clear();
+    messages_.clear();
+    return digests;
+  }
+#endif  // PARSE4880_MULTIHASH_AVX2
+
+  const mbedtls_md_info_t* md_info = mbedtls_md_info_from_type(
+      kSHA1 == algorithm_ ? MBEDTLS_MD_SHA1 : MBEDTLS_MD_SHA256);
+  mbedtls_md_context_t md_ctx;
+  mbedtls_md_init(&md_ctx);
+  mbedtls_md_setup(&md_ctx, md_info, 0);
+  for (std::size_t i = 0; i < messages_.size(); i++) {
+    const Message& message = messages_[i];
+    mbedtls_md_starts(&md_ctx);
+    for (std::size_t j = 0; j < message.segment_count; j++) {
+      const Segment& segment = segments_[message.first_segment + j];
+      mbedtls_md_update(&md_ctx, segment.data, segment.length);
+    }
+    digests[i].resize(mbedtls_md_get_size(md_info));
+    mbedtls_md_finish(&md_ctx, &digests[i][0]);
+  }
+  mbedtls_md_free(&md_ctx);
+
+  segments_.clear();
+  messages_.clear();
+  return digests;
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(MultiHasher, MatchesMbedTLS) {
+  std::mt19937 generator(4880);
+  ustring data(300, 0);
+  for (std::size_t i = 0; i < data.length(); i++) {
+    data[i] = static_cast<uint8_t>(generator());
+  }
+
+  const MultiHasher::Algorithm algorithms[] = {
+    MultiHasher::kSHA1, MultiHasher::kSHA256};
+  for (int a = 0; a < 2; a++) {
+    const mbedtls_md_info_t* md_info = mbedtls_md_info_from_type(
+        MultiHasher::kSHA1 == algorithms[a]
+        ? MBEDTLS_MD_SHA1 : MBEDTLS_MD_SHA256);
+
+    // Every length around the padding boundaries, each message split
+    // into two segments.
+    MultiHasher hasher(algorithms[a]);
+    for (std::size_t length = 0; length < 140; length++) {
+      hasher.Begin();
+      hasher.Update(data.data(), length / 3);
+      hasher.Update(data.data() + 100, length - length / 3);
+    }
+    ASSERT_EQ(hasher.size(), 140);
+    std::vector<ustring> digests = hasher.Finish();
+    ASSERT_EQ(hasher.size(), 0);
+    ASSERT_EQ(digests.size(), 140);
+    for (std::size_t length = 0; length < 140; length++) {
+      ustring message = data.substr(0, length / 3)
+          + data.substr(100, length - length / 3);
+      ustring expected(mbedtls_md_get_size(md_info), 0);
+      mbedtls_md(md_info, message.data(), message.length(), &expected[0]);
+      ASSERT_EQ(digests[length], expected) << "length " << length;
+    }
+  }
+
+  // A lone message takes the scalar path.
+  MultiHasher hasher(MultiHasher::kSHA1);
+  hasher.Begin();
+  hasher.Update((const uint8_t*)"abc", 3);
+  ASSERT_EQ(hasher.Finish().front(), ustring((const uint8_t*)
+      "\xA9\x99\x3E\x36\x47\x06\x81\x6A\xBA\x3E"
+      "\x25\x71\x78\x50\xC2\x6C\x9C\xD0\xD8\x9D", 20));
+}
+
+#endif  // INCLUDE_TESTS
+
+}
@@ -3,6 +3,7 @@
 #include <string>
 #include <memory>
 #include <list>
+#include <utility>
 
 #include "boost/format.hpp"
 
@@ -10,30 +11,43 @@
 #include "packet.h"
 #include "exceptions.h"
 #include "parser.h"
+#include "trace.h"
 
 namespace parse4880 {
 
-PGPPacket::PGPPacket(ustring contents) : contents_(contents) {
+PGPPacket::PGPPacket(ustring contents) : contents_(std::move(contents)) {
+}
+
+void PGPPacket::ChargeMemory(MemorySubsystem subsystem, uint8_t tag,
+                             std::size_t object_size) {
+  memory_charge_.Reset(subsystem, tag,
+                       object_size + contents_.capacity()
+                       + kPacketHolderOverhead);
 }
 
 std::shared_ptr<PGPPacket> PGPPacket::ParsePacket(uint8_t tag,
-                                                  ustring packet) {
-  try {
-    switch (tag) {
-      case 2:
-        return std::shared_ptr<PGPPacket>(new SignaturePacket(packet));
-      case 6:
-        return std::shared_ptr<PGPPacket>(new PublicKeyPacket(packet));
-      case 13:
-        return std::shared_ptr<PGPPacket>(new UserIDPacket(packet));
-      case 14:
-        return std::shared_ptr<PGPPacket>(new PublicSubkeyPacket(packet));
-      default:
-        return std::shared_ptr<PGPPacket>(new UnknownPGPPacket(tag, packet));
-    }
-  } catch (parse4880_error e) {
+                                                  ustring packet,
+                                                  const ParseLimits& limits) {
+  ParseResult<std::shared_ptr<PGPPacket>> result =
+      TryParsePacket(tag, packet, limits);
+  if (!result.ok()) {
     return std::shared_ptr<PGPPacket>(new UnknownPGPPacket(tag, packet));
   }
+  return result.value;
+}
+
+ParseResult<std::shared_ptr<PGPPacket>> PGPPacket::TryParsePacket(
+    uint8_t tag, const ustring& packet, const ParseLimits& limits) {
+  TraceSpan span("parse", "packet");
+  span.SetArgument("tag", tag);
+  PARSE4880_PROBE2(packet, tag, packet.length());
+
+  ParseResult<std::shared_ptr<PGPPacket>> result;
+  result.value = packet_factory(tag)(tag, packet, limits, &result.error);
+  if (!result.ok()) {
+    result.value.reset();
+  }
+  return result;
 }
 
 const std::list<std::shared_ptr<PGPPacket>>& PGPPacket::subpackets() const {
@@ -4,6 +4,8 @@
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #ifdef INCLUDE_TESTS
 #include <gtest/gtest.h>
@@ -11,7 +13,11 @@
 
 #include "parser_types.h"
 #include "parser.h"
+#include "packet.h"
 #include "exceptions.h"
+#include "fields.h"
+#include "memory_accounting.h"
+#include "trace.h"
 
 namespace parse4880 {
 
@@ -37,82 +43,112 @@ struct find_length_result {
  * length record we have---one-octet, two-octet, five-octet, or a partial
  * record---then decode and return it.
  *
+ * Failures are reported through the return value rather than by
+ * exceptions, so that malformed input is no more expensive than good
+ * input.
+ *
  * @todo Deal with partial-length records.
  */
-struct find_length_result find_length_new(const ustring& string_data,
-                                          size_t field_position,
-                                          bool allow_partial,
-                                          size_t packet_start_position) {
-  struct find_length_result result;
-
+ParseError find_length_new(const uint8_t* data,
+                           size_t data_length,
+                           size_t field_position,
+                           bool allow_partial,
+                           size_t packet_start_position,
+                           struct find_length_result* result) {
   // Now we have to get the length.
-  if (string_data.length() < field_position + 1) {
-    throw packet_header_length_error(packet_start_position);
+  if (data_length < field_position + 1) {
+    return ParseError(kParseHeaderTooShort, packet_start_position);
   }
-  result.length = (unsigned char)string_data[field_position];
-  result.length_field_length = 1;
+  result->length = data[field_position];
+  result->length_field_length = 1;
 
   // If the packet length is less than 192, then it is equal to the first
   // octet and we are done.
-  if (result.length < 192) {
+  if (result->length < 192) {
     // Do nothing.
   }
   // If the first octet is from 192 to 223, then we have a two-octet length.
   // But if we don't allow partial packets (as in signature subpackets), then
   // this can go up to 254.
-  else if (result.length > 191 &&
-           ( ( allow_partial && result.length < 224) ||
-             (!allow_partial && result.length < 255)) ) {
+  else if (result->length > 191 &&
+           ( ( allow_partial && result->length < 224) ||
+             (!allow_partial && result->length < 255)) ) {
     // Check that the buffer is large enough
-    if (string_data.length() <= field_position + 1) {
-      throw packet_header_length_error(packet_start_position);
+    if (data_length <= field_position + 1) {
+      return ParseError(kParseHeaderTooShort, packet_start_position);
     }
     // The two-octet length is defined in RFC4880§4.2.2.2
-    result.length =
-        ( (string_data[field_position    ] - 192 ) << 8)
-        +  string_data[field_position + 1]
+    result->length =
+        ( (data[field_position    ] - 192 ) << 8)
+        +  data[field_position + 1]
         + 192;
-    result.length_field_length = 2;
+    result->length_field_length = 2;
   }
   // If the first octet is from 224 to 254, then we have a partial length
   // header.
-  else if (allow_partial && (result.length >= 224 && result.length < 255)) {
+  else if (allow_partial && (result->length >= 224 && result->length < 255)) {
     // TODO: Deal with these.
-    throw unsupported_feature_error(field_position,
-                                    "partial body lengths");
+    return ParseError(kParseUnsupportedFeature, field_position,
+                      "partial body lengths");
   }
   // If the first octet is 255, then we have a five-octet length.
   else {
     // Check that the buffer is large enough
-    if (string_data.length() < field_position + 5) {
-      throw packet_header_length_error(packet_start_position);
+    if (data_length < field_position + 5) {
+      return ParseError(kParseHeaderTooShort, packet_start_position);
     }
     // The five-octet length is defined in RFC4880§4.2.2.3
-    result.length =
-          ((uint64_t)string_data[field_position + 1] << 24)
-        + ((uint64_t)string_data[field_position + 2] << 16)
-        + ((uint64_t)string_data[field_position + 3] << 8)
-        +  (uint64_t)string_data[field_position + 4];
-    result.length_field_length = 5;
+    result->length =
+          ((uint64_t)data[field_position + 1] << 24)
+        + ((uint64_t)data[field_position + 2] << 16)
+        + ((uint64_t)data[field_position + 3] << 8)
+        +  (uint64_t)data[field_position + 4];
+    result->length_field_length = 5;
   }
-  
-  return result;
+
+  return ParseError();
 }
 
 #ifdef INCLUDE_TESTS
 
 TEST(PacketLengths, NewFormat) {
   struct find_length_result length;
-  length = find_length_new(ustring((uint8_t*)"\x64",1),0,true,0);
+  ASSERT_TRUE(find_length_new((uint8_t*)"\x64",1,0,true,0,&length).ok());
   ASSERT_EQ(length.length, 100);
 
-  length = find_length_new(ustring((uint8_t*)"\xC5\xFB",2),0,true,0);
+  ASSERT_TRUE(find_length_new((uint8_t*)"\xC5\xFB",2,0,true,0,&length).ok());
   ASSERT_EQ(length.length, 1723);
 
-  length = find_length_new(ustring((uint8_t*)"\xFF\x00\x01\x86\xA0",5),0,true,0);
+  ASSERT_TRUE(find_length_new((uint8_t*)"\xFF\x00\x01\x86\xA0",5,0,true,0,
+                              &length).ok());
   ASSERT_EQ(length.length, 100000);
 }
 
+TEST(PacketLengths, Truncated) {
+  struct find_length_result length;
+  ASSERT_EQ(find_length_new((uint8_t*)"\xC5",1,0,true,7,&length).status,
+            kParseHeaderTooShort);
+  ASSERT_EQ(find_length_new((uint8_t*)"\xC5",1,0,true,7,&length).position, 7);
+
+  ASSERT_EQ(find_length_new((uint8_t*)"\xE0",1,0,true,0,&length).status,
+            kParseUnsupportedFeature);
+}
+
+TEST(ByteView, Substr) {
+  const ustring data((const uint8_t*)"abcdef", 6);
+  const ByteView view(data);
+  ASSERT_EQ(view.substr(2), ustring((const uint8_t*)"cdef", 4));
+  ASSERT_EQ(view.substr(2, 3), ustring((const uint8_t*)"cde", 3));
+  ASSERT_EQ(view.substr(4, 10), ustring((const uint8_t*)"ef", 2));
+
+  // Positions beyond the end give an empty view at the end.
+  ASSERT_TRUE(view.substr(6).empty());
+  ASSERT_TRUE(view.substr(7).empty());
+  ASSERT_TRUE(view.substr(100, 3).empty());
+  ASSERT_EQ(view.substr(7).data(), view.end());
+  ASSERT_TRUE(ByteView().substr(2).empty());
+}
+
 #endif  // INCLUDE_TESTS
 
 
@@ -127,28 +163,31 @@ TEST(PacketLengths, NewFormat) {
  * The exception to this is where N=3.  Then, the packet
  * continues until the end of of the data.
  */
-struct find_length_result find_length_old(const ustring& data,
-                                          size_t field_position,
-                                          int length_type,
-                                          size_t packet_start_position) {
-  struct find_length_result result;
-
+ParseError find_length_old(const uint8_t* data,
+                           size_t data_length,
+                           size_t field_position,
+                           int length_type,
+                           size_t packet_start_position,
+                           struct find_length_result* result) {
   if (length_type == 3) {
-    result.length = data.length() - field_position;
-    result.length_field_length = 0;
+    result->length = data_length - field_position;
+    result->length_field_length = 0;
   }
   else {
-    result.length_field_length = 1 << length_type ;
+    result->length_field_length = 1 << length_type ;
     // Check that the buffer is large enough
-    if (data.length() <= field_position + result.length_field_length) {
-      throw packet_header_length_error(packet_start_position);
+    if (data_length <= field_position + result->length_field_length) {
+      return ParseError(kParseHeaderTooShort, packet_start_position);
     }
 
-    result.length = ReadInteger(data.substr(field_position,
-                                            result.length_field_length));
+    result->length = 0;
+    for (int i = 0; i < result->length_field_length; i++) {
+      result->length <<= 8;
+      result->length += data[field_position + i];
+    }
   }
-  
-  return result;
+
+  return ParseError();
 }
 
 } // namespace
@@ -173,6 +212,32 @@ ustring WriteInteger(uint64_t value, uint8_t length) {
 
 #ifdef INCLUDE_TESTS
 
+TEST(ScalarNumbers, FieldLayouts) {
+  typedef fields::Layout<fields::U8, fields::U32, fields::Octets<2>,
+                         fields::U16> TestLayout;
+  const uint8_t data[] = {0x04, 0x12, 0x34, 0x56, 0x78, 0xAB, 0xCD,
+                          0x01, 0x02, 0x00, 0x09, 0x01, 0xFF, 0x7F};
+
+  ASSERT_EQ(TestLayout::size(), 9);
+  ASSERT_TRUE(TestLayout::Fits(sizeof(data)));
+  ASSERT_FALSE(TestLayout::Fits(sizeof(data), 6));
+  ASSERT_EQ(TestLayout::Get<1>(data), 0x12345678);
+  ASSERT_EQ(TestLayout::Get<2>(data), data + 5);
+  ASSERT_EQ(TestLayout::Get<3>(data), 0x0102);
+
+  // A nine-bit MPI occupies two octets, leaving one over.
+  size_t position = TestLayout::size();
+  fields::Region mpi;
+  ASSERT_TRUE(fields::ReadPrefixed<fields::MPI>(data, sizeof(data),
+                                                &position, &mpi));
+  ASSERT_EQ(mpi.offset, 11);
+  ASSERT_EQ(mpi.length, 2);
+  ASSERT_EQ(position, 13);
+  ASSERT_FALSE(fields::ReadPrefixed<fields::MPI>(data, sizeof(data),
+                                                 &position, &mpi));
+  ASSERT_EQ(position, 13);
+}
+
 TEST(ScalarNumbers, RoundTrip) {
   for (int length = 1; length < 3; length++) {
     for (uint64_t i = 0; i < (uint64_t{1}<<(length*8))-1; i++) {
@@ -183,18 +248,21 @@ TEST(ScalarNumbers, RoundTrip) {
 
 #endif
 
-void parse(ustring data,
-           std::function<bool(std::shared_ptr<PGPPacket>)> callback) {
+ParseError scan(const uint8_t* data, std::size_t data_length,
+                std::function<bool(const PacketRecord&)> callback,
+                const ParseLimits& limits) {
   size_t packet_start_position = 0;
+  std::size_t packet_count = 0;
+  std::size_t total_length = 0;
   while(true) {
     // Check that we have enough data left.  We need at one byte for the
     // header and at least one byte for the length field.
-    if (data.length() < packet_start_position + 1) {
+    if (data_length < packet_start_position + 1) {
       break;
     }
 
-    if (data.length() < packet_start_position + 2) {
-      throw packet_header_length_error(packet_start_position);
+    if (data_length < packet_start_position + 2) {
+      return ParseError(kParseHeaderTooShort, packet_start_position);
     }
 
     // Check whether we have a valid new-style packet header.
@@ -211,80 +279,325 @@ void parse(ustring data,
     //
     // See RFC4880 §4.2.
     uint8_t header = data[packet_start_position];
-    uint8_t packet_tag;
-    int64_t packet_length = 0;
-    int     packet_length_length;
+    PacketRecord record;
+    struct find_length_result length;
+    ParseError error;
 
     // Bit seven should always be set
     if (0x80 != (header & 0x80)) {
-      throw invalid_header_error(packet_start_position);
+      return ParseError(kParseInvalidHeader, packet_start_position);
     }
     // Bit six is set if and only if we have a new-style packet.
     if (0x40 != (header & 0x40)) {
-      packet_tag = (header & 0x3C) >> 2;
+      record.tag = (header & 0x3C) >> 2;
       uint8_t length_type = header & 0x03;
 
-      struct find_length_result length
-          = find_length_old(data, packet_start_position+1, length_type,
-                            packet_start_position);
-
-      packet_length = length.length;
-      packet_length_length = length.length_field_length;
+      error = find_length_old(data, data_length, packet_start_position+1,
+                              length_type, packet_start_position, &length);
     }
     else {
       // First, we  extract the packet tag in bits [5:0]
-      packet_tag = header & 0x3F;
+      record.tag = header & 0x3F;
 
       // Next, we get the length.
-      struct find_length_result length
-          = find_length_new(data, packet_start_position+1, true,
-                            packet_start_position);
-
-      packet_length = length.length;
-      packet_length_length = length.length_field_length;
+      error = find_length_new(data, data_length, packet_start_position+1,
+                              true, packet_start_position, &length);
+    }
+    if (!error.ok()) {
+      return error;
     }
-      
+
     // Now that we know how long the packet should be, we can check that we
     // have enough data.
+    record.offset        = packet_start_position;
+    record.header_length = 1 + length.length_field_length;
+    record.length        = length.length;
+
     std::size_t packet_length_with_overhead =
-        1                     // Header
-        + packet_length_length  // Length
-        + packet_length;        // Data
-    
-    if (data.length() < packet_start_position+packet_length_with_overhead) {
-      throw packet_length_error(packet_start_position,
-                                packet_length_with_overhead,
-                                data.length() - packet_start_position);
+        record.header_length + record.length;
+
+    // The limits are checked before the length, so that a hostile
+    // packet is rejected however much of it has been received.
+    if (++packet_count > limits.max_packets) {
+      return ParseError(kParseLimitExceeded, packet_start_position,
+                        "packet count limit");
     }
-    // Finally, we can create the packet.
-    if (!callback(
-        PGPPacket::ParsePacket(packet_tag, data.substr(
-            packet_start_position + packet_length_length + 1, packet_length)))) {
-      packet_start_position += packet_length_with_overhead;
-      break;
+    if (record.length > limits.max_packet_length) {
+      return ParseError(kParseLimitExceeded, packet_start_position,
+                        "packet length limit");
+    }
+    total_length += record.length;
+    if (total_length > limits.max_total_length) {
+      return ParseError(kParseLimitExceeded, packet_start_position,
+                        "total length limit");
+    }
+
+    if (data_length < packet_start_position+packet_length_with_overhead) {
+      return ParseError(packet_start_position,
+                        packet_length_with_overhead,
+                        data_length - packet_start_position);
     }
 
     packet_start_position += packet_length_with_overhead;
+
+    if (!callback(record)) {
+      break;
+    }
   }
 
+  return ParseError();
 }
 
-std::list<std::shared_ptr<PGPPacket>> parse(ustring data) {
-  std::list<std::shared_ptr<PGPPacket>> parsed_packets;
-  parse(data, [&parsed_packets](std::shared_ptr<PGPPacket> packet) -> bool {
-      parsed_packets.push_back(std::move(packet));
-      return true;
-    });
-  return parsed_packets;
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+/**
+ * Check a packet's length against the memory budget, before its
+ * contents are copied.
+ */
+ParseError CheckBudget(const PacketRecord& record) {
+  if (!memory_budget_allows(record.length + kPacketHolderOverhead)) {
+    return ParseError(kParseMemoryBudgetExceeded, record.offset);
+  }
+  return ParseError();
+}
+
+/**
+ * Parse a packet found by scan().
+ *
+ * As PGPPacket::ParsePacket, a malformed packet is kept as an
+ * UnknownPGPPacket, but one that exceeds the limits or the memory
+ * budget fails the parse.
+ */
+ParseResult<std::shared_ptr<PGPPacket>> ParseRecord(
+    const PacketRecord& record, const ustring& contents,
+    const ParseLimits& limits) {
+  ParseResult<std::shared_ptr<PGPPacket>> result =
+      PGPPacket::TryParsePacket(record.tag, contents, limits);
+  if (kParseLimitExceeded == result.error.status) {
+    result.error.position = record.offset;
+    return result;
+  }
+  if (!result.ok()) {
+    result.error = ParseError();
+    result.value.reset(new UnknownPGPPacket(record.tag, contents));
+  }
+  if (memory_budget_exceeded()) {
+    result.error = ParseError(kParseMemoryBudgetExceeded, record.offset);
+    result.value.reset();
+  }
+  return result;
+}
+
+}
+
+/// @endcond
+
+ParseError try_parse(const ustring& data,
+                     std::function<bool(std::shared_ptr<PGPPacket>)> callback,
+                     const ParseLimits& limits) {
+  TraceSpan span("parse", "parse");
+  span.SetArgument("length", data.length());
+  PARSE4880_PROBE1(parse, data.length());
+  ParseError packet_error;
+  ParseError error = scan(
+      data.data(), data.length(),
+      [&data, &callback, &limits, &packet_error](const PacketRecord& record)
+          -> bool {
+        packet_error = CheckBudget(record);
+        if (!packet_error.ok()) {
+          return false;
+        }
+        // We have the packet's location, so can now create it.
+        ParseResult<std::shared_ptr<PGPPacket>> packet = ParseRecord(
+            record,
+            data.substr(record.offset + record.header_length, record.length),
+            limits);
+        if (!packet.ok()) {
+          packet_error = packet.error;
+          return false;
+        }
+        return callback(std::move(packet.value));
+      },
+      limits);
+  return packet_error.ok() ? error : packet_error;
+}
+
+TagMask::TagMask(std::initializer_list<uint8_t> tags) {
+  for (auto i = tags.begin(); i != tags.end(); i++) {
+    Set(*i);
+  }
+}
+
+TagMask TagMask::All() {
+  TagMask mask;
+  mask.bits_ = ~static_cast<uint64_t>(0);
+  return mask;
+}
+
+TagMask& TagMask::Set(uint8_t tag) {
+  bits_ |= static_cast<uint64_t>(1) << (tag & 0x3F);
+  return *this;
+}
+
+ParseError try_parse(const uint8_t* data, std::size_t length,
+                     const TagMask& mask,
+                     std::function<bool(std::shared_ptr<PGPPacket>)> callback,
+                     const ParseLimits& limits) {
+  TraceSpan span("parse", "parse");
+  span.SetArgument("length", length);
+  PARSE4880_PROBE1(parse, length);
+  ParseError packet_error;
+  ParseError error = scan(
+      data, length,
+      [data, &mask, &callback, &limits, &packet_error](
+          const PacketRecord& record) -> bool {
+        if (!mask.Test(record.tag)) {
+          return true;
+        }
+        packet_error = CheckBudget(record);
+        if (!packet_error.ok()) {
+          return false;
+        }
+        ParseResult<std::shared_ptr<PGPPacket>> packet = ParseRecord(
+            record,
+            ustring(data + record.offset + record.header_length,
+                    record.length),
+            limits);
+        if (!packet.ok()) {
+          packet_error = packet.error;
+          return false;
+        }
+        return callback(std::move(packet.value));
+      },
+      limits);
+  return packet_error.ok() ? error : packet_error;
+}
+
+void parse(const ustring& data, const TagMask& mask,
+           std::function<bool(std::shared_ptr<PGPPacket>)> callback,
+           const ParseLimits& limits) {
+  ParseError error = try_parse(data.data(), data.length(), mask, callback,
+                               limits);
+  if (!error.ok()) {
+    ThrowParseError(error);
+  }
+}
+
+ParseResult<std::list<std::shared_ptr<PGPPacket>>> try_parse(
+    const ustring& data, const ParseLimits& limits) {
+  ParseResult<std::list<std::shared_ptr<PGPPacket>>> result;
+  TraceSpan span("parse", "parse");
+  span.SetArgument("length", data.length());
+  PARSE4880_PROBE1(parse, data.length());
+
+  // Find every packet before parsing any, so that the fingerprints of
+  // all of the keys can be computed together.  This is done only for
+  // key packets whose built-in factories have not been replaced.
+  const bool batch_keys[2] = {
+    packet_factory(6) == builtin_packet_factory(6),
+    packet_factory(14) == builtin_packet_factory(14)
+  };
+  auto batched = [&batch_keys](uint8_t tag) -> bool {
+    return (6 == tag && batch_keys[0]) || (14 == tag && batch_keys[1]);
+  };
+  std::vector<PacketRecord> records;
+  std::vector<std::pair<std::size_t, std::size_t>> key_contents;
+  result.error = scan(
+      data.data(), data.length(),
+      [&records, &key_contents, &batched](const PacketRecord& record) -> bool {
+        records.push_back(record);
+        if (batched(record.tag)) {
+          key_contents.push_back(std::make_pair(
+              record.offset + record.header_length, record.length));
+        }
+        return true;
+      },
+      limits);
+  const std::vector<ustring> fingerprints =
+      PublicKeyPacket::FingerprintKeys(data.data(), key_contents);
+
+  std::size_t next_key = 0;
+  for (auto i = records.begin(); i != records.end(); i++) {
+    ParseError budget_error = CheckBudget(*i);
+    if (!budget_error.ok()) {
+      result.error = budget_error;
+      result.value.clear();
+      return result;
+    }
+    const ustring contents =
+        data.substr(i->offset + i->header_length, i->length);
+    if (!batched(i->tag)) {
+      ParseResult<std::shared_ptr<PGPPacket>> packet =
+          ParseRecord(*i, contents, limits);
+      if (!packet.ok()) {
+        result.error = packet.error;
+        if (kParseMemoryBudgetExceeded == result.error.status) {
+          result.value.clear();
+        }
+        return result;
+      }
+      result.value.push_back(std::move(packet.value));
+      continue;
+    }
+
+    ParseError error;
+    std::shared_ptr<PGPPacket> packet;
+    if (6 == i->tag) {
+      packet.reset(
+          new PublicKeyPacket(contents, fingerprints[next_key++], &error));
+    }
+    else {
+      packet.reset(
+          new PublicSubkeyPacket(contents, fingerprints[next_key++], &error));
+    }
+    if (!error.ok()) {
+      packet.reset(new UnknownPGPPacket(i->tag, contents));
+    }
+    result.value.push_back(packet);
+    if (memory_budget_exceeded()) {
+      result.error = ParseError(kParseMemoryBudgetExceeded, i->offset);
+      result.value.clear();
+      return result;
+    }
+  }
+  return result;
+}
+
+void parse(ustring data,
+           std::function<bool(std::shared_ptr<PGPPacket>)> callback,
+           const ParseLimits& limits) {
+  ParseError error = try_parse(data, callback, limits);
+  if (!error.ok()) {
+    ThrowParseError(error);
+  }
 }
 
-std::list<std::shared_ptr<PGPPacket>> parse_subpackets(ustring data) {
-  std::list<std::shared_ptr<PGPPacket>> subpackets;
+std::list<std::shared_ptr<PGPPacket>> parse(ustring data,
+                                            const ParseLimits& limits) {
+  ParseResult<std::list<std::shared_ptr<PGPPacket>>> result =
+      try_parse(data, limits);
+  if (!result.ok()) {
+    ThrowParseError(result.error);
+  }
+  return result.value;
+}
+
+ParseResult<std::list<std::shared_ptr<PGPPacket>>> try_parse_subpackets(
+    const ustring& data, const ParseLimits& limits) {
+  ParseResult<std::list<std::shared_ptr<PGPPacket>>> result;
+  std::list<std::shared_ptr<PGPPacket>>& subpackets = result.value;
   for (size_t packet_start_position = 0; packet_start_position < data.length();) {
     // First we need to extract the packet length.  This is a new-style
     // length, so it has a variable length itself.
-    struct find_length_result packet_length_result =
-        find_length_new(data, packet_start_position, false, -1);
+    struct find_length_result packet_length_result;
+    result.error = find_length_new(data.data(), data.length(),
+                                   packet_start_position, false, -1,
+                                   &packet_length_result);
+    if (!result.ok()) {
+      return result;
+    }
 
     // Now that we have decoded the length field, we can find the
     // full size of the packet plus header.
@@ -297,15 +610,29 @@ std::list<std::shared_ptr<PGPPacket>> parse_subpackets(ustring data) {
     // because the first octet of the packet is the subpacket tag.
     if (data.length() < packet_start_position + packet_length_with_overhead
         || packet_length_result.length == 0) {
-      throw packet_length_error(-1,
+      result.error = ParseError(-1,
                                 packet_length_with_overhead,
-                                data.length() - packet_start_position); 
+                                data.length() - packet_start_position);
+      return result;
+    }
+
+    if (subpackets.size() >= limits.max_subpackets) {
+      result.error = ParseError(kParseLimitExceeded, packet_start_position,
+                                "subpacket count limit");
+      return result;
     }
 
     // Extract the tag octet from the packet.
     uint8_t packet_tag =
         data[packet_start_position + packet_length_result.length_field_length];
 
+    if (!memory_budget_allows(packet_length_result.length
+                              + kPacketHolderOverhead)) {
+      result.error = ParseError(kParseMemoryBudgetExceeded,
+                                packet_start_position);
+      return result;
+    }
+
     // Push the newly-extracted packet into our return-value list.
     //
     // As yet we have not implemented proper container classes for the
@@ -317,13 +644,123 @@ std::list<std::shared_ptr<PGPPacket>> parse_subpackets(ustring data) {
         data.substr(packet_start_position
                     + packet_length_result.length_field_length
                     + 1,
-                    packet_length_result.length - 1))));
+                    packet_length_result.length - 1),
+        kMemorySubpackets)));
+    if (memory_budget_exceeded()) {
+      result.error = ParseError(kParseMemoryBudgetExceeded,
+                                packet_start_position);
+      return result;
+    }
 
     // Skip forward to the next packet.
     packet_start_position += packet_length_with_overhead;
   }
 
-  return subpackets;
+  return result;
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(Parse, NonThrowing) {
+  // A user-id packet followed by a header without bit seven set.
+  ParseResult<std::list<std::shared_ptr<PGPPacket>>> result =
+      try_parse(ustring((uint8_t*)"\xCD\x01X\x00\x00", 5));
+  ASSERT_EQ(result.error.status, kParseInvalidHeader);
+  ASSERT_EQ(result.error.position, 3);
+  ASSERT_EQ(result.value.size(), 1);
+
+  // A packet claiming more data than there is.
+  result = try_parse(ustring((uint8_t*)"\xCD\x05XY", 4));
+  ASSERT_EQ(result.error.status, kParsePacketTooShort);
+  ASSERT_EQ(result.error.claimed_length, 7);
+  ASSERT_EQ(result.error.actual_length, 4);
+
+  ASSERT_THROW(parse(ustring((uint8_t*)"\xCD\x05XY", 4)),
+               packet_length_error);
+}
+
+TEST(Parse, TagMask) {
+  // A user ID, an unknown packet, and another user ID.
+  ustring data((uint8_t*)"\xCD\x01X\xFE\x02YZ\xCD\x01W", 10);
+
+  std::list<std::shared_ptr<PGPPacket>> packets;
+  parse(data, TagMask({13}), [&packets](std::shared_ptr<PGPPacket> packet) {
+      packets.push_back(std::move(packet));
+      return true;
+    });
+  ASSERT_EQ(packets.size(), 2);
+  ASSERT_EQ(packets.back()->contents(), ustring((uint8_t*)"W", 1));
+
+  // Packets that are skipped must still be well-formed.
+  ASSERT_EQ(try_parse(data.data(), data.length() - 1, TagMask({2}),
+                      [](std::shared_ptr<PGPPacket>) { return true; }).status,
+            kParsePacketTooShort);
+  ASSERT_TRUE(TagMask::All().Test(63));
+  ASSERT_FALSE(TagMask().Test(0));
+}
+
+TEST(Parse, Limits) {
+  // A v4 signature with three hashed subpackets and one unhashed.
+  const ustring signature{
+      0x04, 0x13, 0x01, 0x08,
+      0x00, 0x0E, 0x05, 0x02, 0, 0, 0, 1,
+                  0x05, 0x03, 0, 0, 0, 2,
+                  0x01, 0x1B,
+      0x00, 0x0A, 0x09, 0x10, 1, 2, 3, 4, 5, 6, 7, 8,
+      0xAB, 0xCD, 0x00, 0x01, 0x01};
+  ustring data{0xC2, static_cast<uint8_t>(signature.length())};
+  data += signature;
+  data += ustring{0xCD, 0x01, 'X'};
+
+  ParseLimits limits;
+  ASSERT_TRUE(try_parse(data, limits).ok());
+  limits.max_subpackets = 4;
+  ASSERT_TRUE(try_parse(data, limits).ok());
+  ASSERT_EQ(parse(data, limits).front()->subpackets().size(), 4);
+
+  // The limit on subpackets covers both areas together.
+  limits.max_subpackets = 3;
+  ParseResult<std::list<std::shared_ptr<PGPPacket>>> result =
+      try_parse(data, limits);
+  ASSERT_EQ(result.error.status, kParseLimitExceeded);
+  ASSERT_EQ(result.error.position, 0);
+  ASSERT_THROW(parse(data, limits), limit_error);
+  ASSERT_EQ(try_parse(data, [](std::shared_ptr<PGPPacket>) { return true; },
+                      limits).status,
+            kParseLimitExceeded);
+
+  limits = ParseLimits();
+  limits.max_packets = 1;
+  result = try_parse(data, limits);
+  ASSERT_EQ(result.error.status, kParseLimitExceeded);
+  ASSERT_EQ(result.error.position, 2 + signature.length());
+  ASSERT_EQ(result.value.size(), 1);
+
+  limits = ParseLimits();
+  limits.max_packet_length = signature.length() - 1;
+  ASSERT_EQ(try_parse(data, limits).error.status, kParseLimitExceeded);
+
+  limits = ParseLimits();
+  limits.max_total_length = signature.length();
+  ASSERT_EQ(try_parse(data, limits).error.status, kParseLimitExceeded);
+
+  // A huge length is rejected by the limit before the data runs out.
+  const ustring huge{0xC2, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0, 0x04};
+  ASSERT_EQ(try_parse(huge).error.status, kParsePacketTooShort);
+  ASSERT_EQ(try_parse(huge, ParseLimits::Untrusted()).error.status,
+            kParseLimitExceeded);
+}
+
+#endif  // INCLUDE_TESTS
+
+std::list<std::shared_ptr<PGPPacket>> parse_subpackets(
+    ustring data, const ParseLimits& limits) {
+  ParseResult<std::list<std::shared_ptr<PGPPacket>>> result =
+      try_parse_subpackets(data, limits);
+  if (!result.ok()) {
+    ThrowParseError(result.error);
+  }
+  return std::move(result.value);
 }
 
 }
@@ -0,0 +1,248 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <sstream>
+#include <gtest/gtest.h>
+#endif
+
+#include "exceptions.h"
+#include "trace.h"
+
+namespace parse4880 {
+
+namespace trace_internal {
+std::atomic<bool> enabled(false);
+}
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+// Each thread stops recording once it has this many spans, so that a
+// forgotten trace cannot exhaust memory.
+const std::size_t kMaximumSpansPerThread = 1 << 22;
+
+struct TraceEvent {
+  const char* category;
+  const char* name;
+  const char* argument_name;
+  int64_t     argument;
+  int64_t     start;
+  int64_t     duration;
+};
+
+/**
+ * The spans recorded by one thread.
+ *
+ * The mutex is only contended while the trace is being cleared or
+ * written.
+ */
+struct ThreadBuffer {
+  std::mutex              mutex;
+  std::vector<TraceEvent> events;
+  uint32_t                thread_id;
+};
+
+std::mutex& RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<std::shared_ptr<ThreadBuffer>>& Registry() {
+  static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  return buffers;
+}
+
+ThreadBuffer& LocalBuffer() {
+  static thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    buffer->thread_id = Registry().size() + 1;
+    Registry().push_back(buffer);
+  }
+  return *buffer;
+}
+
+int64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::atomic<int64_t> epoch(0);
+
+/**
+ * Write a string as a JSON string literal.
+ */
+void WriteJSONString(std::ostream& out, const char* value) {
+  out << '"';
+  for (const char* c = value; *c != '\0'; c++) {
+    if ('"' == *c || '\\' == *c) {
+      out << '\\' << *c;
+    }
+    else if (static_cast<unsigned char>(*c) < 0x20) {
+      char escaped[8]; // Flawfinder: ignore (fixed-length escape)
+      snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+      out << escaped;
+    }
+    else {
+      out << *c;
+    }
+  }
+  out << '"';
+}
+
+void WriteChromeTrace(std::ostream& out) {
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  const int process_id = getpid();
+  std::lock_guard<std::mutex> registry_lock(RegistryMutex());
+  for (auto i = Registry().begin(); i != Registry().end(); i++) {
+    std::lock_guard<std::mutex> lock((*i)->mutex);
+    for (auto e = (*i)->events.begin(); e != (*i)->events.end(); e++) {
+      out << (first ? "\n" : ",\n") << "{\"name\":";
+      first = false;
+      WriteJSONString(out, e->name);
+      out << ",\"cat\":";
+      WriteJSONString(out, e->category);
+      // Times are in microseconds, kept to nanosecond precision.
+      out << ",\"ph\":\"X\",\"ts\":" << e->start / 1000 << '.';
+      out.width(3);
+      out.fill('0');
+      out << e->start % 1000 << ",\"dur\":" << e->duration / 1000 << '.';
+      out.width(3);
+      out << e->duration % 1000 << ",\"pid\":" << process_id
+          << ",\"tid\":" << (*i)->thread_id;
+      if (nullptr != e->argument_name) {
+        out << ",\"args\":{";
+        WriteJSONString(out, e->argument_name);
+        out << ':' << e->argument << '}';
+      }
+      out << '}';
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+}  // namespace
+
+/// @endcond
+
+void start_tracing() {
+  {
+    // Forget threads that have exited, which hold no other reference
+    // to their buffers.
+    std::lock_guard<std::mutex> registry_lock(RegistryMutex());
+    std::vector<std::shared_ptr<ThreadBuffer>> live;
+    for (auto i = Registry().begin(); i != Registry().end(); i++) {
+      if (1 == i->use_count()) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock((*i)->mutex);
+      (*i)->events.clear();
+      live.push_back(*i);
+    }
+    Registry().swap(live);
+  }
+  epoch.store(Now());
+  trace_internal::enabled.store(true);
+}
+
+void stop_tracing() {
+  trace_internal::enabled.store(false);
+}
+
+std::size_t traced_span_count() {
+  std::size_t count = 0;
+  std::lock_guard<std::mutex> registry_lock(RegistryMutex());
+  for (auto i = Registry().begin(); i != Registry().end(); i++) {
+    std::lock_guard<std::mutex> lock((*i)->mutex);
+    count += (*i)->events.size();
+  }
+  return count;
+}
+
+void write_chrome_trace(const std::string& path) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw write_error(errno);
+  }
+  WriteChromeTrace(out);
+  out.flush();
+  if (!out) {
+    throw write_error(errno);
+  }
+}
+
+void TraceSpan::Begin(const char* category, const char* name) {
+  category_ = category;
+  name_ = name;
+  argument_name_ = nullptr;
+  argument_ = 0;
+  start_ = Now();
+}
+
+void TraceSpan::End() {
+  const int64_t end = Now();
+  const int64_t epoch_time = epoch.load(std::memory_order_relaxed);
+  // A span begun before the trace was restarted belongs to no trace.
+  if (start_ < epoch_time) {
+    return;
+  }
+  TraceEvent event = {category_, name_, argument_name_, argument_,
+                      start_ - epoch_time, end - start_};
+
+  ThreadBuffer& buffer = LocalBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if (buffer.events.size() < kMaximumSpansPerThread) {
+    buffer.events.push_back(event);
+  }
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(Trace, ChromeTrace) {
+  {
+    TraceSpan ignored("test", "before");
+  }
+
+  start_tracing();
+  {
+    TraceSpan outer("test", "outer");
+    outer.SetArgument("length", 42);
+    TraceSpan inner("test", "in\"ner");
+  }
+  stop_tracing();
+  {
+    TraceSpan ignored("test", "after");
+  }
+  ASSERT_EQ(traced_span_count(), 2);
+
+  std::ostringstream out;
+  WriteChromeTrace(out);
+  const std::string trace = out.str();
+  ASSERT_EQ(trace.find("before"), std::string::npos);
+  ASSERT_EQ(trace.find("after"), std::string::npos);
+  ASSERT_NE(trace.find("\"name\":\"outer\",\"cat\":\"test\",\"ph\":\"X\""),
+            std::string::npos);
+  ASSERT_NE(trace.find("\"args\":{\"length\":42}"), std::string::npos);
+  ASSERT_NE(trace.find("\"in\\\"ner\""), std::string::npos);
+
+  start_tracing();
+  ASSERT_EQ(traced_span_count(), 0);
+  stop_tracing();
+}
+
+#endif  // INCLUDE_TESTS
+
+}
@@ -0,0 +1,342 @@
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <sstream>
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "exceptions.h"
+#include "writer.h"
+
+namespace parse4880 {
+
+namespace {
+
+#ifdef IOV_MAX
+const std::size_t kMaxSegmentsPerWrite = IOV_MAX;
+#else
+const std::size_t kMaxSegmentsPerWrite = 1024;
+#endif
+
+/**
+ * Encode a header into a fixed-size buffer.
+ *
+ * @return The length of the encoded header.
+ *
+ * @throw unencodable_packet_error  If the tag or the length does not
+ *                                  fit in a header.
+ */
+std::size_t EncodePacketHeader(uint8_t tag, uint64_t length,
+                               std::array<uint8_t, 6>* header) {
+  if (tag > 0x3F) {
+    throw unencodable_packet_error("tag above 63");
+  }
+  if (length > 0xFFFFFFFF) {
+    throw unencodable_packet_error("body of 2^32 octets or more");
+  }
+
+  // A new-format header has both of the top bits set.
+  (*header)[0] = 0xC0 | tag;
+
+  // The three length encodings are defined in RFC4880§4.2.2.
+  if (length < 192) {
+    (*header)[1] = static_cast<uint8_t>(length);
+    return 2;
+  }
+  else if (length < 8384) {
+    (*header)[1] = static_cast<uint8_t>(((length - 192) >> 8) + 192);
+    (*header)[2] = static_cast<uint8_t>((length - 192) & 0xFF);
+    return 3;
+  }
+  else {
+    (*header)[1] = 0xFF;
+    (*header)[2] = static_cast<uint8_t>((length >> 24) & 0xFF);
+    (*header)[3] = static_cast<uint8_t>((length >> 16) & 0xFF);
+    (*header)[4] = static_cast<uint8_t>((length >>  8) & 0xFF);
+    (*header)[5] = static_cast<uint8_t>( length        & 0xFF);
+    return 6;
+  }
+}
+
+}  // namespace
+
+ustring WritePacketHeader(uint8_t tag, uint64_t length) {
+  std::array<uint8_t, 6> header;
+  std::size_t header_length = EncodePacketHeader(tag, length, &header);
+  return ustring(header.data(), header_length);
+}
+
+PacketWriter::PacketWriter() : size_(0) {}
+
+void PacketWriter::Append(const std::shared_ptr<PGPPacket>& packet) {
+  const ustring& contents = packet->contents();
+
+  // The deque never moves its elements, so the segment can point
+  // straight into it.
+  std::array<uint8_t, 6> header;
+  std::size_t header_length =
+      EncodePacketHeader(packet->tag(), contents.length(), &header);
+  headers_.push_back(header);
+
+  Segment header_segment = {headers_.back().data(), header_length};
+  segments_.push_back(header_segment);
+  if (contents.length() > 0) {
+    Segment contents_segment = {contents.data(), contents.length()};
+    segments_.push_back(contents_segment);
+  }
+
+  packets_.push_back(packet);
+  size_ += header_length + contents.length();
+}
+
+const std::vector<PacketWriter::Segment>& PacketWriter::segments() const {
+  return segments_;
+}
+
+std::size_t PacketWriter::size() const {
+  return size_;
+}
+
+void PacketWriter::WriteTo(int fd) const {
+  std::vector<struct iovec> iov;
+  iov.reserve(std::min(segments_.size(), kMaxSegmentsPerWrite));
+
+  std::size_t next_segment = 0;
+  while (next_segment < segments_.size()) {
+    iov.clear();
+    for (; next_segment < segments_.size()
+           && iov.size() < kMaxSegmentsPerWrite; next_segment++) {
+      struct iovec segment;
+      segment.iov_base =
+          const_cast<uint8_t*>(segments_[next_segment].data);
+      segment.iov_len = segments_[next_segment].length;
+      iov.push_back(segment);
+    }
+
+    // writev may stop short, in which case we skip over whatever
+    // was written and go again.
+    std::size_t first = 0;
+    while (first < iov.size()) {
+      ssize_t written = writev(fd, &iov[first], iov.size() - first);
+      if (written < 0) {
+        if (EINTR == errno) {
+          continue;
+        }
+        throw write_error(errno);
+      }
+      // No segment is empty, so a write of nothing will not make
+      // progress if tried again.
+      if (0 == written) {
+        throw write_error(EIO);
+      }
+
+      std::size_t remaining = written;
+      while (first < iov.size() && remaining >= iov[first].iov_len) {
+        remaining -= iov[first].iov_len;
+        first++;
+      }
+      if (first < iov.size()) {
+        iov[first].iov_base =
+            static_cast<uint8_t*>(iov[first].iov_base) + remaining;
+        iov[first].iov_len -= remaining;
+      }
+    }
+  }
+}
+
+void PacketWriter::WriteTo(std::ostream& stream) const {
+  for (auto segment = segments_.begin(); segment != segments_.end();
+       segment++) {
+    stream.write(reinterpret_cast<const char*>(segment->data),
+                 segment->length);
+    // A stream does not say why it failed.
+    if (!stream) {
+      throw write_error(EIO);
+    }
+  }
+}
+
+void PacketWriter::Clear() {
+  headers_.clear();
+  segments_.clear();
+  packets_.clear();
+  size_ = 0;
+}
+
+void WriteFilteredPackets(
+    const std::list<std::shared_ptr<PGPPacket>>& packets,
+    std::function<bool(const PGPPacket&, const ExportContext&)> predicate,
+    PacketWriter* writer) {
+  ExportContext context = {nullptr, nullptr};
+  bool key_kept = true;
+  bool component_kept = true;
+
+  for (auto i = packets.begin(); i != packets.end(); i++) {
+    const std::shared_ptr<PGPPacket>& packet = *i;
+    switch (packet->tag()) {
+      // A primary key starts a new key.
+      case 6:
+        context.primary_key =
+            dynamic_cast<const PublicKeyPacket*>(packet.get());
+        context.component = packet.get();
+        key_kept = predicate(*packet, context);
+        component_kept = key_kept;
+        if (key_kept) {
+          writer->Append(packet);
+        }
+        break;
+
+      // User IDs, user attributes and subkeys start a new component
+      // of the current key.
+      case 13:
+      case 14:
+      case 17:
+        context.component = packet.get();
+        component_kept = key_kept && predicate(*packet, context);
+        if (component_kept) {
+          writer->Append(packet);
+        }
+        break;
+
+      // Anything else belongs to the current component.
+      default:
+        if (component_kept && predicate(*packet, context)) {
+          writer->Append(packet);
+        }
+        break;
+    }
+  }
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(PacketWriter, RoundTrip) {
+  std::list<std::shared_ptr<PGPPacket>> packets;
+  const std::size_t lengths[] = {0, 191, 192, 8383, 8384, 100000};
+  for (std::size_t i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++) {
+    packets.push_back(std::shared_ptr<PGPPacket>(
+        new UnknownPGPPacket(60, ustring(lengths[i], 'x'))));
+  }
+
+  PacketWriter writer;
+  for (auto i = packets.begin(); i != packets.end(); i++) {
+    writer.Append(*i);
+  }
+
+  ustring output;
+  for (auto i = writer.segments().begin(); i != writer.segments().end(); i++) {
+    output.append(i->data, i->length);
+  }
+  ASSERT_EQ(output.length(), writer.size());
+
+  std::ostringstream stream;
+  writer.WriteTo(stream);
+  ASSERT_EQ(stream.str().length(), writer.size());
+  // A stream that cannot be written must not look like success.
+  std::ostream broken(nullptr);
+  ASSERT_THROW(writer.WriteTo(broken), write_error);
+
+  std::list<std::shared_ptr<PGPPacket>> reparsed = parse(output);
+  ASSERT_EQ(reparsed.size(), packets.size());
+  for (auto i = packets.begin(), j = reparsed.begin(); i != packets.end();
+       i++, j++) {
+    ASSERT_EQ((*j)->tag(), 60);
+    ASSERT_EQ((*j)->contents(), (*i)->contents());
+  }
+
+  ASSERT_THROW(WritePacketHeader(64, 0), unencodable_packet_error);
+  ASSERT_THROW(WritePacketHeader(2, 0x100000000ULL),
+               unencodable_packet_error);
+  ASSERT_EQ(WritePacketHeader(2, 0xFFFFFFFF).length(), 6);
+}
+
+TEST(PacketWriter, WriteFilteredPackets) {
+  auto key = [](uint8_t n) {
+    return std::shared_ptr<PGPPacket>(new PublicKeyPacket(
+        ustring((const uint8_t*)"\x04\0\0\0\0\x01", 6)
+        + ustring{0, 8, n, 0, 8, 3}));
+  };
+  auto packet = [](uint8_t tag, const char* contents) {
+    return std::shared_ptr<PGPPacket>(new UnknownPGPPacket(
+        tag, ustring((const uint8_t*)contents, strlen(contents))));
+  };
+  std::shared_ptr<PGPPacket> first_key = key(1);
+  std::shared_ptr<PGPPacket> kept_uid(new UserIDPacket(
+      ustring((const uint8_t*)"A <a@example.org>", 17)));
+  std::shared_ptr<PGPPacket> kept_uid_sig = packet(2, "sig A");
+  std::shared_ptr<PGPPacket> dropped_uid(new UserIDPacket(
+      ustring((const uint8_t*)"B <b@example.org>", 17)));
+  std::shared_ptr<PGPPacket> dropped_uid_sig = packet(2, "sig B");
+  std::shared_ptr<PGPPacket> subkey = packet(14, "subkey");
+  std::shared_ptr<PGPPacket> subkey_sig = packet(2, "sig S");
+  std::shared_ptr<PGPPacket> second_key = key(2);
+  std::shared_ptr<PGPPacket> second_uid = packet(13, "C");
+  const std::list<std::shared_ptr<PGPPacket>> packets = {
+    first_key, kept_uid, kept_uid_sig, dropped_uid, dropped_uid_sig,
+    subkey, subkey_sig, second_key, second_uid};
+
+  struct Call {
+    const PGPPacket* packet;
+    const PublicKeyPacket* primary_key;
+    const PGPPacket* component;
+  };
+  std::vector<Call> calls;
+  PacketWriter writer;
+  WriteFilteredPackets(
+      packets,
+      [&](const PGPPacket& candidate, const ExportContext& context) {
+        calls.push_back({&candidate, context.primary_key, context.component});
+        return &candidate != dropped_uid.get()
+            && &candidate != second_key.get();
+      },
+      &writer);
+
+  // The predicate is not asked about the packets of a rejected UID or
+  // key.
+  const PublicKeyPacket* primary =
+      dynamic_cast<const PublicKeyPacket*>(first_key.get());
+  const Call expected_calls[] = {
+    {first_key.get(), primary, first_key.get()},
+    {kept_uid.get(), primary, kept_uid.get()},
+    {kept_uid_sig.get(), primary, kept_uid.get()},
+    {dropped_uid.get(), primary, dropped_uid.get()},
+    {subkey.get(), primary, subkey.get()},
+    {subkey_sig.get(), primary, subkey.get()},
+    {second_key.get(),
+     dynamic_cast<const PublicKeyPacket*>(second_key.get()),
+     second_key.get()}};
+  ASSERT_EQ(calls.size(), sizeof(expected_calls) / sizeof(expected_calls[0]));
+  for (std::size_t i = 0; i < calls.size(); i++) {
+    ASSERT_EQ(calls[i].packet, expected_calls[i].packet);
+    ASSERT_EQ(calls[i].primary_key, expected_calls[i].primary_key);
+    ASSERT_EQ(calls[i].component, expected_calls[i].component);
+  }
+
+  ustring expected;
+  for (const std::shared_ptr<PGPPacket>& kept :
+       {first_key, kept_uid, kept_uid_sig, subkey, subkey_sig}) {
+    expected += WritePacketHeader(kept->tag(), kept->contents().length());
+    expected += kept->contents();
+  }
+  ustring output;
+  for (auto i = writer.segments().begin(); i != writer.segments().end(); i++) {
+    output.append(i->data, i->length);
+  }
+  ASSERT_EQ(output, expected);
+}
+
+#endif  // INCLUDE_TESTS
+
+}
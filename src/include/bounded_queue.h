@@ -0,0 +1,223 @@
+#ifndef PARSE4880_INCLUDE_BOUNDED_QUEUE_H_
+#define PARSE4880_INCLUDE_BOUNDED_QUEUE_H_
+
+/**
+ * @file bounded_queue.h
+ *
+ * A fixed-capacity queue for passing work between threads.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace parse4880 {
+
+/**
+ * Wait for another thread, first by yielding and then by sleeping
+ * briefly.
+ */
+class Backoff {
+ public:
+  Backoff() : attempts_(0) {}
+
+  /**
+   * Wait a little longer.
+   */
+  void Wait() {
+    if (++attempts_ < 64) {
+      std::this_thread::yield();
+    }
+    else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+ private:
+  unsigned attempts_;
+};
+
+/**
+ * A lock-free queue of fixed capacity, with any number of producers
+ * and consumers.
+ *
+ * Each slot carries a sequence number recording whether it is waiting
+ * to be written or to be read on the current lap of the ring, so that
+ * producers and consumers each claim a slot with a single
+ * compare-and-swap.
+ *
+ * Push() and Pop() wait with a Backoff while the queue is full or
+ * empty; this is the backpressure
+ * between the stages of a pipeline.  Once the queue is closed, Push()
+ * fails and Pop() fails as soon as the queue has been drained.
+ */
+template <typename T>
+class BoundedQueue {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param capacity  The number of values that may be queued at once,
+   *                  rounded up to a power of two.
+   */
+  explicit BoundedQueue(std::size_t capacity)
+      : closed_(false) {
+    enqueue_position_.value.store(0, std::memory_order_relaxed);
+    dequeue_position_.value.store(0, std::memory_order_relaxed);
+    std::size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    mask_ = size - 1;
+    cells_.reset(new Cell[size]);
+    for (std::size_t i = 0; i < size; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Add a value unless the queue is full.
+   *
+   * @param value  The value, which is only moved from on success.
+   *
+   * @return true if the value was added.
+   */
+  bool TryPush(T&& value) {
+    std::size_t position = enqueue_position_.value.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[position & mask_];
+      const std::size_t sequence =
+          cell->sequence.load(std::memory_order_acquire);
+      const intptr_t difference =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (0 == difference) {
+        if (enqueue_position_.value.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      }
+      else if (difference < 0) {
+        return false;
+      }
+      else {
+        position = enqueue_position_.value.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Remove a value unless the queue is empty.
+   *
+   * @param value  Set to the value removed.
+   *
+   * @return true if a value was removed.
+   */
+  bool TryPop(T* value) {
+    std::size_t position = dequeue_position_.value.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[position & mask_];
+      const std::size_t sequence =
+          cell->sequence.load(std::memory_order_acquire);
+      const intptr_t difference = static_cast<intptr_t>(sequence)
+          - static_cast<intptr_t>(position + 1);
+      if (0 == difference) {
+        if (dequeue_position_.value.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      }
+      else if (difference < 0) {
+        return false;
+      }
+      else {
+        position = dequeue_position_.value.load(std::memory_order_relaxed);
+      }
+    }
+    *value = std::move(cell->value);
+    cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Add a value, waiting while the queue is full.
+   *
+   * @param value  The value to be added.
+   *
+   * @return false if the queue was closed first.
+   */
+  bool Push(T value) {
+    Backoff backoff;
+    while (!TryPush(std::move(value))) {
+      if (closed()) {
+        return false;
+      }
+      backoff.Wait();
+    }
+    return true;
+  }
+
+  /**
+   * Remove a value, waiting while the queue is empty.
+   *
+   * @param value  Set to the value removed.
+   *
+   * @return false if the queue is closed and empty.
+   */
+  bool Pop(T* value) {
+    Backoff backoff;
+    while (!TryPop(value)) {
+      // Anything pushed before the queue was closed is visible now.
+      if (closed()) {
+        return TryPop(value);
+      }
+      backoff.Wait();
+    }
+    return true;
+  }
+
+  /**
+   * Close the queue, so that no more values may be added.
+   */
+  void Close() {
+    closed_.store(true, std::memory_order_release);
+  }
+
+  /**
+   * Whether the queue has been closed.
+   */
+  bool closed() const {
+    return closed_.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    T                        value;
+  };
+
+  // Producers and consumers each update their own position, so keep
+  // the two on separate cache lines.
+  struct Position {
+    std::atomic<std::size_t> value;
+    char padding[64 - sizeof(std::atomic<std::size_t>)];
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  std::size_t mask_;
+  Position enqueue_position_;
+  Position dequeue_position_;
+  std::atomic<bool> closed_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_BOUNDED_QUEUE_H_
@@ -17,7 +17,10 @@ enum PublicKeyAlgorithmCodes {
   kPublicKeyRSAEncryptOnly   = 2,
   kPublicKeyRSASignOnly      = 3,
   kPublicKeyElGamal          = 16,
-  kPublicKeyDSA              = 17  
+  kPublicKeyDSA              = 17,
+  kPublicKeyECDH             = 18,
+  kPublicKeyECDSA            = 19,
+  kPublicKeyEdDSA            = 22
 };
 
 /**
@@ -0,0 +1,78 @@
+#ifndef PARSE4880_INCLUDE_DIGEST_H_
+#define PARSE4880_INCLUDE_DIGEST_H_
+
+/**
+ * @file digest.h
+ *
+ * Content digests identifying packets and combinations of packets.
+ */
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#include "parser_types.h"
+#include "packet.h"
+
+namespace parse4880 {
+
+/**
+ * A SHA-256 digest of some packet content.
+ */
+typedef std::array<uint8_t, 32> ContentDigest;
+
+/**
+ * Hash functor allowing a ContentDigest to key unordered containers.
+ *
+ * The digest is already uniformly distributed, so we just take its
+ * leading octets.
+ */
+struct ContentDigestHash {
+  std::size_t operator()(const ContentDigest& digest) const {
+    std::size_t value;
+    memcpy(&value, digest.data(), sizeof(value));
+    return value;
+  }
+};
+
+/**
+ * Digest a sequence of strings.
+ *
+ * Each part is preceded by its eight-octet length, so that no two
+ * different sequences can be made to hash the same input by moving
+ * octets from one part to another.
+ *
+ * @param parts  The strings to be digested, in order.
+ *
+ * @return The SHA-256 digest of the encoded parts.
+ */
+ContentDigest DigestParts(std::initializer_list<const ustring*> parts);
+
+/**
+ * Digest a packet's tag and contents.
+ *
+ * @param packet  The packet to be digested.
+ *
+ * @return A digest identifying the packet.
+ */
+ContentDigest DigestPacket(const PGPPacket& packet);
+
+/**
+ * Digest a packet's tag and contents without constructing the packet.
+ *
+ * The result is the same as that of DigestPacket(const PGPPacket&)
+ * for the packet that would be parsed from these contents.
+ *
+ * @param tag       The packet tag.
+ * @param contents  The packet contents.
+ * @param length    The length of the contents.
+ *
+ * @return A digest identifying the packet.
+ */
+ContentDigest DigestPacket(uint8_t tag, const uint8_t* contents,
+                           std::size_t length);
+
+}
+
+#endif  // PARSE4880_INCLUDE_DIGEST_H_
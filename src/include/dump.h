@@ -0,0 +1,258 @@
+#ifndef PARSE4880_INCLUDE_DUMP_H_
+#define PARSE4880_INCLUDE_DUMP_H_
+
+/**
+ * @file dump.h
+ *
+ * Machine-readable dumps of packets.
+ *
+ * Two formats are supported.  In kDumpJSONLines, each top-level packet
+ * is written as a single JSON object on a line of its own, with its
+ * subpackets nested inside it.  Binary fields are written as lower-case
+ * hexadecimal, and times as seconds since the epoch.
+ *
+ * In kDumpBinary, the output begins with the magic string "P4880DP1"
+ * and each packet is then written as a record:
+ *
+ *   - Record
+ *     + [1] Packet tag, or subpacket type including the critical bit
+ *     + [4] Length of the fields
+ *     + Field
+ *       * [1] DumpField
+ *       * [4] Length of the value
+ *       * [?] Value
+ *     + ...
+ *
+ * Subpackets are fields whose values are themselves records.  All
+ * integers are big-endian; times are eight octets and two's complement,
+ * and the other integer fields are a single octet.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "parser_types.h"
+#include "packet.h"
+
+namespace parse4880 {
+
+/**
+ * Buffered output to a file descriptor.
+ *
+ * Small writes are gathered into a buffer of fixed size, so that a dump
+ * makes one system call for every few tens of kilobytes of output.
+ */
+class BufferedOutput {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param fd        The descriptor to write to, which is not closed.
+   * @param capacity  The size of the buffer.
+   */
+  explicit BufferedOutput(int fd, std::size_t capacity = 64 * 1024);
+
+  /**
+   * Flush the buffer, ignoring any error.  Call Flush() first to see
+   * errors.
+   */
+  ~BufferedOutput();
+
+  BufferedOutput(const BufferedOutput&) = delete;
+  BufferedOutput& operator=(const BufferedOutput&) = delete;
+
+  /**
+   * Write some octets.
+   *
+   * @param data    The octets.
+   * @param length  The number of octets.
+   *
+   * @throw write_error  If the buffer is full and cannot be written.
+   */
+  void Write(const void* data, std::size_t length) {
+    if (length > buffer_.size() - used_) {
+      WriteSlow(data, length);
+      return;
+    }
+    memcpy(&buffer_[used_], data, length);
+    used_ += length;
+  }
+
+  /**
+   * Write a string.
+   *
+   * @param text  The string, without its terminating null character.
+   *
+   * @throw write_error  If the buffer is full and cannot be written.
+   */
+  void Write(const std::string& text) {
+    Write(text.data(), text.length());
+  }
+
+  /**
+   * Write a null-terminated string.
+   *
+   * @param text  The string, without its terminating null character.
+   *
+   * @throw write_error  If the buffer is full and cannot be written.
+   */
+  void Write(const char* text) {
+    Write(text, strlen(text));
+  }
+
+  /**
+   * Write a single character.
+   *
+   * @param c  The character.
+   *
+   * @throw write_error  If the buffer is full and cannot be written.
+   */
+  void Put(char c) {
+    if (used_ == buffer_.size()) {
+      Drain();
+    }
+    buffer_[used_++] = c;
+  }
+
+  /**
+   * Write octets as lower-case hexadecimal, straight into the buffer.
+   *
+   * @param data  The octets.
+   *
+   * @throw write_error  If the buffer is full and cannot be written.
+   */
+  void WriteHex(ByteView data);
+
+  /**
+   * Write an integer in decimal.
+   *
+   * @param value  The integer.
+   *
+   * @throw write_error  If the buffer is full and cannot be written.
+   */
+  void WriteDecimal(int64_t value);
+
+  /**
+   * Write out everything buffered so far.
+   *
+   * @throw write_error  If the output cannot be written.
+   */
+  void Flush();
+
+ private:
+  void WriteSlow(const void* data, std::size_t length);
+  void Drain();
+
+  int fd_;
+  std::vector<char> buffer_;
+  std::size_t used_;
+};
+
+/**
+ * Check that text can be written as a JSON string as it stands.
+ *
+ * @param text  The text.
+ *
+ * @return true if the text is valid UTF-8.
+ */
+bool is_utf8(ByteView text);
+
+/**
+ * Write text as a JSON string literal, with its quotation marks.
+ *
+ * The text is written as it stands, apart from the characters that
+ * JSON requires to be escaped, so it should be valid UTF-8.
+ *
+ * @param out   The output.
+ * @param text  The text.
+ *
+ * @throw write_error  If the output cannot be written.
+ */
+void write_json_string(BufferedOutput* out, ByteView text);
+
+/**
+ * The formats in which packets can be dumped.
+ */
+enum DumpFormat {
+  kDumpJSONLines,  ///< One JSON object per line.
+  kDumpBinary      ///< Length-prefixed records, described in dump.h.
+};
+
+/**
+ * The fields of a binary dump record.
+ */
+enum DumpField {
+  kDumpFieldVersion = 1,                  ///< One octet.
+  kDumpFieldCreationTime = 2,             ///< Eight octets.
+  kDumpFieldPublicKeyAlgorithm = 3,       ///< One octet.
+  kDumpFieldFingerprint = 4,              ///< A key's fingerprint.
+  kDumpFieldKeyMaterial = 5,              ///< A key's algorithm fields.
+  kDumpFieldSignatureType = 6,            ///< One octet.
+  kDumpFieldHashAlgorithm = 7,            ///< One octet.
+  kDumpFieldKeyID = 8,                    ///< A signature's issuer.
+  kDumpFieldSignatureExpirationTime = 9,  ///< Eight octets.
+  kDumpFieldKeyExpirationTime = 10,       ///< Eight octets.
+  kDumpFieldHashLeft16Bits = 11,          ///< Two octets.
+  kDumpFieldSignature = 12,               ///< The signature's MPIs.
+  kDumpFieldHashedSubpacket = 13,         ///< A record.
+  kDumpFieldUnhashedSubpacket = 14,       ///< A record.
+  kDumpFieldSubpacket = 15,               ///< A record, for other packets.
+  kDumpFieldUserID = 16,                  ///< The user ID as it stands.
+  kDumpFieldContents = 17                 ///< The contents of other packets.
+};
+
+/**
+ * Write packets in a machine-readable form.
+ *
+ * Every field that the packet classes decode is written, and the
+ * contents of packets that they do not understand are written whole,
+ * so that no information is lost.
+ */
+class PacketDumper {
+ public:
+  /**
+   * Constructor.  For kDumpBinary, this writes the magic string.
+   *
+   * @param out     The output, which must outlive the dumper.
+   * @param format  The format in which to write.
+   *
+   * @throw write_error  If the output cannot be written.
+   */
+  PacketDumper(BufferedOutput* out, DumpFormat format);
+
+  /**
+   * Write a packet and its subpackets.
+   *
+   * @param packet  The packet.
+   *
+   * @throw write_error  If the output cannot be written.
+   */
+  void Dump(const PGPPacket& packet);
+
+ private:
+  void WriteJSON(const PGPPacket& packet, bool subpacket, bool hashed);
+  void WriteJSONKey(const char* name);
+  void WriteJSONBoolean(bool value);
+  void WriteJSONHex(const char* name, ByteView data);
+  void WriteJSONInteger(const char* name, int64_t value);
+  void WriteJSONTime(const char* name, int64_t value);
+
+  void AppendRecord(const PGPPacket& packet);
+  void AppendField(DumpField field, ByteView value);
+  void AppendInteger(DumpField field, uint64_t value, std::size_t length);
+  void AppendU32(uint32_t value);
+  void WriteU32At(std::size_t offset);
+
+  BufferedOutput* out_;
+  DumpFormat format_;
+
+  // Records are assembled here so that their lengths can be filled in.
+  ustring record_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_DUMP_H_
@@ -15,6 +15,8 @@
 
 #include <boost/format.hpp>
 
+#include "parse_status.h"
+
 using boost::format;
 
 namespace parse4880 {
@@ -50,7 +52,7 @@ class format_error : public parse4880_error, public std::runtime_error {
    * @return The offset from the beginning of the file at which the
    *         error was found.
    */
-  std::size_t position();
+  std::size_t position() const;
 
   /**
    * Default destructor.
@@ -200,6 +202,215 @@ class wrong_algorithm_error : public parse4880_error, public std::logic_error {
   ~wrong_algorithm_error() noexcept = default;
 };
 
+/**
+ * Input could not be read.
+ */
+class read_error : public parse4880_error, public std::runtime_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param path          The file that could not be read.
+   * @param error_number  The errno value describing the failure.
+   */
+  read_error(std::string path, int error_number);
+
+  /**
+   * Default destructor.
+   */
+  ~read_error() noexcept = default;
+};
+
+/**
+ * Output could not be written.
+ */
+class write_error : public parse4880_error, public std::runtime_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param error_number  The errno value describing the failure.
+   */
+  write_error(int error_number);
+
+  /**
+   * Default destructor.
+   */
+  ~write_error() noexcept = default;
+};
+
+/**
+ * A packet cannot be written in the OpenPGP format.
+ */
+class unencodable_packet_error : public parse4880_error,
+                                 public std::logic_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param problem  What makes the packet unencodable.
+   */
+  unencodable_packet_error(std::string problem);
+
+  /**
+   * Default destructor.
+   */
+  ~unencodable_packet_error() noexcept = default;
+};
+
+/**
+ * The data exceeds one of the limits set on the parse.
+ *
+ * @see ParseLimits
+ */
+class limit_error : public format_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param position  The position at which the limit was exceeded.
+   * @param limit     A description of the limit.
+   */
+  limit_error(std::size_t position, std::string limit);
+
+  /**
+   * Default destructor.
+   */
+  ~limit_error() noexcept = default;
+};
+
+/**
+ * Parsing stopped because the soft memory budget was exceeded.
+ *
+ * @see set_memory_budget
+ */
+class memory_budget_error : public parse4880_error, public std::runtime_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param position  The position at which parsing stopped.
+   */
+  memory_budget_error(std::size_t position);
+
+  /**
+   * Default destructor.
+   */
+  ~memory_budget_error() noexcept = default;
+};
+
+/**
+ * A socket could not be created, or a connection over one failed.
+ */
+class socket_error : public parse4880_error, public std::runtime_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param path          The path of the socket.
+   * @param error_number  The errno value describing the failure, or
+   *                      zero if the peer broke the protocol.
+   */
+  socket_error(std::string path, int error_number);
+
+  /**
+   * Default destructor.
+   */
+  ~socket_error() noexcept = default;
+};
+
+/**
+ * Throw the exception corresponding to a parse status.
+ *
+ * This converts the result of the non-throwing interface into the
+ * exception that the throwing interface would have produced.
+ *
+ * @param error  A status describing a failure.
+ */
+[[noreturn]] void ThrowParseError(const ParseError& error);
+
+/**
+ * The parse status corresponding to an exception.
+ *
+ * This is the reverse of ThrowParseError, for code that must report
+ * failures through the non-throwing interface.  The detail is a static
+ * description of the kind of failure; error_message gives the full one.
+ *
+ * @param error  The exception.
+ *
+ * @return The status of the same kind, or kParseInvalidPacket for an
+ *         exception that no status describes.
+ */
+ParseError ParseErrorFor(const parse4880_error& error);
+
+/**
+ * The message of one of the library's exceptions.
+ *
+ * Each reaches std::exception both through parse4880_error and through
+ * a standard exception class, so what() cannot be called on a
+ * parse4880_error directly.
+ *
+ * @param error  The exception.
+ *
+ * @return The message of its standard exception class.
+ */
+std::string error_message(const parse4880_error& error);
+
+/**
+ * A verification cache file could not be opened or written.
+ */
+class cache_error : public parse4880_error, public std::runtime_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param path  The path of the cache file.
+   */
+  cache_error(std::string path);
+
+  /**
+   * Default destructor.
+   */
+  ~cache_error() noexcept = default;
+};
+
+/**
+ * A user ID index file is malformed.
+ */
+class index_error : public parse4880_error, public std::runtime_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param path  The path of the index file.
+   */
+  index_error(std::string path);
+
+  /**
+   * Default destructor.
+   */
+  ~index_error() noexcept = default;
+};
+
+/**
+ * The cryptographic library failed an operation that should not fail.
+ */
+class crypto_error : public parse4880_error, public std::runtime_error {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param operation   The operation that failed.
+   * @param error_code  The library's error code.
+   */
+  crypto_error(std::string operation, int error_code);
+
+  /**
+   * Default destructor.
+   */
+  ~crypto_error() noexcept = default;
+};
+
 }
 
 /**
@@ -0,0 +1,231 @@
+#ifndef PARSE4880_INCLUDE_FIELDS_H_
+#define PARSE4880_INCLUDE_FIELDS_H_
+
+/**
+ * @file fields.h
+ *
+ * Declarative decoders for fixed packet layouts.
+ *
+ * Rather than decoding a packet field by field, each with its own
+ * bounds check and a temporary copy of its octets, a packet's fixed
+ * part is described as a Layout of field types.  The size and the
+ * offset of every field are then known at compile time, so a single
+ * bounds check covers the whole layout and each field is loaded
+ * directly from the packet data.
+ *
+ * Variable-length parts are read with ReadPrefixed, which decodes a
+ * length prefix and checks that the region that it describes is
+ * present.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace parse4880 {
+
+namespace fields {
+
+/**
+ * A big-endian unsigned integer of N octets.
+ */
+template <std::size_t N>
+struct UInt {
+  typedef uint64_t value_type;
+
+  static constexpr std::size_t width() { return N; }
+
+  /**
+   * Load the field.
+   *
+   * The loop has a constant trip count, so the compiler reduces
+   * this to an unaligned load and a byte swap.
+   *
+   * @param data  The first octet of the field.
+   */
+  static value_type Load(const uint8_t* data) {
+    value_type value = 0;
+    for (std::size_t i = 0; i < N; i++) {
+      value = (value << 8) | data[i];
+    }
+    return value;
+  }
+};
+
+typedef UInt<1> U8;
+typedef UInt<2> U16;
+typedef UInt<4> U32;
+
+/**
+ * A run of N raw octets, loaded as a pointer to the first of them.
+ */
+template <std::size_t N>
+struct Octets {
+  typedef const uint8_t* value_type;
+
+  static constexpr std::size_t width() { return N; }
+
+  static value_type Load(const uint8_t* data) {
+    return data;
+  }
+};
+
+/// @cond SHOW_INTERNAL
+
+template <std::size_t I, typename... Fields>
+struct FieldAt;
+
+template <typename First, typename... Rest>
+struct FieldAt<0, First, Rest...> {
+  typedef First type;
+  static constexpr std::size_t offset() { return 0; }
+};
+
+template <std::size_t I, typename First, typename... Rest>
+struct FieldAt<I, First, Rest...> {
+  typedef typename FieldAt<I-1, Rest...>::type type;
+  static constexpr std::size_t offset() {
+    return First::width() + FieldAt<I-1, Rest...>::offset();
+  }
+};
+
+template <typename... Fields>
+struct TotalWidth;
+
+template <>
+struct TotalWidth<> {
+  static constexpr std::size_t value() { return 0; }
+};
+
+template <typename First, typename... Rest>
+struct TotalWidth<First, Rest...> {
+  static constexpr std::size_t value() {
+    return First::width() + TotalWidth<Rest...>::value();
+  }
+};
+
+/// @endcond
+
+/**
+ * A fixed sequence of fields.
+ *
+ * For example, the fixed part of a v4 public-key packet is
+ *
+ *     typedef Layout<U8,    // Version
+ *                    U32,   // Creation time
+ *                    U8>    // Public-key algorithm
+ *         PublicKeyLayout;
+ *
+ * after which PublicKeyLayout::Fits(length) checks that the whole
+ * layout is present, and PublicKeyLayout::Get<1>(data) loads the
+ * creation time.
+ */
+template <typename... Fields>
+struct Layout {
+  /**
+   * The total width of the layout, in octets.
+   */
+  static constexpr std::size_t size() {
+    return TotalWidth<Fields...>::value();
+  }
+
+  /**
+   * The offset of a field from the start of the layout.
+   */
+  template <std::size_t I>
+  static constexpr std::size_t offset() {
+    return FieldAt<I, Fields...>::offset();
+  }
+
+  /**
+   * Check that the layout fits in the data.
+   *
+   * @param length    The length of the data.
+   * @param position  Where in the data the layout begins.
+   *
+   * @return true if every field lies within the data.
+   */
+  static bool Fits(std::size_t length, std::size_t position = 0) {
+    return position <= length && length - position >= size();
+  }
+
+  /**
+   * Load a field.  The caller must already have checked Fits.
+   *
+   * @param data  The first octet of the layout.
+   *
+   * @return The value of field I.
+   */
+  template <std::size_t I>
+  static typename FieldAt<I, Fields...>::type::value_type Get(
+      const uint8_t* data) {
+    return FieldAt<I, Fields...>::type::Load(data + offset<I>());
+  }
+};
+
+/**
+ * A region preceded by an N-octet big-endian count of its octets.
+ */
+template <std::size_t N>
+struct LengthPrefixed {
+  static constexpr std::size_t width() { return N; }
+
+  static uint64_t RegionLength(uint64_t prefix) { return prefix; }
+};
+
+/**
+ * A multiprecision integer, as defined in RFC4880 §3.2.
+ *
+ * The prefix counts bits rather than octets.
+ */
+struct MPI {
+  static constexpr std::size_t width() { return 2; }
+
+  static uint64_t RegionLength(uint64_t prefix) { return (prefix + 7) / 8; }
+};
+
+/**
+ * The location of a variable-length region within some data.
+ */
+struct Region {
+  std::size_t offset;
+  std::size_t length;
+};
+
+/**
+ * Read a length-prefixed region.
+ *
+ * @param data      The data containing the region.
+ * @param length    The length of the data.
+ * @param position  The position of the prefix, advanced past the
+ *                  region on success.
+ * @param region    Set to the location of the region on success.
+ *
+ * @tparam Prefix  The kind of prefix, LengthPrefixed or MPI.
+ *
+ * @return true if the prefix and the whole region lie within the data.
+ */
+template <typename Prefix>
+bool ReadPrefixed(const uint8_t* data, std::size_t length,
+                  std::size_t* position, Region* region) {
+  if (!Layout<UInt<Prefix::width()>>::Fits(length, *position)) {
+    return false;
+  }
+
+  uint64_t region_length = Prefix::RegionLength(
+      UInt<Prefix::width()>::Load(data + *position));
+  std::size_t region_offset = *position + Prefix::width();
+  if (length - region_offset < region_length) {
+    return false;
+  }
+
+  region->offset = region_offset;
+  region->length = region_length;
+  *position = region_offset + region_length;
+  return true;
+}
+
+}  // namespace fields
+
+}
+
+#endif  // PARSE4880_INCLUDE_FIELDS_H_
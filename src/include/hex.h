@@ -0,0 +1,46 @@
+#ifndef PARSE4880_INCLUDE_HEX_H_
+#define PARSE4880_INCLUDE_HEX_H_
+
+/**
+ * @file hex.h
+ *
+ * Hexadecimal encoding of binary data.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "parser_types.h"
+
+namespace parse4880 {
+
+/**
+ * Encode octets as hexadecimal, two characters per octet.
+ *
+ * Each octet is encoded with a single lookup in a table of all 256
+ * character pairs, so this is far cheaper than formatting octets one
+ * at a time.
+ *
+ * @param data    The octets to encode.
+ * @param length  The number of octets.
+ * @param out     Where to write the 2 * length characters.  No
+ *                terminating null character is written.
+ * @param upper   Whether to use upper-case letters.
+ */
+void hex_encode(const uint8_t* data, std::size_t length, char* out,
+                bool upper = false);
+
+/**
+ * Encode octets as a hexadecimal string.
+ *
+ * @param data   The octets to encode.
+ * @param upper  Whether to use upper-case letters.
+ *
+ * @return The encoded string.
+ */
+std::string hex_string(ByteView data, bool upper = false);
+
+}
+
+#endif  // PARSE4880_INCLUDE_HEX_H_
@@ -0,0 +1,148 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_INCREMENTAL_H_
+#define PARSE4880_INCLUDE_KEYRING_INCREMENTAL_H_
+
+/**
+ * @file incremental.h
+ *
+ * Incremental re-parsing of keyrings that change over time.
+ */
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "parser_types.h"
+#include "packet.h"
+#include "digest.h"
+#include "keyring/transferable_key.h"
+
+namespace parse4880 {
+
+/**
+ * A summary of the changes made by IncrementalKeyring::Update().
+ */
+struct KeyringUpdate {
+  KeyringUpdate()
+      : keys_added(0), keys_removed(0), keys_modified(0), keys_unchanged(0),
+        packets_added(0), packets_removed(0) {}
+
+  std::size_t keys_added;
+  std::size_t keys_removed;
+  std::size_t keys_modified;
+  std::size_t keys_unchanged;
+
+  /**
+   * Packets in modified or added keys that were not there before.
+   */
+  std::size_t packets_added;
+
+  /**
+   * Packets in modified or removed keys that are no longer there.
+   */
+  std::size_t packets_removed;
+};
+
+/**
+ * A parsed keyring that can be brought up to date cheaply.
+ *
+ * Each new version of the keyring is split into keys by reading only
+ * the packet headers.  A key whose octets are unchanged keeps its
+ * parsed packets, so only keys that have changed are parsed again,
+ * and even then any packet already seen in the old version of the key
+ * is reused rather than parsed.
+ *
+ * Keys that are added or modified are marked dirty, and removed keys
+ * are remembered, until ClearDirty() is called.  A caller that has
+ * verified the keyring need only re-verify the dirty keys after each
+ * update.
+ *
+ * Keys are identified by the contents of their primary key packet, so
+ * moving a key within the keyring does not make it dirty.
+ */
+class IncrementalKeyring {
+ public:
+  IncrementalKeyring();
+
+  /**
+   * Replace the keyring with a new version.
+   *
+   * If the new version is malformed, an exception is thrown as for
+   * parse() and the keyring is left as it was.
+   *
+   * @param data  The new version of the keyring.
+   *
+   * @return A summary of the changes.
+   */
+  KeyringUpdate Update(ustring data);
+
+  /**
+   * The number of keys in the keyring.
+   *
+   * @return The number of keys.
+   */
+  std::size_t size() const;
+
+  /**
+   * Visit each key, in the order in which they appear in the keyring.
+   *
+   * @param callback  Called with each key and whether it is dirty.
+   */
+  void ForEach(
+      std::function<void(const TransferableKey&, bool)> callback) const;
+
+  /**
+   * Visit each key that has been added or modified since the last call
+   * to ClearDirty().
+   *
+   * @param callback  Called with each dirty key.
+   */
+  void ForEachDirty(
+      std::function<void(const TransferableKey&)> callback) const;
+
+  /**
+   * The fingerprints of keys removed since the last call to
+   * ClearDirty().
+   *
+   * @return The fingerprints of the removed keys.
+   */
+  const std::vector<ustring>& removed_keys() const;
+
+  /**
+   * Mark every key clean and forget the removed keys.
+   */
+  void ClearDirty();
+
+ private:
+  typedef std::vector<std::pair<ContentDigest, std::shared_ptr<PGPPacket>>>
+      PacketList;
+
+  struct Entry {
+    std::size_t                      offset;
+    std::size_t                      length;
+    PacketList                       packets;
+    std::shared_ptr<TransferableKey> key;
+    bool                             dirty;
+  };
+
+  struct Span {
+    ContentDigest identity;
+    std::size_t   offset;
+    std::size_t   length;
+  };
+
+  std::vector<Span> Split(const ustring& data) const;
+  Entry ParseEntry(const ustring& data, const Span& span,
+                   const Entry* previous, KeyringUpdate* update) const;
+
+ private:
+  ustring data_;
+  std::vector<ContentDigest> order_;
+  std::unordered_map<ContentDigest, Entry, ContentDigestHash> entries_;
+  std::vector<ustring> removed_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_INCREMENTAL_H_
@@ -0,0 +1,175 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_KEY_INDEX_H_
+#define PARSE4880_INCLUDE_KEYRING_KEY_INDEX_H_
+
+/**
+ * @file key_index.h
+ *
+ * Parsed public keys, indexed by key ID.
+ */
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "parser_types.h"
+#include "packet.h"
+#include "keys/key.h"
+
+namespace parse4880 {
+
+/**
+ * The keys and subkeys of a keyring, ready for verification.
+ *
+ * Each key is parsed once, when the index is built, so that checking a
+ * signature costs only a lookup, the hashing of the data and a single
+ * public-key operation.  The index is immutable once built, and may be
+ * used from any number of threads at once.
+ */
+class KeyIndex {
+ public:
+  /**
+   * A key in the index.
+   */
+  struct Entry {
+    /**
+     * The key ID, the low 64 bits of the fingerprint.
+     */
+    uint64_t key_id;
+
+    /**
+     * The key or subkey packet.
+     */
+    std::shared_ptr<const PublicKeyPacket> packet;
+
+    /**
+     * The key parsed from the packet.
+     */
+    std::shared_ptr<const Key> key;
+  };
+
+  /**
+   * A range of entries.
+   */
+  struct Range {
+    const Entry* begin;
+    const Entry* end;
+  };
+
+  /**
+   * The outcome of a verification.
+   */
+  struct Verification {
+    /**
+     * The key that made the signature, or nullptr if no key in the
+     * index has the signature's key ID.
+     */
+    const Entry* key;
+
+    /**
+     * Whether the signature is valid.
+     */
+    bool valid;
+  };
+
+  /**
+   * A verification of data that arrives in pieces.
+   *
+   * Every key with the signature's key ID is tried at once, so that
+   * the data need only be read once.
+   */
+  class StreamVerification {
+   public:
+    /**
+     * Hash some more of the data.
+     *
+     * @param data    The data.
+     * @param length  The length of the data.
+     */
+    void Update(const uint8_t* data, std::size_t length);
+
+    /**
+     * Finish the verification, once all of the data has been hashed.
+     *
+     * @return The key used and the result.
+     */
+    Verification Finish();
+
+   private:
+    friend class KeyIndex;
+
+    StreamVerification(const Entry* last_key);
+
+    std::vector<std::pair<const Entry*, std::unique_ptr<VerificationContext>>>
+        contexts_;
+    const Entry* last_key_;
+  };
+
+  /**
+   * Index the key packets in a list of packets.
+   *
+   * Keys with unsupported algorithms or malformed key material are
+   * left out.
+   *
+   * @param packets  The packets, of which only key and subkey packets
+   *                 are used.
+   */
+  explicit KeyIndex(const std::list<std::shared_ptr<PGPPacket>>& packets);
+
+  /**
+   * Index the keys in a keyring.  Only the key and subkey packets are
+   * parsed.
+   *
+   * @param data    The keyring.
+   * @param length  The length of the keyring.
+   *
+   * @throw format_error  If the keyring is malformed.
+   */
+  KeyIndex(const uint8_t* data, std::size_t length);
+
+  /**
+   * The number of keys in the index.
+   */
+  std::size_t size() const;
+
+  /**
+   * Find the keys with a key ID.
+   *
+   * @param key_id  The eight-octet key ID.
+   *
+   * @return The matching keys, of which there are usually at most one.
+   */
+  Range Find(ByteView key_id) const;
+
+  /**
+   * Verify a signature over some data with the key that made it.
+   *
+   * @param signature  The signature.
+   * @param data       The signed data.
+   * @param length     The length of the data.
+   *
+   * @return The key used and the result.
+   */
+  Verification Verify(const SignaturePacket& signature,
+                      const uint8_t* data, std::size_t length) const;
+
+  /**
+   * Begin verifying a signature over data that arrives in pieces.
+   *
+   * @param signature  The signature, which must outlive the result.
+   *
+   * @return The verification, to which the data should be passed.
+   */
+  StreamVerification StartVerify(const SignaturePacket& signature) const;
+
+ private:
+  void Add(const std::shared_ptr<PGPPacket>& packet);
+  void Sort();
+
+  std::vector<Entry> entries_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_KEY_INDEX_H_
@@ -0,0 +1,69 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_MANIFEST_H_
+#define PARSE4880_INCLUDE_KEYRING_MANIFEST_H_
+
+/**
+ * @file manifest.h
+ *
+ * Verification of many detached signatures against one keyring.
+ */
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "keyring/key_index.h"
+#include "keyring/verify_service.h"
+
+namespace parse4880 {
+
+/**
+ * A file and the detached signature over it.
+ */
+struct ManifestEntry {
+  /**
+   * The path of the signed file.
+   */
+  std::string file;
+
+  /**
+   * The path of the binary detached signature.
+   */
+  std::string signature;
+};
+
+/**
+ * Read a manifest of files and their signatures.
+ *
+ * Each line names a file and its signature, separated by a tab, or by
+ * a space if the line has no tab.  A line naming only a file stands
+ * for the file and the file with ".sig" appended.  Blank lines and
+ * lines starting with '#' are skipped.
+ *
+ * @param in  The manifest.
+ *
+ * @return The entries, in order.
+ */
+std::vector<ManifestEntry> read_manifest(std::istream& in);
+
+/**
+ * Verify every entry of a manifest.
+ *
+ * The entries are shared out among a fixed number of threads, each of
+ * which reads and verifies one file at a time, so that no more than
+ * that many files are held at once however long the manifest.
+ *
+ * @param index    The keys with which to verify.
+ * @param entries  The files and signatures.
+ * @param threads  The number of threads, or zero for one per hardware
+ *                 thread.
+ *
+ * @return The outcome for each entry, in the order of the entries.
+ */
+std::vector<VerifyResponse> verify_manifest(
+    const KeyIndex& index, const std::vector<ManifestEntry>& entries,
+    std::size_t threads = 0);
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_MANIFEST_H_
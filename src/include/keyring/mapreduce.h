@@ -0,0 +1,160 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_MAPREDUCE_H_
+#define PARSE4880_INCLUDE_KEYRING_MAPREDUCE_H_
+
+/**
+ * @file mapreduce.h
+ *
+ * Parallel map-reduce over the keys of large keyrings.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "parser_types.h"
+#include "keyring/transferable_key.h"
+
+namespace parse4880 {
+
+/**
+ * Options controlling a parallel pass over a keyring.
+ */
+struct MapReduceOptions {
+  MapReduceOptions()
+      : threads(0), chunk_length(16 << 20), skip_malformed(false) {}
+
+  /**
+   * The number of worker threads, or zero for one per hardware thread.
+   */
+  std::size_t threads;
+
+  /**
+   * The approximate length of each chunk of the keyring, in octets.
+   *
+   * Each worker parses one chunk at a time, so at most this many
+   * octets per worker are copied and parsed at once.
+   */
+  std::size_t chunk_length;
+
+  /**
+   * Whether to skip the remainder of a chunk that fails to parse,
+   * rather than abandoning the whole pass with an exception.
+   */
+  bool skip_malformed;
+};
+
+/**
+ * A piece of a keyring that begins with a primary key.
+ */
+struct KeyringChunk {
+  std::size_t offset;
+  std::size_t length;
+};
+
+/**
+ * Split a keyring into chunks that can be parsed independently.
+ *
+ * Only packet headers are read.  Each chunk but the last ends just
+ * before a primary key, so that no transferable key is split between
+ * two chunks.  If a malformed header is found, everything from the
+ * start of the chunk containing it is left in the final chunk, whose
+ * parse will then report the error.
+ *
+ * @param data          The keyring.
+ * @param length        The length of the keyring.
+ * @param chunk_length  The length after which to start a new chunk.
+ *
+ * @return The chunks, in order, covering the whole keyring.
+ */
+std::vector<KeyringChunk> split_keyring(const uint8_t* data,
+                                        std::size_t length,
+                                        std::size_t chunk_length);
+
+/**
+ * The number of workers that a pass with the given options will use.
+ *
+ * @param options  The options for the pass.
+ *
+ * @return The number of worker threads.
+ */
+std::size_t map_reduce_workers(const MapReduceOptions& options);
+
+/**
+ * Call a function for each key in a keyring, using a pool of threads.
+ *
+ * The keyring is split into chunks with split_keyring(), which are
+ * handed out to the workers in turn.  Keys from the same chunk are
+ * visited in order by the same worker, but there is no ordering
+ * between chunks.
+ *
+ * Any exception thrown by the callback, or any parse error (unless
+ * skipped), stops the pass and is rethrown once all of the workers
+ * have finished.
+ *
+ * @param data      The keyring.
+ * @param length    The length of the keyring.
+ * @param options   Options for the pass.
+ * @param callback  Called with the index of the worker, less than
+ *                  map_reduce_workers(options), and each key.
+ */
+void for_each_key_parallel(
+    const uint8_t* data, std::size_t length, const MapReduceOptions& options,
+    std::function<void(std::size_t, const TransferableKey&)> callback);
+
+/**
+ * Compute a summary of a keyring in parallel.
+ *
+ * Each worker has its own accumulator, which starts out
+ * value-initialized and is updated by the map function for each key
+ * that the worker visits.  The per-worker accumulators are then
+ * combined by the reduce function, which should be associative and
+ * commutative, into a value-initialized result.
+ *
+ * For example, to count keys by public-key algorithm:
+ *
+ *     typedef std::map<int, std::size_t> Histogram;
+ *     Histogram histogram = map_reduce_keyring<Histogram>(
+ *         file.data(), file.size(),
+ *         [](const TransferableKey& key, Histogram* partial) {
+ *           (*partial)[key.primary_key->public_key_algorithm()]++;
+ *         },
+ *         [](Histogram* result, const Histogram& partial) {
+ *           for (auto i = partial.begin(); i != partial.end(); i++) {
+ *             (*result)[i->first] += i->second;
+ *           }
+ *         });
+ *
+ * @param data     The keyring.
+ * @param length   The length of the keyring.
+ * @param map      Fold a key into a worker's accumulator.
+ * @param reduce   Fold a worker's accumulator into the result.
+ * @param options  Options for the pass.
+ *
+ * @tparam Accumulator  The type of the summary, which must be given
+ *                      explicitly.
+ *
+ * @return The combined summary.
+ */
+template <typename Accumulator>
+Accumulator map_reduce_keyring(
+    const uint8_t* data, std::size_t length,
+    std::function<void(const TransferableKey&, Accumulator*)> map,
+    std::function<void(Accumulator*, const Accumulator&)> reduce,
+    const MapReduceOptions& options = MapReduceOptions()) {
+  std::vector<Accumulator> partial(map_reduce_workers(options));
+  for_each_key_parallel(
+      data, length, options,
+      [&partial, &map](std::size_t worker, const TransferableKey& key) {
+        map(key, &partial[worker]);
+      });
+
+  Accumulator result = Accumulator();
+  for (auto i = partial.begin(); i != partial.end(); i++) {
+    reduce(&result, *i);
+  }
+  return result;
+}
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_MAPREDUCE_H_
@@ -0,0 +1,108 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_MERGE_H_
+#define PARSE4880_INCLUDE_KEYRING_MERGE_H_
+
+/**
+ * @file merge.h
+ *
+ * Merging and deduplication of keyrings.
+ */
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "parser_types.h"
+#include "packet.h"
+#include "digest.h"
+#include "writer.h"
+#include "keyring/transferable_key.h"
+
+namespace parse4880 {
+
+/**
+ * Merge keys from any number of keyrings into one.
+ *
+ * Keys are identified by the fingerprint of their primary key, and
+ * user IDs, subkeys and signatures by a digest of their contents.
+ * Each distinct packet is kept once, however many times it is added,
+ * so memory use is proportional to the number of unique packets
+ * rather than to the total size of the input.
+ */
+class KeyringMerger {
+ public:
+  KeyringMerger();
+
+  /**
+   * Merge a key into the keyring.
+   *
+   * @param key  The key to be merged.
+   */
+  void Add(const TransferableKey& key);
+
+  /**
+   * Parse a keyring and merge each of its keys.
+   *
+   * The keyring is grouped into keys as it is parsed, so only one of
+   * its keys is held outside the merger at a time.
+   *
+   * @param data  The keyring to be merged.
+   */
+  void AddKeyring(const ustring& data);
+
+  /**
+   * The number of distinct keys.
+   *
+   * @return The number of keys in the merged keyring.
+   */
+  std::size_t size() const;
+
+  /**
+   * Visit each merged key, in the order in which they were first seen.
+   *
+   * @param callback  Called with each key.
+   */
+  void ForEach(std::function<void(const TransferableKey&)> callback) const;
+
+  /**
+   * Write the merged keyring.
+   *
+   * @param writer  The writer to which the packets are appended.
+   */
+  void WriteTo(PacketWriter* writer) const;
+
+ private:
+  typedef std::unordered_set<ContentDigest, ContentDigestHash> DigestSet;
+
+  struct MergedComponent {
+    KeyComponent* component;
+    DigestSet     signatures;
+  };
+
+  struct MergedKey {
+    TransferableKey key;
+    DigestSet       signatures;
+    std::unordered_map<ContentDigest, MergedComponent, ContentDigestHash>
+                    user_ids;
+    std::unordered_map<ContentDigest, MergedComponent, ContentDigestHash>
+                    subkeys;
+  };
+
+  static void MergeSignatures(
+      const std::list<std::shared_ptr<PGPPacket>>& from,
+      std::list<std::shared_ptr<PGPPacket>>* to, DigestSet* seen);
+  static void MergeComponents(
+      const std::list<KeyComponent>& from, std::list<KeyComponent>* to,
+      std::unordered_map<ContentDigest, MergedComponent, ContentDigestHash>*
+          seen);
+
+ private:
+  std::list<MergedKey> keys_;
+  std::map<ustring, MergedKey*> index_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_MERGE_H_
@@ -0,0 +1,451 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_PIPELINE_H_
+#define PARSE4880_INCLUDE_KEYRING_PIPELINE_H_
+
+/**
+ * @file pipeline.h
+ *
+ * A staged pipeline for reading, parsing and verifying keyrings.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parser_types.h"
+#include "bounded_queue.h"
+#include "keyring/transferable_key.h"
+
+namespace parse4880 {
+
+/**
+ * Options controlling a KeyringPipeline.
+ */
+struct PipelineOptions {
+  PipelineOptions()
+      : read_length(1 << 20), queue_capacity(64), parse_threads(1),
+        verify_threads(0) {}
+
+  /**
+   * The number of octets read from the file at a time.
+   */
+  std::size_t read_length;
+
+  /**
+   * The capacity of each queue between stages.
+   *
+   * This also bounds the number of keys in the pipeline at once, so
+   * that a slow key cannot cause the keys behind it to pile up while
+   * waiting to be returned in order.
+   */
+  std::size_t queue_capacity;
+
+  /**
+   * The number of threads parsing keys.
+   */
+  std::size_t parse_threads;
+
+  /**
+   * The number of threads verifying keys, or zero for one per
+   * hardware thread.
+   */
+  std::size_t verify_threads;
+};
+
+/**
+ * Split a stream of packets into the data of each transferable key.
+ *
+ * Only the packet headers are read, so this is cheap enough to be done
+ * by one thread while the keys themselves are parsed by others.
+ * Packets preceding the first primary key are dropped, as by
+ * TransferableKeyGrouper.
+ */
+class KeyFramer {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param callback  Called with the packets of each key, in order.
+   */
+  explicit KeyFramer(std::function<void(ustring)> callback);
+
+  /**
+   * Add the next piece of the stream.
+   *
+   * A packet split between two pieces is held back until the rest
+   * arrives.
+   *
+   * @param data    The data to be added.
+   * @param length  The length of the data.
+   *
+   * @throw parse4880_error  If a packet header is malformed.
+   */
+  void Add(const uint8_t* data, std::size_t length);
+
+  /**
+   * Pass on the last key at the end of the stream.
+   *
+   * @throw parse4880_error  If the stream ends part-way through a
+   *                         packet.
+   */
+  void Finish();
+
+ private:
+  std::function<void(ustring)> callback_;
+  ustring     buffer_;
+  std::size_t buffer_offset_;
+  std::size_t key_start_;
+  std::size_t scanned_;
+};
+
+/**
+ * Read a keyring file and verify each of its keys, overlapping the
+ * reading, parsing and verification.
+ *
+ * The stages are:
+ *
+ *   1. A thread reading the file;
+ *   2. A thread finding the boundaries between keys (KeyFramer);
+ *   3. A pool of threads parsing the keys;
+ *   4. A pool of threads verifying the keys.
+ *
+ * They are joined by BoundedQueues, so each stage stalls rather than
+ * running ahead when the next falls behind, and the throughput of the
+ * whole approaches that of the slowest stage.  Results are returned
+ * in the order in which the keys appear in the file.
+ *
+ * If a stage fails, the stages feeding the pipeline stop, but the keys
+ * already under way before the failure are still finished, so Next()
+ * returns every result that precedes the failure before throwing.
+ *
+ * @tparam Result  The outcome of verifying a key, which must be
+ *                 default-constructible and movable.
+ */
+template <typename Result>
+class KeyringPipeline {
+ public:
+  /**
+   * Verify a key, returning some summary of the outcome.
+   *
+   * This is called concurrently from several threads.
+   */
+  typedef std::function<Result(const TransferableKey&)> Verifier;
+
+  /**
+   * Start the pipeline.
+   *
+   * @param path     The keyring file to be read.
+   * @param verify   Called with each key.
+   * @param options  The sizes of the stages and queues.
+   *
+   * @throw read_error  If the file cannot be opened.
+   */
+  KeyringPipeline(const std::string& path, Verifier verify,
+                  const PipelineOptions& options = PipelineOptions());
+
+  /**
+   * Stop the pipeline, abandoning any keys not yet returned.
+   */
+  ~KeyringPipeline();
+
+  KeyringPipeline(const KeyringPipeline&) = delete;
+  KeyringPipeline& operator=(const KeyringPipeline&) = delete;
+
+  /**
+   * Get the result for the next key.
+   *
+   * Keys whose primary key cannot be parsed are skipped.
+   *
+   * @param result  Set to the result for the next key.
+   *
+   * @return false once every key has been returned.
+   *
+   * @throw parse4880_error  If the file could not be read or framed,
+   *                         or any other exception thrown by a stage,
+   *                         once the results for every key before the
+   *                         failure have been returned.
+   */
+  bool Next(Result* result);
+
+ private:
+  struct Frame {
+    std::size_t sequence;
+    ustring     data;
+  };
+
+  struct Parsed {
+    std::size_t                      sequence;
+    std::shared_ptr<TransferableKey> key;
+  };
+
+  struct Output {
+    std::size_t sequence;
+    bool        present;
+    Result      value;
+  };
+
+  void Read();
+  void FrameKeys();
+  void Parse();
+  void Verify();
+  void Fail(std::exception_ptr error, std::size_t sequence);
+  void Stop();
+
+  Verifier                   verify_;
+  PipelineOptions            options_;
+  std::string                path_;
+  int                        fd_;
+
+  BoundedQueue<ustring>      reads_;
+  BoundedQueue<Frame>        frames_;
+  BoundedQueue<Parsed>       parsed_;
+  BoundedQueue<Output>       outputs_;
+
+  std::atomic<std::size_t>   delivered_;
+  std::atomic<std::size_t>   parsers_left_;
+  std::atomic<std::size_t>   verifiers_left_;
+  std::atomic<bool>          cancelled_;
+  std::atomic<bool>          failed_;
+  std::mutex                 error_mutex_;
+  std::exception_ptr         error_;
+  std::size_t                failed_at_;
+
+  std::map<std::size_t, Output> reorder_;
+  std::vector<std::thread>   threads_;
+};
+
+/// @cond SHOW_INTERNAL
+
+/**
+ * Open a file for a pipeline to read.
+ *
+ * @throw read_error  If the file cannot be opened.
+ */
+int open_pipeline_input(const std::string& path);
+
+/**
+ * Read from a pipeline's file.
+ *
+ * @return The number of octets read, zero at the end of the file.
+ *
+ * @throw read_error  If the read fails.
+ */
+std::size_t read_pipeline_input(int fd, const std::string& path,
+                                uint8_t* data, std::size_t length);
+
+/**
+ * Close a pipeline's file.
+ */
+void close_pipeline_input(int fd);
+
+/**
+ * Parse the packets of one key.
+ *
+ * @return The key, or nullptr if its primary key could not be parsed.
+ */
+std::shared_ptr<TransferableKey> parse_framed_key(const ustring& data);
+
+/**
+ * The number of verification threads that a pipeline will use.
+ */
+std::size_t pipeline_verify_threads(const PipelineOptions& options);
+
+template <typename Result>
+KeyringPipeline<Result>::KeyringPipeline(const std::string& path,
+                                         Verifier verify,
+                                         const PipelineOptions& options)
+    : verify_(verify), options_(options), path_(path),
+      fd_(open_pipeline_input(path)),
+      reads_(options.queue_capacity), frames_(options.queue_capacity),
+      parsed_(options.queue_capacity), outputs_(options.queue_capacity),
+      delivered_(0), parsers_left_(std::max<std::size_t>(
+          1, options.parse_threads)),
+      verifiers_left_(pipeline_verify_threads(options)), cancelled_(false),
+      failed_(false), failed_at_(0) {
+  threads_.push_back(std::thread(&KeyringPipeline::Read, this));
+  threads_.push_back(std::thread(&KeyringPipeline::FrameKeys, this));
+  for (std::size_t i = parsers_left_; i > 0; i--) {
+    threads_.push_back(std::thread(&KeyringPipeline::Parse, this));
+  }
+  for (std::size_t i = verifiers_left_; i > 0; i--) {
+    threads_.push_back(std::thread(&KeyringPipeline::Verify, this));
+  }
+}
+
+template <typename Result>
+KeyringPipeline<Result>::~KeyringPipeline() {
+  Stop();
+  for (auto i = threads_.begin(); i != threads_.end(); i++) {
+    i->join();
+  }
+  close_pipeline_input(fd_);
+}
+
+template <typename Result>
+bool KeyringPipeline<Result>::Next(Result* result) {
+  while (true) {
+    const std::size_t sequence = delivered_.load();
+    if (failed_) {
+      std::lock_guard<std::mutex> lock(error_mutex_);
+      if (sequence >= failed_at_) {
+        std::rethrow_exception(error_);
+      }
+    }
+    auto i = reorder_.find(sequence);
+    if (reorder_.end() == i) {
+      Output output;
+      if (!outputs_.Pop(&output)) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if (error_) {
+          std::rethrow_exception(error_);
+        }
+        return false;
+      }
+      reorder_.insert(std::make_pair(output.sequence, std::move(output)));
+      continue;
+    }
+
+    const bool present = i->second.present;
+    if (present) {
+      *result = std::move(i->second.value);
+    }
+    reorder_.erase(i);
+    delivered_.store(sequence + 1);
+    if (present) {
+      return true;
+    }
+  }
+}
+
+template <typename Result>
+void KeyringPipeline<Result>::Read() {
+  try {
+    while (!cancelled_ && !failed_) {
+      ustring data(options_.read_length, 0);
+      data.resize(read_pipeline_input(fd_, path_, &data[0], data.length()));
+      if (data.empty() || !reads_.Push(std::move(data))) {
+        break;
+      }
+    }
+  }
+  catch (...) {
+    // This comes after every key that can be framed.
+    Fail(std::current_exception(), static_cast<std::size_t>(-1));
+  }
+  reads_.Close();
+}
+
+template <typename Result>
+void KeyringPipeline<Result>::FrameKeys() {
+  std::size_t sequence = 0;
+  try {
+    KeyFramer framer([this, &sequence](ustring data) {
+        // Hold back while the window of keys in flight is full.
+        Backoff backoff;
+        while (sequence >= delivered_.load() + options_.queue_capacity) {
+          if (cancelled_ || failed_) {
+            return;
+          }
+          backoff.Wait();
+        }
+        Frame frame = {sequence++, std::move(data)};
+        frames_.Push(std::move(frame));
+      });
+    ustring data;
+    while (!cancelled_ && !failed_ && reads_.Pop(&data)) {
+      framer.Add(data.data(), data.length());
+    }
+    // After a failure the last key may be incomplete.
+    if (!cancelled_ && !failed_) {
+      framer.Finish();
+    }
+  }
+  catch (...) {
+    Fail(std::current_exception(), sequence);
+  }
+  frames_.Close();
+}
+
+template <typename Result>
+void KeyringPipeline<Result>::Parse() {
+  Frame frame = Frame();
+  try {
+    while (!cancelled_ && frames_.Pop(&frame)) {
+      Parsed parsed = {frame.sequence, parse_framed_key(frame.data)};
+      if (!parsed_.Push(std::move(parsed))) {
+        break;
+      }
+    }
+  }
+  catch (...) {
+    Fail(std::current_exception(), frame.sequence);
+  }
+  if (0 == --parsers_left_) {
+    parsed_.Close();
+  }
+}
+
+template <typename Result>
+void KeyringPipeline<Result>::Verify() {
+  Parsed parsed = Parsed();
+  try {
+    while (!cancelled_ && parsed_.Pop(&parsed)) {
+      Output output;
+      output.sequence = parsed.sequence;
+      output.present = static_cast<bool>(parsed.key);
+      if (output.present) {
+        output.value = verify_(*parsed.key);
+      }
+      if (!outputs_.Push(std::move(output))) {
+        break;
+      }
+    }
+  }
+  catch (...) {
+    Fail(std::current_exception(), parsed.sequence);
+  }
+  if (0 == --verifiers_left_) {
+    outputs_.Close();
+  }
+}
+
+template <typename Result>
+void KeyringPipeline<Result>::Fail(std::exception_ptr error,
+                                   std::size_t sequence) {
+  {
+    // Next() reaches the earliest failure first.
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (!error_ || sequence < failed_at_) {
+      error_ = error;
+      failed_at_ = sequence;
+    }
+  }
+  failed_ = true;
+  // Only the stages feeding the pipeline stop; the keys already past
+  // them are finished, so that their results can be returned.
+  reads_.Close();
+  frames_.Close();
+}
+
+template <typename Result>
+void KeyringPipeline<Result>::Stop() {
+  cancelled_ = true;
+  reads_.Close();
+  frames_.Close();
+  parsed_.Close();
+  outputs_.Close();
+}
+
+/// @endcond
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_PIPELINE_H_
@@ -0,0 +1,173 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_SNAPSHOT_H_
+#define PARSE4880_INCLUDE_KEYRING_SNAPSHOT_H_
+
+/**
+ * @file snapshot.h
+ *
+ * Immutable keyring snapshots, replaced atomically as a keyring changes.
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parser_types.h"
+#include "parse_limits.h"
+#include "packet.h"
+#include "keyring/key_index.h"
+#include "keyring/transferable_key.h"
+#include "keyring/uid_index.h"
+
+namespace parse4880 {
+
+/**
+ * A keyring, its transferable keys and its indices, as at one moment.
+ *
+ * A snapshot is never modified once built, so any number of threads
+ * may read it at once without locking.
+ */
+class KeyringSnapshot {
+ public:
+  /**
+   * Construct an empty snapshot.
+   */
+  KeyringSnapshot();
+
+  /**
+   * Construct a snapshot of a parsed keyring.
+   *
+   * @param packets     The packets of the keyring.
+   * @param generation  The number of the snapshot.
+   */
+  KeyringSnapshot(const std::list<std::shared_ptr<PGPPacket>>& packets,
+                  uint64_t generation);
+
+  KeyringSnapshot(const KeyringSnapshot&) = delete;
+  KeyringSnapshot& operator=(const KeyringSnapshot&) = delete;
+
+  /**
+   * The number of the snapshot, counting from zero for the empty
+   * snapshot with which a SnapshotPublisher starts.
+   */
+  uint64_t generation() const;
+
+  /**
+   * The transferable keys, in the order in which they appeared.
+   */
+  const std::vector<std::shared_ptr<const TransferableKey>>& keys() const;
+
+  /**
+   * The parsed keys and subkeys, by key ID.
+   */
+  const KeyIndex& key_index() const;
+
+  /**
+   * The user IDs.
+   */
+  const UserIDIndex& user_ids() const;
+
+ private:
+  uint64_t generation_;
+  std::vector<std::shared_ptr<const TransferableKey>> keys_;
+  KeyIndex key_index_;
+  UserIDIndex user_ids_;
+};
+
+/**
+ * The current snapshot of a keyring that is refreshed in the background.
+ *
+ * Readers call Current() and keep the shared_ptr that it returns for
+ * as long as they need a consistent view; the snapshot stays alive
+ * until the last reader lets go, however many refreshes come in the
+ * meantime.  Taking a snapshot uses std::atomic_load on a shared_ptr,
+ * which standard libraries such as libstdc++ implement with a small
+ * lock that publishing also takes, but only to copy or swap the
+ * pointer.  Parsing and indexing happen outside it, and nothing a
+ * reader does with a snapshot involves the publisher, so readers and
+ * refreshes hold each other up for no more than a pointer swap.
+ *
+ * Refreshes are parsed and indexed on the publisher's own thread.  If
+ * several arrive while one is being built, only the latest is used.
+ * Replaced snapshots are kept until no reader holds them, and are then
+ * freed on the publisher's thread, so that a reader is not left to pay
+ * for tearing down a whole keyring.
+ */
+class SnapshotPublisher {
+ public:
+  /**
+   * Start publishing, beginning with an empty snapshot.
+   *
+   * @param limits  The limits within which keyrings are parsed.
+   */
+  explicit SnapshotPublisher(const ParseLimits& limits = ParseLimits());
+
+  /**
+   * Stop the publisher, dropping any refresh not yet published.
+   * Snapshots held by readers remain valid.
+   */
+  ~SnapshotPublisher();
+
+  SnapshotPublisher(const SnapshotPublisher&) = delete;
+  SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+  /**
+   * The latest snapshot.  This may be called from any thread.
+   *
+   * @return The snapshot, which is never nullptr.
+   */
+  std::shared_ptr<const KeyringSnapshot> Current() const;
+
+  /**
+   * Replace the keyring.  This returns at once; the new snapshot is
+   * built and published in the background.
+   *
+   * @param keyring  The new contents of the keyring.
+   */
+  void Refresh(ustring keyring);
+
+  /**
+   * Wait until every refresh so far has been published or rejected.
+   *
+   * @param message  If not nullptr, set to a description of the last
+   *                 refresh's failure, or emptied if it succeeded.
+   *
+   * @return The outcome of the last refresh, which leaves the previous
+   *         snapshot in place if it failed.  Exceptions while building
+   *         the snapshot are reported with the status of the same kind
+   *         (see ParseErrorFor), as kParseMemoryBudgetExceeded if
+   *         memory ran out, or as kParseInvalidPacket otherwise.
+   */
+  ParseError Flush(std::string* message = nullptr);
+
+ private:
+  void Run();
+  void Build(const ustring& keyring);
+  void Reap();
+
+  const ParseLimits limits_;
+  std::shared_ptr<const KeyringSnapshot> current_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  ustring pending_;
+  bool has_pending_;
+  bool building_;
+  bool stopping_;
+  ParseError last_error_;
+  std::string last_message_;
+
+  // Only touched by the publisher's thread.
+  std::list<std::shared_ptr<const KeyringSnapshot>> retired_;
+
+  std::thread thread_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_SNAPSHOT_H_
@@ -0,0 +1,130 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_TIMELINE_H_
+#define PARSE4880_INCLUDE_KEYRING_TIMELINE_H_
+
+/**
+ * @file timeline.h
+ *
+ * Point-in-time validity of keys.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "keyring/transferable_key.h"
+
+namespace parse4880 {
+
+/**
+ * The state of a key at some point in time.
+ */
+enum KeyValidity {
+  kKeyValid = 0,     ///< The key is bound and in force.
+  kKeyNotYetValid,   ///< The key had not yet been created.
+  kKeyUnbound,       ///< No self-signature was in force.
+  kKeyExpired,       ///< The most recent self-signature had expired the key.
+  kKeyRevoked        ///< The key had been revoked.
+};
+
+/**
+ * A self-signature binding a key, as recorded in a KeyTimeline.
+ */
+struct KeyBinding {
+  /**
+   * When the binding signature was made.
+   */
+  int64_t created;
+
+  /**
+   * When the binding stops counting, because the signature expired
+   * or its user ID was revoked, or INT64_MAX if it does not.
+   */
+  int64_t withdrawn;
+
+  /**
+   * When the binding says the key expires, or INT64_MAX if it does not.
+   */
+  int64_t key_expires;
+};
+
+/**
+ * The self-signatures and revocations of a key, ordered by time.
+ *
+ * The timeline is built once from a transferable key, after which the
+ * validity of the key at any time is found by a binary search over its
+ * bindings.  At time T a key is
+ *
+ *   - not yet valid if T precedes its creation,
+ *   - revoked if a revocation made at or before T exists,
+ *   - unbound if no binding made at or before T is still in force,
+ *   - expired if the latest such binding sets an expiration at or
+ *     before T, and
+ *   - valid otherwise.
+ *
+ * A subkey is also invalid whenever its primary key is.
+ *
+ * Only signatures issued by the primary key are considered, but they
+ * are not verified here: the key should be checked with
+ * verify_uid_binding() and verify_subkey_binding() first, and
+ * signatures failing verification discarded.
+ */
+class KeyTimeline {
+ public:
+  /**
+   * Build the timeline of a primary key.
+   *
+   * Its bindings are the certifications (0x10--0x13) of its user IDs,
+   * withdrawn by any certification revocation (0x30), and direct-key
+   * signatures (0x1F).  It is revoked by a key revocation (0x20).
+   *
+   * @param key  The key.
+   */
+  explicit KeyTimeline(const TransferableKey& key);
+
+  /**
+   * Build the timeline of a subkey.
+   *
+   * Its bindings are subkey binding signatures (0x18), and it is
+   * revoked by a subkey revocation (0x28).
+   *
+   * @param primary  The timeline of the primary key.
+   * @param key      The transferable key holding the subkey.
+   * @param subkey   The subkey.
+   */
+  KeyTimeline(std::shared_ptr<const KeyTimeline> primary,
+              const TransferableKey& key, const KeyComponent& subkey);
+
+  /**
+   * The validity of the key at some time.
+   *
+   * @param time  The time in seconds since the epoch.
+   *
+   * @return The state of the key at that time.
+   */
+  KeyValidity validity_at(int64_t time) const;
+
+  /**
+   * The bindings of the key, ordered by creation time.
+   */
+  const std::vector<KeyBinding>& bindings() const;
+
+  /**
+   * The time of the earliest revocation, or INT64_MAX if there is none.
+   */
+  int64_t revoked_at() const;
+
+ private:
+  void AddBinding(const SignaturePacket& signature, int64_t withdrawn);
+  void Sort();
+
+ private:
+  std::shared_ptr<const KeyTimeline> primary_;
+  ustring                            issuer_;
+  int64_t                            key_created_;
+  int64_t                            revoked_at_;
+  std::vector<KeyBinding>            bindings_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_TIMELINE_H_
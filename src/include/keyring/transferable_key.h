@@ -0,0 +1,134 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_TRANSFERABLE_KEY_H_
+#define PARSE4880_INCLUDE_KEYRING_TRANSFERABLE_KEY_H_
+
+/**
+ * @file transferable_key.h
+ *
+ * Grouping of packets into transferable public keys.
+ */
+
+#include <functional>
+#include <list>
+#include <memory>
+
+#include "parser_types.h"
+#include "packet.h"
+#include "writer.h"
+
+namespace parse4880 {
+
+/**
+ * A user ID, user attribute or subkey together with its signatures.
+ */
+struct KeyComponent {
+  /**
+   * The user ID, user attribute or subkey packet.
+   */
+  std::shared_ptr<PGPPacket> packet;
+
+  /**
+   * The signatures following the packet.
+   *
+   * These are usually SignaturePackets, but signatures that could not
+   * be parsed are kept as UnknownPGPPackets so that they survive a
+   * round trip.
+   */
+  std::list<std::shared_ptr<PGPPacket>> signatures;
+};
+
+/**
+ * A transferable public key, as described in RFC4880 §11.1.
+ *
+ * This is a primary key followed by its direct signatures, its
+ * user IDs and user attributes, and its subkeys, each with their
+ * own signatures.
+ */
+struct TransferableKey {
+  /**
+   * The primary key.
+   */
+  std::shared_ptr<PublicKeyPacket> primary_key;
+
+  /**
+   * Signatures directly on the primary key, such as revocations.
+   */
+  std::list<std::shared_ptr<PGPPacket>> signatures;
+
+  /**
+   * User IDs and user attributes, in the order in which they appeared.
+   */
+  std::list<KeyComponent> user_ids;
+
+  /**
+   * Subkeys, in the order in which they appeared.
+   */
+  std::list<KeyComponent> subkeys;
+};
+
+/**
+ * Assemble a stream of packets into transferable keys.
+ *
+ * Packets are added one at a time, for example from the callback of
+ * parse(), and each key is passed on as soon as the next primary key
+ * is seen, so only one key need be held in memory at once.
+ *
+ * Packets that precede the first primary key, trust packets, and the
+ * packets of a key whose primary key could not be parsed are dropped.
+ */
+class TransferableKeyGrouper {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param callback  Called with each complete key.  Grouping stops
+   *                  when it returns false.
+   */
+  explicit TransferableKeyGrouper(
+      std::function<bool(std::shared_ptr<TransferableKey>)> callback);
+
+  /**
+   * Add the next packet.
+   *
+   * @param packet  The packet to be added.
+   *
+   * @return false if the callback has asked for grouping to stop.
+   */
+  bool Add(std::shared_ptr<PGPPacket> packet);
+
+  /**
+   * Pass on the last key, if any.
+   *
+   * @return false if the callback has asked for grouping to stop.
+   */
+  bool Finish();
+
+ private:
+  std::function<bool(std::shared_ptr<TransferableKey>)> callback_;
+  std::shared_ptr<TransferableKey> current_;
+  std::list<std::shared_ptr<PGPPacket>>* current_signatures_;
+  bool skipping_;
+};
+
+/**
+ * Group a list of packets into transferable keys.
+ *
+ * @param packets  The packets to be grouped.
+ *
+ * @return The keys found in the packets.
+ *
+ * @see TransferableKeyGrouper
+ */
+std::list<std::shared_ptr<TransferableKey>> group_transferable_keys(
+    const std::list<std::shared_ptr<PGPPacket>>& packets);
+
+/**
+ * Append the packets of a transferable key to a writer.
+ *
+ * @param key     The key to be written.
+ * @param writer  The writer to which the packets are appended.
+ */
+void WriteTransferableKey(const TransferableKey& key, PacketWriter* writer);
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_TRANSFERABLE_KEY_H_
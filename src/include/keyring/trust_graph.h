@@ -0,0 +1,194 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_TRUST_GRAPH_H_
+#define PARSE4880_INCLUDE_KEYRING_TRUST_GRAPH_H_
+
+/**
+ * @file trust_graph.h
+ *
+ * The web-of-trust certification graph.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "parser_types.h"
+#include "packet.h"
+#include "keyring/transferable_key.h"
+
+namespace parse4880 {
+
+/**
+ * A graph of third-party certifications between keys.
+ *
+ * Keys are numbered densely from zero, and there is an edge from one
+ * key to another for each key that the first has certified.  Edges
+ * are held in compressed sparse row form: the targets of every edge,
+ * sorted by source, and for each key the offset of its first edge.
+ * The reverse edges are held in the same way.
+ *
+ * Traversals can be spread across several threads.  Each level of a
+ * breadth-first search is divided between the threads, which claim
+ * newly-reached keys with an atomic operation.
+ */
+class TrustGraph {
+ public:
+  /**
+   * The distance to a key that cannot be reached.
+   */
+  static const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+
+  /**
+   * A range of key indices.
+   */
+  struct Range {
+    const uint32_t* begin;
+    const uint32_t* end;
+  };
+
+  TrustGraph();
+
+  /**
+   * The number of keys in the graph.
+   */
+  std::size_t size() const;
+
+  /**
+   * The number of certifications in the graph.
+   */
+  std::size_t edge_count() const;
+
+  /**
+   * Find the index of a key.
+   *
+   * @param fingerprint  The fingerprint of the key.
+   * @param index        Set to the index of the key if it is found.
+   *
+   * @return true if the key is in the graph.
+   */
+  bool Find(const ustring& fingerprint, uint32_t* index) const;
+
+  /**
+   * The fingerprint of a key.
+   *
+   * @param index  The index of the key.
+   */
+  const ustring& fingerprint(uint32_t index) const;
+
+  /**
+   * The keys certified by a key.
+   *
+   * @param index  The index of the certifying key.
+   */
+  Range certified_by(uint32_t index) const;
+
+  /**
+   * The keys that have certified a key.
+   *
+   * @param index  The index of the certified key.
+   */
+  Range certifiers_of(uint32_t index) const;
+
+  /**
+   * Find how many certifications separate each key from a set of
+   * trusted keys.
+   *
+   * @param roots      The indices of the trusted keys.
+   * @param max_depth  The longest chain of certifications to follow.
+   * @param threads    The number of threads to use, or zero for one
+   *                   per hardware thread.
+   *
+   * @return The length of the shortest chain from a root to each key,
+   *         or kUnreachable if there is none no longer than max_depth.
+   */
+  std::vector<uint32_t> TrustDepths(const std::vector<uint32_t>& roots,
+                                    uint32_t max_depth,
+                                    std::size_t threads = 0) const;
+
+  /**
+   * Find a shortest chain of certifications from one key to another.
+   *
+   * @param from       The index of the trusted key.
+   * @param to         The index of the key to be reached.
+   * @param max_depth  The longest chain of certifications to follow.
+   *
+   * @return The keys along the chain, from from to to inclusive, or
+   *         an empty vector if there is no chain of at most max_depth
+   *         certifications.
+   */
+  std::vector<uint32_t> FindPath(uint32_t from, uint32_t to,
+                                 uint32_t max_depth) const;
+
+ private:
+  friend class TrustGraphBuilder;
+
+  std::vector<ustring>           fingerprints_;
+  std::map<ustring, uint32_t>    index_;
+  std::vector<std::size_t>       forward_offsets_;
+  std::vector<uint32_t>          forward_targets_;
+  std::vector<std::size_t>       reverse_offsets_;
+  std::vector<uint32_t>          reverse_targets_;
+};
+
+/**
+ * Collect the certifications of a keyring into a TrustGraph.
+ *
+ * Keys are added one at a time, for example from a
+ * TransferableKeyGrouper, and their certifications are held until
+ * Build() is called, when the certifying keys are found by key ID.
+ * Self-signatures and certifications by keys not in the keyring are
+ * dropped.
+ */
+class TrustGraphBuilder {
+ public:
+  /**
+   * Check a certification before it is added to the graph.
+   *
+   * This is given the certified key and user ID, the certifying key
+   * and the certification, as for verify_uid_binding().
+   */
+  typedef std::function<bool(const PublicKeyPacket&, const UserIDPacket&,
+                             const PublicKeyPacket&, const SignaturePacket&)>
+      Verifier;
+
+  TrustGraphBuilder();
+
+  /**
+   * Add a key and the certifications of its user IDs.
+   *
+   * @param key  The key to be added.
+   */
+  void Add(const TransferableKey& key);
+
+  /**
+   * Build the graph.
+   *
+   * @param verifier  Called for each certification, which is dropped
+   *                  unless it returns true.  If this is empty, every
+   *                  certification is accepted.
+   * @param threads   The number of threads among which to share the
+   *                  verifications, or zero for one per hardware
+   *                  thread.
+   *
+   * @return The certification graph.
+   */
+  TrustGraph Build(Verifier verifier = Verifier(), std::size_t threads = 0);
+
+ private:
+  struct Certification {
+    uint32_t                         target;
+    ustring                          issuer;
+    std::shared_ptr<UserIDPacket>    uid;
+    std::shared_ptr<SignaturePacket> signature;
+  };
+
+  std::vector<std::shared_ptr<PublicKeyPacket>> keys_;
+  std::multimap<ustring, uint32_t>              key_ids_;
+  std::vector<Certification>                    certifications_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_TRUST_GRAPH_H_
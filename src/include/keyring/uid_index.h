@@ -0,0 +1,164 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_UID_INDEX_H_
+#define PARSE4880_INCLUDE_KEYRING_UID_INDEX_H_
+
+/**
+ * @file uid_index.h
+ *
+ * Search index over the user IDs of a keyring.
+ */
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "parser_types.h"
+#include "keyring/transferable_key.h"
+
+namespace parse4880 {
+
+/**
+ * A user ID found in a UserIDIndex.
+ */
+struct UserIDMatch {
+  /**
+   * The fingerprint of the primary key to which the user ID belongs.
+   */
+  ustring     fingerprint;
+
+  /**
+   * The user ID itself.
+   */
+  std::string user_id;
+};
+
+/**
+ * Find keys by their user IDs.
+ *
+ * Two kinds of lookup are supported: exact lookup of an email
+ * address, ignoring case, and case-insensitive substring search over
+ * the whole user ID.  Substring search uses an inverted index of the
+ * three-octet sequences (trigrams) in each user ID, so that only user
+ * IDs containing every trigram of the query need to be examined.
+ *
+ * User IDs are held in a single buffer, and each trigram maps to a
+ * sorted list of four-octet user ID numbers, so the index costs a
+ * small multiple of the size of the user IDs themselves.
+ *
+ * The index can be saved to a file, which holds the fingerprints and
+ * user IDs only.  The lookup tables are rebuilt when it is loaded:
+ *
+ *   - Header
+ *     + [8] Magic "P4880UI1"
+ *     + [8] Number of keys
+ *     + [8] Number of user IDs
+ *   - Key
+ *     + [1] Fingerprint length
+ *     + [?] Fingerprint
+ *   - ...
+ *   - User ID
+ *     + [4] Key number
+ *     + [4] User ID length
+ *     + [?] User ID
+ *   - ...
+ *
+ * All integers are big-endian.
+ */
+class UserIDIndex {
+ public:
+  UserIDIndex();
+
+  /**
+   * Load an index from a file.
+   *
+   * @param path  The file from which to load the index.
+   */
+  explicit UserIDIndex(const std::string& path);
+
+  /**
+   * Add the user IDs of a key to the index.
+   *
+   * @param key  The key whose user IDs are to be indexed.
+   */
+  void Add(const TransferableKey& key);
+
+  /**
+   * Add a single user ID to the index.
+   *
+   * @param fingerprint  The fingerprint of the key holding the user ID.
+   * @param user_id      The user ID.
+   */
+  void Add(const ustring& fingerprint, const std::string& user_id);
+
+  /**
+   * Find user IDs by email address.
+   *
+   * @param email  The address to find, which need not be normalized.
+   *
+   * @return Every user ID with the given address, in the order in
+   *         which they were added.
+   */
+  std::vector<UserIDMatch> FindByEmail(const std::string& email) const;
+
+  /**
+   * Find user IDs containing some text, ignoring case.
+   *
+   * @param text  The text to find.
+   *
+   * @return Every user ID containing the text, in the order in which
+   *         they were added.
+   */
+  std::vector<UserIDMatch> FindSubstring(const std::string& text) const;
+
+  /**
+   * Write the index to a file.
+   *
+   * @param path  The file to which the index is written.
+   */
+  void Save(const std::string& path) const;
+
+  /**
+   * The number of user IDs in the index.
+   *
+   * @return The number of user IDs.
+   */
+  std::size_t size() const;
+
+  /**
+   * Extract the normalized email address from a user ID.
+   *
+   * The address is the text between the last pair of angle brackets
+   * or, if there are none, the whole user ID if it contains an '@'.
+   * ASCII letters are converted to lower case, and surrounding
+   * whitespace is removed.
+   *
+   * @param user_id  The user ID.
+   *
+   * @return The normalized address, or an empty string if there is none.
+   */
+  static std::string NormalizeEmail(const std::string& user_id);
+
+ private:
+  struct Entry {
+    uint32_t    key;
+    std::size_t offset;
+    uint32_t    length;
+  };
+
+  void Index(uint32_t entry_number);
+  std::string LowerCaseUserID(const Entry& entry) const;
+  UserIDMatch Match(uint32_t entry_number) const;
+
+ private:
+  std::vector<ustring> keys_;
+  std::map<ustring, uint32_t> key_numbers_;
+  std::vector<Entry> entries_;
+  std::string user_ids_;
+  std::unordered_map<std::string, std::vector<uint32_t>> emails_;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_UID_INDEX_H_
@@ -0,0 +1,303 @@
+#ifndef PARSE4880_INCLUDE_KEYRING_VERIFY_SERVICE_H_
+#define PARSE4880_INCLUDE_KEYRING_VERIFY_SERVICE_H_
+
+/**
+ * @file verify_service.h
+ *
+ * A signature verification service on a Unix domain socket.
+ *
+ * The server holds a KeyIndex, so that the keyring is read and its keys
+ * parsed only once, and answers requests on a pool of threads.  The
+ * socket is accessible only to the server's own user.  Each connection
+ * carries any number of requests, one after another, each answered
+ * before the next is read, until it has been open for
+ * kVerifyConnectionSeconds or idle for kVerifyIdleSeconds; clients with
+ * more to ask then reconnect.
+ * All integers are big-endian.
+ *
+ * A request is:
+ *
+ *   - one octet, the protocol version, kVerifyProtocolVersion;
+ *   - one octet, the VerifySource of the data;
+ *   - four octets, the length of the signature;
+ *   - four octets, the length of the path, zero unless the source is
+ *     kVerifySourcePath;
+ *   - the detached signature, in binary;
+ *   - the path.
+ *
+ * For kVerifySourcePath, the path must name a regular file.  For
+ * kVerifySourceDescriptor, an open file descriptor is passed with
+ * SCM_RIGHTS alongside the first ten octets, so that the server reads
+ * exactly the files that the client can.  A descriptor that is not on
+ * a regular file, such as a pipe, is read to its end, up to
+ * kVerifyMaximumStreamLength octets.
+ *
+ * A response is:
+ *
+ *   - one octet, the VerifyStatus;
+ *   - four octets, the length of the message;
+ *   - the message: a description of the signing key where there is
+ *     one, and of the error otherwise.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parser_types.h"
+#include "exceptions.h"
+#include "keyring/key_index.h"
+
+namespace parse4880 {
+
+/**
+ * The version of the protocol.
+ */
+const uint8_t kVerifyProtocolVersion = 1;
+
+/**
+ * The longest signature that the server accepts.
+ */
+const uint32_t kVerifyMaximumSignatureLength = 64 * 1024;
+
+/**
+ * The longest path that the server accepts.
+ */
+const uint32_t kVerifyMaximumPathLength = 4096;
+
+/**
+ * The most data that the server reads from a descriptor that is not on
+ * a regular file.
+ */
+const uint64_t kVerifyMaximumStreamLength = 1ULL << 30;
+
+/**
+ * How long a connection may stay open, in seconds, however many
+ * requests it carries.
+ */
+const int kVerifyConnectionSeconds = 60;
+
+/**
+ * How long the server waits for a request to start, in seconds, before
+ * closing an idle connection.
+ */
+const int kVerifyIdleSeconds = 5;
+
+/**
+ * Where the server finds the signed data.
+ */
+enum VerifySource {
+  kVerifySourcePath = 0,        ///< The server opens a path.
+  kVerifySourceDescriptor = 1   ///< The client passes an open descriptor.
+};
+
+/**
+ * The outcome of a request.
+ */
+enum VerifyStatus {
+  kVerifyBad = 0,               ///< The signature does not verify.
+  kVerifyGood = 1,              ///< The signature verifies.
+  kVerifyNoKey = 2,             ///< No key has the signature's key ID.
+  kVerifyMalformed = 3,         ///< The request or signature is malformed.
+  kVerifyReadError = 4          ///< The signed data could not be read.
+};
+
+/**
+ * The server's answer to a request.
+ */
+struct VerifyResponse {
+  /**
+   * The outcome.
+   */
+  VerifyStatus status;
+
+  /**
+   * The signing key or the error, for people to read.
+   */
+  std::string message;
+};
+
+/**
+ * Verify a detached signature over some data.
+ *
+ * @param index      The keys with which to verify.
+ * @param signature  The detached signature, in binary.  It is parsed
+ *                   with ParseLimits::Untrusted().
+ * @param data       The signed data.
+ * @param length     The length of the data.
+ *
+ * @return The outcome, with a description of the signing key if one
+ *         was found.
+ *
+ * @throw unsupported_feature_error  If the signature's hash algorithm is
+ *                                   not supported.
+ */
+VerifyResponse verify_signature(const KeyIndex& index,
+                                const ustring& signature,
+                                const uint8_t* data, std::size_t length);
+
+/**
+ * Verify a detached signature over the data in an open file.  Regular
+ * files are mapped.  Anything else is hashed as it is read, up to
+ * kVerifyMaximumStreamLength octets.
+ *
+ * @param index      The keys with which to verify.
+ * @param fd         A descriptor open for reading on the data.  It is
+ *                   not closed.
+ * @param name       The name of the file, for error messages.
+ * @param signature  The detached signature, in binary.
+ * @param deadline   When to give up waiting for data that is not in a
+ *                   regular file.
+ * @param wake_fd    A descriptor that becomes readable when waiting
+ *                   for such data should be abandoned, or -1.
+ *
+ * @return The outcome, which is kVerifyReadError if the file cannot be
+ *         read in time or is too long.
+ *
+ * @throw unsupported_feature_error  If the signature's hash algorithm is
+ *                                   not supported.
+ */
+VerifyResponse verify_descriptor(
+    const KeyIndex& index, int fd, const std::string& name,
+    const ustring& signature,
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::time_point::max(),
+    int wake_fd = -1);
+
+/**
+ * A short name for a status, for machine-readable output.
+ *
+ * @param status  The status.
+ *
+ * @return The name, such as "good" or "no_key".
+ */
+const char* verify_status_name(VerifyStatus status);
+
+/**
+ * A verification server.
+ */
+class VerifyServer {
+ public:
+  /**
+   * Listen on a socket, which only the server's user may connect to.
+   * Any stale socket at the path is replaced, but nothing else is.
+   *
+   * @param index    The keys with which to verify.
+   * @param path     The path of the socket.
+   * @param threads  The number of requests to handle at once, or zero
+   *                 for one per hardware thread.
+   *
+   * @throw socket_error  If the socket cannot be created, or something
+   *                      other than a socket is at the path.
+   */
+  VerifyServer(std::shared_ptr<const KeyIndex> index, const std::string& path,
+               std::size_t threads = 0);
+
+  /**
+   * Stop the server and remove the socket.
+   */
+  ~VerifyServer();
+
+  VerifyServer(const VerifyServer&) = delete;
+  VerifyServer& operator=(const VerifyServer&) = delete;
+
+  /**
+   * Start answering requests in the background.
+   */
+  void Start();
+
+  /**
+   * Stop accepting connections, and wait for the requests under way to
+   * finish.  Connections waiting on their clients are closed at once.
+   * This may be called from any thread but the server's own.
+   */
+  void Stop();
+
+  /**
+   * Answer a single request.
+   *
+   * @param signature  The detached signature.
+   * @param data       The signed data.
+   * @param length     The length of the data.
+   *
+   * @return The response.
+   */
+  VerifyResponse Answer(const ustring& signature,
+                        const uint8_t* data, std::size_t length) const;
+
+ private:
+  void Run();
+  void Serve(int connection,
+             std::chrono::steady_clock::time_point deadline) const;
+
+  std::shared_ptr<const KeyIndex> index_;
+  std::string path_;
+  std::size_t threads_;
+  int listener_;
+  // Written by Stop() to wake the threads waiting on connections.
+  int wake_[2];
+  std::atomic<bool> stopping_;
+  std::vector<std::thread> workers_;
+};
+
+/**
+ * A connection to a verification server.
+ */
+class VerifyClient {
+ public:
+  /**
+   * Connect to a server.
+   *
+   * @param path  The path of the server's socket.
+   *
+   * @throw socket_error  If the connection fails.
+   */
+  explicit VerifyClient(const std::string& path);
+
+  /**
+   * Close the connection.
+   */
+  ~VerifyClient();
+
+  VerifyClient(const VerifyClient&) = delete;
+  VerifyClient& operator=(const VerifyClient&) = delete;
+
+  /**
+   * Verify the data in an open file.
+   *
+   * @param fd         A descriptor open for reading on the data.
+   * @param signature  The detached signature.
+   *
+   * @return The server's response.
+   *
+   * @throw socket_error  If the server cannot be reached.
+   */
+  VerifyResponse Verify(int fd, const ustring& signature);
+
+  /**
+   * Verify the data in a file that the server opens itself.
+   *
+   * @param path       The path of the data, as seen by the server.
+   * @param signature  The detached signature.
+   *
+   * @return The server's response.
+   *
+   * @throw socket_error  If the server cannot be reached.
+   */
+  VerifyResponse Verify(const std::string& path, const ustring& signature);
+
+ private:
+  VerifyResponse Request(VerifySource source, int fd, const std::string& path,
+                         const ustring& signature);
+
+  std::string path_;
+  int socket_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYRING_VERIFY_SERVICE_H_
@@ -0,0 +1,66 @@
+#ifndef PARSE4880_INCLUDE_KEYS_ECDSAKEY_H_
+#define PARSE4880_INCLUDE_KEYS_ECDSAKEY_H_
+
+/**
+ * @file ecdsakey.h
+ *
+ * Machinery for ECDSA public keys.
+ */
+
+#include <memory>
+
+#include "packets/signature.h"
+#include "packets/keymaterial.h"
+#include "keys/key.h"
+
+namespace parse4880 {
+
+/**
+ * Represent an ECDSA public key.
+ *
+ * The NIST curves P-256, P-384 and P-521 are supported.
+ *
+ * Each curve is loaded once, together with the fixed-base table used
+ * to multiply by its generator, when the first key on it is
+ * constructed.  The loaded curve is never modified afterwards, so it
+ * is shared by every key on that curve and verifications may run on
+ * any number of threads at once.
+ *
+ * @see Key
+ */
+class ECDSAKey : public Key {
+ public:
+  /**
+   * Construct an ECDSAKey from a PublicKeyPacket.
+   *
+   * @param rhs  The packet containing the key.
+   *
+   * @throw crypto_error  If the key's curve cannot be loaded.
+   */
+  explicit ECDSAKey(const PublicKeyPacket& rhs);
+
+  /**
+   * Construct an ECDSAKey without throwing on malformed key material.
+   *
+   * @param rhs    The packet containing the key.
+   * @param error  Set to the status of the parse.  The key should be
+   *               discarded unless this is successful.
+   *
+   * @throw crypto_error  If the key's curve cannot be loaded.
+   */
+  ECDSAKey(const PublicKeyPacket& rhs, ParseError* error);
+  virtual ~ECDSAKey();
+
+  virtual std::unique_ptr<VerificationContext> GetVerificationContext(
+      const SignaturePacket& signature) const;
+
+ private:
+  ParseError Load(const PublicKeyPacket& rhs);
+
+  class impl;
+  std::shared_ptr<impl> impl_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYS_ECDSAKEY_H_
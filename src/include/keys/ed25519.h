@@ -0,0 +1,76 @@
+#ifndef PARSE4880_INCLUDE_KEYS_ED25519_H_
+#define PARSE4880_INCLUDE_KEYS_ED25519_H_
+
+/**
+ * @file ed25519.h
+ *
+ * Ed25519 signature verification.
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace parse4880 {
+
+namespace ed25519 {
+
+/**
+ * A signature to be verified as part of a batch.
+ */
+struct BatchEntry {
+  /**
+   * The encoded public key.
+   */
+  const uint8_t* public_key;
+
+  /**
+   * The signature, R followed by S.
+   */
+  const uint8_t* signature;
+
+  /**
+   * The signed message.
+   */
+  const uint8_t* message;
+
+  /**
+   * The length of the message.
+   */
+  std::size_t message_length;
+};
+
+/**
+ * Verify an Ed25519 signature, as specified in RFC8032.
+ *
+ * @param public_key      The 32-octet encoded public key.
+ * @param signature       The 64-octet signature.
+ * @param message         The signed message.
+ * @param message_length  The length of the message.
+ *
+ * @return true if the signature is valid, false if not.
+ */
+bool Verify(const uint8_t* public_key, const uint8_t* signature,
+            const uint8_t* message, std::size_t message_length);
+
+/**
+ * Verify several Ed25519 signatures at once.
+ *
+ * Rather than checking [S]B = R + [h]A for each signature, we check a
+ * random linear combination of these equations, multiplied by the
+ * cofactor.  All of the scalar multiplications are done together,
+ * so that the doublings are shared between the signatures rather than
+ * repeated for each one.  A batch containing an invalid
+ * signature fails except with negligible probability.
+ *
+ * @param entries  The signatures to verify.
+ *
+ * @return true if every signature is valid, false if not.
+ */
+bool VerifyBatch(const std::vector<BatchEntry>& entries);
+
+}
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYS_ED25519_H_
@@ -0,0 +1,120 @@
+#ifndef PARSE4880_INCLUDE_KEYS_EDDSAKEY_H_
+#define PARSE4880_INCLUDE_KEYS_EDDSAKEY_H_
+
+/**
+ * @file eddsakey.h
+ *
+ * Machinery for EdDSA public keys.
+ */
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "packets/signature.h"
+#include "packets/keymaterial.h"
+#include "keys/key.h"
+
+namespace parse4880 {
+
+/**
+ * Represent an EdDSA public key.
+ *
+ * Only Ed25519 keys are supported.  As is usual in OpenPGP, the data
+ * to be signed is first hashed with the signature's hash algorithm,
+ * and the digest is then signed with Ed25519.
+ *
+ * @see Key
+ */
+class EdDSAKey : public Key {
+ public:
+  /**
+   * Construct an EdDSAKey from a PublicKeyPacket.
+   *
+   * @param rhs  The packet containing the key.
+   */
+  explicit EdDSAKey(const PublicKeyPacket& rhs);
+
+  /**
+   * Construct an EdDSAKey without throwing on malformed key material.
+   *
+   * @param rhs    The packet containing the key.
+   * @param error  Set to the status of the parse.  The key should be
+   *               discarded unless this is successful.
+   */
+  EdDSAKey(const PublicKeyPacket& rhs, ParseError* error);
+  virtual ~EdDSAKey();
+
+  virtual std::unique_ptr<VerificationContext> GetVerificationContext(
+      const SignaturePacket& signature) const;
+
+ private:
+  ParseError Load(const PublicKeyPacket& rhs);
+
+ private:
+  std::array<uint8_t, 32> public_key_;
+
+  friend class EdDSABatchVerifier;
+};
+
+/**
+ * Verify many EdDSA signatures at once.
+ *
+ * Signatures are added along with the data that they sign, and are
+ * then checked together, which is several times cheaper per signature
+ * than checking them one by one.
+ *
+ * The batch check uses the cofactored verification equation, so it
+ * may accept a contrived signature that the individual check would
+ * reject; no signature produced by an honest signer differs.  When
+ * the batch fails, each signature is checked individually to find the
+ * invalid ones.
+ */
+class EdDSABatchVerifier {
+ public:
+  EdDSABatchVerifier();
+  ~EdDSABatchVerifier();
+
+  /**
+   * Add a signature to the batch.
+   *
+   * Short data signed with SHA-1 or SHA-256 is copied, and hashed
+   * together with the rest of the batch by Verify().  Other data is
+   * hashed immediately.  Neither the data nor the signature need
+   * outlive this call.
+   *
+   * @param key        The key that made the signature.
+   * @param signature  The signature to be verified.
+   * @param data       The signed data, excluding the signature's own
+   *                   hashed data.
+   *
+   * @return The index of the signature in the results of Verify().
+   */
+  std::size_t Add(const EdDSAKey& key, const SignaturePacket& signature,
+                  const ustring& data);
+
+  /**
+   * Verify every signature added since the last call.
+   *
+   * @return Whether each signature is valid, in the order in which
+   *         they were added.
+   */
+  std::vector<bool> Verify();
+
+ private:
+  struct Entry {
+    std::array<uint8_t, 32> public_key;
+    std::array<uint8_t, 64> signature;
+    ustring                 digest;
+    ustring                 message;
+    uint8_t                 hash_algorithm;
+    std::array<uint8_t, 2>  hash_prefix;
+    bool                    well_formed;
+  };
+
+  std::vector<Entry> entries_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_KEYS_EDDSAKEY_H_
@@ -10,6 +10,7 @@
 #include <memory>
 #include <string>
 
+#include "memory_accounting.h"
 #include "parser_types.h"
 #include "packet.h"
 
@@ -64,6 +65,18 @@ class VerificationContext {
    * @see Update
    */
   virtual bool Verify() = 0;
+
+ protected:
+  /**
+   * Charge the context's memory to the accounts.  Each concrete
+   * context calls this on construction.
+   *
+   * @param bytes  The number of bytes that the context holds.
+   */
+  void ChargeMemory(std::size_t bytes);
+
+ private:
+  MemoryCharge memory_charge_;
 };
 
 /**
@@ -99,6 +112,30 @@ class Key {
    * @return A unique_ptr to the resulting key object.
    */
   static std::unique_ptr<Key> ParseKey(const PublicKeyPacket& packet);
+
+  /**
+   * Construct an algorithm-specific public-key object without throwing
+   * on malformed or unsupported keys.
+   *
+   * @param packet  The packet that is to be parsed.
+   *
+   * @return The resulting key object, or nullptr and the reason for
+   *         failure.
+   */
+  static ParseResult<std::unique_ptr<Key>> TryParseKey(
+      const PublicKeyPacket& packet);
+
+ protected:
+  /**
+   * Charge the key's memory to the accounts.  Each concrete key type
+   * calls this on construction.
+   *
+   * @param bytes  The number of bytes that the key holds.
+   */
+  void ChargeMemory(std::size_t bytes);
+
+ private:
+  MemoryCharge memory_charge_;
 };
 
 }
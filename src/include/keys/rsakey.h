@@ -27,11 +27,23 @@ class RSAKey : public Key {
    * a blob with the key information.
    */
   explicit RSAKey(const PublicKeyPacket& rhs);
+
+  /**
+   * Construct an RSAKey without throwing on malformed key material.
+   *
+   * @param rhs    The packet containing the key.
+   * @param error  Set to the status of the parse.  The key should be
+   *               discarded unless this is successful.
+   */
+  RSAKey(const PublicKeyPacket& rhs, ParseError* error);
   virtual ~RSAKey();
   
   virtual std::unique_ptr<VerificationContext> GetVerificationContext(
       const SignaturePacket& Signature) const;
 
+ private:
+  ParseError Load(const PublicKeyPacket& rhs);
+
  private:
   class impl;
   std::unique_ptr<impl> impl_;
@@ -0,0 +1,70 @@
+#ifndef PARSE4880_INCLUDE_MAPPED_FILE_H_
+#define PARSE4880_INCLUDE_MAPPED_FILE_H_
+
+/**
+ * @file mapped_file.h
+ *
+ * Read-only memory mapping of files.
+ */
+
+#include <cstdint>
+#include <string>
+
+namespace parse4880 {
+
+/**
+ * A file mapped read-only into memory.
+ *
+ * This lets multi-gigabyte keyrings be scanned and split without
+ * first being read into a ustring; the operating system pages the
+ * data in as it is touched.
+ */
+class MappedFile {
+ public:
+  /**
+   * Map a file.
+   *
+   * @param path  The file to be mapped.
+   */
+  explicit MappedFile(const std::string& path);
+
+  /**
+   * Map an open file.  The descriptor is not closed, and may be
+   * closed as soon as the constructor returns.
+   *
+   * @param fd  A descriptor open for reading on a regular file.
+   */
+  explicit MappedFile(int fd);
+
+  /**
+   * Destructor, unmaps the file.
+   */
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   * The contents of the file.
+   *
+   * @return A pointer to the first octet of the file.
+   */
+  const uint8_t* data() const;
+
+  /**
+   * The length of the file.
+   *
+   * @return The length of the file, in octets.
+   */
+  std::size_t size() const;
+
+ private:
+  void Map(int fd, const std::string& name);
+
+  const uint8_t* data_;
+  std::size_t    size_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_MAPPED_FILE_H_
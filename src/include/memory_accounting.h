@@ -0,0 +1,217 @@
+#ifndef PARSE4880_INCLUDE_MEMORY_ACCOUNTING_H_
+#define PARSE4880_INCLUDE_MEMORY_ACCOUNTING_H_
+
+/**
+ * @file memory_accounting.h
+ *
+ * Accounting of the memory held by parsed objects.
+ *
+ * Packets, subpackets, keys and verification contexts charge the
+ * bytes that they hold to a set of process-wide counters when they
+ * are created and release them when they are destroyed, so that the
+ * live bytes, object counts and high-water marks can be read per
+ * subsystem and per packet tag.  The figures are the sizes of the
+ * objects and of the buffers that they own, with an estimate of the
+ * shared_ptr control block and list node that hold each packet, and
+ * do not include allocator overhead.
+ *
+ * A soft budget may be set on the total.  The parser checks each
+ * packet's length against it before copying the packet's contents,
+ * and stops with kParseMemoryBudgetExceeded rather than going on to
+ * allocate more.  Objects already created are not affected.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace parse4880 {
+
+/**
+ * The kinds of object whose memory is accounted.
+ */
+enum MemorySubsystem {
+  kMemoryPackets = 0,           ///< Packets, also accounted by tag.
+  kMemorySubpackets,            ///< Signature subpackets.
+  kMemoryKeys,                  ///< Keys parsed from key packets.
+  kMemoryVerificationContexts,  ///< Signature verification contexts.
+  kMemorySubsystemCount
+};
+
+/**
+ * The memory charged with each packet for what holds it besides its
+ * own object: a shared_ptr control block, with its vtable pointer,
+ * two counts and the owned pointer, and a list node, with its two
+ * links and the shared_ptr.
+ */
+const std::size_t kPacketHolderOverhead =
+    2 * sizeof(void*) + 2 * sizeof(int)
+    + 2 * sizeof(void*) + sizeof(std::shared_ptr<void>);
+
+/**
+ * The memory held by one class of objects.
+ */
+struct MemoryUsage {
+  /**
+   * The number of bytes currently held.
+   */
+  std::size_t bytes;
+
+  /**
+   * The number of objects currently alive.
+   */
+  std::size_t objects;
+
+  /**
+   * The largest value that bytes has taken since the counters were
+   * last reset.
+   */
+  std::size_t peak_bytes;
+};
+
+/**
+ * The memory held by a subsystem.
+ *
+ * @param subsystem  The subsystem.
+ *
+ * @return The subsystem's usage.
+ */
+MemoryUsage memory_usage(MemorySubsystem subsystem);
+
+/**
+ * The memory held by packets of a single type.
+ *
+ * @param tag  The packet tag.
+ *
+ * @return The usage of packets with that tag.
+ */
+MemoryUsage packet_memory_usage(uint8_t tag);
+
+/**
+ * The memory held by all subsystems together.
+ *
+ * @return The total usage.
+ */
+MemoryUsage total_memory_usage();
+
+/**
+ * Reset every high-water mark to the current number of live bytes.
+ */
+void reset_memory_peaks();
+
+/**
+ * Set the soft memory budget.
+ *
+ * @param bytes  The number of live bytes above which parsing fails,
+ *               or zero for no limit.
+ */
+void set_memory_budget(std::size_t bytes);
+
+/**
+ * The soft memory budget.
+ *
+ * @return The budget in bytes, or zero if there is none.
+ */
+std::size_t memory_budget();
+
+/**
+ * Whether more memory is held than the budget allows.
+ *
+ * @return true if a budget is set and the total exceeds it.
+ */
+bool memory_budget_exceeded();
+
+/**
+ * Whether a further allocation would fit within the budget.
+ *
+ * @param bytes  The size of the allocation.
+ *
+ * @return true unless a budget is set and the total would exceed it
+ *         once the allocation was charged.
+ */
+bool memory_budget_allows(std::size_t bytes);
+
+/**
+ * Set the soft memory budget for the lifetime of this object, and then
+ * restore the budget that it replaced.
+ *
+ * The budget is process-wide, so scopes on different threads should
+ * not overlap.
+ */
+class ScopedMemoryBudget {
+ public:
+  /**
+   * Set the budget.
+   *
+   * @param bytes  As for set_memory_budget().
+   */
+  explicit ScopedMemoryBudget(std::size_t bytes);
+
+  /**
+   * Restore the previous budget.
+   */
+  ~ScopedMemoryBudget();
+
+  ScopedMemoryBudget(const ScopedMemoryBudget&) = delete;
+  ScopedMemoryBudget& operator=(const ScopedMemoryBudget&) = delete;
+
+ private:
+  std::size_t previous_;
+};
+
+/**
+ * A charge against the memory accounts, released on destruction.
+ *
+ * Objects whose memory is accounted hold one of these.  Copying an
+ * object copies its charge, as the copy holds memory of its own.
+ */
+class MemoryCharge {
+ public:
+  /**
+   * Construct an empty charge.
+   */
+  MemoryCharge();
+
+  /**
+   * Copy a charge, charging the same amount again.
+   *
+   * @param rhs  The charge to be copied.
+   */
+  MemoryCharge(const MemoryCharge& rhs);
+
+  /**
+   * Replace this charge with a copy of another.
+   *
+   * @param rhs  The charge to be copied.
+   */
+  MemoryCharge& operator=(const MemoryCharge& rhs);
+
+  /**
+   * Release the charge.
+   */
+  ~MemoryCharge();
+
+  /**
+   * Replace the charge.
+   *
+   * @param subsystem  The subsystem to be charged.
+   * @param tag        The packet tag, used only for kMemoryPackets.
+   * @param bytes      The number of bytes held.
+   */
+  void Reset(MemorySubsystem subsystem, uint8_t tag, std::size_t bytes);
+
+  /**
+   * Release the charge, leaving it empty.
+   */
+  void Release();
+
+ private:
+  MemorySubsystem subsystem_;
+  uint8_t tag_;
+  std::size_t bytes_;
+  bool charged_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_MEMORY_ACCOUNTING_H_
@@ -0,0 +1,103 @@
+#ifndef PARSE4880_INCLUDE_MULTIHASH_H_
+#define PARSE4880_INCLUDE_MULTIHASH_H_
+
+/**
+ * @file multihash.h
+ *
+ * Hashing of many small messages at once.
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "parser_types.h"
+
+namespace parse4880 {
+
+/**
+ * Hash many independent messages together.
+ *
+ * Key fingerprints and certification digests are short, so hashing
+ * them one at a time leaves most of the processor idle.  Where the
+ * processor supports AVX2, messages are instead hashed eight at a
+ * time, one in each 32-bit lane of the vector registers.  Messages
+ * are grouped by length so that the lanes finish together.
+ *
+ * Otherwise, or when there are too few messages to fill the lanes,
+ * each message is hashed with MbedTLS.
+ *
+ * Messages are built from segments that are not copied, so the data
+ * must outlive the call to Finish().
+ */
+class MultiHasher {
+ public:
+  /**
+   * The hash functions that can be computed.
+   */
+  enum Algorithm {
+    kSHA1,
+    kSHA256
+  };
+
+  /**
+   * Constructor.
+   *
+   * @param algorithm  The hash function to apply to every message.
+   */
+  explicit MultiHasher(Algorithm algorithm);
+
+  /**
+   * Start a new message.
+   *
+   * @return The index of the message in the results of Finish().
+   */
+  std::size_t Begin();
+
+  /**
+   * Append data to the message most recently started.
+   *
+   * @param data    The data to be appended, which must remain valid
+   *                until Finish() is called.
+   * @param length  The length of the data.
+   */
+  void Update(const uint8_t* data, std::size_t length);
+
+  /**
+   * Hash every message started since the last call.
+   *
+   * @return The digest of each message, in the order in which they
+   *         were started.
+   */
+  std::vector<ustring> Finish();
+
+  /**
+   * The number of messages waiting to be hashed.
+   */
+  std::size_t size() const;
+
+  /**
+   * The name of the implementation in use, "avx2" or "scalar".
+   */
+  static const char* implementation();
+
+ private:
+  struct Segment {
+    const uint8_t* data;
+    std::size_t    length;
+  };
+
+  struct Message {
+    std::size_t first_segment;
+    std::size_t segment_count;
+    uint64_t    length;
+  };
+
+  Algorithm            algorithm_;
+  std::vector<Segment> segments_;
+  std::vector<Message> messages_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_MULTIHASH_H_
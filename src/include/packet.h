@@ -13,6 +13,7 @@
 #include <list>
 
 #include "packets/pgppacket.h"
+#include "packets/registry.h"
 #include "packets/unknownpacket.h"
 #include "packets/signature.h"
 #include "packets/keymaterial.h"
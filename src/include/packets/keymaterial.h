@@ -7,6 +7,10 @@
  * Key-related packet classes.
  */
 
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 #include "parser_types.h"
 #include "packet.h"
 
@@ -75,6 +79,43 @@ class PublicKeyPacket : public KeyMaterialPacket {
    */
   PublicKeyPacket(const ustring& contents);
 
+  /**
+   * Parse raw public key packet data without throwing on malformed data.
+   *
+   * @param contents  Packet data to be parsed.
+   * @param error     Set to the status of the parse.  The packet
+   *                  should be discarded unless this is successful.
+   */
+  PublicKeyPacket(const ustring& contents, ParseError* error);
+
+  /**
+   * Parse raw public key packet data whose fingerprint is known.
+   *
+   * This allows the fingerprints of many keys to be computed together,
+   * as by FingerprintKeys().
+   *
+   * @param contents     Packet data to be parsed.
+   * @param fingerprint  The fingerprint of the key.
+   * @param error        Set to the status of the parse.
+   */
+  PublicKeyPacket(const ustring& contents, const ustring& fingerprint,
+                  ParseError* error);
+
+  /**
+   * Compute the fingerprints of many keys at once.
+   *
+   * @param data      The data holding the packet contents.
+   * @param contents  The offset and length within data of the
+   *                  contents of each packet.
+   *
+   * @return The fingerprint of each key.
+   *
+   * @see MultiHasher
+   */
+  static std::vector<ustring> FingerprintKeys(
+      const uint8_t* data,
+      const std::vector<std::pair<std::size_t, std::size_t>>& contents);
+
   virtual uint8_t tag() const override;
   virtual std::string str() const override;
 
@@ -88,13 +129,16 @@ class PublicKeyPacket : public KeyMaterialPacket {
   /**
    * The raw key material of the packet.
    *
-   * @return A string containing the packet's raw key material.
+   * @return A view of the packet's raw key material.
    */
-  const ustring& key_material() const;
+  ByteView key_material() const;
 
  private:
-  ustring key_material_;
-  ustring fingerprint_;
+  ParseError Parse();
+
+ private:
+  std::size_t key_material_offset_;
+  ustring     fingerprint_;
 };
 
 /**
@@ -110,6 +154,25 @@ class PublicSubkeyPacket : public PublicKeyPacket {
    */
   PublicSubkeyPacket(ustring contents);
 
+  /**
+   * Parse the public-key part of a subkey without throwing on malformed
+   * data.
+   *
+   * @param contents  Packet data to be parsed.
+   * @param error     Set to the status of the parse.
+   */
+  PublicSubkeyPacket(const ustring& contents, ParseError* error);
+
+  /**
+   * Parse the public-key part of a subkey whose fingerprint is known.
+   *
+   * @param contents     Packet data to be parsed.
+   * @param fingerprint  The fingerprint of the subkey.
+   * @param error        Set to the status of the parse.
+   */
+  PublicSubkeyPacket(const ustring& contents, const ustring& fingerprint,
+                     ParseError* error);
+
   virtual uint8_t tag() const override;
   virtual std::string str() const override;
 };
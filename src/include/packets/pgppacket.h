@@ -7,7 +7,10 @@
  * Generic PGP packet type.
  */
 
+#include "memory_accounting.h"
 #include "parser_types.h"
+#include "parse_limits.h"
+#include "parse_status.h"
 
 namespace parse4880 {
 
@@ -62,8 +65,20 @@ class PGPPacket {
    */
   std::list<std::shared_ptr<PGPPacket>> subpackets_;
 
+  /**
+   * Charge the packet's memory to the accounts, replacing any earlier
+   * charge.  Each concrete packet type calls this on construction.
+   *
+   * @param subsystem    The subsystem to be charged.
+   * @param tag          The packet tag.
+   * @param object_size  The size of the most-derived object.
+   */
+  void ChargeMemory(MemorySubsystem subsystem, uint8_t tag,
+                    std::size_t object_size);
+
  private:
   ustring contents_;
+  MemoryCharge memory_charge_;
 
  public:
   /**
@@ -71,9 +86,29 @@ class PGPPacket {
    *
    * @param tag     The packet tag.
    * @param packet  The raw packet data to be parsed.
+   * @param limits  The limits on the parse.
+   */
+  static std::shared_ptr<PGPPacket> ParsePacket(
+      uint8_t tag, ustring packet, const ParseLimits& limits = ParseLimits());
+
+  /**
+   * Parse a single packet without throwing on malformed data.
+   *
+   * Where ParsePacket falls back to an UnknownPGPPacket, this reports
+   * why the packet could not be parsed.  The packet is decoded by the
+   * factory registered for its tag.
+   *
+   * @see register_packet_type
+   *
+   * @param tag     The packet tag.
+   * @param packet  The raw packet data to be parsed.
+   * @param limits  The limits on the parse.
+   *
+   * @return The parsed packet, or nullptr and the reason for failure.
    */
-  static std::shared_ptr<PGPPacket> ParsePacket(uint8_t tag,
-                                                ustring packet);
+  static ParseResult<std::shared_ptr<PGPPacket>> TryParsePacket(
+      uint8_t tag, const ustring& packet,
+      const ParseLimits& limits = ParseLimits());
 };
 
 }
@@ -0,0 +1,112 @@
+#ifndef PARSE4880_INCLUDE_PACKETS_REGISTRY_H_
+#define PARSE4880_INCLUDE_PACKETS_REGISTRY_H_
+
+/**
+ * @file registry.h
+ *
+ * Registry of packet decoders, indexed by tag.
+ *
+ * PGPPacket::TryParsePacket looks the packet's tag up in a table of
+ * factory functions and makes a single indirect call.  The table is
+ * constant-initialised with the library's own packet types, so it is
+ * complete before any static constructor runs, and applications may
+ * replace or add entries to decode further packet types themselves.
+ */
+
+#include <cstdint>
+#include <memory>
+
+#include "parser_types.h"
+#include "parse_limits.h"
+#include "parse_status.h"
+
+namespace parse4880 {
+
+class PGPPacket;
+
+/**
+ * A function that decodes a packet of a particular type.
+ *
+ * A factory must not throw on malformed data.  Instead it sets
+ * *error, in which case its return value is discarded.
+ *
+ * @param tag       The packet tag.
+ * @param contents  The packet contents, without the header.
+ * @param limits    The limits on the parse, for packets with nested
+ *                  structure of their own.
+ * @param error     Set to the reason for failure, if any.
+ *
+ * @return The decoded packet.
+ */
+typedef std::shared_ptr<PGPPacket> (*PacketFactory)(uint8_t tag,
+                                                    const ustring& contents,
+                                                    const ParseLimits& limits,
+                                                    ParseError* error);
+
+/**
+ * A factory for any packet class with a non-throwing constructor
+ * taking the contents and a ParseError*.
+ *
+ * @tparam T  The packet class.
+ */
+template <typename T>
+std::shared_ptr<PGPPacket> make_packet(uint8_t tag, const ustring& contents,
+                                       const ParseLimits& limits,
+                                       ParseError* error) {
+  (void)tag;
+  (void)limits;
+  return std::shared_ptr<PGPPacket>(new T(contents, error));
+}
+
+/**
+ * A factory for any packet class with a non-throwing constructor
+ * taking the contents, the limits on the parse and a ParseError*.
+ *
+ * @tparam T  The packet class.
+ */
+template <typename T>
+std::shared_ptr<PGPPacket> make_limited_packet(uint8_t tag,
+                                               const ustring& contents,
+                                               const ParseLimits& limits,
+                                               ParseError* error) {
+  (void)tag;
+  return std::shared_ptr<PGPPacket>(new T(contents, limits, error));
+}
+
+/**
+ * Set the factory used for a packet tag.
+ *
+ * Registration should be done before parsing begins: a parse that is
+ * already running may use either factory.
+ *
+ * @param tag      The packet tag, of which only the low six bits are used.
+ * @param factory  The new factory, or nullptr to restore the built-in one.
+ *
+ * @return The factory previously registered.
+ */
+PacketFactory register_packet_type(uint8_t tag, PacketFactory factory);
+
+/**
+ * The factory currently used for a packet tag.
+ *
+ * @param tag  The packet tag, of which only the low six bits are used.
+ *
+ * @return The registered factory.
+ */
+PacketFactory packet_factory(uint8_t tag);
+
+/**
+ * The library's own factory for a packet tag.
+ *
+ * Tags that the library does not decode map to a factory producing
+ * UnknownPGPPackets.
+ *
+ * @param tag  The packet tag, of which only the low six bits are used.
+ *
+ * @return The built-in factory.
+ */
+PacketFactory builtin_packet_factory(uint8_t tag);
+
+}
+
+#endif  // PARSE4880_INCLUDE_PACKETS_REGISTRY_H_
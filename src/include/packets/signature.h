@@ -12,6 +12,7 @@
 
 #include "parser_types.h"
 #include "packet.h"
+#include "fields.h"
 
 namespace parse4880 {
 
@@ -27,6 +28,27 @@ class SignaturePacket : public PGPPacket {
    */
   explicit SignaturePacket(ustring packet_data);
 
+  /**
+   * Parse a signature packet without throwing on malformed data.
+   *
+   * @param packet_data  Packet data to parse.
+   * @param error        Set to the status of the parse.  The packet
+   *                     should be discarded unless this is successful.
+   */
+  SignaturePacket(const ustring& packet_data, ParseError* error);
+
+  /**
+   * Parse a signature packet within limits, without throwing on
+   * malformed data.
+   *
+   * @param packet_data  Packet data to parse.
+   * @param limits       The limits on the parse.
+   * @param error        Set to the status of the parse.  The packet
+   *                     should be discarded unless this is successful.
+   */
+  SignaturePacket(const ustring& packet_data, const ParseLimits& limits,
+                  ParseError* error);
+
   virtual uint8_t tag() const;
   virtual std::string str() const;
 
@@ -40,9 +62,10 @@ class SignaturePacket : public PGPPacket {
   /**
    * The long (64-bit) key-id of the signing key.
    *
-   * @return A string containing the long key-id in binary form.
+   * @return The long key-id in binary form, or an empty view if the
+   *         signature does not name its issuer.
    */
-  const ustring& key_id() const;
+  ByteView key_id() const;
 
   /**
    * The type of the signature.
@@ -54,6 +77,34 @@ class SignaturePacket : public PGPPacket {
    */
   uint8_t signature_type() const;
 
+  /**
+   * The time at which the signature was made.
+   *
+   * For v4 signatures this comes from the hashed subpackets, and so
+   * is missing if the signer did not include it.
+   *
+   * @return The creation time in seconds since the epoch, or -1 if
+   *         the signature has none.
+   */
+  int64_t creation_time() const;
+
+  /**
+   * How long the signature remains valid after its creation.
+   *
+   * @return The validity period in seconds, or zero if the signature
+   *         does not expire.
+   */
+  int64_t signature_expiration_time() const;
+
+  /**
+   * How long the key remains valid after the key's creation, as
+   * stated by a self-signature.
+   *
+   * @return The validity period in seconds, or zero if the key does
+   *         not expire.
+   */
+  int64_t key_expiration_time() const;
+
   /**
    * The public key algorithm used by the signature.
    *
@@ -71,16 +122,24 @@ class SignaturePacket : public PGPPacket {
   /**
    * The raw subpacket data that is to be hashed.
    *
-   * @return A string containing the raw subpackets.
+   * @return A view of the raw subpackets.
    */
-  const ustring& hashed_subpacket_data() const;
+  ByteView hashed_subpacket_data() const;
 
   /**
    * The raw subpacket data that is not to be hashed.
    *
-   * @return A string containing the raw subpackets.
+   * @return A view of the raw subpackets.
+   */
+  ByteView unhashed_subpacket_data() const;
+
+  /**
+   * The number of subpackets from the hashed area.  These come first
+   * in subpackets(), followed by those from the unhashed area.
+   *
+   * @return The number of hashed subpackets.
    */
-  const ustring& unhashed_subpacket_data() const;
+  std::size_t hashed_subpacket_count() const;
 
   /**
    * The left sixteen bits of the hash, for quick verification.
@@ -89,12 +148,25 @@ class SignaturePacket : public PGPPacket {
    */
   const uint8_t* hash_left_16bits() const;
 
+  /**
+   * Compare a digest with the quick-check field.
+   *
+   * A digest whose first two octets differ from the quick-check field
+   * cannot verify, so this allows a bad signature to be rejected
+   * without any public-key operation.
+   *
+   * @param digest  The digest of the signed data, at least two octets.
+   *
+   * @return false if the digest cannot match the signature.
+   */
+  bool MatchesHashPrefix(const uint8_t* digest) const;
+
   /**
    * The raw signature.
    *
-   * @return A string containing the raw signature data.
+   * @return A view of the raw signature data.
    */
-  const ustring& signature() const;
+  ByteView signature() const;
 
   /**
    * The entirety of the hashed data from the signature packet.
@@ -103,28 +175,36 @@ class SignaturePacket : public PGPPacket {
    * first is the data of interest, whereas the second is the beginning
    * of the signature packet.
    *
-   * We therefore need to provide a copy of the entirety of the
-   * signature data to be hashed before we can verify the signature.
+   * We therefore need to provide the entirety of the signature data
+   * to be hashed before we can verify the signature.
    *
-   * @return A string to be appended to the data being verified before
-   *         it is hashed.
+   * @return A view of the data to be appended to the data being
+   *         verified before it is hashed.
    */
-  const ustring& hashed_data() const;
+  ByteView hashed_data() const;
 
  private:
-  void SetSignaturePropertiesFromSubpackets();
+  ParseError Parse(const ParseLimits& limits);
+  ParseError SetSignaturePropertiesFromSubpackets();
 
  private:
-  uint8_t version_;
-  ustring key_id_;
-  uint8_t signature_type_;
-  uint8_t public_key_algorithm_;
-  uint8_t hash_algorithm_;
-  ustring hashed_subpacket_data_;
-  ustring unhashed_subpacket_data_;
-  uint8_t hash_left_16bits_[2];
-  ustring signature_;
-  ustring hashed_data_;
+  // Variable-length fields are held as their locations in contents(),
+  // so that the packet holds only one copy of its data.
+  uint8_t        version_;
+  uint8_t        key_id_[8];
+  bool           has_key_id_;
+  uint8_t        signature_type_;
+  int64_t        creation_time_;
+  int64_t        signature_expiration_time_;
+  int64_t        key_expiration_time_;
+  uint8_t        public_key_algorithm_;
+  uint8_t        hash_algorithm_;
+  fields::Region hashed_subpacket_data_;
+  fields::Region unhashed_subpacket_data_;
+  std::size_t    hashed_subpacket_count_;
+  uint8_t        hash_left_16bits_[2];
+  fields::Region signature_;
+  fields::Region hashed_data_;
 };
 
 }
@@ -19,10 +19,12 @@ class UnknownPGPPacket : public PGPPacket {
   /**
    * Construct the placeholder.
    *
-   * @param tag       The packet type code.
-   * @param contents  The contents of the packet.
+   * @param tag        The packet type code.
+   * @param contents   The contents of the packet.
+   * @param subsystem  The subsystem to which its memory is charged.
    */
-  UnknownPGPPacket(uint8_t tag, ustring contents);
+  UnknownPGPPacket(uint8_t tag, ustring contents,
+                   MemorySubsystem subsystem = kMemoryPackets);
   
   virtual uint8_t tag() const;
   virtual std::string str() const;
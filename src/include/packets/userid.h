@@ -22,6 +22,15 @@ class UserIDPacket : public PGPPacket {
    * @param contents  The packet data to parse.
    */
   UserIDPacket(ustring contents);
+
+  /**
+   * Parse a user-id packet with the non-throwing constructor signature
+   * used by make_packet.  Any contents are a valid user ID.
+   *
+   * @param contents  The packet data to parse.
+   * @param error     Set to success.
+   */
+  UserIDPacket(const ustring& contents, ParseError* error);
   
   virtual uint8_t tag() const;
   virtual std::string str() const;
@@ -32,9 +41,6 @@ class UserIDPacket : public PGPPacket {
    * @return A string containing the user-id.
    */
   std::string user_id() const;
-
- private:
-  ustring user_id_;
 };
 
 }
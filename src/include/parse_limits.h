@@ -0,0 +1,78 @@
+#ifndef PARSE4880_INCLUDE_PARSE_LIMITS_H_
+#define PARSE4880_INCLUDE_PARSE_LIMITS_H_
+
+/**
+ * @file parse_limits.h
+ *
+ * Limits on the resources that a single parse may use.
+ */
+
+#include <cstddef>
+#include <limits>
+
+namespace parse4880 {
+
+/**
+ * Limits on the work done parsing a single buffer.
+ *
+ * Each limit is checked from the packet and subpacket headers before
+ * anything is copied, so hostile input is rejected with
+ * kParseLimitExceeded as soon as it goes over a limit.  Together they
+ * bound both the time taken, which is linear in the input, and the
+ * memory allocated.
+ *
+ * The default-constructed limits are unlimited.  Untrusted() gives
+ * limits suited to keys uploaded by the public.
+ */
+struct ParseLimits {
+  /**
+   * Construct limits that allow anything.
+   */
+  ParseLimits()
+      : max_packets(std::numeric_limits<std::size_t>::max()),
+        max_packet_length(std::numeric_limits<std::size_t>::max()),
+        max_total_length(std::numeric_limits<std::size_t>::max()),
+        max_subpackets(std::numeric_limits<std::size_t>::max()) {}
+
+  /**
+   * Limits for untrusted data.
+   *
+   * These comfortably admit real keys with many signatures, but not
+   * keys that have been flooded with them.
+   *
+   * @return The limits.
+   */
+  static ParseLimits Untrusted() {
+    ParseLimits limits;
+    limits.max_packets = 100000;
+    limits.max_packet_length = 1 << 20;
+    limits.max_total_length = 64 << 20;
+    limits.max_subpackets = 256;
+    return limits;
+  }
+
+  /**
+   * The number of packets that may be parsed.
+   */
+  std::size_t max_packets;
+
+  /**
+   * The largest packet body that may be parsed, in octets.
+   */
+  std::size_t max_packet_length;
+
+  /**
+   * The total length of the packet bodies that may be parsed.
+   */
+  std::size_t max_total_length;
+
+  /**
+   * The number of subpackets that a signature may have, in its hashed
+   * and unhashed areas together.
+   */
+  std::size_t max_subpackets;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_PARSE_LIMITS_H_
@@ -0,0 +1,135 @@
+#ifndef PARSE4880_INCLUDE_PARSE_STATUS_H_
+#define PARSE4880_INCLUDE_PARSE_STATUS_H_
+
+/**
+ * @file parse_status.h
+ *
+ * Status codes for the non-throwing parser interface.
+ */
+
+#include <cstddef>
+
+namespace parse4880 {
+
+/**
+ * The outcome of a parsing operation.
+ *
+ * Each failure corresponds to one of the exception types thrown
+ * by the throwing interface.
+ *
+ * @see ThrowParseError
+ */
+enum ParseStatus {
+  kParseOk = 0,
+  kParseInvalidHeader,         ///< As invalid_header_error.
+  kParseHeaderTooShort,        ///< As packet_header_length_error.
+  kParsePacketTooShort,        ///< As packet_length_error.
+  kParseOldPacket,             ///< As old_packet_error.
+  kParseUnsupportedFeature,    ///< As unsupported_feature_error.
+  kParseInvalidPacket,         ///< As invalid_packet_error.
+  kParseWrongAlgorithm,        ///< As wrong_algorithm_error.
+  kParseMemoryBudgetExceeded,  ///< As memory_budget_error.
+  kParseLimitExceeded          ///< As limit_error.
+};
+
+/**
+ * A description of a parsing failure, or of its absence.
+ *
+ * This carries everything that would otherwise be put into an
+ * exception, so that a failure can be reported cheaply and only
+ * converted into an exception if the caller wants one.
+ */
+struct ParseError {
+  /**
+   * Construct a successful status.
+   */
+  ParseError()
+      : status(kParseOk), position(0), detail(""),
+        claimed_length(0), actual_length(0) {}
+
+  /**
+   * Construct a failure status.
+   *
+   * @param status    The kind of failure.
+   * @param position  The position in the data at which it occurred.
+   * @param detail    A static, human-readable description.
+   */
+  ParseError(ParseStatus status, std::size_t position, const char* detail = "")
+      : status(status), position(position), detail(detail),
+        claimed_length(0), actual_length(0) {}
+
+  /**
+   * Construct a failure in which a packet is shorter than its length
+   * fields demand.
+   *
+   * @param position        The position at which the error occurred.
+   * @param claimed_length  The length that the packet should be.
+   * @param actual_length   How long the packet actually is.
+   */
+  ParseError(std::size_t position, std::size_t claimed_length,
+             std::size_t actual_length)
+      : status(kParsePacketTooShort), position(position), detail(""),
+        claimed_length(claimed_length), actual_length(actual_length) {}
+
+  /**
+   * Whether the operation succeeded.
+   *
+   * @return true if there was no error.
+   */
+  bool ok() const { return kParseOk == status; }
+
+  /**
+   * The kind of failure.
+   */
+  ParseStatus status;
+
+  /**
+   * The offset at which the failure was found.
+   */
+  std::size_t position;
+
+  /**
+   * A static description of the failure, never nullptr.
+   */
+  const char* detail;
+
+  /**
+   * For kParsePacketTooShort, the length demanded by the packet.
+   */
+  std::size_t claimed_length;
+
+  /**
+   * For kParsePacketTooShort, the length actually available.
+   */
+  std::size_t actual_length;
+};
+
+/**
+ * A value together with the status of the operation that produced it.
+ *
+ * When error.ok() is false the value may be empty or, where
+ * documented, may hold whatever was produced before the failure.
+ */
+template <typename T>
+struct ParseResult {
+  /**
+   * The status of the operation.
+   */
+  ParseError error;
+
+  /**
+   * The result of the operation.
+   */
+  T value;
+
+  /**
+   * Whether the operation succeeded.
+   *
+   * @return true if there was no error.
+   */
+  bool ok() const { return error.ok(); }
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_PARSE_STATUS_H_
@@ -7,12 +7,17 @@
  * Parser for PGP binary format.
  */
 
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
 #include <list>
 #include <memory>
 #include <string>
 
 #include "packet.h"
 #include "parser_types.h"
+#include "parse_limits.h"
+#include "parse_status.h"
 
 /**
  * Namespace for all library functionality.
@@ -27,7 +32,8 @@ namespace parse4880 {
  * classes generated, other packets will result in the emission of
  * an UnknownPGPPacket.
  *
- * @param data  The binary data to be parsed.
+ * @param data    The binary data to be parsed.
+ * @param limits  The limits on the parse.
  *
  * @return A list of shared_ptr<PGPPacket>s to each of the packets
  *         in the provided data.
@@ -36,7 +42,8 @@ namespace parse4880 {
  * @see parse4880::PGPPacket
  * @see parse4880::parse_subpackets()
  */
-std::list<std::shared_ptr<PGPPacket>> parse(ustring data);
+std::list<std::shared_ptr<PGPPacket>> parse(
+    ustring data, const ParseLimits& limits = ParseLimits());
 
 /**
  * Parse a series of PGP packets, calling a function for each packet
@@ -44,11 +51,61 @@ std::list<std::shared_ptr<PGPPacket>> parse(ustring data);
  *
  * @param data      The binary data to be parsed.
  * @param callback  A callback to be called after each packet.
+ * @param limits    The limits on the parse.
  *
  * @see parse4880::parse(ustring data)
  */
 void parse(ustring data,
-           std::function<bool(std::shared_ptr<PGPPacket>)> callback);
+           std::function<bool(std::shared_ptr<PGPPacket>)> callback,
+           const ParseLimits& limits = ParseLimits());
+
+/**
+ * The location of a packet, as found from its header alone.
+ */
+struct PacketRecord {
+  /**
+   * The packet tag.
+   */
+  uint8_t     tag;
+
+  /**
+   * The offset of the packet header from the start of the data.
+   */
+  std::size_t offset;
+
+  /**
+   * The length of the header, including the length field.
+   */
+  std::size_t header_length;
+
+  /**
+   * The length of the packet body, which follows the header.
+   */
+  std::size_t length;
+};
+
+/**
+ * Find the packets in some data without parsing them.
+ *
+ * Only the packet headers are decoded, so this is much cheaper than
+ * parse(), and the data need not be held in a ustring.
+ *
+ * Packets are counted against the limits whether or not the callback
+ * goes on to parse them.
+ *
+ * @param data      The binary data to be scanned.
+ * @param length    The length of the data.
+ * @param callback  Called with the location of each packet in turn.
+ *                  The scan stops if it returns false.
+ * @param limits    The limits on the packets found.
+ *
+ * @return The status of the scan.
+ *
+ * @see parse4880::parse()
+ */
+ParseError scan(const uint8_t* data, std::size_t length,
+                std::function<bool(const PacketRecord&)> callback,
+                const ParseLimits& limits = ParseLimits());
 
 /**
  * Parse a series of signature subpackets.
@@ -69,14 +126,153 @@ void parse(ustring data,
  *
  * We thus require a different parser.
  *
- * @param data  The binary data to be parsed.
+ * @param data    The binary data to be parsed.
+ * @param limits  The limits on the parse, of which only max_subpackets
+ *                applies.
  *
  * @return A list of shared_ptr<PGPPacket>s to each of the subpackets in
  *         the provided data.
  *
  * @see parse4880::parse()
  */
-std::list<std::shared_ptr<PGPPacket>> parse_subpackets(ustring data);
+std::list<std::shared_ptr<PGPPacket>> parse_subpackets(
+    ustring data, const ParseLimits& limits = ParseLimits());
+
+/**
+ * Parse a series of PGP packets without throwing on malformed input.
+ *
+ * This behaves as parse(ustring data), except that a malformation is
+ * reported through the returned status rather than by an exception.
+ * The packets that were parsed before any error are still returned,
+ * unless the error is that the memory budget has been exceeded.
+ *
+ * @param data    The binary data to be parsed.
+ * @param limits  The limits on the parse.
+ *
+ * @return The packets found, and the status of the parse.
+ *
+ * @see parse4880::parse(ustring data)
+ */
+ParseResult<std::list<std::shared_ptr<PGPPacket>>> try_parse(
+    const ustring& data, const ParseLimits& limits = ParseLimits());
+
+/**
+ * Parse a series of PGP packets, calling a function for each packet
+ * found, without throwing on malformed input.
+ *
+ * @param data      The binary data to be parsed.
+ * @param callback  A callback to be called after each packet.
+ * @param limits    The limits on the parse.
+ *
+ * @return The status of the parse.
+ *
+ * @see parse4880::parse(ustring data, std::function callback)
+ */
+ParseError try_parse(const ustring& data,
+                     std::function<bool(std::shared_ptr<PGPPacket>)> callback,
+                     const ParseLimits& limits = ParseLimits());
+
+/**
+ * A set of packet tags.
+ *
+ * Packet tags are at most six bits long, so a set of them fits in a
+ * single machine word.
+ */
+class TagMask {
+ public:
+  /**
+   * Create an empty set of tags.
+   */
+  TagMask() {}
+
+  /**
+   * Create a set of tags.
+   *
+   * @param tags  The tags in the set.
+   */
+  TagMask(std::initializer_list<uint8_t> tags);
+
+  /**
+   * Create the set of all tags.
+   */
+  static TagMask All();
+
+  /**
+   * Add a tag to the set.
+   *
+   * @param tag  The tag to add.
+   *
+   * @return This set.
+   */
+  TagMask& Set(uint8_t tag);
+
+  /**
+   * Check whether a tag is in the set.
+   *
+   * @param tag  The tag to check.
+   *
+   * @return True if the tag is in the set.
+   */
+  bool Test(uint8_t tag) const {
+    return (bits_ >> (tag & 0x3F)) & 1;
+  }
+
+ private:
+  uint64_t bits_ = 0;
+};
+
+/**
+ * Parse only those packets with certain tags, without throwing on
+ * malformed input.
+ *
+ * The headers of the other packets are decoded so that they can be
+ * skipped, but their contents are neither copied nor parsed.
+ *
+ * @param data      The binary data to be parsed.
+ * @param length    The length of the data.
+ * @param mask      The tags of the packets to parse.
+ * @param callback  A callback to be called after each selected packet.
+ * @param limits    The limits on the parse.
+ *
+ * @return The status of the parse.
+ *
+ * @see parse4880::scan()
+ */
+ParseError try_parse(const uint8_t* data, std::size_t length,
+                     const TagMask& mask,
+                     std::function<bool(std::shared_ptr<PGPPacket>)> callback,
+                     const ParseLimits& limits = ParseLimits());
+
+/**
+ * Parse only those packets with certain tags.
+ *
+ * @param data      The binary data to be parsed.
+ * @param mask      The tags of the packets to parse.
+ * @param callback  A callback to be called after each selected packet.
+ * @param limits    The limits on the parse.
+ *
+ * @see parse4880::try_parse(const uint8_t*, std::size_t, const TagMask&,
+ *                           std::function)
+ */
+void parse(const ustring& data, const TagMask& mask,
+           std::function<bool(std::shared_ptr<PGPPacket>)> callback,
+           const ParseLimits& limits = ParseLimits());
+
+/**
+ * Parse a series of signature subpackets without throwing on malformed
+ * input.
+ *
+ * @param data    The binary data to be parsed.
+ * @param limits  The limits on the parse, of which only max_subpackets
+ *                applies.
+ *
+ * @return The subpackets found before any error, and the status of
+ *         the parse.
+ *
+ * @see parse4880::parse_subpackets()
+ */
+ParseResult<std::list<std::shared_ptr<PGPPacket>>> try_parse_subpackets(
+    const ustring& data, const ParseLimits& limits = ParseLimits());
 
 /**
  * Read a PGP normal integer.
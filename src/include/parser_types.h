@@ -1,12 +1,95 @@
 #ifndef PARSE4880_INCLUDE_PARSER_TYPES_H_
 #define PARSE4880_INCLUDE_PARSER_TYPES_H_
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 
 namespace parse4880 {
 
 typedef std::basic_string<uint8_t> ustring;
-  
+
+/**
+ * A read-only view of octets held elsewhere.
+ *
+ * Packets return views of the fields within their contents rather
+ * than copies of them.  A view is only valid for as long as the
+ * packet from which it came, so use str() to keep a field longer.
+ */
+class ByteView {
+ public:
+  ByteView() : data_(nullptr), length_(0) {}
+  ByteView(const uint8_t* data, std::size_t length)
+      : data_(data), length_(length) {}
+
+  /**
+   * View a whole string.
+   *
+   * @param data  The string, which must outlive the view.
+   */
+  ByteView(const ustring& data) : data_(data.data()), length_(data.length()) {}
+
+  const uint8_t* data() const { return data_; }
+  std::size_t length() const { return length_; }
+  std::size_t size() const { return length_; }
+  bool empty() const { return 0 == length_; }
+  const uint8_t* begin() const { return data_; }
+  const uint8_t* end() const { return data_ + length_; }
+  uint8_t operator[](std::size_t i) const { return data_[i]; }
+
+  /**
+   * View part of the octets.
+   *
+   * @param position  The offset of the first octet, which is reduced
+   *                  to length() if it is beyond the end.
+   * @param length    The number of octets, which is reduced to fit.
+   */
+  ByteView substr(std::size_t position,
+                  std::size_t length = ustring::npos) const {
+    if (position > length_) {
+      position = length_;
+    }
+    if (length > length_ - position) {
+      length = length_ - position;
+    }
+    return ByteView(data_ + position, length);
+  }
+
+  /**
+   * Copy the octets.
+   */
+  ustring str() const { return ustring(data_, length_); }
+
+ private:
+  const uint8_t* data_;
+  std::size_t    length_;
+};
+
+inline bool operator==(const ByteView& lhs, const ByteView& rhs) {
+  return lhs.length() == rhs.length()
+      && (lhs.empty() || 0 == memcmp(lhs.data(), rhs.data(), lhs.length()));
+}
+
+inline bool operator!=(const ByteView& lhs, const ByteView& rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator==(const ByteView& lhs, const ustring& rhs) {
+  return lhs == ByteView(rhs);
+}
+
+inline bool operator==(const ustring& lhs, const ByteView& rhs) {
+  return ByteView(lhs) == rhs;
+}
+
+inline bool operator!=(const ByteView& lhs, const ustring& rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator!=(const ustring& lhs, const ByteView& rhs) {
+  return !(lhs == rhs);
+}
+
 }
 
 #endif // PARSE4880_INCLUDE_PARSER_TYPES_H_
@@ -0,0 +1,100 @@
+#ifndef PARSE4880_INCLUDE_PREFILTER_H_
+#define PARSE4880_INCLUDE_PREFILTER_H_
+
+/**
+ * @file prefilter.h
+ *
+ * Cheap checks to reject signatures before verifying them.
+ */
+
+#include <bitset>
+#include <cstdint>
+
+#include "packet.h"
+
+namespace parse4880 {
+
+/**
+ * The outcome of prefiltering a signature.
+ */
+enum PrefilterResult {
+  kPrefilterPass = 0,       ///< The signature may be valid.
+  kPrefilterKeyID,          ///< The issuer is a different key.
+  kPrefilterAlgorithm,      ///< The key cannot have made the signature.
+  kPrefilterSignatureType,  ///< The signature is of an unexpected type.
+  kPrefilterCreationTime    ///< The signature's creation time is implausible.
+};
+
+/**
+ * Reject signatures that cannot verify, without hashing anything.
+ *
+ * These checks look only at fields of the key and signature packets,
+ * so a signature that is plainly mismatched with its key costs nothing
+ * more than parsing.  A signature is rejected if
+ *
+ *   - it names an issuer key ID that is not the key's,
+ *   - its public-key algorithm differs from the key's, or the key
+ *     cannot make signatures at all,
+ *   - its type is not one of those expected, or
+ *   - it has no creation time, it predates the key, or it postdates
+ *     the latest time allowed.
+ */
+class SignaturePrefilter {
+ public:
+  /**
+   * Create a prefilter accepting any signature type, at any time.
+   */
+  SignaturePrefilter();
+
+  /**
+   * Accept a signature type.
+   *
+   * Once any type has been accepted, signatures of other types are
+   * rejected.
+   *
+   * @param signature_type  The type to accept.
+   *
+   * @return This prefilter.
+   */
+  SignaturePrefilter& AcceptType(uint8_t signature_type);
+
+  /**
+   * Reject signatures made after some time.
+   *
+   * @param time  The latest acceptable creation time, in seconds
+   *              since the epoch.
+   *
+   * @return This prefilter.
+   */
+  SignaturePrefilter& NotAfter(int64_t time);
+
+  /**
+   * Check a signature against the key that supposedly made it.
+   *
+   * @param key        The signing key.
+   * @param signature  The signature.
+   *
+   * @return kPrefilterPass if the signature is worth verifying, or
+   *         the reason for rejecting it.
+   */
+  PrefilterResult Check(const PublicKeyPacket& key,
+                        const SignaturePacket& signature) const;
+
+  /**
+   * A prefilter for user ID certifications and their revocations.
+   */
+  static const SignaturePrefilter& UserIDBinding();
+
+  /**
+   * A prefilter for subkey bindings and their revocations.
+   */
+  static const SignaturePrefilter& SubkeyBinding();
+
+ private:
+  std::bitset<256> types_;
+  int64_t          not_after_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_PREFILTER_H_
@@ -0,0 +1,135 @@
+#ifndef PARSE4880_INCLUDE_TRACE_H_
+#define PARSE4880_INCLUDE_TRACE_H_
+
+/**
+ * @file trace.h
+ *
+ * Tracing of the time spent parsing and verifying.
+ *
+ * Two mechanisms are provided.  TraceSpans record the start and
+ * duration of each stage in memory while tracing is switched on, for
+ * export with write_chrome_trace() and viewing in chrome://tracing or
+ * Perfetto.  While tracing is off, a span costs a single relaxed load.
+ *
+ * USDT probes, in the parse4880 provider, are compiled in where
+ * <sys/sdt.h> is available, and are a single nop unless a tracer such
+ * as bpftrace is attached:
+ *
+ *   - parse(length)
+ *   - packet(tag, length)
+ *   - key(algorithm)
+ *   - verify(public_key_algorithm, hash_algorithm)
+ *   - uid_binding(result)
+ *   - subkey_binding(result)
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifdef PARSE4880_HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define PARSE4880_PROBE1(name, a) DTRACE_PROBE1(parse4880, name, a)
+#define PARSE4880_PROBE2(name, a, b) DTRACE_PROBE2(parse4880, name, a, b)
+#else
+#define PARSE4880_PROBE1(name, a) do {} while (0)
+#define PARSE4880_PROBE2(name, a, b) do {} while (0)
+#endif
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+namespace trace_internal {
+extern std::atomic<bool> enabled;
+}
+/// @endcond
+
+/**
+ * Whether spans are being recorded.
+ */
+inline bool tracing_enabled() {
+  return trace_internal::enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Start recording spans, discarding any recorded earlier.
+ */
+void start_tracing();
+
+/**
+ * Stop recording spans.
+ *
+ * Spans already open when tracing stops are still recorded when they
+ * close.
+ */
+void stop_tracing();
+
+/**
+ * The number of spans recorded since tracing was started.
+ */
+std::size_t traced_span_count();
+
+/**
+ * Write the recorded spans in the Chrome trace event format.
+ *
+ * @param path  The file to be written.
+ *
+ * @throw write_error  If the file cannot be written.
+ */
+void write_chrome_trace(const std::string& path);
+
+/**
+ * Record the time from construction to destruction as a span.
+ *
+ * The category and name must be string literals, or otherwise live
+ * until the trace has been written.
+ */
+class TraceSpan {
+ public:
+  /**
+   * Open a span.
+   *
+   * @param category  The stage, such as "parse" or "verify".
+   * @param name      What is being done.
+   */
+  TraceSpan(const char* category, const char* name) : name_(nullptr) {
+    if (tracing_enabled()) {
+      Begin(category, name);
+    }
+  }
+
+  ~TraceSpan() {
+    if (nullptr != name_) {
+      End();
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  /**
+   * Attach a value to the span, such as a packet tag or a length.
+   *
+   * @param key    The name of the value, which must be a string
+   *               literal.
+   * @param value  The value.
+   */
+  void SetArgument(const char* key, int64_t value) {
+    argument_name_ = key;
+    argument_ = value;
+  }
+
+ private:
+  void Begin(const char* category, const char* name);
+  void End();
+
+  const char* category_;
+  const char* name_;
+  const char* argument_name_;
+  int64_t     argument_;
+  int64_t     start_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_TRACE_H_
@@ -0,0 +1,116 @@
+#ifndef PARSE4880_INCLUDE_VERIFICATION_CACHE_H_
+#define PARSE4880_INCLUDE_VERIFICATION_CACHE_H_
+
+/**
+ * @file verification_cache.h
+ *
+ * Persistent cache of signature verification outcomes.
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "digest.h"
+
+namespace parse4880 {
+
+/**
+ * Remember the outcome of signature verifications between runs.
+ *
+ * Each entry maps a digest of everything that goes into a verification
+ * (the signing key packet, the signed material, and the signature
+ * packet) to the result of that verification.  Since a change to any
+ * of these changes the digest, an entry never needs to be invalidated.
+ *
+ * Entries are stored in an append-only file of fixed-size records
+ * following a sixteen-octet header:
+ *
+ *   - Header
+ *     + [8] Magic "P4880VC1"
+ *     + [8] Reserved, zero
+ *   - Record
+ *     + [32] SHA-256 digest
+ *     + [1]  Verification outcome
+ *     + [7]  Reserved, zero
+ *   - Record
+ *     + ...
+ *
+ * Records are kept in the order in which they were written.  The file
+ * is read into a hash table when the cache is opened, and lookups are
+ * made in that table rather than in the file.
+ *
+ * The cache holds at most a fixed number of entries; once it is full,
+ * further outcomes are simply not recorded.  The cache is safe to use
+ * from several threads at once.
+ *
+ * @see verify_uid_binding
+ * @see verify_subkey_binding
+ */
+class VerificationCache {
+ public:
+  /**
+   * Open or create a cache file.
+   *
+   * A file that does not begin with the expected header is replaced
+   * with an empty cache, and a partial record at the end of the file
+   * (as left behind by an interrupted write) is discarded.
+   *
+   * @param path         The file in which outcomes are stored.
+   * @param max_entries  The largest number of entries to hold.
+   */
+  VerificationCache(const std::string& path, std::size_t max_entries);
+
+  /**
+   * Destructor, flushes any pending records to disk.
+   */
+  ~VerificationCache();
+
+  /**
+   * Look up a verification outcome.
+   *
+   * @param key      The digest identifying the verification.
+   * @param outcome  Set to the recorded outcome if one is found.
+   *
+   * @return true if the outcome was found, false otherwise.
+   */
+  bool Lookup(const ContentDigest& key, int* outcome) const;
+
+  /**
+   * Record a verification outcome.
+   *
+   * @param key      The digest identifying the verification.
+   * @param outcome  The outcome of the verification, from -128 to 127.
+   *
+   * @return true if the outcome was recorded, false if the cache is full.
+   */
+  bool Insert(const ContentDigest& key, int outcome);
+
+  /**
+   * Write any buffered records to the cache file.
+   */
+  void Flush();
+
+  /**
+   * The number of entries in the cache.
+   *
+   * @return The number of verification outcomes held.
+   */
+  std::size_t size() const;
+
+ private:
+  void Rewrite();
+
+ private:
+  std::string path_;
+  std::size_t max_entries_;
+  std::unordered_map<ContentDigest, int8_t, ContentDigestHash> entries_;
+  std::ofstream file_;
+  mutable std::mutex mutex_;
+};
+
+}
+
+#endif  // PARSE4880_INCLUDE_VERIFICATION_CACHE_H_
@@ -5,6 +5,7 @@
 
 #include "packet.h"
 #include "keys/key.h"
+#include "verification_cache.h"
 
 namespace parse4880 {
 
@@ -14,9 +15,27 @@ namespace parse4880 {
 bool verify_uid_binding(const PublicKeyPacket& key, const UserIDPacket& uid,
                         const Key& attester, const SignaturePacket& signature);
 
+/**
+ * Verify a key-to-UID binding, consulting a cache of earlier outcomes.
+ *
+ * The attesting key is only parsed, and the signature only checked,
+ * if the cache has no record of this combination of packets.  A
+ * signature rejected by SignaturePrefilter::UserIDBinding() fails
+ * without either.
+ *
+ * @param cache  The cache to consult and update, may be nullptr.
+ */
+bool verify_uid_binding(const PublicKeyPacket& key, const UserIDPacket& uid,
+                        const PublicKeyPacket& attester,
+                        const SignaturePacket& signature,
+                        VerificationCache* cache);
+
 /**
  * Verify a key-to-subkey binding.
  *
+ * A signature rejected by SignaturePrefilter::SubkeyBinding() fails
+ * without the key being parsed.
+ *
  * @return 0 if verification failed,
  *         1 if the subkey binding was verified,
  *         2 if the subkey and a primary-key binding were verified.
@@ -25,6 +44,18 @@ int verify_subkey_binding(const PublicKeyPacket&    key,
                           const PublicSubkeyPacket& subkey,
                           const SignaturePacket&    signature);
 
+/**
+ * Verify a key-to-subkey binding, consulting a cache of earlier outcomes.
+ *
+ * @param cache  The cache to consult and update, may be nullptr.
+ *
+ * @return As for verify_subkey_binding without a cache.
+ */
+int verify_subkey_binding(const PublicKeyPacket&    key,
+                          const PublicSubkeyPacket& subkey,
+                          const SignaturePacket&    signature,
+                          VerificationCache*        cache);
+
 }  // namespace parse4880
 
 #endif  // PARSE4880_SRC_INCLUDE_VERIFY_H_
@@ -0,0 +1,150 @@
+#ifndef PARSE4880_INCLUDE_WRITER_H_
+#define PARSE4880_INCLUDE_WRITER_H_
+
+/**
+ * @file writer.h
+ *
+ * Serialisation of parsed packets.
+ */
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "parser_types.h"
+#include "packet.h"
+
+namespace parse4880 {
+
+/**
+ * Encode a new-format packet header.
+ *
+ * The shortest length encoding is chosen, as described in
+ * RFC4880 §4.2.2.
+ *
+ * @param tag     The packet tag, less than 64.
+ * @param length  The length of the packet body, less than 2^32.
+ *
+ * @return The encoded header, between two and six octets long.
+ *
+ * @throw unencodable_packet_error  If the tag or the length is too large.
+ */
+ustring WritePacketHeader(uint8_t tag, uint64_t length);
+
+/**
+ * Gather packets for output without copying their contents.
+ *
+ * Each appended packet contributes a freshly encoded new-format header
+ * and a reference to the packet's existing contents.  The writer holds
+ * a reference to each packet, so the contents remain valid until the
+ * writer is cleared or destroyed.  The result is written with a single
+ * gathering write where possible.
+ */
+class PacketWriter {
+ public:
+  /**
+   * A contiguous piece of the output.
+   */
+  struct Segment {
+    const uint8_t* data;
+    std::size_t    length;
+  };
+
+  PacketWriter();
+
+  /**
+   * Append a packet to the output.
+   *
+   * @param packet  The packet to be written.
+   *
+   * @throw unencodable_packet_error  If the packet's tag or length is
+   *                                  too large for a header.
+   */
+  void Append(const std::shared_ptr<PGPPacket>& packet);
+
+  /**
+   * The pieces of the output, in order.
+   *
+   * @return The list of segments making up the output.
+   */
+  const std::vector<Segment>& segments() const;
+
+  /**
+   * The total length of the output.
+   *
+   * @return The number of octets that will be written.
+   */
+  std::size_t size() const;
+
+  /**
+   * Write the output to a file descriptor using writev.
+   *
+   * @param fd  The file descriptor to write to.
+   *
+   * @throw write_error  If the output cannot be written.
+   */
+  void WriteTo(int fd) const;
+
+  /**
+   * Write the output to a stream.
+   *
+   * @param stream  The stream to write to.
+   *
+   * @throw write_error  If the stream fails, before or during the write.
+   */
+  void WriteTo(std::ostream& stream) const;
+
+  /**
+   * Discard the output, releasing the packets that it refers to.
+   */
+  void Clear();
+
+ private:
+  std::deque<std::array<uint8_t, 6>>     headers_;
+  std::vector<Segment>                   segments_;
+  std::vector<std::shared_ptr<PGPPacket>> packets_;
+  std::size_t                            size_;
+};
+
+/**
+ * Context given to the predicate of WriteFilteredPackets.
+ */
+struct ExportContext {
+  /**
+   * The primary key of the key being exported, or nullptr if no
+   * primary key has yet been seen.
+   */
+  const PublicKeyPacket* primary_key;
+
+  /**
+   * The key, subkey or user-id packet to which a signature applies,
+   * or nullptr if no such packet has yet been seen.
+   */
+  const PGPPacket* component;
+};
+
+/**
+ * Write those packets of a keyring that are accepted by a predicate.
+ *
+ * Signatures belong to the key, subkey, user-id or user-attribute
+ * packet that precedes them.  If that packet is rejected, then its
+ * signatures are dropped along with it without consulting the
+ * predicate; likewise all of a key's packets are dropped when its
+ * primary key is rejected.
+ *
+ * @param packets    The packets to be filtered.
+ * @param predicate  Returns true for each packet that should be kept.
+ * @param writer     The writer to which kept packets are appended.
+ */
+void WriteFilteredPackets(
+    const std::list<std::shared_ptr<PGPPacket>>& packets,
+    std::function<bool(const PGPPacket&, const ExportContext&)> predicate,
+    PacketWriter* writer);
+
+}
+
+#endif  // PARSE4880_INCLUDE_WRITER_H_
@@ -0,0 +1,285 @@
+#include <cstring>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "exceptions.h"
+#include "digest.h"
+#include "writer.h"
+#include "keyring/transferable_key.h"
+#include "keyring/incremental.h"
+
+namespace parse4880 {
+
+IncrementalKeyring::IncrementalKeyring() {}
+
+std::vector<IncrementalKeyring::Span> IncrementalKeyring::Split(
+    const ustring& data) const {
+  std::vector<Span> spans;
+  std::unordered_map<ContentDigest, std::size_t, ContentDigestHash> seen;
+
+  ParseError error = scan(
+      data.data(), data.length(),
+      [&data, &spans, &seen](const PacketRecord& record) -> bool {
+        if (6 == record.tag) {
+          Span span;
+          span.identity = DigestPacket(
+              record.tag, data.data() + record.offset + record.header_length,
+              record.length);
+          span.offset = record.offset;
+          span.length = 0;
+
+          // A key that appears more than once is told apart by the
+          // number of times it has been seen.
+          std::size_t occurrence = seen[span.identity]++;
+          if (occurrence > 0) {
+            const ustring identity(span.identity.begin(),
+                                   span.identity.end());
+            const ustring count = WriteInteger(occurrence, 8);
+            span.identity = DigestParts({&identity, &count});
+          }
+          spans.push_back(span);
+        }
+
+        // Packets before the first primary key belong to no key.
+        if (!spans.empty()) {
+          spans.back().length += record.header_length + record.length;
+        }
+        return true;
+      });
+  if (!error.ok()) {
+    ThrowParseError(error);
+  }
+
+  return spans;
+}
+
+IncrementalKeyring::Entry IncrementalKeyring::ParseEntry(
+    const ustring& data, const Span& span, const Entry* previous,
+    KeyringUpdate* update) const {
+  std::unordered_map<ContentDigest, std::shared_ptr<PGPPacket>,
+                     ContentDigestHash> reusable;
+  if (nullptr != previous) {
+    for (auto i = previous->packets.begin(); i != previous->packets.end();
+         i++) {
+      reusable.insert(*i);
+    }
+  }
+
+  Entry entry;
+  entry.offset = span.offset;
+  entry.length = span.length;
+  entry.dirty = true;
+
+  std::unordered_set<ContentDigest, ContentDigestHash> present;
+  TransferableKeyGrouper grouper(
+      [&entry](std::shared_ptr<TransferableKey> key) -> bool {
+        entry.key = key;
+        return true;
+      });
+
+  // The span was scanned successfully once already.
+  const uint8_t* span_data = data.data() + span.offset;
+  scan(span_data, span.length,
+       [&](const PacketRecord& record) -> bool {
+         const uint8_t* contents =
+             span_data + record.offset + record.header_length;
+         ContentDigest digest =
+             DigestPacket(record.tag, contents, record.length);
+         present.insert(digest);
+
+         std::shared_ptr<PGPPacket> packet;
+         auto existing = reusable.find(digest);
+         if (reusable.end() != existing) {
+           packet = existing->second;
+         }
+         else {
+           packet = PGPPacket::ParsePacket(record.tag,
+                                           ustring(contents, record.length));
+           update->packets_added++;
+         }
+
+         entry.packets.push_back(std::make_pair(digest, packet));
+         return grouper.Add(packet);
+       });
+  grouper.Finish();
+
+  for (auto i = reusable.begin(); i != reusable.end(); i++) {
+    if (0 == present.count(i->first)) {
+      update->packets_removed++;
+    }
+  }
+
+  return entry;
+}
+
+KeyringUpdate IncrementalKeyring::Update(ustring data) {
+  const std::vector<Span> spans = Split(data);
+
+  KeyringUpdate update;
+  std::vector<ContentDigest> order;
+  std::unordered_map<ContentDigest, Entry, ContentDigestHash> entries;
+  order.reserve(spans.size());
+
+  for (auto span = spans.begin(); span != spans.end(); span++) {
+    order.push_back(span->identity);
+    auto previous = entries_.find(span->identity);
+
+    if (entries_.end() == previous) {
+      entries[span->identity] = ParseEntry(data, *span, nullptr, &update);
+      update.keys_added++;
+      continue;
+    }
+
+    Entry& old_entry = previous->second;
+    if (old_entry.length == span->length
+        && 0 == memcmp(data_.data() + old_entry.offset,
+                       data.data() + span->offset, span->length)) {
+      old_entry.offset = span->offset;
+      entries[span->identity] = std::move(old_entry);
+      update.keys_unchanged++;
+    }
+    else {
+      entries[span->identity] =
+          ParseEntry(data, *span, &old_entry, &update);
+      update.keys_modified++;
+    }
+    entries_.erase(previous);
+  }
+
+  // Whatever is left of the old keyring has been removed.
+  for (auto i = entries_.begin(); i != entries_.end(); i++) {
+    update.keys_removed++;
+    update.packets_removed += i->second.packets.size();
+    if (nullptr != i->second.key) {
+      removed_.push_back(i->second.key->primary_key->fingerprint());
+    }
+  }
+
+  data_ = std::move(data);
+  order_ = std::move(order);
+  entries_ = std::move(entries);
+  return update;
+}
+
+std::size_t IncrementalKeyring::size() const {
+  return order_.size();
+}
+
+void IncrementalKeyring::ForEach(
+    std::function<void(const TransferableKey&, bool)> callback) const {
+  for (auto i = order_.begin(); i != order_.end(); i++) {
+    const Entry& entry = entries_.find(*i)->second;
+    if (nullptr != entry.key) {
+      callback(*entry.key, entry.dirty);
+    }
+  }
+}
+
+void IncrementalKeyring::ForEachDirty(
+    std::function<void(const TransferableKey&)> callback) const {
+  ForEach([&callback](const TransferableKey& key, bool dirty) {
+      if (dirty) {
+        callback(key);
+      }
+    });
+}
+
+const std::vector<ustring>& IncrementalKeyring::removed_keys() const {
+  return removed_;
+}
+
+void IncrementalKeyring::ClearDirty() {
+  for (auto i = entries_.begin(); i != entries_.end(); i++) {
+    i->second.dirty = false;
+  }
+  removed_.clear();
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(IncrementalKeyring, Update) {
+  std::vector<std::shared_ptr<PGPPacket>> keys;
+  for (int i = 0; i < 3; i++) {
+    keys.push_back(std::shared_ptr<PGPPacket>(new PublicKeyPacket(
+        ustring((const uint8_t*)"\x04\0\0\0\0\x01", 6)
+        + WriteInteger(i, 4))));
+  }
+  std::shared_ptr<PGPPacket> uid(
+      new UserIDPacket(ustring((const uint8_t*)"uid", 3)));
+  std::shared_ptr<PGPPacket> new_uid(
+      new UserIDPacket(ustring((const uint8_t*)"new", 3)));
+  ASSERT_EQ(DigestPacket(*uid),
+            DigestPacket(13, uid->contents().data(), 3));
+
+  auto write = [](std::initializer_list<std::shared_ptr<PGPPacket>> packets) {
+    PacketWriter writer;
+    for (auto i = packets.begin(); i != packets.end(); i++) {
+      writer.Append(*i);
+    }
+    ustring data;
+    for (auto i = writer.segments().begin(); i != writer.segments().end();
+         i++) {
+      data.append(i->data, i->length);
+    }
+    return data;
+  };
+
+  IncrementalKeyring keyring;
+  KeyringUpdate update = keyring.Update(
+      write({keys[0], uid, keys[1], uid, keys[2], uid}));
+  ASSERT_EQ(update.keys_added, 3);
+  ASSERT_EQ(update.packets_added, 6);
+  keyring.ClearDirty();
+
+  const PGPPacket* unchanged_uid = nullptr;
+  keyring.ForEach([&unchanged_uid](const TransferableKey& key, bool) {
+      unchanged_uid = key.user_ids.front().packet.get();
+    });
+
+  // Add a user ID to the second key and drop the first.
+  update = keyring.Update(
+      write({keys[1], uid, new_uid, keys[2], uid}));
+  ASSERT_EQ(update.keys_added, 0);
+  ASSERT_EQ(update.keys_modified, 1);
+  ASSERT_EQ(update.keys_unchanged, 1);
+  ASSERT_EQ(update.keys_removed, 1);
+  ASSERT_EQ(update.packets_added, 1);
+  ASSERT_EQ(update.packets_removed, 2);
+  ASSERT_EQ(keyring.size(), 2);
+  ASSERT_EQ(keyring.removed_keys().size(), 1);
+
+  std::size_t dirty = 0;
+  keyring.ForEachDirty([&dirty](const TransferableKey& key) {
+      ASSERT_EQ(key.user_ids.size(), 2);
+      dirty++;
+    });
+  ASSERT_EQ(dirty, 1);
+
+  // The unchanged key keeps the packets parsed the first time.
+  keyring.ForEach([&unchanged_uid](const TransferableKey& key, bool dirty) {
+      if (!dirty) {
+        ASSERT_EQ(key.user_ids.front().packet.get(), unchanged_uid);
+      }
+    });
+
+  ASSERT_THROW(keyring.Update(ustring((const uint8_t*)"\xC6\x05X", 3)),
+               packet_length_error);
+  ASSERT_EQ(keyring.size(), 2);
+}
+
+#endif  // INCLUDE_TESTS
+
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "exceptions.h"
+#include "parser.h"
+#include "keyring/key_index.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+uint64_t ReadKeyID(ByteView key_id) {
+  uint64_t value = 0;
+  for (std::size_t i = 0; i < key_id.size(); i++) {
+    value = (value << 8) | key_id[i];
+  }
+  return value;
+}
+
+bool ByKeyID(const KeyIndex::Entry& lhs, const KeyIndex::Entry& rhs) {
+  return lhs.key_id < rhs.key_id;
+}
+
+}
+
+/// @endcond
+
+KeyIndex::KeyIndex(const std::list<std::shared_ptr<PGPPacket>>& packets) {
+  for (auto i = packets.begin(); i != packets.end(); i++) {
+    Add(*i);
+  }
+  Sort();
+}
+
+KeyIndex::KeyIndex(const uint8_t* data, std::size_t length) {
+  ParseError error = try_parse(
+      data, length, TagMask({6, 14}),
+      [this](std::shared_ptr<PGPPacket> packet) -> bool {
+        Add(packet);
+        return true;
+      });
+  if (!error.ok()) {
+    ThrowParseError(error);
+  }
+  Sort();
+}
+
+void KeyIndex::Add(const std::shared_ptr<PGPPacket>& packet) {
+  std::shared_ptr<const PublicKeyPacket> key_packet =
+      std::dynamic_pointer_cast<const PublicKeyPacket>(packet);
+  if (nullptr == key_packet) {
+    return;
+  }
+  ParseResult<std::unique_ptr<Key>> key = Key::TryParseKey(*key_packet);
+  if (!key.ok()) {
+    return;
+  }
+
+  Entry entry;
+  entry.key_id = ReadKeyID(ByteView(key_packet->fingerprint()).substr(12));
+  entry.packet = key_packet;
+  entry.key = std::move(key.value);
+  entries_.push_back(std::move(entry));
+}
+
+void KeyIndex::Sort() {
+  std::stable_sort(entries_.begin(), entries_.end(), ByKeyID);
+}
+
+std::size_t KeyIndex::size() const {
+  return entries_.size();
+}
+
+KeyIndex::Range KeyIndex::Find(ByteView key_id) const {
+  Entry target;
+  target.key_id = ReadKeyID(key_id);
+  auto range = std::equal_range(entries_.begin(), entries_.end(), target,
+                                ByKeyID);
+
+  Range result;
+  result.begin = entries_.data() + (range.first - entries_.begin());
+  result.end = entries_.data() + (range.second - entries_.begin());
+  return result;
+}
+
+KeyIndex::Verification KeyIndex::Verify(const SignaturePacket& signature,
+                                        const uint8_t* data,
+                                        std::size_t length) const {
+  StreamVerification verification = StartVerify(signature);
+  verification.Update(data, length);
+  return verification.Finish();
+}
+
+KeyIndex::StreamVerification KeyIndex::StartVerify(
+    const SignaturePacket& signature) const {
+  if (signature.key_id().empty()) {
+    return StreamVerification(nullptr);
+  }
+
+  // Key IDs can collide, so try each key that has the right one.
+  Range keys = Find(signature.key_id());
+  StreamVerification verification(
+      keys.begin == keys.end ? nullptr : keys.end - 1);
+  for (const Entry* i = keys.begin; i != keys.end; i++) {
+    std::unique_ptr<VerificationContext> context =
+        i->key->GetVerificationContext(signature);
+    if (nullptr != context) {
+      verification.contexts_.push_back(std::make_pair(i, std::move(context)));
+    }
+  }
+  return verification;
+}
+
+KeyIndex::StreamVerification::StreamVerification(const Entry* last_key)
+    : last_key_(last_key) {}
+
+void KeyIndex::StreamVerification::Update(const uint8_t* data,
+                                          std::size_t length) {
+  for (auto i = contexts_.begin(); i != contexts_.end(); i++) {
+    i->second->Update(data, length);
+  }
+}
+
+KeyIndex::Verification KeyIndex::StreamVerification::Finish() {
+  Verification result;
+  result.key = last_key_;
+  result.valid = false;
+  for (auto i = contexts_.begin(); i != contexts_.end(); i++) {
+    if (i->second->Verify()) {
+      result.key = i->first;
+      result.valid = true;
+      break;
+    }
+  }
+  return result;
+}
+
+}
@@ -0,0 +1,232 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <istream>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <gtest/gtest.h>
+#endif
+
+#include "exceptions.h"
+#include "mapped_file.h"
+#include "keyring/manifest.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+// Closes a descriptor when it goes out of scope.
+class ScopedDescriptor {
+ public:
+  explicit ScopedDescriptor(int fd) : fd_(fd) {}
+  ~ScopedDescriptor() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  ScopedDescriptor(const ScopedDescriptor&) = delete;
+  ScopedDescriptor& operator=(const ScopedDescriptor&) = delete;
+
+  int get() const { return fd_; }
+
+ private:
+  int fd_;
+};
+
+VerifyResponse VerifyEntry(const KeyIndex& index,
+                           const ManifestEntry& entry) {
+  // Any failure is this entry's alone, and must not leave the worker.
+  VerifyResponse response;
+  response.status = kVerifyReadError;
+  try {
+    MappedFile signature_file(entry.signature);
+    const ustring signature(signature_file.data(), signature_file.size());
+
+    const char* path = entry.file.c_str();
+    ScopedDescriptor fd(open(path, O_RDONLY | O_CLOEXEC)); // Flawfinder: ignore
+    if (fd.get() < 0) {
+      throw read_error(entry.file, errno);
+    }
+    response = verify_descriptor(index, fd.get(), entry.file, signature);
+  }
+  catch (const read_error& e) {
+    response.message = static_cast<const std::runtime_error&>(e).what();
+  }
+  catch (const parse4880_error& e) {
+    response.status = kVerifyMalformed;
+    response.message = error_message(e);
+  }
+  catch (const std::exception& e) {
+    response.message = e.what();
+  }
+  return response;
+}
+
+}
+
+/// @endcond
+
+std::vector<ManifestEntry> read_manifest(std::istream& in) {
+  std::vector<ManifestEntry> entries;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && '\r' == line.back()) {
+      line.pop_back();
+    }
+    if (line.empty() || '#' == line[0]) {
+      continue;
+    }
+
+    std::size_t separator = line.find('\t');
+    if (std::string::npos == separator) {
+      separator = line.find(' ');
+    }
+    ManifestEntry entry;
+    entry.file = line.substr(0, separator);
+    entry.signature = std::string::npos == separator
+        ? entry.file + ".sig"
+        : line.substr(separator + 1);
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+std::vector<VerifyResponse> verify_manifest(
+    const KeyIndex& index, const std::vector<ManifestEntry>& entries,
+    std::size_t threads) {
+  std::vector<VerifyResponse> results(entries.size());
+  if (0 == threads) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, entries.size());
+
+  // Each thread takes the next entry as it finishes the last, so that
+  // a few large files do not hold up the rest.
+  std::atomic<std::size_t> next(0);
+  auto work = [&index, &entries, &results, &next]() {
+    std::size_t i;
+    while ((i = next.fetch_add(1)) < entries.size()) {
+      results[i] = VerifyEntry(index, entries[i]);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < threads; i++) {
+    workers.push_back(std::thread(work));
+  }
+  work();
+  for (auto i = workers.begin(); i != workers.end(); i++) {
+    i->join();
+  }
+  return results;
+}
+
+}
+
+#ifdef INCLUDE_TESTS
+
+namespace parse4880 {
+
+TEST(Manifest, Verify) {
+  std::istringstream manifest(
+      "# Release\n"
+      "a.txt\ta.txt.asc\r\n"
+      "\n"
+      "b c.txt\td.sig\n"
+      "e.txt f.sig\n"
+      "g.txt\n");
+  std::vector<ManifestEntry> entries = read_manifest(manifest);
+  ASSERT_EQ(entries.size(), 4);
+  ASSERT_EQ(entries[0].file, "a.txt");
+  ASSERT_EQ(entries[0].signature, "a.txt.asc");
+  ASSERT_EQ(entries[1].file, "b c.txt");
+  ASSERT_EQ(entries[1].signature, "d.sig");
+  ASSERT_EQ(entries[2].file, "e.txt");
+  ASSERT_EQ(entries[2].signature, "f.sig");
+  ASSERT_EQ(entries[3].signature, "g.txt.sig");
+
+  // The EdDSA key and signature from TEST(EdDSAKey, Verify).
+  const ustring key_data((const uint8_t*)
+      "\x98\x33\x04\x6A\xD5\x41\x9A\x16\x09\x2B\x06\x01\x04\x01\xDA\x47"
+      "\x0F\x01\x01\x07\x40\x8D\x34\x30\x60\x24\xF1\x96\x7C\x00\x64\xF9"
+      "\x50\x39\x71\x76\xAB\x5C\x4E\xDE\xEE\x78\x87\x04\x1A\x63\x2C\x83"
+      "\x5D\xA6\xE5\x1D\x87", 53);
+  const std::string signature(
+      "\x88\x85\x04\x00\x16\x08\x00\x2D\x16\x21\x04\xE3\x7D\xE8\x87\xB6"
+      "\xA2\xB6\xEB\x70\x93\x1A\x6D\x23\xBF\xDA\x20\x17\xA2\xEE\x02\x05"
+      "\x02\x6A\xD5\x41\x9A\x0F\x1C\x65\x64\x40\x65\x78\x61\x6D\x70\x6C"
+      "\x65\x2E\x6F\x72\x67\x00\x0A\x09\x10\x23\xBF\xDA\x20\x17\xA2\xEE"
+      "\x02\xCE\x13\x01\x00\xA6\x24\x63\xC3\xCD\xCA\xD8\xAC\xCC\xCB\xCF"
+      "\x29\xC2\x4B\x5A\x82\x07\x26\xC8\xE9\x0B\x1A\x8B\xCF\x9C\x41\xFE"
+      "\x75\xD0\x5B\xE9\x3D\x01\x00\xF1\xA3\xD7\x0F\x24\xEF\x3C\xD1\x3C"
+      "\x78\xC7\xEE\xAD\x22\x80\x11\xE5\xC0\x50\x0C\xC3\x5F\xEE\x8D\xA7"
+      "\xBB\xD9\x4B\x45\xBB\x8A\x0F", 135);
+  // The fixtures go in a directory of their own.
+  const char* tmpdir = getenv("TMPDIR"); // Flawfinder: ignore
+  std::string directory_template =
+      std::string(nullptr == tmpdir ? "/tmp" : tmpdir)
+      + "/manifest_test.XXXXXX";
+  ASSERT_NE(mkdtemp(&directory_template[0]), nullptr);
+  const std::string directory = directory_template + "/";
+  const std::string data_path = directory + "data";
+  const std::string signature_path = directory + "data.sig";
+  const std::string bad_path = directory + "bad";
+  auto write_file = [](const std::string& path, const std::string& contents) {
+    FILE* file = fopen(path.c_str(), "wb"); // Flawfinder: ignore
+    ASSERT_NE(file, nullptr);
+    fwrite(contents.data(), 1, contents.length(), file);
+    fclose(file);
+  };
+  write_file(data_path, "hello world\n");
+  write_file(signature_path, signature);
+  write_file(bad_path, "hello world!");
+
+  KeyIndex index(key_data.data(), key_data.length());
+  std::vector<ManifestEntry> batch;
+  for (int i = 0; i < 8; i++) {
+    batch.push_back({data_path, signature_path});
+    batch.push_back({bad_path, signature_path});
+  }
+  batch.push_back({directory + "missing", signature_path});
+  batch.push_back({data_path, directory + "missing.sig"});
+  batch.push_back({data_path, data_path});
+  // A directory opens, but cannot be read.
+  batch.push_back({directory, signature_path});
+
+  std::vector<VerifyResponse> results = verify_manifest(index, batch, 3);
+  ASSERT_EQ(results.size(), batch.size());
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(results[2 * i].status, kVerifyGood);
+    ASSERT_EQ(results[2 * i + 1].status, kVerifyBad);
+  }
+  ASSERT_EQ(results[16].status, kVerifyReadError);
+  ASSERT_NE(results[16].message.find(directory + "missing"),
+            std::string::npos);
+  ASSERT_EQ(results[17].status, kVerifyReadError);
+  ASSERT_EQ(results[18].status, kVerifyMalformed);
+  ASSERT_EQ(results[19].status, kVerifyReadError);
+  ASSERT_TRUE(verify_manifest(index, {}).empty());
+
+  unlink(data_path.c_str());
+  unlink(signature_path.c_str());
+  unlink(bad_path.c_str());
+  ASSERT_EQ(rmdir(directory_template.c_str()), 0);
+}
+
+}
+
+#endif
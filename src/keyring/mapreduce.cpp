@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "exceptions.h"
+#include "writer.h"
+#include "keyring/transferable_key.h"
+#include "keyring/mapreduce.h"
+
+namespace parse4880 {
+
+std::vector<KeyringChunk> split_keyring(const uint8_t* data,
+                                        std::size_t length,
+                                        std::size_t chunk_length) {
+  std::vector<KeyringChunk> chunks;
+  KeyringChunk current = {0, 0};
+
+  scan(data, length,
+       [&chunks, &current, chunk_length](const PacketRecord& record) -> bool {
+         // Start a new chunk at the first primary key past the limit.
+         if (6 == record.tag && current.length >= chunk_length) {
+           chunks.push_back(current);
+           current.offset = record.offset;
+           current.length = 0;
+         }
+         current.length += record.header_length + record.length;
+         return true;
+       });
+
+  // Whatever is left, including anything that could not be scanned,
+  // belongs to the final chunk.
+  current.length = length - current.offset;
+  if (current.length > 0) {
+    chunks.push_back(current);
+  }
+  return chunks;
+}
+
+std::size_t map_reduce_workers(const MapReduceOptions& options) {
+  if (options.threads > 0) {
+    return options.threads;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void for_each_key_parallel(
+    const uint8_t* data, std::size_t length, const MapReduceOptions& options,
+    std::function<void(std::size_t, const TransferableKey&)> callback) {
+  const std::vector<KeyringChunk> chunks =
+      split_keyring(data, length, options.chunk_length);
+
+  std::atomic<std::size_t> next_chunk(0);
+  std::atomic<bool>        failed(false);
+  std::exception_ptr       error;
+  std::mutex               error_mutex;
+
+  auto worker = [&](std::size_t worker_index) {
+    while (!failed) {
+      std::size_t chunk_index = next_chunk++;
+      if (chunk_index >= chunks.size()) {
+        break;
+      }
+      const KeyringChunk& chunk = chunks[chunk_index];
+
+      try {
+        const ustring chunk_data(data + chunk.offset, chunk.length);
+        TransferableKeyGrouper grouper(
+            [&callback, worker_index](std::shared_ptr<TransferableKey> key) {
+              callback(worker_index, *key);
+              return true;
+            });
+        ParseError parse_error = try_parse(
+            chunk_data, [&grouper](std::shared_ptr<PGPPacket> packet) {
+              return grouper.Add(std::move(packet));
+            });
+        grouper.Finish();
+
+        if (!parse_error.ok() && !options.skip_malformed) {
+          // Report the error relative to the whole keyring.
+          if (static_cast<std::size_t>(-1) != parse_error.position) {
+            parse_error.position += chunk.offset;
+          }
+          ThrowParseError(parse_error);
+        }
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  std::size_t worker_count = map_reduce_workers(options);
+  for (std::size_t i = 0; i < worker_count; i++) {
+    threads.push_back(std::thread(worker, i));
+  }
+  for (auto i = threads.begin(); i != threads.end(); i++) {
+    i->join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(MapReduce, CountsKeys) {
+  // Build a keyring of many small keys.
+  PacketWriter writer;
+  for (int i = 0; i < 1000; i++) {
+    ustring key_data((const uint8_t*)"\x04\0\0\0\0\x01", 6);
+    key_data += WriteInteger(i, 4);
+    writer.Append(std::shared_ptr<PGPPacket>(new PublicKeyPacket(key_data)));
+    writer.Append(std::shared_ptr<PGPPacket>(
+        new UserIDPacket(ustring((const uint8_t*)"uid", 3))));
+  }
+  ustring keyring;
+  for (auto i = writer.segments().begin(); i != writer.segments().end(); i++) {
+    keyring.append(i->data, i->length);
+  }
+
+  MapReduceOptions options;
+  options.threads = 4;
+  options.chunk_length = 256;
+  ASSERT_GT(split_keyring(keyring.data(), keyring.length(),
+                          options.chunk_length).size(), 1);
+
+  std::size_t user_ids = map_reduce_keyring<std::size_t>(
+      keyring.data(), keyring.length(),
+      [](const TransferableKey& key, std::size_t* count) {
+        *count += key.user_ids.size();
+      },
+      [](std::size_t* total, const std::size_t& count) {
+        *total += count;
+      },
+      options);
+  ASSERT_EQ(user_ids, 1000);
+
+  // A truncated keyring is reported unless malformed chunks are skipped.
+  ASSERT_THROW(map_reduce_keyring<std::size_t>(
+      keyring.data(), keyring.length() - 1,
+      [](const TransferableKey&, std::size_t*) {},
+      [](std::size_t*, const std::size_t&) {},
+      options), packet_length_error);
+}
+
+#endif  // INCLUDE_TESTS
+
+}
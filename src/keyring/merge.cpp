@@ -0,0 +1,136 @@
+#include <functional>
+#include <list>
+#include <memory>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "digest.h"
+#include "writer.h"
+#include "keyring/transferable_key.h"
+#include "keyring/merge.h"
+
+namespace parse4880 {
+
+KeyringMerger::KeyringMerger() {}
+
+void KeyringMerger::MergeSignatures(
+    const std::list<std::shared_ptr<PGPPacket>>& from,
+    std::list<std::shared_ptr<PGPPacket>>* to, DigestSet* seen) {
+  for (auto i = from.begin(); i != from.end(); i++) {
+    if (seen->insert(DigestPacket(**i)).second) {
+      to->push_back(*i);
+    }
+  }
+}
+
+void KeyringMerger::MergeComponents(
+    const std::list<KeyComponent>& from, std::list<KeyComponent>* to,
+    std::unordered_map<ContentDigest, MergedComponent, ContentDigestHash>*
+        seen) {
+  for (auto i = from.begin(); i != from.end(); i++) {
+    ContentDigest digest = DigestPacket(*i->packet);
+    auto existing = seen->find(digest);
+    if (existing == seen->end()) {
+      to->push_back(KeyComponent());
+      to->back().packet = i->packet;
+      MergedComponent merged;
+      merged.component = &to->back();
+      existing = seen->insert(std::make_pair(digest, merged)).first;
+    }
+    MergeSignatures(i->signatures, &existing->second.component->signatures,
+                    &existing->second.signatures);
+  }
+}
+
+void KeyringMerger::Add(const TransferableKey& key) {
+  const ustring& fingerprint = key.primary_key->fingerprint();
+  auto existing = index_.find(fingerprint);
+
+  MergedKey* merged;
+  if (existing == index_.end()) {
+    keys_.push_back(MergedKey());
+    merged = &keys_.back();
+    merged->key.primary_key = key.primary_key;
+    index_[fingerprint] = merged;
+  }
+  else {
+    merged = existing->second;
+  }
+
+  MergeSignatures(key.signatures, &merged->key.signatures,
+                  &merged->signatures);
+  MergeComponents(key.user_ids, &merged->key.user_ids, &merged->user_ids);
+  MergeComponents(key.subkeys, &merged->key.subkeys, &merged->subkeys);
+}
+
+void KeyringMerger::AddKeyring(const ustring& data) {
+  TransferableKeyGrouper grouper(
+      [this](std::shared_ptr<TransferableKey> key) -> bool {
+        Add(*key);
+        return true;
+      });
+  parse(data, [&grouper](std::shared_ptr<PGPPacket> packet) -> bool {
+      return grouper.Add(std::move(packet));
+    });
+  grouper.Finish();
+}
+
+std::size_t KeyringMerger::size() const {
+  return keys_.size();
+}
+
+void KeyringMerger::ForEach(
+    std::function<void(const TransferableKey&)> callback) const {
+  for (auto i = keys_.begin(); i != keys_.end(); i++) {
+    callback(i->key);
+  }
+}
+
+void KeyringMerger::WriteTo(PacketWriter* writer) const {
+  for (auto i = keys_.begin(); i != keys_.end(); i++) {
+    WriteTransferableKey(i->key, writer);
+  }
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(KeyringMerger, Deduplicates) {
+  std::shared_ptr<PublicKeyPacket> primary_key(
+      new PublicKeyPacket(ustring((const uint8_t*)"\x04\0\0\0\1\1key", 9)));
+  std::shared_ptr<PGPPacket> uid(
+      new UserIDPacket(ustring((const uint8_t*)"uid", 3)));
+  std::shared_ptr<PGPPacket> first_signature(
+      new UnknownPGPPacket(2, ustring((const uint8_t*)"first", 5)));
+  std::shared_ptr<PGPPacket> second_signature(
+      new UnknownPGPPacket(2, ustring((const uint8_t*)"second", 6)));
+
+  TransferableKey first;
+  first.primary_key = primary_key;
+  first.user_ids.push_back(KeyComponent());
+  first.user_ids.back().packet = uid;
+  first.user_ids.back().signatures.push_back(first_signature);
+
+  TransferableKey second = first;
+  second.user_ids.back().signatures.push_back(second_signature);
+
+  KeyringMerger merger;
+  merger.Add(first);
+  merger.Add(second);
+  merger.Add(first);
+
+  ASSERT_EQ(merger.size(), 1);
+  merger.ForEach([&](const TransferableKey& key) {
+      ASSERT_EQ(key.user_ids.size(), 1);
+      ASSERT_EQ(key.user_ids.front().signatures.size(), 2);
+      ASSERT_EQ(key.subkeys.size(), 0);
+    });
+}
+
+#endif  // INCLUDE_TESTS
+
+}
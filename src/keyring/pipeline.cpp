@@ -0,0 +1,266 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+
+#ifdef INCLUDE_TESTS
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "exceptions.h"
+#include "writer.h"
+#include "keyring/transferable_key.h"
+#include "keyring/pipeline.h"
+
+namespace parse4880 {
+
+KeyFramer::KeyFramer(std::function<void(ustring)> callback)
+    : callback_(callback), buffer_offset_(0), key_start_(ustring::npos),
+      scanned_(0) {
+}
+
+void KeyFramer::Add(const uint8_t* data, std::size_t length) {
+  buffer_.append(data, length);
+
+  const std::size_t base = scanned_;
+  ParseError error = scan(
+      buffer_.data() + base, buffer_.length() - base,
+      [this, base](const PacketRecord& record) -> bool {
+        const std::size_t offset = base + record.offset;
+        if (6 == record.tag) {
+          if (ustring::npos != key_start_) {
+            callback_(buffer_.substr(key_start_, offset - key_start_));
+          }
+          key_start_ = offset;
+        }
+        scanned_ = offset + record.header_length + record.length;
+        return true;
+      });
+
+  // A packet cut short may be completed by the next piece.
+  if (!error.ok() && kParseHeaderTooShort != error.status
+      && kParsePacketTooShort != error.status) {
+    error.position += buffer_offset_ + base;
+    ThrowParseError(error);
+  }
+
+  // Drop whatever has been passed on, and anything before the first
+  // primary key.
+  const std::size_t consumed =
+      ustring::npos == key_start_ ? scanned_ : key_start_;
+  buffer_.erase(0, consumed);
+  buffer_offset_ += consumed;
+  scanned_ -= consumed;
+  if (ustring::npos != key_start_) {
+    key_start_ -= consumed;
+  }
+}
+
+void KeyFramer::Finish() {
+  if (scanned_ != buffer_.length()) {
+    ParseError error = scan(buffer_.data() + scanned_,
+                            buffer_.length() - scanned_,
+                            [](const PacketRecord&) -> bool {
+                              return true;
+                            });
+    error.position += buffer_offset_ + scanned_;
+    ThrowParseError(error);
+  }
+  if (ustring::npos != key_start_) {
+    callback_(buffer_.substr(key_start_, scanned_ - key_start_));
+  }
+  buffer_.clear();
+  key_start_ = ustring::npos;
+  scanned_ = 0;
+}
+
+/// @cond SHOW_INTERNAL
+
+int open_pipeline_input(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY); // Flawfinder: ignore
+  if (fd < 0) {
+    throw read_error(path, errno);
+  }
+  return fd;
+}
+
+std::size_t read_pipeline_input(int fd, const std::string& path,
+                                uint8_t* data, std::size_t length) {
+  while (true) {
+    ssize_t result = read(fd, data, length); // Flawfinder: ignore
+    if (result >= 0) {
+      return result;
+    }
+    if (EINTR != errno) {
+      throw read_error(path, errno);
+    }
+  }
+}
+
+void close_pipeline_input(int fd) {
+  close(fd);
+}
+
+std::shared_ptr<TransferableKey> parse_framed_key(const ustring& data) {
+  std::list<std::shared_ptr<TransferableKey>> keys =
+      group_transferable_keys(parse(data));
+  if (keys.empty()) {
+    return std::shared_ptr<TransferableKey>();
+  }
+  return keys.front();
+}
+
+std::size_t pipeline_verify_threads(const PipelineOptions& options) {
+  if (options.verify_threads > 0) {
+    return options.verify_threads;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/// @endcond
+
+#ifdef INCLUDE_TESTS
+
+namespace {
+
+std::shared_ptr<PGPPacket> MakeKey(uint32_t created) {
+  ustring data((const uint8_t*)"\x04", 1);
+  data += WriteInteger(created, 4);
+  data += ustring((const uint8_t*)"\x01\x00\x01\x01\x00\x01\x01", 7);
+  return std::shared_ptr<PGPPacket>(new PublicKeyPacket(data));
+}
+
+}  // namespace
+
+TEST(KeyringPipeline, OrderedResults) {
+  // A stray user ID, then keys each with a user ID of their own, one
+  // of which has a primary key that cannot be parsed.
+  const uint32_t kKeys = 300;
+  const std::shared_ptr<PGPPacket> uid(
+      new UserIDPacket(ustring((const uint8_t*)"uid", 3)));
+  PacketWriter writer;
+  writer.Append(uid);
+  for (uint32_t i = 0; i < kKeys; i++) {
+    if (100 == i) {
+      writer.Append(std::shared_ptr<PGPPacket>(new UnknownPGPPacket(
+          6, ustring((const uint8_t*)"\x03", 1))));
+    }
+    else {
+      writer.Append(MakeKey(i));
+    }
+    writer.Append(uid);
+  }
+
+  const char* tmpdir = getenv("TMPDIR"); // Flawfinder: ignore
+  std::string directory =
+      std::string(nullptr == tmpdir ? "/tmp" : tmpdir)
+      + "/pipeline_test.XXXXXX";
+  ASSERT_NE(mkdtemp(&directory[0]), nullptr);
+  const std::string path = directory + "/keyring";
+  {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    ASSERT_GE(fd, 0);
+    writer.WriteTo(fd);
+    close(fd);
+  }
+
+  // Small reads split packets between pieces, and a small window
+  // keeps the stages waiting on one another.
+  PipelineOptions options;
+  options.read_length = 7;
+  options.queue_capacity = 4;
+  options.parse_threads = 2;
+  options.verify_threads = 3;
+  {
+    KeyringPipeline<int64_t> pipeline(
+        path, [](const TransferableKey& key) -> int64_t {
+          return key.primary_key->creation_time();
+        }, options);
+    int64_t created;
+    for (uint32_t i = 0; i < kKeys; i++) {
+      if (100 == i) {
+        continue;
+      }
+      ASSERT_TRUE(pipeline.Next(&created));
+      ASSERT_EQ(created, i);
+    }
+    ASSERT_FALSE(pipeline.Next(&created));
+  }
+
+  // Abandoning a pipeline part-way stops it cleanly.
+  {
+    KeyringPipeline<int64_t> pipeline(
+        path, [](const TransferableKey& key) -> int64_t {
+          return key.primary_key->creation_time();
+        }, options);
+    int64_t created;
+    ASSERT_TRUE(pipeline.Next(&created));
+  }
+
+  // A verifier's failure is reported after the keys before it, even
+  // though later keys are already being verified.
+  {
+    KeyringPipeline<int64_t> pipeline(
+        path, [](const TransferableKey& key) -> int64_t {
+          if (150 == key.primary_key->creation_time()) {
+            throw std::runtime_error("verifier failed");
+          }
+          return key.primary_key->creation_time();
+        }, options);
+    int64_t created;
+    std::vector<int64_t> results;
+    ASSERT_THROW(while (pipeline.Next(&created)) {
+                   results.push_back(created);
+                 },
+                 std::runtime_error);
+    ASSERT_EQ(results.size(), 149);
+    for (std::size_t i = 0; i < results.size(); i++) {
+      ASSERT_EQ(results[i], i < 100 ? i : i + 1);
+    }
+  }
+
+  // A file cut off part-way through a packet is reported after the
+  // keys before it.  The last key, which the bad packet follows, is
+  // never complete.
+  {
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, "\x98\x40", 2), 2);
+    close(fd);
+  }
+  {
+    KeyringPipeline<int64_t> pipeline(
+        path, [](const TransferableKey& key) -> int64_t {
+          return key.primary_key->creation_time();
+        }, options);
+    int64_t created;
+    std::vector<int64_t> results;
+    ASSERT_THROW(while (pipeline.Next(&created)) {
+                   results.push_back(created);
+                 },
+                 format_error);
+    ASSERT_EQ(results.size(), kKeys - 2);
+    for (std::size_t i = 0; i < results.size(); i++) {
+      ASSERT_EQ(results[i], i < 100 ? i : i + 1);
+    }
+  }
+  std::remove(path.c_str());
+  rmdir(directory.c_str());
+}
+
+#endif  // INCLUDE_TESTS
+
+}
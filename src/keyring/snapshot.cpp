@@ -0,0 +1,313 @@
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#include "packets/registry.h"
+#include "writer.h"
+#endif
+
+#include "exceptions.h"
+#include "parser.h"
+#include "keyring/snapshot.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+// How often the publisher looks for replaced snapshots that readers
+// have finished with.
+const std::chrono::seconds kReapInterval(1);
+
+}
+
+/// @endcond
+
+KeyringSnapshot::KeyringSnapshot()
+    : generation_(0),
+      key_index_(std::list<std::shared_ptr<PGPPacket>>()) {}
+
+KeyringSnapshot::KeyringSnapshot(
+    const std::list<std::shared_ptr<PGPPacket>>& packets,
+    uint64_t generation)
+    : generation_(generation), key_index_(packets) {
+  std::list<std::shared_ptr<TransferableKey>> keys =
+      group_transferable_keys(packets);
+  keys_.reserve(keys.size());
+  for (auto i = keys.begin(); i != keys.end(); i++) {
+    user_ids_.Add(**i);
+    keys_.push_back(std::move(*i));
+  }
+}
+
+uint64_t KeyringSnapshot::generation() const {
+  return generation_;
+}
+
+const std::vector<std::shared_ptr<const TransferableKey>>&
+KeyringSnapshot::keys() const {
+  return keys_;
+}
+
+const KeyIndex& KeyringSnapshot::key_index() const {
+  return key_index_;
+}
+
+const UserIDIndex& KeyringSnapshot::user_ids() const {
+  return user_ids_;
+}
+
+SnapshotPublisher::SnapshotPublisher(const ParseLimits& limits)
+    : limits_(limits), current_(std::make_shared<const KeyringSnapshot>()),
+      has_pending_(false), building_(false), stopping_(false) {
+  thread_ = std::thread(&SnapshotPublisher::Run, this);
+}
+
+SnapshotPublisher::~SnapshotPublisher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+std::shared_ptr<const KeyringSnapshot> SnapshotPublisher::Current() const {
+  return std::atomic_load(&current_);
+}
+
+void SnapshotPublisher::Refresh(ustring keyring) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.swap(keyring);
+    has_pending_ = true;
+  }
+  wake_.notify_all();
+  // The replaced refresh, if any, is freed here rather than under the
+  // lock.
+}
+
+ParseError SnapshotPublisher::Flush(std::string* message) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return !has_pending_ && !building_; });
+  if (nullptr != message) {
+    *message = last_message_;
+  }
+  return last_error_;
+}
+
+void SnapshotPublisher::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (!has_pending_) {
+      if (retired_.empty()) {
+        wake_.wait(lock);
+      }
+      else {
+        wake_.wait_for(lock, kReapInterval);
+      }
+    }
+    if (stopping_) {
+      break;
+    }
+    if (!has_pending_) {
+      lock.unlock();
+      Reap();
+      lock.lock();
+      continue;
+    }
+
+    ustring keyring;
+    keyring.swap(pending_);
+    has_pending_ = false;
+    building_ = true;
+    lock.unlock();
+
+    Build(keyring);
+    Reap();
+
+    lock.lock();
+    building_ = false;
+    if (!has_pending_) {
+      idle_.notify_all();
+    }
+  }
+}
+
+void SnapshotPublisher::Build(const ustring& keyring) {
+  // Nothing may escape this thread, so a failure of any kind leaves
+  // the previous snapshot in place and is reported by Flush().
+  ParseError error;
+  std::string message;
+  try {
+    ParseResult<std::list<std::shared_ptr<PGPPacket>>> packets =
+        try_parse(keyring, limits_);
+    if (!packets.ok()) {
+      // Keep the status as it is, detail and all, but describe it as
+      // the throwing interface would.
+      error = packets.error;
+      ThrowParseError(error);
+    }
+    else {
+      // Only this thread publishes, so the generation cannot change
+      // between reading and replacing the snapshot.
+      std::shared_ptr<const KeyringSnapshot> next =
+          std::make_shared<const KeyringSnapshot>(
+              packets.value, Current()->generation() + 1);
+      std::shared_ptr<const KeyringSnapshot> previous =
+          std::atomic_exchange(&current_, next);
+      retired_.push_back(std::move(previous));
+    }
+  }
+  catch (const parse4880_error& e) {
+    if (error.ok()) {
+      error = ParseErrorFor(e);
+    }
+    message = error_message(e);
+  }
+  catch (const std::bad_alloc& e) {
+    error = ParseError(kParseMemoryBudgetExceeded, 0, "out of memory");
+    message = e.what();
+  }
+  catch (const std::exception& e) {
+    error = ParseError(kParseInvalidPacket, 0, "keyring could not be indexed");
+    message = e.what();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  last_error_ = error;
+  last_message_.swap(message);
+}
+
+void SnapshotPublisher::Reap() {
+  // A retired snapshot can no longer be taken by a reader, so once the
+  // publisher holds the only reference it is safe to free.
+  for (auto i = retired_.begin(); i != retired_.end();) {
+    if (1 == i->use_count()) {
+      i = retired_.erase(i);
+    }
+    else {
+      i++;
+    }
+  }
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(KeyringSnapshot, Publisher) {
+  auto key = [](uint8_t n) {
+    return std::shared_ptr<PGPPacket>(new PublicKeyPacket(
+        ustring((const uint8_t*)"\x04\0\0\0\0\x01", 6)
+        + ustring{0, 8, n, 0, 8, 3}));
+  };
+  std::shared_ptr<PGPPacket> uid(new UserIDPacket(
+      ustring((const uint8_t*)"A <a@example.org>", 17)));
+  auto write = [](std::initializer_list<std::shared_ptr<PGPPacket>> packets) {
+    PacketWriter writer;
+    for (auto i = packets.begin(); i != packets.end(); i++) {
+      writer.Append(*i);
+    }
+    ustring data;
+    for (auto i = writer.segments().begin(); i != writer.segments().end();
+         i++) {
+      data.append(i->data, i->length);
+    }
+    return data;
+  };
+
+  SnapshotPublisher publisher;
+  std::shared_ptr<const KeyringSnapshot> empty = publisher.Current();
+  ASSERT_EQ(empty->generation(), 0);
+  ASSERT_TRUE(empty->keys().empty());
+
+  publisher.Refresh(write({key(1), uid}));
+  ASSERT_TRUE(publisher.Flush().ok());
+  std::shared_ptr<const KeyringSnapshot> first = publisher.Current();
+  ASSERT_EQ(first->generation(), 1);
+  ASSERT_EQ(first->keys().size(), 1);
+  ASSERT_EQ(first->user_ids().FindByEmail("A@example.org").size(), 1);
+  // Readers of the old snapshot are unaffected.
+  ASSERT_TRUE(empty->keys().empty());
+
+  // A malformed keyring leaves the snapshot in place.
+  publisher.Refresh(ustring{0xFF});
+  ASSERT_EQ(publisher.Flush().status, kParseHeaderTooShort);
+  ASSERT_EQ(publisher.Current(), first);
+
+  std::weak_ptr<const KeyringSnapshot> released = first;
+  first.reset();
+  publisher.Refresh(write({key(1), uid, key(2)}));
+  ASSERT_TRUE(publisher.Flush().ok());
+  ASSERT_EQ(publisher.Current()->generation(), 2);
+  ASSERT_EQ(publisher.Current()->keys().size(), 2);
+  // Freed by the publisher once the last reader let go.
+  ASSERT_TRUE(released.expired());
+  ASSERT_EQ(empty.use_count(), 2);
+
+  // Exceptions from building a snapshot are reported, not fatal.
+  std::shared_ptr<const KeyringSnapshot> second = publisher.Current();
+  const ustring private_packet{0xFC, 1, 0};
+  PacketFactory previous = register_packet_type(
+      60, [](uint8_t, const ustring&, const ParseLimits&, ParseError*)
+              -> std::shared_ptr<PGPPacket> { throw std::bad_alloc(); });
+  publisher.Refresh(private_packet);
+  ParseError error = publisher.Flush();
+  ASSERT_EQ(error.status, kParseMemoryBudgetExceeded);
+  register_packet_type(
+      60, [](uint8_t, const ustring&, const ParseLimits&, ParseError*)
+              -> std::shared_ptr<PGPPacket> {
+        throw invalid_packet_error("test");
+      });
+  publisher.Refresh(private_packet);
+  ASSERT_EQ(publisher.Flush().status, kParseInvalidPacket);
+  // Each exception keeps its own status and message.
+  register_packet_type(
+      60, [](uint8_t, const ustring&, const ParseLimits&, ParseError*)
+              -> std::shared_ptr<PGPPacket> {
+        throw unsupported_feature_error(7, "test feature");
+      });
+  publisher.Refresh(private_packet);
+  std::string message;
+  error = publisher.Flush(&message);
+  ASSERT_EQ(error.status, kParseUnsupportedFeature);
+  ASSERT_EQ(error.position, 7);
+  ASSERT_NE(message.find("test feature not supported"), std::string::npos);
+  register_packet_type(
+      60, [](uint8_t, const ustring&, const ParseLimits&, ParseError*)
+              -> std::shared_ptr<PGPPacket> {
+        throw limit_error(3, "test limit");
+      });
+  publisher.Refresh(private_packet);
+  ASSERT_EQ(publisher.Flush(&message).status, kParseLimitExceeded);
+  ASSERT_NE(message.find("test limit exceeded"), std::string::npos);
+  register_packet_type(
+      60, [](uint8_t, const ustring&, const ParseLimits&, ParseError*)
+              -> std::shared_ptr<PGPPacket> {
+        throw std::out_of_range("test range");
+      });
+  publisher.Refresh(private_packet);
+  ASSERT_EQ(publisher.Flush(&message).status, kParseInvalidPacket);
+  ASSERT_EQ(message, "test range");
+  register_packet_type(60, previous);
+  ASSERT_EQ(publisher.Current(), second);
+
+  publisher.Refresh(private_packet);
+  ASSERT_TRUE(publisher.Flush(&message).ok());
+  ASSERT_TRUE(message.empty());
+  ASSERT_EQ(publisher.Current()->generation(), 3);
+}
+
+#endif
+
+}
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "constants.h"
+#include "keyring/transferable_key.h"
+#include "keyring/timeline.h"
+
+namespace parse4880 {
+
+namespace {
+
+const int64_t kNever = std::numeric_limits<int64_t>::max();
+
+/**
+ * Find the signatures in a list that were issued by a given key.
+ *
+ * @param signatures  The signatures to search.
+ * @param issuer      The long key ID of the issuer.
+ * @param callback    Called for each signature that was issued by the
+ *                    key and has a creation time.
+ */
+void ForEachSelfSignature(
+    const std::list<std::shared_ptr<PGPPacket>>& signatures,
+    const ustring& issuer,
+    std::function<void(const SignaturePacket&)> callback) {
+  for (auto i = signatures.begin(); i != signatures.end(); i++) {
+    const SignaturePacket* signature =
+        dynamic_cast<const SignaturePacket*>(i->get());
+    if (nullptr == signature || signature->creation_time() < 0) {
+      continue;
+    }
+    // An absent issuer is taken to be the key itself.
+    if (!signature->key_id().empty() && signature->key_id() != issuer) {
+      continue;
+    }
+    callback(*signature);
+  }
+}
+
+}  // namespace
+
+KeyTimeline::KeyTimeline(const TransferableKey& key)
+    : issuer_(key.primary_key->fingerprint().substr(12)),
+      key_created_(key.primary_key->creation_time()),
+      revoked_at_(kNever) {
+  ForEachSelfSignature(
+      key.signatures, issuer_, [this](const SignaturePacket& signature) {
+        if (kSignatureRevocationKey == signature.signature_type()) {
+          revoked_at_ = std::min(revoked_at_, signature.creation_time());
+        }
+        else if (kSignatureKey == signature.signature_type()) {
+          AddBinding(signature, kNever);
+        }
+      });
+
+  for (auto uid = key.user_ids.begin(); uid != key.user_ids.end(); uid++) {
+    // A certification revocation withdraws the certifications made
+    // before it, though the user ID may be certified again afterwards.
+    std::vector<int64_t> uid_revocations;
+    ForEachSelfSignature(
+        uid->signatures, issuer_,
+        [&uid_revocations](const SignaturePacket& signature) {
+          if (kSignatureRevocationCertification
+              == signature.signature_type()) {
+            uid_revocations.push_back(signature.creation_time());
+          }
+        });
+    std::sort(uid_revocations.begin(), uid_revocations.end());
+
+    ForEachSelfSignature(
+        uid->signatures, issuer_,
+        [this, &uid_revocations](const SignaturePacket& signature) {
+          uint8_t type = signature.signature_type();
+          if (kSignatureCertificationGeneric <= type
+              && type <= kSignatureCertificationPositive) {
+            auto revocation = std::lower_bound(uid_revocations.begin(),
+                                               uid_revocations.end(),
+                                               signature.creation_time());
+            AddBinding(signature, uid_revocations.end() == revocation
+                       ? kNever : *revocation);
+          }
+        });
+  }
+
+  Sort();
+}
+
+KeyTimeline::KeyTimeline(std::shared_ptr<const KeyTimeline> primary,
+                         const TransferableKey& key,
+                         const KeyComponent& subkey)
+    : primary_(primary),
+      issuer_(key.primary_key->fingerprint().substr(12)),
+      key_created_(kNever),
+      revoked_at_(kNever) {
+  const PublicKeyPacket* subkey_packet =
+      dynamic_cast<const PublicKeyPacket*>(subkey.packet.get());
+  if (nullptr != subkey_packet) {
+    key_created_ = subkey_packet->creation_time();
+  }
+
+  ForEachSelfSignature(
+      subkey.signatures, issuer_, [this](const SignaturePacket& signature) {
+        if (kSignatureRevocationSubkey == signature.signature_type()) {
+          revoked_at_ = std::min(revoked_at_, signature.creation_time());
+        }
+        else if (kSignatureSubkeyBinding == signature.signature_type()) {
+          AddBinding(signature, kNever);
+        }
+      });
+
+  Sort();
+}
+
+void KeyTimeline::AddBinding(const SignaturePacket& signature,
+                             int64_t withdrawn) {
+  KeyBinding binding;
+  binding.created = signature.creation_time();
+  binding.withdrawn = withdrawn;
+  if (0 != signature.signature_expiration_time()) {
+    binding.withdrawn = std::min(
+        binding.withdrawn,
+        binding.created + signature.signature_expiration_time());
+  }
+  binding.key_expires = (0 == signature.key_expiration_time())
+      ? kNever : key_created_ + signature.key_expiration_time();
+  bindings_.push_back(binding);
+}
+
+void KeyTimeline::Sort() {
+  std::stable_sort(bindings_.begin(), bindings_.end(),
+                   [](const KeyBinding& a, const KeyBinding& b) {
+                     return a.created < b.created;
+                   });
+}
+
+KeyValidity KeyTimeline::validity_at(int64_t time) const {
+  if (nullptr != primary_) {
+    KeyValidity primary_validity = primary_->validity_at(time);
+    if (kKeyValid != primary_validity) {
+      return primary_validity;
+    }
+  }
+
+  if (time < key_created_) {
+    return kKeyNotYetValid;
+  }
+  if (revoked_at_ <= time) {
+    return kKeyRevoked;
+  }
+
+  // Find the latest binding made by this time that is still in force.
+  auto end = std::upper_bound(bindings_.begin(), bindings_.end(), time,
+                              [](int64_t t, const KeyBinding& binding) {
+                                return t < binding.created;
+                              });
+  for (auto i = end; i != bindings_.begin(); ) {
+    --i;
+    if (time < i->withdrawn) {
+      return (time < i->key_expires) ? kKeyValid : kKeyExpired;
+    }
+  }
+  return kKeyUnbound;
+}
+
+const std::vector<KeyBinding>& KeyTimeline::bindings() const {
+  return bindings_;
+}
+
+int64_t KeyTimeline::revoked_at() const {
+  return revoked_at_;
+}
+
+#ifdef INCLUDE_TESTS
+
+namespace {
+
+/**
+ * Build a v4 signature with a creation time, key expiration time, and
+ * issuer.
+ */
+std::shared_ptr<PGPPacket> MakeSignature(uint8_t type, uint32_t created,
+                                         uint32_t key_expires,
+                                         const ustring& issuer) {
+  ustring hashed = ustring((const uint8_t*)"\x05\x02", 2)
+      + WriteInteger(created, 4);
+  if (0 != key_expires) {
+    hashed += ustring((const uint8_t*)"\x05\x09", 2)
+        + WriteInteger(key_expires, 4);
+  }
+
+  ustring data((const uint8_t*)"\x04", 1);
+  data += type;
+  data += ustring((const uint8_t*)"\x01\x08", 2);
+  data += WriteInteger(hashed.length(), 2) + hashed;
+  data += ustring((const uint8_t*)"\x00\x0A\x09\x10", 4) + issuer;
+  data += ustring((const uint8_t*)"\x00\x00\x00\x01\x01", 5);
+  return std::shared_ptr<PGPPacket>(new SignaturePacket(data));
+}
+
+}  // namespace
+
+TEST(KeyTimeline, ValidityAt) {
+  // A key created at time 100.
+  TransferableKey key;
+  key.primary_key.reset(new PublicKeyPacket(ustring((const uint8_t*)
+      "\x04\x00\x00\x00\x64\x01\x00\x01\x01\x00\x01\x01", 12)));
+  const ustring issuer = key.primary_key->fingerprint().substr(12);
+
+  // Certified at 200, recertified at 300 to expire at 500, and
+  // revoked at 1000.
+  KeyComponent uid;
+  uid.packet.reset(new UserIDPacket(ustring((const uint8_t*)"uid", 3)));
+  uid.signatures.push_back(MakeSignature(0x13, 300, 400, issuer));
+  uid.signatures.push_back(MakeSignature(0x13, 200, 0, issuer));
+  key.user_ids.push_back(uid);
+  key.signatures.push_back(MakeSignature(0x20, 1000, 0, issuer));
+
+  // A second user ID, certified at 120 and revoked at 180.
+  KeyComponent revoked_uid;
+  revoked_uid.packet.reset(
+      new UserIDPacket(ustring((const uint8_t*)"old", 3)));
+  revoked_uid.signatures.push_back(MakeSignature(0x13, 120, 0, issuer));
+  revoked_uid.signatures.push_back(MakeSignature(0x30, 180, 0, issuer));
+  key.user_ids.push_back(revoked_uid);
+
+  // Signatures from other keys are ignored.
+  ustring other_issuer = issuer;
+  other_issuer[0] ^= 1;
+  key.signatures.push_back(MakeSignature(0x20, 150, 0, other_issuer));
+
+  std::shared_ptr<KeyTimeline> timeline(new KeyTimeline(key));
+  ASSERT_EQ(timeline->bindings().size(), 3);
+  ASSERT_EQ(timeline->validity_at(50), kKeyNotYetValid);
+  ASSERT_EQ(timeline->validity_at(150), kKeyValid);
+  ASSERT_EQ(timeline->validity_at(190), kKeyUnbound);
+  ASSERT_EQ(timeline->validity_at(250), kKeyValid);
+  ASSERT_EQ(timeline->validity_at(450), kKeyValid);
+  ASSERT_EQ(timeline->validity_at(500), kKeyExpired);
+  ASSERT_EQ(timeline->validity_at(1000), kKeyRevoked);
+
+  // A subkey bound at 260 is only valid while its primary key is.
+  KeyComponent subkey;
+  subkey.packet.reset(new PublicSubkeyPacket(ustring((const uint8_t*)
+      "\x04\x00\x00\x00\xFA\x01\x00\x01\x01\x00\x01\x03", 12)));
+  subkey.signatures.push_back(MakeSignature(0x18, 260, 0, issuer));
+  KeyTimeline subkey_timeline(timeline, key, subkey);
+  ASSERT_EQ(subkey_timeline.validity_at(255), kKeyUnbound);
+  ASSERT_EQ(subkey_timeline.validity_at(270), kKeyValid);
+  ASSERT_EQ(subkey_timeline.validity_at(600), kKeyExpired);
+}
+
+#endif  // INCLUDE_TESTS
+
+}
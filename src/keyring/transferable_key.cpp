@@ -0,0 +1,118 @@
+#include <functional>
+#include <list>
+#include <memory>
+
+#include "parser_types.h"
+#include "packet.h"
+#include "writer.h"
+#include "keyring/transferable_key.h"
+
+namespace parse4880 {
+
+TransferableKeyGrouper::TransferableKeyGrouper(
+    std::function<bool(std::shared_ptr<TransferableKey>)> callback)
+    : callback_(callback), current_(nullptr), current_signatures_(nullptr),
+      skipping_(true) {}
+
+bool TransferableKeyGrouper::Add(std::shared_ptr<PGPPacket> packet) {
+  switch (packet->tag()) {
+    // A primary key finishes the previous key and starts a new one.
+    case 6: {
+      if (!Finish()) {
+        return false;
+      }
+      std::shared_ptr<PublicKeyPacket> primary_key =
+          std::dynamic_pointer_cast<PublicKeyPacket>(packet);
+      skipping_ = (nullptr == primary_key);
+      if (!skipping_) {
+        current_.reset(new TransferableKey);
+        current_->primary_key = primary_key;
+        current_signatures_ = &current_->signatures;
+      }
+      break;
+    }
+
+    // User IDs and user attributes.
+    case 13:
+    case 17:
+      if (!skipping_) {
+        current_->user_ids.push_back(KeyComponent());
+        current_->user_ids.back().packet = packet;
+        current_signatures_ = &current_->user_ids.back().signatures;
+      }
+      break;
+
+    // Subkeys.
+    case 14:
+      if (!skipping_) {
+        current_->subkeys.push_back(KeyComponent());
+        current_->subkeys.back().packet = packet;
+        current_signatures_ = &current_->subkeys.back().signatures;
+      }
+      break;
+
+    // Signatures apply to whatever came before them.
+    case 2:
+      if (!skipping_) {
+        current_signatures_->push_back(packet);
+      }
+      break;
+
+    // Trust packets and anything else are not part of a key.
+    default:
+      break;
+  }
+
+  return true;
+}
+
+bool TransferableKeyGrouper::Finish() {
+  if (nullptr == current_) {
+    return true;
+  }
+  std::shared_ptr<TransferableKey> finished = std::move(current_);
+  current_.reset();
+  current_signatures_ = nullptr;
+  skipping_ = true;
+  return callback_(finished);
+}
+
+std::list<std::shared_ptr<TransferableKey>> group_transferable_keys(
+    const std::list<std::shared_ptr<PGPPacket>>& packets) {
+  std::list<std::shared_ptr<TransferableKey>> keys;
+  TransferableKeyGrouper grouper(
+      [&keys](std::shared_ptr<TransferableKey> key) -> bool {
+        keys.push_back(std::move(key));
+        return true;
+      });
+  for (auto i = packets.begin(); i != packets.end(); i++) {
+    grouper.Add(*i);
+  }
+  grouper.Finish();
+  return keys;
+}
+
+namespace {
+
+void WriteComponents(const std::list<KeyComponent>& components,
+                     PacketWriter* writer) {
+  for (auto i = components.begin(); i != components.end(); i++) {
+    writer->Append(i->packet);
+    for (auto j = i->signatures.begin(); j != i->signatures.end(); j++) {
+      writer->Append(*j);
+    }
+  }
+}
+
+}  // namespace
+
+void WriteTransferableKey(const TransferableKey& key, PacketWriter* writer) {
+  writer->Append(key.primary_key);
+  for (auto i = key.signatures.begin(); i != key.signatures.end(); i++) {
+    writer->Append(*i);
+  }
+  WriteComponents(key.user_ids, writer);
+  WriteComponents(key.subkeys, writer);
+}
+
+}
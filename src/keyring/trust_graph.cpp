@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "packet.h"
+#include "constants.h"
+#include "exceptions.h"
+#include "keyring/transferable_key.h"
+#include "keyring/trust_graph.h"
+
+namespace parse4880 {
+
+namespace {
+
+/**
+ * Frontiers smaller than this are expanded without starting threads.
+ */
+const std::size_t kParallelFrontier = 1024;
+
+std::size_t WorkerCount(std::size_t threads) {
+  if (threads > 0) {
+    return threads;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool IsCertification(uint8_t type) {
+  return kSignatureCertificationGeneric == type
+      || kSignatureCertificationPersona == type
+      || kSignatureCertificationCasual == type
+      || kSignatureCertificationPositive == type;
+}
+
+/**
+ * Lay out a list of edges in compressed sparse row form.
+ *
+ * @param keys     The number of keys.
+ * @param edges    The edges, as (source, target) pairs.  These are
+ *                 sorted and duplicates removed.
+ * @param offsets  Set to the offset of the first edge of each key,
+ *                 followed by the total number of edges.
+ * @param targets  Set to the target of each edge.
+ */
+void BuildRows(std::size_t keys,
+               std::vector<std::pair<uint32_t, uint32_t>>* edges,
+               std::vector<std::size_t>* offsets,
+               std::vector<uint32_t>* targets) {
+  std::sort(edges->begin(), edges->end());
+  edges->erase(std::unique(edges->begin(), edges->end()), edges->end());
+
+  offsets->assign(keys + 1, 0);
+  targets->clear();
+  targets->reserve(edges->size());
+  for (auto i = edges->begin(); i != edges->end(); i++) {
+    (*offsets)[i->first + 1]++;
+    targets->push_back(i->second);
+  }
+  for (std::size_t i = 0; i < keys; i++) {
+    (*offsets)[i + 1] += (*offsets)[i];
+  }
+}
+
+}  // namespace
+
+const uint32_t TrustGraph::kUnreachable;
+
+TrustGraph::TrustGraph()
+    : forward_offsets_(1, 0), reverse_offsets_(1, 0) {
+}
+
+std::size_t TrustGraph::size() const {
+  return fingerprints_.size();
+}
+
+std::size_t TrustGraph::edge_count() const {
+  return forward_targets_.size();
+}
+
+bool TrustGraph::Find(const ustring& fingerprint, uint32_t* index) const {
+  auto i = index_.find(fingerprint);
+  if (index_.end() == i) {
+    return false;
+  }
+  *index = i->second;
+  return true;
+}
+
+const ustring& TrustGraph::fingerprint(uint32_t index) const {
+  return fingerprints_.at(index);
+}
+
+TrustGraph::Range TrustGraph::certified_by(uint32_t index) const {
+  Range range = {forward_targets_.data() + forward_offsets_.at(index),
+                 forward_targets_.data() + forward_offsets_.at(index + 1)};
+  return range;
+}
+
+TrustGraph::Range TrustGraph::certifiers_of(uint32_t index) const {
+  Range range = {reverse_targets_.data() + reverse_offsets_.at(index),
+                 reverse_targets_.data() + reverse_offsets_.at(index + 1)};
+  return range;
+}
+
+std::vector<uint32_t> TrustGraph::TrustDepths(
+    const std::vector<uint32_t>& roots, uint32_t max_depth,
+    std::size_t threads) const {
+  std::unique_ptr<std::atomic<uint32_t>[]> depths(
+      new std::atomic<uint32_t>[size()]);
+  for (std::size_t i = 0; i < size(); i++) {
+    depths[i].store(kUnreachable, std::memory_order_relaxed);
+  }
+
+  std::vector<uint32_t> frontier;
+  for (auto i = roots.begin(); i != roots.end(); i++) {
+    if (*i >= size()) {
+      throw std::out_of_range("Trust root is not in the graph");
+    }
+    if (kUnreachable == depths[*i].exchange(0, std::memory_order_relaxed)) {
+      frontier.push_back(*i);
+    }
+  }
+
+  const std::size_t worker_count = WorkerCount(threads);
+
+  // Expand part of the frontier, claiming each newly-reached key for
+  // the next level so that it is added to the next frontier only once.
+  auto expand = [this, &depths, &frontier](
+      std::size_t begin, std::size_t end, uint32_t depth,
+      std::vector<uint32_t>* next) {
+    for (std::size_t i = begin; i < end; i++) {
+      Range edges = certified_by(frontier[i]);
+      for (const uint32_t* target = edges.begin; target != edges.end;
+           target++) {
+        uint32_t expected = kUnreachable;
+        if (depths[*target].load(std::memory_order_relaxed) == kUnreachable
+            && depths[*target].compare_exchange_strong(
+                expected, depth, std::memory_order_relaxed)) {
+          next->push_back(*target);
+        }
+      }
+    }
+  };
+
+  for (uint32_t depth = 1; depth <= max_depth && !frontier.empty();
+       depth++) {
+    std::vector<uint32_t> next;
+    if (worker_count < 2 || frontier.size() < kParallelFrontier) {
+      expand(0, frontier.size(), depth, &next);
+    }
+    else {
+      std::vector<std::vector<uint32_t>> partial(worker_count);
+      std::vector<std::thread> workers;
+      const std::size_t share =
+          (frontier.size() + worker_count - 1) / worker_count;
+      for (std::size_t w = 0; w < worker_count; w++) {
+        const std::size_t begin = std::min(frontier.size(), w * share);
+        const std::size_t end = std::min(frontier.size(), begin + share);
+        workers.push_back(
+            std::thread(expand, begin, end, depth, &partial[w]));
+      }
+      for (auto w = workers.begin(); w != workers.end(); w++) {
+        w->join();
+      }
+      for (auto p = partial.begin(); p != partial.end(); p++) {
+        next.insert(next.end(), p->begin(), p->end());
+      }
+    }
+    frontier.swap(next);
+  }
+
+  std::vector<uint32_t> result(size());
+  for (std::size_t i = 0; i < size(); i++) {
+    result[i] = depths[i].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+std::vector<uint32_t> TrustGraph::FindPath(uint32_t from, uint32_t to,
+                                           uint32_t max_depth) const {
+  if (from >= size() || to >= size()) {
+    throw std::out_of_range("Key is not in the graph");
+  }
+
+  // Breadth-first search, remembering how each key was reached and
+  // stopping as soon as the target is found.
+  std::vector<uint32_t> parent(size(), kUnreachable);
+  std::vector<uint32_t> frontier(1, from);
+  parent[from] = from;
+  for (uint32_t depth = 0;
+       kUnreachable == parent[to] && depth < max_depth && !frontier.empty();
+       depth++) {
+    std::vector<uint32_t> next;
+    for (auto i = frontier.begin(); i != frontier.end(); i++) {
+      Range edges = certified_by(*i);
+      for (const uint32_t* target = edges.begin; target != edges.end;
+           target++) {
+        if (kUnreachable == parent[*target]) {
+          parent[*target] = *i;
+          next.push_back(*target);
+        }
+      }
+    }
+    frontier.swap(next);
+  }
+
+  std::vector<uint32_t> path;
+  if (kUnreachable == parent[to]) {
+    return path;
+  }
+  for (uint32_t key = to; key != from; key = parent[key]) {
+    path.push_back(key);
+  }
+  path.push_back(from);
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+TrustGraphBuilder::TrustGraphBuilder() {
+}
+
+void TrustGraphBuilder::Add(const TransferableKey& key) {
+  const uint32_t index = keys_.size();
+  const ustring key_id = key.primary_key->fingerprint().substr(12);
+  keys_.push_back(key.primary_key);
+  key_ids_.insert(std::make_pair(key_id, index));
+
+  for (auto uid = key.user_ids.begin(); uid != key.user_ids.end(); uid++) {
+    std::shared_ptr<UserIDPacket> uid_packet =
+        std::dynamic_pointer_cast<UserIDPacket>(uid->packet);
+    if (!uid_packet) {
+      continue;
+    }
+    for (auto i = uid->signatures.begin(); i != uid->signatures.end(); i++) {
+      std::shared_ptr<SignaturePacket> signature =
+          std::dynamic_pointer_cast<SignaturePacket>(*i);
+      if (!signature || !IsCertification(signature->signature_type())
+          || signature->key_id().empty() || signature->key_id() == key_id) {
+        continue;
+      }
+      Certification certification = {index, signature->key_id().str(),
+                                      uid_packet, signature};
+      certifications_.push_back(certification);
+    }
+  }
+}
+
+TrustGraph TrustGraphBuilder::Build(Verifier verifier, std::size_t threads) {
+  TrustGraph graph;
+  graph.fingerprints_.reserve(keys_.size());
+  for (std::size_t i = 0; i < keys_.size(); i++) {
+    graph.fingerprints_.push_back(keys_[i]->fingerprint());
+    graph.index_.insert(std::make_pair(graph.fingerprints_.back(), i));
+  }
+
+  // Resolve the certifying key of each certification, checking each
+  // candidate in turn in case of a key ID collision.  The checks are
+  // shared between threads, since they usually dominate.
+  const uint32_t kNoIssuer = TrustGraph::kUnreachable;
+  std::vector<uint32_t> issuers(certifications_.size(), kNoIssuer);
+  std::atomic<std::size_t> next(0);
+  std::exception_ptr error;
+  std::atomic<bool> failed(false);
+  auto worker = [this, &verifier, &issuers, &next, &error, &failed]() {
+    try {
+      for (std::size_t i = next++; i < certifications_.size() && !failed;
+           i = next++) {
+        const Certification& certification = certifications_[i];
+        auto candidates = key_ids_.equal_range(certification.issuer);
+        for (auto c = candidates.first; c != candidates.second; c++) {
+          if (!verifier
+              || verifier(*keys_[certification.target], *certification.uid,
+                          *keys_[c->second], *certification.signature)) {
+            issuers[i] = c->second;
+            break;
+          }
+        }
+      }
+    }
+    catch (...) {
+      if (!failed.exchange(true)) {
+        error = std::current_exception();
+      }
+    }
+  };
+
+  const std::size_t worker_count =
+      verifier ? std::min(WorkerCount(threads), certifications_.size()) : 1;
+  if (worker_count < 2) {
+    worker();
+  }
+  else {
+    std::vector<std::thread> workers;
+    for (std::size_t w = 0; w < worker_count; w++) {
+      workers.push_back(std::thread(worker));
+    }
+    for (auto w = workers.begin(); w != workers.end(); w++) {
+      w->join();
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> forward;
+  std::vector<std::pair<uint32_t, uint32_t>> reverse;
+  for (std::size_t i = 0; i < certifications_.size(); i++) {
+    if (kNoIssuer != issuers[i]) {
+      forward.push_back(
+          std::make_pair(issuers[i], certifications_[i].target));
+      reverse.push_back(
+          std::make_pair(certifications_[i].target, issuers[i]));
+    }
+  }
+  BuildRows(keys_.size(), &forward,
+            &graph.forward_offsets_, &graph.forward_targets_);
+  BuildRows(keys_.size(), &reverse,
+            &graph.reverse_offsets_, &graph.reverse_targets_);
+  return graph;
+}
+
+#ifdef INCLUDE_TESTS
+
+namespace {
+
+std::shared_ptr<PublicKeyPacket> MakeKey(uint8_t n) {
+  ustring data((const uint8_t*)
+      "\x04\x00\x00\x00\x64\x01\x00\x01\x01\x00\x01\x01", 12);
+  data[11] = n;
+  return std::shared_ptr<PublicKeyPacket>(new PublicKeyPacket(data));
+}
+
+std::shared_ptr<PGPPacket> MakeCertification(const ustring& issuer) {
+  ustring data((const uint8_t*)"\x04\x10\x01\x08\x00\x00\x00\x0A\x09\x10",
+               10);
+  data += issuer;
+  data += ustring((const uint8_t*)"\x00\x00\x00\x01\x01", 5);
+  return std::shared_ptr<PGPPacket>(new SignaturePacket(data));
+}
+
+}  // namespace
+
+TEST(TrustGraph, Paths) {
+  // A chain 0 -> 1 -> 2 -> 3, a shortcut 0 -> 2, and a key 4 that is
+  // certified only by itself and by a key that is not in the keyring.
+  const std::size_t kKeys = 5;
+  std::vector<TransferableKey> keys(kKeys);
+  std::vector<ustring> key_ids;
+  for (std::size_t i = 0; i < kKeys; i++) {
+    keys[i].primary_key = MakeKey(i + 1);
+    key_ids.push_back(keys[i].primary_key->fingerprint().substr(12));
+    KeyComponent uid;
+    uid.packet.reset(new UserIDPacket(ustring((const uint8_t*)"uid", 3)));
+    uid.signatures.push_back(MakeCertification(key_ids[i]));
+    keys[i].user_ids.push_back(uid);
+  }
+  keys[1].user_ids.front().signatures.push_back(
+      MakeCertification(key_ids[0]));
+  keys[2].user_ids.front().signatures.push_back(
+      MakeCertification(key_ids[1]));
+  keys[2].user_ids.front().signatures.push_back(
+      MakeCertification(key_ids[0]));
+  keys[3].user_ids.front().signatures.push_back(
+      MakeCertification(key_ids[2]));
+  ustring stranger = key_ids[4];
+  stranger[0] ^= 1;
+  keys[4].user_ids.front().signatures.push_back(
+      MakeCertification(stranger));
+
+  TrustGraphBuilder builder;
+  for (auto i = keys.begin(); i != keys.end(); i++) {
+    builder.Add(*i);
+  }
+  TrustGraph graph = builder.Build();
+  ASSERT_EQ(graph.size(), kKeys);
+  ASSERT_EQ(graph.edge_count(), 4);
+  uint32_t index;
+  ASSERT_TRUE(graph.Find(keys[3].primary_key->fingerprint(), &index));
+  ASSERT_EQ(index, 3);
+  ASSERT_EQ(graph.certifiers_of(2).end - graph.certifiers_of(2).begin, 2);
+
+  std::vector<uint32_t> depths =
+      graph.TrustDepths(std::vector<uint32_t>(1, 0), 10, 4);
+  ASSERT_EQ(depths[0], 0);
+  ASSERT_EQ(depths[1], 1);
+  ASSERT_EQ(depths[2], 1);
+  ASSERT_EQ(depths[3], 2);
+  ASSERT_EQ(depths[4], TrustGraph::kUnreachable);
+  depths = graph.TrustDepths(std::vector<uint32_t>(1, 0), 1);
+  ASSERT_EQ(depths[3], TrustGraph::kUnreachable);
+
+  std::vector<uint32_t> path = graph.FindPath(0, 3, 2);
+  ASSERT_EQ(path.size(), 3);
+  ASSERT_EQ(path[1], 2);
+  ASSERT_TRUE(graph.FindPath(0, 3, 1).empty());
+  ASSERT_TRUE(graph.FindPath(3, 0, 10).empty());
+
+  // Certifications rejected by the verifier are left out.
+  TrustGraph verified = builder.Build(
+      [](const PublicKeyPacket&, const UserIDPacket&,
+         const PublicKeyPacket& certifier, const SignaturePacket&) {
+        return certifier.fingerprint() != MakeKey(1)->fingerprint();
+      }, 2);
+  ASSERT_EQ(verified.edge_count(), 2);
+}
+
+#endif  // INCLUDE_TESTS
+
+}
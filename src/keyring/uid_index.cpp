@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "exceptions.h"
+#include "keyring/transferable_key.h"
+#include "keyring/uid_index.h"
+
+namespace parse4880 {
+
+namespace {
+
+const char kIndexMagic[] = "P4880UI1";
+
+char LowerCase(char c) {
+  return ('A' <= c && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+std::string LowerCase(const char* text, std::size_t length) {
+  std::string result(text, length);
+  std::transform(result.begin(), result.end(), result.begin(),
+                 static_cast<char(*)(char)>(LowerCase));
+  return result;
+}
+
+uint32_t Trigram(const char* text) {
+  return (static_cast<uint32_t>(static_cast<uint8_t>(text[0])) << 16)
+      | (static_cast<uint32_t>(static_cast<uint8_t>(text[1])) << 8)
+      | static_cast<uint32_t>(static_cast<uint8_t>(text[2]));
+}
+
+void WriteNumber(std::ofstream* file, uint64_t value, uint8_t length) {
+  const ustring encoded = WriteInteger(value, length);
+  file->write(reinterpret_cast<const char*>(encoded.data()), length);
+}
+
+uint64_t ReadNumber(std::ifstream* file, uint8_t length,
+                    const std::string& path) {
+  uint8_t encoded[8];
+  if (!file->read(reinterpret_cast<char*>(encoded), length)) {
+    throw index_error(path);
+  }
+  return ReadInteger(ustring(encoded, length));
+}
+
+}  // namespace
+
+UserIDIndex::UserIDIndex() {
+}
+
+UserIDIndex::UserIDIndex(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw read_error(path, errno);
+  }
+
+  // Lengths read from the file are checked against what is left of it
+  // before anything is allocated for them.
+  file.seekg(0, std::ios::end);
+  const uint64_t file_size = file.tellg();
+  file.seekg(0, std::ios::beg);
+  auto remaining = [&file, file_size]() -> uint64_t {
+    return file_size - static_cast<uint64_t>(file.tellg());
+  };
+
+  char magic[8];
+  if (!file.read(magic, sizeof(magic))
+      || 0 != memcmp(magic, kIndexMagic, sizeof(magic))) {
+    throw index_error(path);
+  }
+
+  const uint64_t key_count = ReadNumber(&file, 8, path);
+  const uint64_t entry_count = ReadNumber(&file, 8, path);
+  // Each key takes at least one octet, and each user ID eight.
+  if (key_count > UINT32_MAX || entry_count > UINT32_MAX
+      || key_count > remaining() || entry_count > remaining() / 8) {
+    throw index_error(path);
+  }
+
+  for (uint64_t i = 0; i < key_count; i++) {
+    ustring fingerprint(ReadNumber(&file, 1, path), 0);
+    if (!file.read(reinterpret_cast<char*>(&fingerprint[0]),
+                   fingerprint.length())) {
+      throw index_error(path);
+    }
+    key_numbers_[fingerprint] = keys_.size();
+    keys_.push_back(fingerprint);
+  }
+
+  entries_.reserve(entry_count);
+  for (uint64_t i = 0; i < entry_count; i++) {
+    Entry entry;
+    entry.key = ReadNumber(&file, 4, path);
+    entry.length = ReadNumber(&file, 4, path);
+    entry.offset = user_ids_.length();
+    if (entry.key >= keys_.size() || entry.length > remaining()) {
+      throw index_error(path);
+    }
+
+    user_ids_.resize(entry.offset + entry.length);
+    if (!file.read(&user_ids_[entry.offset], entry.length)) {
+      throw index_error(path);
+    }
+    entries_.push_back(entry);
+    Index(entries_.size() - 1);
+  }
+}
+
+void UserIDIndex::Add(const TransferableKey& key) {
+  const ustring& fingerprint = key.primary_key->fingerprint();
+  for (auto i = key.user_ids.begin(); i != key.user_ids.end(); i++) {
+    // User attributes are grouped with the user IDs but are not text.
+    if (13 != i->packet->tag()) {
+      continue;
+    }
+    const ustring& contents = i->packet->contents();
+    Add(fingerprint, std::string(contents.begin(), contents.end()));
+  }
+}
+
+void UserIDIndex::Add(const ustring& fingerprint,
+                      const std::string& user_id) {
+  auto key = key_numbers_.find(fingerprint);
+  if (key_numbers_.end() == key) {
+    key = key_numbers_.insert(std::make_pair(fingerprint,
+                                             keys_.size())).first;
+    keys_.push_back(fingerprint);
+  }
+
+  Entry entry;
+  entry.key = key->second;
+  entry.offset = user_ids_.length();
+  entry.length = user_id.length();
+  user_ids_ += user_id;
+  entries_.push_back(entry);
+  Index(entries_.size() - 1);
+}
+
+void UserIDIndex::Index(uint32_t entry_number) {
+  const Entry& entry = entries_[entry_number];
+  const std::string user_id(user_ids_, entry.offset, entry.length);
+
+  const std::string email = NormalizeEmail(user_id);
+  if (!email.empty()) {
+    emails_[email].push_back(entry_number);
+  }
+
+  // Entries are numbered in order, so each posting list stays sorted
+  // and a repeated trigram need only be compared with the last entry.
+  const std::string lower_case = LowerCase(user_id.data(), user_id.length());
+  for (std::size_t i = 0; i + 3 <= lower_case.length(); i++) {
+    std::vector<uint32_t>& postings = trigrams_[Trigram(&lower_case[i])];
+    if (postings.empty() || postings.back() != entry_number) {
+      postings.push_back(entry_number);
+    }
+  }
+}
+
+std::string UserIDIndex::LowerCaseUserID(const Entry& entry) const {
+  return LowerCase(user_ids_.data() + entry.offset, entry.length);
+}
+
+UserIDMatch UserIDIndex::Match(uint32_t entry_number) const {
+  const Entry& entry = entries_[entry_number];
+  UserIDMatch match;
+  match.fingerprint = keys_[entry.key];
+  match.user_id = user_ids_.substr(entry.offset, entry.length);
+  return match;
+}
+
+std::vector<UserIDMatch> UserIDIndex::FindByEmail(
+    const std::string& email) const {
+  std::vector<UserIDMatch> matches;
+  auto found = emails_.find(NormalizeEmail("<" + email + ">"));
+  if (emails_.end() != found) {
+    for (auto i = found->second.begin(); i != found->second.end(); i++) {
+      matches.push_back(Match(*i));
+    }
+  }
+  return matches;
+}
+
+std::vector<UserIDMatch> UserIDIndex::FindSubstring(
+    const std::string& text) const {
+  const std::string query = LowerCase(text.data(), text.length());
+  std::vector<UserIDMatch> matches;
+
+  // Queries too short to contain a trigram must examine every user ID.
+  if (query.length() < 3) {
+    for (uint32_t i = 0; i < entries_.size(); i++) {
+      if (std::string::npos != LowerCaseUserID(entries_[i]).find(query)) {
+        matches.push_back(Match(i));
+      }
+    }
+    return matches;
+  }
+
+  std::vector<const std::vector<uint32_t>*> posting_lists;
+  for (std::size_t i = 0; i + 3 <= query.length(); i++) {
+    auto postings = trigrams_.find(Trigram(&query[i]));
+    if (trigrams_.end() == postings) {
+      return matches;
+    }
+    posting_lists.push_back(&postings->second);
+  }
+
+  // Intersect the shortest lists first to keep the candidates few.
+  std::sort(posting_lists.begin(), posting_lists.end(),
+            [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+              return a->size() < b->size();
+            });
+  std::vector<uint32_t> candidates = *posting_lists.front();
+  for (std::size_t i = 1; i < posting_lists.size() && !candidates.empty();
+       i++) {
+    std::vector<uint32_t> remaining;
+    std::set_intersection(candidates.begin(), candidates.end(),
+                          posting_lists[i]->begin(), posting_lists[i]->end(),
+                          std::back_inserter(remaining));
+    candidates.swap(remaining);
+  }
+
+  // Having every trigram does not mean that they are in the right order.
+  for (auto i = candidates.begin(); i != candidates.end(); i++) {
+    if (std::string::npos != LowerCaseUserID(entries_[*i]).find(query)) {
+      matches.push_back(Match(*i));
+    }
+  }
+  return matches;
+}
+
+void UserIDIndex::Save(const std::string& path) const {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw write_error(errno);
+  }
+
+  file.write(kIndexMagic, 8);
+  WriteNumber(&file, keys_.size(), 8);
+  WriteNumber(&file, entries_.size(), 8);
+  for (auto i = keys_.begin(); i != keys_.end(); i++) {
+    WriteNumber(&file, i->length(), 1);
+    file.write(reinterpret_cast<const char*>(i->data()), i->length());
+  }
+  for (auto i = entries_.begin(); i != entries_.end(); i++) {
+    WriteNumber(&file, i->key, 4);
+    WriteNumber(&file, i->length, 4);
+    file.write(user_ids_.data() + i->offset, i->length);
+  }
+
+  file.flush();
+  if (!file) {
+    throw write_error(errno);
+  }
+}
+
+std::size_t UserIDIndex::size() const {
+  return entries_.size();
+}
+
+std::string UserIDIndex::NormalizeEmail(const std::string& user_id) {
+  std::size_t start = 0;
+  std::size_t end = user_id.length();
+
+  std::size_t close = user_id.rfind('>');
+  std::size_t open = (std::string::npos == close)
+      ? std::string::npos : user_id.rfind('<', close);
+  if (std::string::npos != open) {
+    start = open + 1;
+    end = close;
+  }
+  else if (std::string::npos == user_id.find('@')) {
+    return std::string();
+  }
+
+  while (start < end && isspace(static_cast<uint8_t>(user_id[start]))) {
+    start++;
+  }
+  while (end > start && isspace(static_cast<uint8_t>(user_id[end-1]))) {
+    end--;
+  }
+  return LowerCase(user_id.data() + start, end - start);
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(UserIDIndex, Lookup) {
+  const ustring first((const uint8_t*)"first", 5);
+  const ustring second((const uint8_t*)"second", 6);
+
+  UserIDIndex index;
+  index.Add(first, "Alice Example <Alice@Example.ORG>");
+  index.Add(first, "Alice (work) <alice@corp.example>");
+  index.Add(second, "bob@example.org");
+
+  ASSERT_EQ(UserIDIndex::NormalizeEmail("A <b@c> < D@E >"), "d@e");
+  ASSERT_EQ(UserIDIndex::NormalizeEmail("No address"), "");
+
+  std::vector<UserIDMatch> matches = index.FindByEmail("ALICE@example.org");
+  ASSERT_EQ(matches.size(), 1);
+  ASSERT_EQ(matches[0].fingerprint, first);
+
+  matches = index.FindSubstring("EXAMPLE.org");
+  ASSERT_EQ(matches.size(), 2);
+  ASSERT_EQ(matches[1].fingerprint, second);
+  ASSERT_EQ(index.FindSubstring("ecila").size(), 0);
+  ASSERT_EQ(index.FindSubstring("k)").size(), 1);
+
+  // The lookup tables are rebuilt when the index is loaded.
+  const std::string path = "uid_index_test.tmp";
+  index.Save(path);
+  UserIDIndex loaded(path);
+  std::remove(path.c_str());
+  ASSERT_EQ(loaded.size(), 3);
+  ASSERT_EQ(loaded.FindByEmail("bob@example.org").size(), 1);
+  ASSERT_EQ(loaded.FindSubstring("alice").size(), 2);
+
+  // Lengths beyond the end of the file are rejected without being
+  // allocated.
+  auto write_index = [&path](const std::string& contents) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.length());
+  };
+  const std::string header("P4880UI1\0\0\0\0\0\0\0\x01", 16);
+  write_index(header + std::string("\0\0\0\0\0\0\0\x01\x01x"
+                                   "\0\0\0\0\xFF\xFF\xFF\xFF", 18));
+  ASSERT_THROW(UserIDIndex index(path), index_error);
+  write_index(header + std::string("\0\0\0\0\xFF\xFF\xFF\xFF\x01x", 10));
+  ASSERT_THROW(UserIDIndex index(path), index_error);
+  std::remove(path.c_str());
+}
+
+#endif  // INCLUDE_TESTS
+
+}
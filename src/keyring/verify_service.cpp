@@ -0,0 +1,791 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef INCLUDE_TESTS
+#include <cstdio>
+#include <gtest/gtest.h>
+#endif
+
+#include "constants.h"
+#include "exceptions.h"
+#include "mapped_file.h"
+#include "parser.h"
+#include "keyring/verify_service.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+const std::size_t kRequestHeaderLength = 10;
+const std::size_t kResponseHeaderLength = 5;
+
+// The longest message that the client accepts in a response.
+const uint32_t kMaximumMessageLength = 64 * 1024;
+
+typedef std::chrono::steady_clock Clock;
+
+void WriteU32(uint8_t* out, uint32_t value) {
+  out[0] = value >> 24;
+  out[1] = value >> 16;
+  out[2] = value >> 8;
+  out[3] = value;
+}
+
+uint32_t ReadU32(const uint8_t* in) {
+  return (static_cast<uint32_t>(in[0]) << 24)
+       | (static_cast<uint32_t>(in[1]) << 16)
+       | (static_cast<uint32_t>(in[2]) << 8)
+       |  static_cast<uint32_t>(in[3]);
+}
+
+/**
+ * Wait until a descriptor is ready.
+ *
+ * @param wake_fd  A descriptor that becomes readable when the wait
+ *                 should be abandoned, or -1.
+ *
+ * @return false if the deadline passes or wake_fd becomes readable
+ *         first, or the wait fails.
+ */
+bool WaitFor(int fd, short events, Clock::time_point deadline,
+             int wake_fd = -1) {
+  while (true) {
+    int timeout = -1;
+    if (Clock::time_point::max() != deadline) {
+      const Clock::time_point now = Clock::now();
+      if (now >= deadline) {
+        return false;
+      }
+      timeout = std::min<int64_t>(
+          INT_MAX,
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              deadline - now).count() + 1);
+    }
+    struct pollfd poll_fds[2];
+    poll_fds[0].fd = fd;
+    poll_fds[0].events = events;
+    poll_fds[0].revents = 0;
+    poll_fds[1].fd = wake_fd;
+    poll_fds[1].events = POLLIN;
+    poll_fds[1].revents = 0;
+    int ready = poll(poll_fds, wake_fd < 0 ? 1 : 2, timeout);
+    if (ready > 0) {
+      return 0 == poll_fds[1].revents;
+    }
+    if (ready < 0 && EINTR != errno) {
+      return false;
+    }
+  }
+}
+
+bool WouldBlock(int error_number) {
+  return EINTR == error_number || EAGAIN == error_number
+      || EWOULDBLOCK == error_number;
+}
+
+bool SendAll(int socket, const void* data, std::size_t length,
+             Clock::time_point deadline = Clock::time_point::max(),
+             int wake_fd = -1) {
+  const uint8_t* position = static_cast<const uint8_t*>(data);
+  while (length > 0) {
+    if (!WaitFor(socket, POLLOUT, deadline, wake_fd)) {
+      return false;
+    }
+    ssize_t sent = send(socket, position, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0) {
+      if (WouldBlock(errno)) {
+        continue;
+      }
+      return false;
+    }
+    position += sent;
+    length -= sent;
+  }
+  return true;
+}
+
+bool ReceiveAll(int socket, void* data, std::size_t length,
+                Clock::time_point deadline = Clock::time_point::max(),
+                int wake_fd = -1) {
+  uint8_t* position = static_cast<uint8_t*>(data);
+  while (length > 0) {
+    if (!WaitFor(socket, POLLIN, deadline, wake_fd)) {
+      return false;
+    }
+    ssize_t received = recv(socket, position, length, MSG_DONTWAIT);
+    if (received < 0 && WouldBlock(errno)) {
+      continue;
+    }
+    if (received <= 0) {
+      return false;
+    }
+    position += received;
+    length -= received;
+  }
+  return true;
+}
+
+/**
+ * Receive the fixed part of a request and any descriptor sent with it.
+ *
+ * @return The number of octets received before the end of the
+ *         connection, which is kRequestHeaderLength on success.
+ */
+std::size_t ReceiveHeader(int socket, uint8_t* header, int* fd,
+                          Clock::time_point deadline, int wake_fd) {
+  *fd = -1;
+  union {
+    char buffer[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+
+  std::size_t received = 0;
+  while (received < kRequestHeaderLength) {
+    if (!WaitFor(socket, POLLIN, deadline, wake_fd)) {
+      break;
+    }
+    struct iovec io;
+    io.iov_base = header + received;
+    io.iov_len = kRequestHeaderLength - received;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t count = recvmsg(socket, &message,
+                            MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+    if (count < 0 && WouldBlock(errno)) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    received += count;
+
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(&message); nullptr != c;
+         c = CMSG_NXTHDR(&message, c)) {
+      if (SOL_SOCKET != c->cmsg_level || SCM_RIGHTS != c->cmsg_type) {
+        continue;
+      }
+      // Keep the first descriptor, and close any others.
+      const std::size_t descriptors =
+          (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (std::size_t i = 0; i < descriptors; i++) {
+        int passed;
+        memcpy(&passed, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+        if (*fd < 0) {
+          *fd = passed;
+        }
+        else {
+          close(passed);
+        }
+      }
+    }
+  }
+  return received;
+}
+
+bool SendResponse(int socket, const VerifyResponse& response,
+                  Clock::time_point deadline, int wake_fd) {
+  uint8_t header[kResponseHeaderLength];
+  header[0] = response.status;
+  WriteU32(header + 1, response.message.length());
+  return SendAll(socket, header, sizeof(header), deadline, wake_fd)
+      && SendAll(socket, response.message.data(), response.message.length(),
+                 deadline, wake_fd);
+}
+
+VerifyResponse MakeResponse(VerifyStatus status, const std::string& message) {
+  VerifyResponse response;
+  response.status = status;
+  response.message = message;
+  return response;
+}
+
+sockaddr_un SocketAddress(const std::string& path) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.length() >= sizeof(address.sun_path)) {
+    throw socket_error(path, ENAMETOOLONG);
+  }
+  memcpy(address.sun_path, path.data(), path.length());
+  return address;
+}
+
+/**
+ * Parse a detached signature.
+ *
+ * @return The signature, or nullptr if it is not a single detached
+ *         signature.
+ */
+std::shared_ptr<SignaturePacket> ParseDetachedSignature(
+    const ustring& signature) {
+  ParseResult<std::list<std::shared_ptr<PGPPacket>>> packets =
+      try_parse(signature, ParseLimits::Untrusted());
+  std::shared_ptr<SignaturePacket> signature_packet;
+  if (packets.ok() && 1 == packets.value.size()) {
+    signature_packet =
+        std::dynamic_pointer_cast<SignaturePacket>(packets.value.front());
+  }
+  if (nullptr == signature_packet
+      || kSignatureBinary != signature_packet->signature_type()) {
+    return nullptr;
+  }
+  return signature_packet;
+}
+
+VerifyResponse MakeResponse(const KeyIndex::Verification& verification) {
+  if (nullptr == verification.key) {
+    return MakeResponse(kVerifyNoKey, "no key for signature");
+  }
+  return MakeResponse(verification.valid ? kVerifyGood : kVerifyBad,
+                      verification.key->packet->str());
+}
+
+const char kNotDetachedSignature[] = "not a detached signature";
+
+}
+
+/// @endcond
+
+VerifyServer::VerifyServer(std::shared_ptr<const KeyIndex> index,
+                           const std::string& path, std::size_t threads)
+    : index_(std::move(index)), path_(path), threads_(threads),
+      listener_(-1), stopping_(false) {
+  if (0 == threads_) {
+    threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  sockaddr_un address = SocketAddress(path_);
+  // Only a socket left behind by an earlier server is replaced; the
+  // path may be mistyped.
+  struct stat status;
+  if (0 == lstat(path_.c_str(), &status)) {
+    if (!S_ISSOCK(status.st_mode)) {
+      throw socket_error(path_, EEXIST);
+    }
+  }
+  else if (ENOENT != errno) {
+    throw socket_error(path_, errno);
+  }
+  if (pipe2(wake_, O_CLOEXEC) < 0) {
+    throw socket_error(path_, errno);
+  }
+  listener_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener_ < 0) {
+    int error_number = errno;
+    close(wake_[0]);
+    close(wake_[1]);
+    throw socket_error(path_, error_number);
+  }
+  unlink(path_.c_str());
+  // Nobody can connect until listen(), by which time only this user
+  // may.
+  if (bind(listener_, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) < 0
+      || chmod(path_.c_str(), S_IRUSR | S_IWUSR) < 0
+      || listen(listener_, SOMAXCONN) < 0) {
+    int error_number = errno;
+    close(listener_);
+    close(wake_[0]);
+    close(wake_[1]);
+    throw socket_error(path_, error_number);
+  }
+}
+
+VerifyServer::~VerifyServer() {
+  Stop();
+  close(listener_);
+  close(wake_[0]);
+  close(wake_[1]);
+  unlink(path_.c_str());
+}
+
+void VerifyServer::Start() {
+  for (std::size_t i = 0; i < threads_; i++) {
+    workers_.push_back(std::thread(&VerifyServer::Run, this));
+  }
+}
+
+void VerifyServer::Stop() {
+  // Waking the threads blocked in accept() also stops new connections.
+  // The wake pipe is never read, so it wakes every thread waiting on a
+  // connection, now and later.
+  if (!stopping_.exchange(true)) {
+    shutdown(listener_, SHUT_RDWR);
+    const char wake = 0;
+    while (write(wake_[1], &wake, 1) < 0 && EINTR == errno) {
+    }
+  }
+  for (auto i = workers_.begin(); i != workers_.end(); i++) {
+    i->join();
+  }
+  workers_.clear();
+}
+
+void VerifyServer::Run() {
+  // Each thread accepts its own connections, so that an idle server
+  // uses no processor time.
+  while (!stopping_.load()) {
+    int connection = accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection < 0) {
+      if (EINTR == errno || ECONNABORTED == errno) {
+        continue;
+      }
+      if (stopping_.load()) {
+        break;
+      }
+      // Out of descriptors, most likely; give other connections a
+      // chance to close.
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+
+    // However the client behaves, the thread is free again once the
+    // connection's time is up.
+    Serve(connection,
+          Clock::now() + std::chrono::seconds(kVerifyConnectionSeconds));
+    close(connection);
+  }
+}
+
+void VerifyServer::Serve(int connection, Clock::time_point deadline) const {
+  while (!stopping_.load()) {
+    uint8_t header[kRequestHeaderLength];
+    int fd;
+    // A client that is not sending a request gives up its thread
+    // sooner.
+    std::size_t received = ReceiveHeader(
+        connection, header, &fd,
+        std::min(deadline,
+                 Clock::now() + std::chrono::seconds(kVerifyIdleSeconds)),
+        wake_[0]);
+    std::unique_ptr<int, void (*)(int*)> fd_guard(
+        &fd, [](int* fd) { if (*fd >= 0) close(*fd); });
+    if (kRequestHeaderLength != received) {
+      return;
+    }
+
+    const uint8_t source = header[1];
+    const uint32_t signature_length = ReadU32(header + 2);
+    const uint32_t path_length = ReadU32(header + 6);
+    if (kVerifyProtocolVersion != header[0]
+        || signature_length > kVerifyMaximumSignatureLength
+        || path_length > kVerifyMaximumPathLength
+        || (kVerifySourcePath == source) == (0 == path_length)
+        || (kVerifySourceDescriptor == source) == (fd < 0)) {
+      // The rest of the stream cannot be trusted, so give up on it.
+      SendResponse(connection,
+                   MakeResponse(kVerifyMalformed, "malformed request"),
+                   deadline, wake_[0]);
+      return;
+    }
+
+    ustring signature(signature_length, 0);
+    std::string path(path_length, '\0');
+    if (!ReceiveAll(connection, &signature[0], signature_length, deadline,
+                    wake_[0])
+        || !ReceiveAll(connection, &path[0], path_length, deadline,
+                       wake_[0])) {
+      return;
+    }
+
+    if (kVerifySourcePath == source) {
+      // Opening a FIFO would otherwise wait for a writer.
+      fd = open(path.c_str(), // Flawfinder: ignore
+                O_RDONLY | O_CLOEXEC | O_NONBLOCK | O_NOCTTY);
+      struct stat file_status;
+      int error_number = 0;
+      if (fd < 0 || fstat(fd, &file_status) < 0) {
+        error_number = errno;
+      }
+      else if (!S_ISREG(file_status.st_mode)) {
+        error_number = EINVAL;
+      }
+      if (0 != error_number) {
+        const std::runtime_error& error = read_error(path, error_number);
+        if (!SendResponse(connection,
+                          MakeResponse(kVerifyReadError, error.what()),
+                          deadline, wake_[0])) {
+          return;
+        }
+        continue;
+      }
+    }
+
+    // Whatever goes wrong is this request's alone, and must not leave
+    // the worker.
+    VerifyResponse response;
+    try {
+      response = verify_descriptor(*index_, fd,
+                                   path.empty() ? "descriptor" : path,
+                                   signature, deadline, wake_[0]);
+    }
+    catch (const parse4880_error& e) {
+      response = MakeResponse(kVerifyMalformed, error_message(e));
+    }
+    catch (const std::exception& e) {
+      response = MakeResponse(kVerifyReadError, e.what());
+    }
+    if (!SendResponse(connection, response, deadline, wake_[0])) {
+      return;
+    }
+  }
+}
+
+VerifyResponse VerifyServer::Answer(const ustring& signature,
+                                    const uint8_t* data,
+                                    std::size_t length) const {
+  return verify_signature(*index_, signature, data, length);
+}
+
+VerifyResponse verify_signature(const KeyIndex& index,
+                                const ustring& signature,
+                                const uint8_t* data, std::size_t length) {
+  std::shared_ptr<SignaturePacket> signature_packet =
+      ParseDetachedSignature(signature);
+  if (nullptr == signature_packet) {
+    return MakeResponse(kVerifyMalformed, kNotDetachedSignature);
+  }
+  return MakeResponse(index.Verify(*signature_packet, data, length));
+}
+
+VerifyResponse verify_descriptor(const KeyIndex& index, int fd,
+                                 const std::string& name,
+                                 const ustring& signature,
+                                 Clock::time_point deadline, int wake_fd) {
+  // Regular files are mapped, and anything else is hashed as it is
+  // read, so that it need not fit in memory.
+  try {
+    struct stat file_status;
+    if (fstat(fd, &file_status) < 0) {
+      throw read_error(name, errno);
+    }
+    if (S_ISREG(file_status.st_mode)) {
+      MappedFile file(fd);
+      return verify_signature(index, signature, file.data(), file.size());
+    }
+
+    std::shared_ptr<SignaturePacket> signature_packet =
+        ParseDetachedSignature(signature);
+    if (nullptr == signature_packet) {
+      return MakeResponse(kVerifyMalformed, kNotDetachedSignature);
+    }
+    KeyIndex::StreamVerification verification =
+        index.StartVerify(*signature_packet);
+    uint8_t buffer[64 * 1024];
+    uint64_t total = 0;
+    while (true) {
+      if (!WaitFor(fd, POLLIN, deadline, wake_fd)) {
+        throw read_error(name, ETIMEDOUT);
+      }
+      ssize_t count = read(fd, buffer, sizeof(buffer));
+      if (count < 0 && WouldBlock(errno)) {
+        continue;
+      }
+      if (count < 0) {
+        throw read_error(name, errno);
+      }
+      if (0 == count) {
+        break;
+      }
+      total += count;
+      if (total > kVerifyMaximumStreamLength) {
+        throw read_error(name, EFBIG);
+      }
+      verification.Update(buffer, count);
+    }
+    return MakeResponse(verification.Finish());
+  }
+  catch (const read_error& e) {
+    return MakeResponse(kVerifyReadError,
+                        static_cast<const std::runtime_error&>(e).what());
+  }
+}
+
+const char* verify_status_name(VerifyStatus status) {
+  switch (status) {
+    case kVerifyBad:
+      return "bad";
+    case kVerifyGood:
+      return "good";
+    case kVerifyNoKey:
+      return "no_key";
+    case kVerifyMalformed:
+      return "malformed";
+    case kVerifyReadError:
+      return "read_error";
+  }
+  return "unknown";
+}
+
+VerifyClient::VerifyClient(const std::string& path)
+    : path_(path), socket_(-1) {
+  sockaddr_un address = SocketAddress(path_);
+  socket_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socket_ < 0) {
+    throw socket_error(path_, errno);
+  }
+  if (connect(socket_, reinterpret_cast<sockaddr*>(&address),
+              sizeof(address)) < 0) {
+    int error_number = errno;
+    close(socket_);
+    throw socket_error(path_, error_number);
+  }
+}
+
+VerifyClient::~VerifyClient() {
+  close(socket_);
+}
+
+VerifyResponse VerifyClient::Verify(int fd, const ustring& signature) {
+  return Request(kVerifySourceDescriptor, fd, "", signature);
+}
+
+VerifyResponse VerifyClient::Verify(const std::string& path,
+                                    const ustring& signature) {
+  return Request(kVerifySourcePath, -1, path, signature);
+}
+
+VerifyResponse VerifyClient::Request(VerifySource source, int fd,
+                                     const std::string& path,
+                                     const ustring& signature) {
+  uint8_t header[kRequestHeaderLength];
+  header[0] = kVerifyProtocolVersion;
+  header[1] = source;
+  WriteU32(header + 2, signature.length());
+  WriteU32(header + 6, path.length());
+
+  struct iovec io;
+  io.iov_base = header;
+  io.iov_len = sizeof(header);
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &io;
+  message.msg_iovlen = 1;
+
+  union {
+    char buffer[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  if (kVerifySourceDescriptor == source) {
+    memset(&control, 0, sizeof(control));
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    struct cmsghdr* c = CMSG_FIRSTHDR(&message);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &fd, sizeof(int));
+  }
+
+  // The descriptor goes with the first octet, so the header is sent
+  // whole or not at all.
+  ssize_t sent;
+  do {
+    sent = sendmsg(socket_, &message, MSG_NOSIGNAL);
+  } while (sent < 0 && EINTR == errno);
+  if (sent < 0) {
+    throw socket_error(path_, errno);
+  }
+  if (!SendAll(socket_, header + sent, sizeof(header) - sent)
+      || !SendAll(socket_, signature.data(), signature.length())
+      || !SendAll(socket_, path.data(), path.length())) {
+    throw socket_error(path_, errno);
+  }
+
+  uint8_t response_header[kResponseHeaderLength];
+  if (!ReceiveAll(socket_, response_header, sizeof(response_header))) {
+    throw socket_error(path_, errno);
+  }
+  const uint32_t message_length = ReadU32(response_header + 1);
+  if (response_header[0] > kVerifyReadError
+      || message_length > kMaximumMessageLength) {
+    throw socket_error(path_, 0);
+  }
+  VerifyResponse response;
+  response.status = static_cast<VerifyStatus>(response_header[0]);
+  response.message.resize(message_length);
+  if (!ReceiveAll(socket_, &response.message[0], message_length)) {
+    throw socket_error(path_, errno);
+  }
+  return response;
+}
+
+}
+
+#ifdef INCLUDE_TESTS
+
+namespace parse4880 {
+
+TEST(VerifyService, RoundTrip) {
+  // The EdDSA key and signature from TEST(EdDSAKey, Verify).
+  const ustring key_data((const uint8_t*)
+      "\x98\x33\x04\x6A\xD5\x41\x9A\x16\x09\x2B\x06\x01\x04\x01\xDA\x47"
+      "\x0F\x01\x01\x07\x40\x8D\x34\x30\x60\x24\xF1\x96\x7C\x00\x64\xF9"
+      "\x50\x39\x71\x76\xAB\x5C\x4E\xDE\xEE\x78\x87\x04\x1A\x63\x2C\x83"
+      "\x5D\xA6\xE5\x1D\x87", 53);
+  const ustring signature((const uint8_t*)
+      "\x88\x85\x04\x00\x16\x08\x00\x2D\x16\x21\x04\xE3\x7D\xE8\x87\xB6"
+      "\xA2\xB6\xEB\x70\x93\x1A\x6D\x23\xBF\xDA\x20\x17\xA2\xEE\x02\x05"
+      "\x02\x6A\xD5\x41\x9A\x0F\x1C\x65\x64\x40\x65\x78\x61\x6D\x70\x6C"
+      "\x65\x2E\x6F\x72\x67\x00\x0A\x09\x10\x23\xBF\xDA\x20\x17\xA2\xEE"
+      "\x02\xCE\x13\x01\x00\xA6\x24\x63\xC3\xCD\xCA\xD8\xAC\xCC\xCB\xCF"
+      "\x29\xC2\x4B\x5A\x82\x07\x26\xC8\xE9\x0B\x1A\x8B\xCF\x9C\x41\xFE"
+      "\x75\xD0\x5B\xE9\x3D\x01\x00\xF1\xA3\xD7\x0F\x24\xEF\x3C\xD1\x3C"
+      "\x78\xC7\xEE\xAD\x22\x80\x11\xE5\xC0\x50\x0C\xC3\x5F\xEE\x8D\xA7"
+      "\xBB\xD9\x4B\x45\xBB\x8A\x0F", 135);
+  const char* data_path = "verify_service_test.dat";
+  const char* socket_path = "verify_service_test.sock";
+
+  FILE* data_file = fopen(data_path, "w"); // Flawfinder: ignore
+  ASSERT_NE(data_file, nullptr);
+  fputs("hello world\n", data_file);
+  fclose(data_file);
+
+  std::shared_ptr<const KeyIndex> index(
+      new KeyIndex(key_data.data(), key_data.length()));
+  ASSERT_EQ(index->size(), 1);
+
+  VerifyServer server(index, socket_path, 2);
+  server.Start();
+  struct stat socket_status;
+  ASSERT_EQ(stat(socket_path, &socket_status), 0);
+  ASSERT_EQ(socket_status.st_mode & 0777, 0600);
+  {
+    VerifyClient client(socket_path);
+    int fd = open(data_path, O_RDONLY); // Flawfinder: ignore
+    ASSERT_GE(fd, 0);
+    VerifyResponse response = client.Verify(fd, signature);
+    close(fd);
+    ASSERT_EQ(response.status, kVerifyGood);
+    ASSERT_NE(response.message.find("E37DE887"), std::string::npos);
+
+    // Several requests can share a connection.
+    ASSERT_EQ(client.Verify(data_path, signature).status, kVerifyGood);
+    ASSERT_EQ(client.Verify(std::string("missing.dat"), signature).status,
+              kVerifyReadError);
+    ASSERT_EQ(client.Verify(data_path, key_data).status, kVerifyMalformed);
+
+    // A signature using a hash that no key supports is refused, and the
+    // server carries on.
+    ustring md5_signature = signature;
+    md5_signature[5] = 1;
+    VerifyResponse unsupported = client.Verify(data_path, md5_signature);
+    ASSERT_EQ(unsupported.status, kVerifyMalformed);
+    ASSERT_NE(unsupported.message.find("not supported"), std::string::npos);
+    ASSERT_EQ(client.Verify(data_path, signature).status, kVerifyGood);
+    ASSERT_EQ(VerifyClient(socket_path).Verify(data_path, signature).status,
+              kVerifyGood);
+
+    // A pipe is read rather than mapped.
+    int pipe_fds[2];
+    ASSERT_EQ(pipe(pipe_fds), 0);
+    ASSERT_EQ(write(pipe_fds[1], "hello world!", 12), 12);
+    close(pipe_fds[1]);
+    ASSERT_EQ(client.Verify(pipe_fds[0], signature).status, kVerifyBad);
+    close(pipe_fds[0]);
+
+    // The server does not open anything but regular files.
+    const char* fifo_path = "verify_service_test.fifo";
+    unlink(fifo_path);
+    ASSERT_EQ(mkfifo(fifo_path, 0600), 0);
+    ASSERT_EQ(client.Verify(std::string(fifo_path), signature).status,
+              kVerifyReadError);
+    ASSERT_EQ(client.Verify(std::string("."), signature).status,
+              kVerifyReadError);
+    unlink(fifo_path);
+  }
+
+  // A pipe that is never finished is abandoned at the deadline.
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+  ASSERT_EQ(write(pipe_fds[1], "hello", 5), 5);
+  ASSERT_EQ(verify_descriptor(*index, pipe_fds[0], "pipe", signature,
+                              std::chrono::steady_clock::now()
+                              + std::chrono::milliseconds(50)).status,
+            kVerifyReadError);
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+
+  std::shared_ptr<const KeyIndex> empty(
+      new KeyIndex(std::list<std::shared_ptr<PGPPacket>>()));
+  ustring data((const uint8_t*)"hello world\n", 12);
+  ASSERT_EQ(VerifyServer(empty, "verify_service_test2.sock", 1)
+                .Answer(signature, data.data(), data.length()).status,
+            kVerifyNoKey);
+
+  server.Stop();
+  ASSERT_THROW(VerifyClient client(socket_path), socket_error);
+  unlink(data_path);
+}
+
+TEST(VerifyService, RefusesToReplaceFile) {
+  const char* path = "verify_service_test4.sock";
+  FILE* file = fopen(path, "w"); // Flawfinder: ignore
+  ASSERT_NE(file, nullptr);
+  fclose(file);
+  std::shared_ptr<const KeyIndex> empty(
+      new KeyIndex(std::list<std::shared_ptr<PGPPacket>>()));
+  ASSERT_THROW(VerifyServer(empty, path, 1), socket_error);
+  struct stat status;
+  ASSERT_EQ(lstat(path, &status), 0);
+  ASSERT_TRUE(S_ISREG(status.st_mode));
+  unlink(path);
+
+  // A stale socket is replaced.
+  int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path); // Flawfinder: ignore
+  ASSERT_EQ(bind(stale, reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)), 0);
+  close(stale);
+  ASSERT_NO_THROW(VerifyServer(empty, path, 1));
+}
+
+TEST(VerifyService, StopWithIdleClient) {
+  const char* socket_path = "verify_service_test3.sock";
+  std::shared_ptr<const KeyIndex> empty(
+      new KeyIndex(std::list<std::shared_ptr<PGPPacket>>()));
+  VerifyServer server(empty, socket_path, 1);
+  server.Start();
+
+  // A client that never sends a request must not keep the server from
+  // stopping.
+  VerifyClient client(socket_path);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  server.Stop();
+  ASSERT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::seconds(1));
+}
+
+}
+
+#endif
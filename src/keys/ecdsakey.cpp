@@ -0,0 +1,393 @@
+#include <cstring>
+
+#include <memory>
+#include <string>
+
+#include <mbedtls/bignum.h>
+#include <mbedtls/ecdsa.h>
+#include <mbedtls/ecp.h>
+#include <mbedtls/md.h>
+
+#ifdef INCLUDE_TESTS
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "constants.h"
+#include "exceptions.h"
+#include "fields.h"
+#include "keys/ecdsakey.h"
+#include "packets/signature.h"
+#include "packets/keymaterial.h"
+#include "trace.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+/**
+ * A curve's group, with the fixed-base table for its generator built.
+ *
+ * MbedTLS only writes the table into the group when it is missing, so
+ * once built the group is not modified by verifications, and one copy
+ * may be used by any number of threads at once.
+ */
+class PrecomputedGroup {
+ public:
+  explicit PrecomputedGroup(mbedtls_ecp_group_id id);
+  ~PrecomputedGroup();
+
+  PrecomputedGroup(const PrecomputedGroup&) = delete;
+  PrecomputedGroup& operator=(const PrecomputedGroup&) = delete;
+
+  mbedtls_ecp_group group;
+};
+
+PrecomputedGroup::PrecomputedGroup(mbedtls_ecp_group_id id) {
+  mbedtls_ecp_group_init(&group);
+  int result = mbedtls_ecp_group_load(&group, id);
+  if (0 == result) {
+    // Multiplying by one would be short-cut without building the table.
+    mbedtls_mpi two;
+    mbedtls_ecp_point product;
+    mbedtls_mpi_init(&two);
+    mbedtls_ecp_point_init(&product);
+    result = mbedtls_mpi_lset(&two, 2);
+    if (0 == result) {
+      result = mbedtls_ecp_mul(&group, &product, &two, &group.G,
+                               nullptr, nullptr);
+    }
+    mbedtls_ecp_point_free(&product);
+    mbedtls_mpi_free(&two);
+  }
+  if (0 != result) {
+    mbedtls_ecp_group_free(&group);
+    throw crypto_error("Loading an ECDSA curve", result);
+  }
+}
+
+PrecomputedGroup::~PrecomputedGroup() {
+  mbedtls_ecp_group_free(&group);
+}
+
+/**
+ * The shared group for a curve, which is loaded on first use.
+ *
+ * @throw crypto_error  If the curve cannot be loaded.
+ */
+template <mbedtls_ecp_group_id id>
+mbedtls_ecp_group* SharedGroup() {
+  static PrecomputedGroup precomputed(id);
+  return &precomputed.group;
+}
+
+/**
+ * An ECDSA public key: the shared group of its curve, and its point.
+ */
+class ECDSAPublicKey {
+ public:
+  ECDSAPublicKey() : group(nullptr) {
+    mbedtls_ecp_point_init(&point);
+  }
+
+  ~ECDSAPublicKey() {
+    mbedtls_ecp_point_free(&point);
+  }
+
+  // Not owned, and not modified by verification.
+  mbedtls_ecp_group* group;
+  mbedtls_ecp_point point;
+};
+
+/**
+ * A curve that we support, and the OID naming it.
+ */
+struct Curve {
+  mbedtls_ecp_group* (*group)();
+  std::size_t        oid_length;
+  const uint8_t*     oid;
+};
+
+const uint8_t kP256OID[] = {0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x07};
+const uint8_t kP384OID[] = {0x2B, 0x81, 0x04, 0x00, 0x22};
+const uint8_t kP521OID[] = {0x2B, 0x81, 0x04, 0x00, 0x23};
+
+const Curve kCurves[] = {
+  {SharedGroup<MBEDTLS_ECP_DP_SECP256R1>, sizeof(kP256OID), kP256OID},
+  {SharedGroup<MBEDTLS_ECP_DP_SECP384R1>, sizeof(kP384OID), kP384OID},
+  {SharedGroup<MBEDTLS_ECP_DP_SECP521R1>, sizeof(kP521OID), kP521OID},
+};
+
+/**
+ * Verification context for ECDSA signatures.
+ *
+ * @see VerificationContext
+ */
+template <mbedtls_md_type_t hash_id>
+class ECDSAVerificationContext : public VerificationContext {
+ public:
+  ECDSAVerificationContext(std::shared_ptr<const ECDSAPublicKey> public_key,
+                           const SignaturePacket& signature);
+  virtual ~ECDSAVerificationContext();
+
+  virtual void Update(const uint8_t* data, std::size_t len);
+  virtual void Update(const ustring& data);
+  virtual bool Verify();
+
+ private:
+  SignaturePacket signature_;
+  mbedtls_md_context_t hash_ctx_;
+  std::shared_ptr<const ECDSAPublicKey> public_key_;
+};
+
+template <mbedtls_md_type_t hash_id>
+ECDSAVerificationContext<hash_id>::ECDSAVerificationContext(
+    std::shared_ptr<const ECDSAPublicKey> public_key,
+    const SignaturePacket& signature)
+    : signature_(signature), public_key_(public_key) {
+  mbedtls_md_init(&hash_ctx_);
+  mbedtls_md_setup(&hash_ctx_, mbedtls_md_info_from_type(hash_id), 0);
+  mbedtls_md_starts(&hash_ctx_);
+  ChargeMemory(sizeof(*this));
+}
+
+template <mbedtls_md_type_t hash_id>
+ECDSAVerificationContext<hash_id>::~ECDSAVerificationContext() {
+  mbedtls_md_free(&hash_ctx_);
+}
+
+template <mbedtls_md_type_t hash_id>
+void ECDSAVerificationContext<hash_id>::Update(const uint8_t* data,
+                                               std::size_t len) {
+  TraceSpan span("verify", "hash");
+  span.SetArgument("length", len);
+  mbedtls_md_update(&hash_ctx_, data, len);
+}
+
+template <mbedtls_md_type_t hash_id>
+void ECDSAVerificationContext<hash_id>::Update(const ustring& data) {
+  Update(data.c_str(), data.length());
+}
+
+template <mbedtls_md_type_t hash_id>
+bool ECDSAVerificationContext<hash_id>::Verify() {
+  TraceSpan span("verify", "verify");
+  span.SetArgument("hash_algorithm", signature_.hash_algorithm());
+  PARSE4880_PROBE2(verify, signature_.public_key_algorithm(),
+                   signature_.hash_algorithm());
+
+  Update(signature_.hashed_data().data(), signature_.hashed_data().length());
+
+  if (4 == signature_.version()) {
+    const uint8_t trailer[]  = {0x04, 0xFF};
+    Update(trailer, sizeof(trailer));
+    Update(WriteInteger(signature_.hashed_data().length(), 4));
+  }
+
+  uint8_t hash_size = mbedtls_md_get_size(mbedtls_md_info_from_type(hash_id));
+  std::unique_ptr<uint8_t[]> hash(new uint8_t[hash_size]);
+  mbedtls_md_finish(&hash_ctx_, hash.get());
+
+  // A digest that fails the quick check need not go to the curve.
+  if (!signature_.MatchesHashPrefix(hash.get())) {
+    return false;
+  }
+
+  // The signature is two MPIs, r and s.
+  const ByteView signature = signature_.signature();
+  std::size_t position = 0;
+  fields::Region r_region, s_region;
+  if (!fields::ReadPrefixed<fields::MPI>(signature.data(), signature.length(),
+                                         &position, &r_region)
+      || !fields::ReadPrefixed<fields::MPI>(signature.data(),
+                                            signature.length(),
+                                            &position, &s_region)) {
+    return false;
+  }
+
+  mbedtls_mpi r, s;
+  mbedtls_mpi_init(&r);
+  mbedtls_mpi_init(&s);
+  mbedtls_mpi_read_binary(&r, signature.data() + r_region.offset,
+                          r_region.length);
+  mbedtls_mpi_read_binary(&s, signature.data() + s_region.offset,
+                          s_region.length);
+
+  int result = mbedtls_ecdsa_verify(public_key_->group, hash.get(),
+                                    hash_size, &public_key_->point, &r, &s);
+
+  mbedtls_mpi_free(&r);
+  mbedtls_mpi_free(&s);
+  return (result == 0);
+}
+
+}
+
+class ECDSAKey::impl : public ECDSAPublicKey {};
+
+ECDSAKey::ECDSAKey(const PublicKeyPacket& rhs)
+    : impl_(new impl) {
+  ParseError error = Load(rhs);
+  if (!error.ok()) {
+    ThrowParseError(error);
+  }
+}
+
+ECDSAKey::ECDSAKey(const PublicKeyPacket& rhs, ParseError* error)
+    : impl_(new impl) {
+  *error = Load(rhs);
+}
+
+ECDSAKey::~ECDSAKey() {
+}
+
+ParseError ECDSAKey::Load(const PublicKeyPacket& rhs) {
+  if (kPublicKeyECDSA != rhs.public_key_algorithm()) {
+    return ParseError(kParseWrongAlgorithm, -1);
+  }
+
+  ChargeMemory(sizeof(ECDSAKey) + sizeof(impl) + rhs.key_material().size());
+
+  /*
+   * The key material is the curve's OID, preceded by its length, and
+   * then the public point as an MPI holding its SEC1 encoding.
+   */
+  const ByteView key_material = rhs.key_material();
+  const uint8_t* data = key_material.data();
+  const std::size_t length = key_material.length();
+
+  std::size_t position = 0;
+  fields::Region oid;
+  if (!fields::ReadPrefixed<fields::LengthPrefixed<1>>(data, length,
+                                                        &position, &oid)) {
+    return ParseError(kParseInvalidPacket, -1,
+                      "Packet too short for ECDSA curve");
+  }
+
+  const Curve* curve = nullptr;
+  for (const Curve& candidate : kCurves) {
+    if (candidate.oid_length == oid.length
+        && 0 == memcmp(candidate.oid, data + oid.offset, oid.length)) {
+      curve = &candidate;
+    }
+  }
+  if (nullptr == curve) {
+    return ParseError(kParseUnsupportedFeature, -1, "unsupported ECDSA curve");
+  }
+
+  fields::Region point;
+  if (!fields::ReadPrefixed<fields::MPI>(data, length, &position, &point)) {
+    return ParseError(kParseInvalidPacket, -1,
+                      "Packet too short for ECDSA point");
+  }
+
+  impl_->group = curve->group();
+  if (0 != mbedtls_ecp_point_read_binary(impl_->group, &impl_->point,
+                                         data + point.offset, point.length)
+      || 0 != mbedtls_ecp_check_pubkey(impl_->group, &impl_->point)) {
+    return ParseError(kParseInvalidPacket, -1, "Invalid ECDSA point");
+  }
+
+  return ParseError();
+}
+
+std::unique_ptr<VerificationContext>
+ECDSAKey::GetVerificationContext(const SignaturePacket& signature) const {
+  VerificationContext* ctx;
+  switch (signature.hash_algorithm()) {
+    case kHashSHA1:
+      ctx = new ECDSAVerificationContext<MBEDTLS_MD_SHA1>(impl_, signature);
+      break;
+    case kHashSHA224:
+      ctx = new ECDSAVerificationContext<MBEDTLS_MD_SHA224>(impl_, signature);
+      break;
+    case kHashSHA256:
+      ctx = new ECDSAVerificationContext<MBEDTLS_MD_SHA256>(impl_, signature);
+      break;
+    case kHashSHA384:
+      ctx = new ECDSAVerificationContext<MBEDTLS_MD_SHA384>(impl_, signature);
+      break;
+    case kHashSHA512:
+      ctx = new ECDSAVerificationContext<MBEDTLS_MD_SHA512>(impl_, signature);
+      break;
+    default:
+      throw unsupported_feature_error(-1, "Unsupported hash function.");
+  }
+
+  return std::unique_ptr<VerificationContext>(ctx);
+}
+
+/// @endcond
+
+#ifdef INCLUDE_TESTS
+
+TEST(ECDSAKey, Verify) {
+  const ustring key_data((const uint8_t*)
+      "\x98\x52\x04\x6A\xD5\x41\x9A\x13\x08\x2A\x86\x48\xCE\x3D\x03\x01"
+      "\x07\x02\x03\x04\x8A\xDC\x04\x38\x91\x90\x5A\x91\x42\x9C\xEE\x3D"
+      "\x7D\x2B\xA5\x96\xA2\xCB\x5F\x91\xF0\xA4\x8F\x8E\xBA\x52\x7D\xAA"
+      "\x47\x87\x74\x69\x18\x63\x41\xED\xEE\x11\xA6\x37\x85\xCC\x35\x97"
+      "\xBA\x12\x61\xD1\x4D\x8E\xFF\x4B\xF2\x24\x80\x40\x84\xEF\x53\x63"
+      "\xC0\xD9\x5B\x88", 84);
+  const ustring signature_data((const uint8_t*)
+      "\x88\x85\x04\x00\x13\x08\x00\x2D\x16\x21\x04\xD3\xBD\xB9\x81\xEB"
+      "\xA5\x71\x39\x4D\x87\xF1\xD7\x90\x99\x7D\xE7\x9B\x32\x6F\xF8\x05"
+      "\x02\x6A\xD5\x41\x9A\x0F\x1C\x65\x63\x40\x65\x78\x61\x6D\x70\x6C"
+      "\x65\x2E\x6F\x72\x67\x00\x0A\x09\x10\x90\x99\x7D\xE7\x9B\x32\x6F"
+      "\xF8\x53\x57\x01\x00\x98\x48\xEC\x83\xED\x70\x5B\xC3\x38\x89\x1C"
+      "\x95\x4F\x0F\xD7\xAD\xDA\xB3\x5D\x6A\x2F\x1E\xA2\x9B\x6F\xF2\x94"
+      "\x83\x7B\xC4\x74\xFA\x00\xFC\x0D\x78\xF8\x6B\xCD\x35\x51\x62\x56"
+      "\x20\x9A\x35\xDE\x32\xAA\x72\x9F\xD5\x19\x89\x0D\x83\x7B\x60\x0E"
+      "\x75\x1C\x17\x23\x07\x0C\x34", 135);
+
+  std::shared_ptr<PublicKeyPacket> key_packet =
+      std::dynamic_pointer_cast<PublicKeyPacket>(parse(key_data).front());
+  std::shared_ptr<SignaturePacket> signature =
+      std::dynamic_pointer_cast<SignaturePacket>(
+          parse(signature_data).front());
+  ASSERT_TRUE(key_packet && signature);
+
+  // Several contexts from one key share its curve.
+  std::unique_ptr<Key> key = Key::ParseKey(*key_packet);
+  for (int i = 0; i < 2; i++) {
+    std::unique_ptr<VerificationContext> context =
+        key->GetVerificationContext(*signature);
+    context->Update(ustring((const uint8_t*)"hello world\n", 12));
+    ASSERT_TRUE(context->Verify());
+  }
+
+  std::unique_ptr<VerificationContext> context =
+      key->GetVerificationContext(*signature);
+  context->Update(ustring((const uint8_t*)"hello world!", 12));
+  ASSERT_FALSE(context->Verify());
+
+  // Keys on one curve share it, and may verify concurrently.
+  std::unique_ptr<Key> other = Key::ParseKey(*key_packet);
+  std::atomic<int> verified(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    const Key* k = (i % 2) ? key.get() : other.get();
+    threads.emplace_back([k, &signature, &verified]() {
+      for (int j = 0; j < 4; j++) {
+        std::unique_ptr<VerificationContext> context =
+            k->GetVerificationContext(*signature);
+        context->Update(ustring((const uint8_t*)"hello world\n", 12));
+        verified += context->Verify();
+      }
+    });
+  }
+  for (auto i = threads.begin(); i != threads.end(); i++) {
+    i->join();
+  }
+  ASSERT_EQ(verified, 16);
+}
+
+#endif  // INCLUDE_TESTS
+
+}
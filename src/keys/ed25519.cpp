@@ -0,0 +1,572 @@
+#include <cstdint>
+#include <cstring>
+
+#include <random>
+#include <vector>
+
+#include <mbedtls/md.h>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "keys/ed25519.h"
+
+namespace parse4880 {
+
+namespace ed25519 {
+
+/// @cond SHOW_INTERNAL
+
+/*
+ * The arithmetic here follows TweetNaCl.  Field elements modulo
+ * 2^255 - 19 are held as sixteen signed limbs of sixteen bits each,
+ * and points are held in extended twisted Edwards coordinates
+ * (X, Y, Z, T) with x = X/Z, y = Y/Z and xy = T/Z.
+ *
+ * None of the data handled during verification is secret, so no
+ * attempt is made to run in constant time.
+ */
+
+namespace {
+
+typedef int64_t FieldElement[16];
+typedef FieldElement Point[4];
+
+// Points in containers need a copyable wrapper.
+struct StoredPoint {
+  Point p;
+};
+
+const FieldElement kZero = {0};
+const FieldElement kOne = {1};
+
+// The curve constant d = -121665/121666, and 2d.
+const FieldElement kD = {
+  0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070,
+  0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203};
+const FieldElement kD2 = {
+  0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0,
+  0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406};
+
+// The coordinates of the base point B.
+const FieldElement kBaseX = {
+  0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c,
+  0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169};
+const FieldElement kBaseY = {
+  0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666,
+  0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666};
+
+// A square root of -1.
+const FieldElement kSqrtMinusOne = {
+  0xa0b0, 0x4a0e, 0x1b27, 0xc4ee, 0xe478, 0xad2f, 0x1806, 0x2f43,
+  0xd7a7, 0x3dfb, 0x0099, 0x2b4d, 0xdf0b, 0x4fc1, 0x2480, 0x2b83};
+
+// The order of the base point, L = 2^252 + 27742317777372353535851937790883648493.
+const int64_t kOrder[32] = {
+  0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+  0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10};
+
+void Copy(FieldElement out, const FieldElement in) {
+  for (int i = 0; i < 16; i++) {
+    out[i] = in[i];
+  }
+}
+
+void Carry(FieldElement o) {
+  for (int i = 0; i < 16; i++) {
+    o[i] += 1 << 16;
+    int64_t carry = o[i] >> 16;
+    // The carry out of the top limb wraps around as 2^256 = 38.
+    o[(i+1) * (i < 15)] += carry - 1 + 37 * (carry - 1) * (i == 15);
+    o[i] -= carry * 65536;
+  }
+}
+
+void Select(FieldElement p, FieldElement q, int b) {
+  int64_t mask = ~(b - 1);
+  for (int i = 0; i < 16; i++) {
+    int64_t t = mask & (p[i] ^ q[i]);
+    p[i] ^= t;
+    q[i] ^= t;
+  }
+}
+
+void Pack(uint8_t* out, const FieldElement n) {
+  FieldElement m, t;
+  Copy(t, n);
+  Carry(t);
+  Carry(t);
+  Carry(t);
+  for (int j = 0; j < 2; j++) {
+    m[0] = t[0] - 0xffed;
+    for (int i = 1; i < 15; i++) {
+      m[i] = t[i] - 0xffff - ((m[i-1] >> 16) & 1);
+      m[i-1] &= 0xffff;
+    }
+    m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+    int b = (m[15] >> 16) & 1;
+    m[14] &= 0xffff;
+    Select(t, m, 1 - b);
+  }
+  for (int i = 0; i < 16; i++) {
+    out[2*i] = t[i] & 0xff;
+    out[2*i+1] = t[i] >> 8;
+  }
+}
+
+void Unpack(FieldElement out, const uint8_t* n) {
+  for (int i = 0; i < 16; i++) {
+    out[i] = n[2*i] + (static_cast<int64_t>(n[2*i+1]) << 8);
+  }
+  out[15] &= 0x7fff;
+}
+
+bool Equal(const FieldElement a, const FieldElement b) {
+  uint8_t packed_a[32], packed_b[32];
+  Pack(packed_a, a);
+  Pack(packed_b, b);
+  return 0 == memcmp(packed_a, packed_b, 32);
+}
+
+uint8_t Parity(const FieldElement a) {
+  uint8_t packed[32];
+  Pack(packed, a);
+  return packed[0] & 1;
+}
+
+void Add(FieldElement o, const FieldElement a, const FieldElement b) {
+  for (int i = 0; i < 16; i++) {
+    o[i] = a[i] + b[i];
+  }
+}
+
+void Subtract(FieldElement o, const FieldElement a, const FieldElement b) {
+  for (int i = 0; i < 16; i++) {
+    o[i] = a[i] - b[i];
+  }
+}
+
+void Multiply(FieldElement o, const FieldElement a, const FieldElement b) {
+  int64_t t[31] = {0};
+  for (int i = 0; i < 16; i++) {
+    for (int j = 0; j < 16; j++) {
+      t[i+j] += a[i] * b[j];
+    }
+  }
+  for (int i = 0; i < 15; i++) {
+    t[i] += 38 * t[i+16];
+  }
+  for (int i = 0; i < 16; i++) {
+    o[i] = t[i];
+  }
+  Carry(o);
+  Carry(o);
+}
+
+void Square(FieldElement o, const FieldElement a) {
+  Multiply(o, a, a);
+}
+
+// Compute i^(2^252 - 3), used to take square roots.
+void Pow2523(FieldElement o, const FieldElement i) {
+  FieldElement c;
+  Copy(c, i);
+  for (int a = 250; a >= 0; a--) {
+    Square(c, c);
+    if (a != 1) {
+      Multiply(c, c, i);
+    }
+  }
+  Copy(o, c);
+}
+
+// Compute i^(p - 2) = 1/i.
+void Invert(FieldElement o, const FieldElement i) {
+  FieldElement c;
+  Copy(c, i);
+  for (int a = 253; a >= 0; a--) {
+    Square(c, c);
+    if (a != 2 && a != 4) {
+      Multiply(c, c, i);
+    }
+  }
+  Copy(o, c);
+}
+
+void SetIdentity(Point p) {
+  Copy(p[0], kZero);
+  Copy(p[1], kOne);
+  Copy(p[2], kOne);
+  Copy(p[3], kZero);
+}
+
+void CopyPoint(Point out, const Point in) {
+  for (int i = 0; i < 4; i++) {
+    Copy(out[i], in[i]);
+  }
+}
+
+// Set p to p + q.
+void AddPoint(Point p, const Point q) {
+  FieldElement a, b, c, d, t, e, f, g, h;
+  Subtract(a, p[1], p[0]);
+  Subtract(t, q[1], q[0]);
+  Multiply(a, a, t);
+  Add(b, p[0], p[1]);
+  Add(t, q[0], q[1]);
+  Multiply(b, b, t);
+  Multiply(c, p[3], q[3]);
+  Multiply(c, c, kD2);
+  Multiply(d, p[2], q[2]);
+  Add(d, d, d);
+  Subtract(e, b, a);
+  Subtract(f, d, c);
+  Add(g, d, c);
+  Add(h, b, a);
+  Multiply(p[0], e, f);
+  Multiply(p[1], h, g);
+  Multiply(p[2], g, f);
+  Multiply(p[3], e, h);
+}
+
+void DoublePoint(Point p) {
+  Point q;
+  CopyPoint(q, p);
+  AddPoint(p, q);
+}
+
+void PackPoint(uint8_t* out, const Point p) {
+  FieldElement tx, ty, zi;
+  Invert(zi, p[2]);
+  Multiply(tx, p[0], zi);
+  Multiply(ty, p[1], zi);
+  Pack(out, ty);
+  out[31] ^= Parity(tx) << 7;
+}
+
+void SetBasePoint(Point p) {
+  Copy(p[0], kBaseX);
+  Copy(p[1], kBaseY);
+  Copy(p[2], kOne);
+  Multiply(p[3], kBaseX, kBaseY);
+}
+
+// Check that the y-coordinate of an encoded point is less than 2^255 - 19,
+// as RFC8032 §5.1.3 requires.
+bool IsCanonicalY(const uint8_t* p) {
+  if ((p[31] & 0x7f) != 0x7f) {
+    return true;
+  }
+  for (int i = 30; i > 0; i--) {
+    if (p[i] != 0xff) {
+      return true;
+    }
+  }
+  return p[0] < 0xed;
+}
+
+// Decode a point and negate it, returning false if it is not on the curve
+// or its encoding is not canonical.
+bool UnpackNegated(Point r, const uint8_t* p) {
+  FieldElement t, check, num, den, den2, den4, den6;
+  if (!IsCanonicalY(p)) {
+    return false;
+  }
+  Copy(r[2], kOne);
+  Unpack(r[1], p);
+  Square(num, r[1]);
+  Multiply(den, num, kD);
+  Subtract(num, num, r[2]);
+  Add(den, r[2], den);
+
+  Square(den2, den);
+  Square(den4, den2);
+  Multiply(den6, den4, den2);
+  Multiply(t, den6, num);
+  Multiply(t, t, den);
+
+  Pow2523(t, t);
+  Multiply(t, t, num);
+  Multiply(t, t, den);
+  Multiply(t, t, den);
+  Multiply(r[0], t, den);
+
+  Square(check, r[0]);
+  Multiply(check, check, den);
+  if (!Equal(check, num)) {
+    Multiply(r[0], r[0], kSqrtMinusOne);
+  }
+
+  Square(check, r[0]);
+  Multiply(check, check, den);
+  if (!Equal(check, num)) {
+    return false;
+  }
+
+  if (Parity(r[0]) == (p[31] >> 7)) {
+    Subtract(r[0], kZero, r[0]);
+  }
+  Multiply(r[3], r[0], r[1]);
+  return true;
+}
+
+/*
+ * Scalars are 32-octet little-endian integers.  Reduction modulo L
+ * works on 64 signed limbs of eight bits each.
+ */
+void ReduceScalar(uint8_t* r, int64_t* x) {
+  int64_t carry;
+  for (int i = 63; i >= 32; i--) {
+    carry = 0;
+    int j;
+    for (j = i - 32; j < i - 12; j++) {
+      x[j] += carry - 16 * x[i] * kOrder[j - (i - 32)];
+      carry = (x[j] + 128) >> 8;
+      x[j] -= carry * 256;
+    }
+    x[j] += carry;
+    x[i] = 0;
+  }
+  carry = 0;
+  for (int j = 0; j < 32; j++) {
+    x[j] += carry - (x[31] >> 4) * kOrder[j];
+    carry = x[j] >> 8;
+    x[j] &= 255;
+  }
+  for (int j = 0; j < 32; j++) {
+    x[j] -= carry * kOrder[j];
+  }
+  for (int i = 0; i < 32; i++) {
+    x[i+1] += x[i] >> 8;
+    r[i] = x[i] & 255;
+  }
+}
+
+void ReduceWideScalar(uint8_t* r, const uint8_t* wide) {
+  int64_t x[64];
+  for (int i = 0; i < 64; i++) {
+    x[i] = wide[i];
+  }
+  ReduceScalar(r, x);
+}
+
+void MultiplyScalars(uint8_t* r, const uint8_t* a, const uint8_t* b) {
+  int64_t x[64] = {0};
+  for (int i = 0; i < 32; i++) {
+    for (int j = 0; j < 32; j++) {
+      x[i+j] += static_cast<int64_t>(a[i]) * b[j];
+    }
+  }
+  ReduceScalar(r, x);
+}
+
+void AddScalars(uint8_t* r, const uint8_t* a, const uint8_t* b) {
+  int64_t x[64] = {0};
+  for (int i = 0; i < 32; i++) {
+    x[i] = static_cast<int64_t>(a[i]) + b[i];
+  }
+  ReduceScalar(r, x);
+}
+
+// Check that S < L, as required to prevent malleability.
+bool IsCanonicalScalar(const uint8_t* s) {
+  for (int i = 31; i >= 0; i--) {
+    if (s[i] != kOrder[i]) {
+      return s[i] < kOrder[i];
+    }
+  }
+  return false;
+}
+
+// Compute the challenge h = SHA-512(R || A || M) mod L.
+bool Challenge(uint8_t* h, const uint8_t* r, const uint8_t* public_key,
+               const uint8_t* message, std::size_t message_length) {
+  uint8_t digest[64];
+  mbedtls_md_context_t ctx;
+  mbedtls_md_init(&ctx);
+  bool ok =
+      0 == mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA512),
+                            0)
+      && 0 == mbedtls_md_starts(&ctx)
+      && 0 == mbedtls_md_update(&ctx, r, 32)
+      && 0 == mbedtls_md_update(&ctx, public_key, 32)
+      && 0 == mbedtls_md_update(&ctx, message, message_length)
+      && 0 == mbedtls_md_finish(&ctx, digest);
+  mbedtls_md_free(&ctx);
+
+  ReduceWideScalar(h, digest);
+  return ok;
+}
+
+/*
+ * Compute the sum of [scalars[i]]points[i] by Straus's method: the
+ * doublings are shared between all of the terms, and each term costs
+ * one addition for each set bit of its scalar.
+ */
+void MultiScalarMultiply(Point out, const std::vector<const uint8_t*>& scalars,
+                         const std::vector<StoredPoint>& points) {
+  SetIdentity(out);
+  for (int bit = 255; bit >= 0; bit--) {
+    DoublePoint(out);
+    for (std::size_t i = 0; i < scalars.size(); i++) {
+      if ((scalars[i][bit / 8] >> (bit & 7)) & 1) {
+        AddPoint(out, points[i].p);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool Verify(const uint8_t* public_key, const uint8_t* signature,
+            const uint8_t* message, std::size_t message_length) {
+  Point p, q;
+  uint8_t h[32], check[32];
+
+  if (!IsCanonicalScalar(signature + 32)
+      || !UnpackNegated(q, public_key)
+      || !Challenge(h, signature, public_key, message, message_length)) {
+    return false;
+  }
+
+  // Check that R = [S]B - [h]A.
+  std::vector<const uint8_t*> scalars = {h, signature + 32};
+  std::vector<StoredPoint> points(2);
+  CopyPoint(points[0].p, q);
+  SetBasePoint(points[1].p);
+  MultiScalarMultiply(p, scalars, points);
+
+  PackPoint(check, p);
+  return 0 == memcmp(check, signature, 32);
+}
+
+bool VerifyBatch(const std::vector<BatchEntry>& entries) {
+  if (entries.empty()) {
+    return true;
+  }
+
+  /*
+   * With random z_i we check that
+   *
+   *   [8]([sum z_i S_i]B + sum [z_i](-R_i) + sum [z_i h_i](-A_i)) = 0.
+   *
+   * The z_i are 128 bits long, so that a batch containing an invalid
+   * signature passes with probability 2^-128.
+   */
+  std::random_device random;
+  const std::size_t count = entries.size();
+  std::vector<uint8_t> scalar_data(32 * (2 * count + 1), 0);
+  std::vector<StoredPoint> points(2 * count + 1);
+  std::vector<const uint8_t*> scalars;
+
+  uint8_t* base_scalar = &scalar_data[64 * count];
+  for (std::size_t i = 0; i < count; i++) {
+    const BatchEntry& entry = entries[i];
+    uint8_t* z = &scalar_data[64 * i];
+    uint8_t* zh = &scalar_data[64 * i + 32];
+    uint8_t h[32], zs[32];
+
+    if (!IsCanonicalScalar(entry.signature + 32)
+        || !UnpackNegated(points[2 * i].p, entry.signature)
+        || !UnpackNegated(points[2 * i + 1].p, entry.public_key)
+        || !Challenge(h, entry.signature, entry.public_key,
+                      entry.message, entry.message_length)) {
+      return false;
+    }
+
+    for (int j = 0; j < 16; j += 4) {
+      uint32_t word = random();
+      memcpy(z + j, &word, 4);
+    }
+    MultiplyScalars(zh, z, h);
+    MultiplyScalars(zs, z, entry.signature + 32);
+    AddScalars(base_scalar, base_scalar, zs);
+
+    scalars.push_back(z);
+    scalars.push_back(zh);
+  }
+
+  SetBasePoint(points[2 * count].p);
+  scalars.push_back(base_scalar);
+
+  Point sum;
+  MultiScalarMultiply(sum, scalars, points);
+
+  // Clear any small-order component before comparing with the identity.
+  for (int i = 0; i < 3; i++) {
+    DoublePoint(sum);
+  }
+  uint8_t packed[32];
+  const uint8_t identity[32] = {1};
+  PackPoint(packed, sum);
+  return 0 == memcmp(packed, identity, 32);
+}
+
+/// @endcond
+
+#ifdef INCLUDE_TESTS
+
+TEST(Ed25519, TestVectors) {
+  // Tests 1 and 2 from RFC8032 §7.1.
+  const uint8_t public_keys[2][32] = {
+    {0xd7, 0x5a, 0x98, 0x01, 0x82, 0xb1, 0x0a, 0xb7,
+     0xd5, 0x4b, 0xfe, 0xd3, 0xc9, 0x64, 0x07, 0x3a,
+     0x0e, 0xe1, 0x72, 0xf3, 0xda, 0xa6, 0x23, 0x25,
+     0xaf, 0x02, 0x1a, 0x68, 0xf7, 0x07, 0x51, 0x1a},
+    {0x3d, 0x40, 0x17, 0xc3, 0xe8, 0x43, 0x89, 0x5a,
+     0x92, 0xb7, 0x0a, 0xa7, 0x4d, 0x1b, 0x7e, 0xbc,
+     0x9c, 0x98, 0x2c, 0xcf, 0x2e, 0xc4, 0x96, 0x8c,
+     0xc0, 0xcd, 0x55, 0xf1, 0x2a, 0xf4, 0x66, 0x0c}};
+  const uint8_t signatures[2][64] = {
+    {0xe5, 0x56, 0x43, 0x00, 0xc3, 0x60, 0xac, 0x72,
+     0x90, 0x86, 0xe2, 0xcc, 0x80, 0x6e, 0x82, 0x8a,
+     0x84, 0x87, 0x7f, 0x1e, 0xb8, 0xe5, 0xd9, 0x74,
+     0xd8, 0x73, 0xe0, 0x65, 0x22, 0x49, 0x01, 0x55,
+     0x5f, 0xb8, 0x82, 0x15, 0x90, 0xa3, 0x3b, 0xac,
+     0xc6, 0x1e, 0x39, 0x70, 0x1c, 0xf9, 0xb4, 0x6b,
+     0xd2, 0x5b, 0xf5, 0xf0, 0x59, 0x5b, 0xbe, 0x24,
+     0x65, 0x51, 0x41, 0x43, 0x8e, 0x7a, 0x10, 0x0b},
+    {0x92, 0xa0, 0x09, 0xa9, 0xf0, 0xd4, 0xca, 0xb8,
+     0x72, 0x0e, 0x82, 0x0b, 0x5f, 0x64, 0x25, 0x40,
+     0xa2, 0xb2, 0x7b, 0x54, 0x16, 0x50, 0x3f, 0x8f,
+     0xb3, 0x76, 0x22, 0x23, 0xeb, 0xdb, 0x69, 0xda,
+     0x08, 0x5a, 0xc1, 0xe4, 0x3e, 0x15, 0x99, 0x6e,
+     0x45, 0x8f, 0x36, 0x13, 0xd0, 0xf1, 0x1d, 0x8c,
+     0x38, 0x7b, 0x2e, 0xae, 0xb4, 0x30, 0x2a, 0xee,
+     0xb0, 0x0d, 0x29, 0x16, 0x12, 0xbb, 0x0c, 0x00}};
+  const uint8_t message[] = {0x72};
+
+  ASSERT_TRUE(Verify(public_keys[0], signatures[0], message, 0));
+  ASSERT_TRUE(Verify(public_keys[1], signatures[1], message, 1));
+  ASSERT_FALSE(Verify(public_keys[1], signatures[1], message, 0));
+
+  std::vector<BatchEntry> batch = {
+    {public_keys[0], signatures[0], message, 0},
+    {public_keys[1], signatures[1], message, 1}};
+  ASSERT_TRUE(VerifyBatch(batch));
+  batch[0].message_length = 1;
+  ASSERT_FALSE(VerifyBatch(batch));
+
+  // y = 0 is on the curve, but y = p is a non-canonical encoding of it.
+  Point point;
+  uint8_t zero[32] = {0};
+  uint8_t p[32];
+  memset(p, 0xff, 32);
+  p[0] = 0xed;
+  p[31] = 0x7f;
+  ASSERT_TRUE(UnpackNegated(point, zero));
+  ASSERT_FALSE(UnpackNegated(point, p));
+  p[0] = 0xec;
+  ASSERT_TRUE(UnpackNegated(point, p));
+  p[0] = 0xee;
+  ASSERT_FALSE(UnpackNegated(point, p));
+  ASSERT_FALSE(Verify(p, signatures[0], message, 0));
+}
+
+#endif  // INCLUDE_TESTS
+
+}
+
+}
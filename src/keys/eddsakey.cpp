@@ -0,0 +1,412 @@
+#include <cstring>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <mbedtls/md.h>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "constants.h"
+#include "exceptions.h"
+#include "fields.h"
+#include "multihash.h"
+#include "keys/ed25519.h"
+#include "keys/eddsakey.h"
+#include "packets/signature.h"
+#include "packets/keymaterial.h"
+#include "trace.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+// The OID of Ed25519, 1.3.6.1.4.1.11591.15.1.
+const uint8_t kEd25519OID[] = {
+  0x2B, 0x06, 0x01, 0x04, 0x01, 0xDA, 0x47, 0x0F, 0x01};
+
+// Points are stored with a prefix marking their native encoding.
+const uint8_t kNativePointPrefix = 0x40;
+
+// Signed data up to this length is hashed in bulk by the batch verifier.
+const std::size_t kDeferredHashLimit = 4096;
+
+/**
+ * Find the MbedTLS hash corresponding to an OpenPGP hash algorithm.
+ *
+ * @param hash_algorithm  The OpenPGP hash algorithm code.
+ *
+ * @return The hash, or nullptr if it is not supported.
+ */
+const mbedtls_md_info_t* HashInfo(uint8_t hash_algorithm) {
+  switch (hash_algorithm) {
+    case kHashSHA1:
+      return mbedtls_md_info_from_type(MBEDTLS_MD_SHA1);
+    case kHashSHA224:
+      return mbedtls_md_info_from_type(MBEDTLS_MD_SHA224);
+    case kHashSHA256:
+      return mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    case kHashSHA384:
+      return mbedtls_md_info_from_type(MBEDTLS_MD_SHA384);
+    case kHashSHA512:
+      return mbedtls_md_info_from_type(MBEDTLS_MD_SHA512);
+    default:
+      return nullptr;
+  }
+}
+
+/**
+ * Read an EdDSA signature from a signature packet.
+ *
+ * The signature is made up of two MPIs, R and S, each holding the
+ * 32-octet native encoding of its value.  Leading zeros may have been
+ * stripped from the MPIs, so we restore them.
+ *
+ * @param signature  The signature packet.
+ * @param out        Set to R followed by S.
+ *
+ * @return true if the signature is well-formed.
+ */
+bool ReadEdDSASignature(const SignaturePacket& signature, uint8_t* out) {
+  const ByteView data = signature.signature();
+  std::size_t position = 0;
+  for (int i = 0; i < 2; i++) {
+    fields::Region value;
+    if (!fields::ReadPrefixed<fields::MPI>(data.data(), data.length(),
+                                           &position, &value)
+        || value.length > 32) {
+      return false;
+    }
+    memset(out + 32*i, 0, 32 - value.length);
+    memcpy(out + 32*i + 32 - value.length, data.data() + value.offset,
+           value.length);
+  }
+  return true;
+}
+
+/**
+ * Verification context for EdDSA signatures.
+ *
+ * @see VerificationContext
+ */
+class EdDSAVerificationContext : public VerificationContext {
+ public:
+  EdDSAVerificationContext(const std::array<uint8_t, 32>& public_key,
+                           const SignaturePacket& signature,
+                           const mbedtls_md_info_t* hash_info);
+  virtual ~EdDSAVerificationContext();
+
+  virtual void Update(const uint8_t* data, std::size_t len);
+  virtual void Update(const ustring& data);
+  virtual bool Verify();
+
+  /**
+   * Hash the signature's own data and return the digest to be signed.
+   *
+   * @return The digest of the signed data.
+   */
+  ustring Finish();
+
+ private:
+  SignaturePacket signature_;
+  std::array<uint8_t, 32> public_key_;
+  const mbedtls_md_info_t* hash_info_;
+  mbedtls_md_context_t hash_ctx_;
+};
+
+EdDSAVerificationContext::EdDSAVerificationContext(
+    const std::array<uint8_t, 32>& public_key,
+    const SignaturePacket& signature,
+    const mbedtls_md_info_t* hash_info)
+    : signature_(signature), public_key_(public_key), hash_info_(hash_info) {
+  mbedtls_md_init(&hash_ctx_);
+  mbedtls_md_setup(&hash_ctx_, hash_info_, 0);
+  mbedtls_md_starts(&hash_ctx_);
+  ChargeMemory(sizeof(*this));
+}
+
+EdDSAVerificationContext::~EdDSAVerificationContext() {
+  mbedtls_md_free(&hash_ctx_);
+}
+
+void EdDSAVerificationContext::Update(const uint8_t* data, std::size_t len) {
+  TraceSpan span("verify", "hash");
+  span.SetArgument("length", len);
+  mbedtls_md_update(&hash_ctx_, data, len);
+}
+
+void EdDSAVerificationContext::Update(const ustring& data) {
+  Update(data.c_str(), data.length());
+}
+
+ustring EdDSAVerificationContext::Finish() {
+  Update(signature_.hashed_data().data(), signature_.hashed_data().length());
+
+  if (4 == signature_.version()) {
+    const uint8_t trailer[]  = {0x04, 0xFF};
+    Update(trailer, sizeof(trailer));
+    Update(WriteInteger(signature_.hashed_data().length(), 4));
+  }
+
+  ustring digest(mbedtls_md_get_size(hash_info_), 0);
+  mbedtls_md_finish(&hash_ctx_, &digest[0]);
+  return digest;
+}
+
+bool EdDSAVerificationContext::Verify() {
+  TraceSpan span("verify", "verify");
+  span.SetArgument("hash_algorithm", signature_.hash_algorithm());
+  PARSE4880_PROBE2(verify, signature_.public_key_algorithm(),
+                   signature_.hash_algorithm());
+
+  const ustring digest = Finish();
+
+  uint8_t signature[64];
+  if (!signature_.MatchesHashPrefix(digest.data())
+      || !ReadEdDSASignature(signature_, signature)) {
+    return false;
+  }
+
+  return ed25519::Verify(public_key_.data(), signature,
+                         digest.data(), digest.length());
+}
+
+}
+
+EdDSAKey::EdDSAKey(const PublicKeyPacket& rhs) {
+  ParseError error = Load(rhs);
+  if (!error.ok()) {
+    ThrowParseError(error);
+  }
+}
+
+EdDSAKey::EdDSAKey(const PublicKeyPacket& rhs, ParseError* error) {
+  *error = Load(rhs);
+}
+
+EdDSAKey::~EdDSAKey() {
+}
+
+ParseError EdDSAKey::Load(const PublicKeyPacket& rhs) {
+  if (kPublicKeyEdDSA != rhs.public_key_algorithm()) {
+    return ParseError(kParseWrongAlgorithm, -1);
+  }
+
+  ChargeMemory(sizeof(EdDSAKey));
+
+  /*
+   * The key material is the curve's OID, preceded by its length, and
+   * then the public point as an MPI.
+   */
+  const ByteView key_material = rhs.key_material();
+  const uint8_t* data = key_material.data();
+  const std::size_t length = key_material.length();
+
+  std::size_t position = 0;
+  fields::Region oid;
+  if (!fields::ReadPrefixed<fields::LengthPrefixed<1>>(data, length,
+                                                        &position, &oid)) {
+    return ParseError(kParseInvalidPacket, -1,
+                      "Packet too short for EdDSA curve");
+  }
+  if (oid.length != sizeof(kEd25519OID)
+      || 0 != memcmp(data + oid.offset, kEd25519OID, oid.length)) {
+    return ParseError(kParseUnsupportedFeature, -1, "non-Ed25519 curves");
+  }
+
+  fields::Region point;
+  if (!fields::ReadPrefixed<fields::MPI>(data, length, &position, &point)) {
+    return ParseError(kParseInvalidPacket, -1,
+                      "Packet too short for EdDSA point");
+  }
+  if (point.length != 1 + public_key_.size()
+      || kNativePointPrefix != data[point.offset]) {
+    return ParseError(kParseInvalidPacket, -1, "Invalid EdDSA point");
+  }
+
+  memcpy(public_key_.data(), data + point.offset + 1, public_key_.size());
+  return ParseError();
+}
+
+std::unique_ptr<VerificationContext>
+EdDSAKey::GetVerificationContext(const SignaturePacket& signature) const {
+  const mbedtls_md_info_t* hash_info = HashInfo(signature.hash_algorithm());
+  if (nullptr == hash_info) {
+    throw unsupported_feature_error(-1, "Unsupported hash function.");
+  }
+
+  return std::unique_ptr<VerificationContext>(
+      new EdDSAVerificationContext(public_key_, signature, hash_info));
+}
+
+EdDSABatchVerifier::EdDSABatchVerifier() {
+}
+
+EdDSABatchVerifier::~EdDSABatchVerifier() {
+}
+
+std::size_t EdDSABatchVerifier::Add(const EdDSAKey& key,
+                                    const SignaturePacket& signature,
+                                    const ustring& data) {
+  const mbedtls_md_info_t* hash_info = HashInfo(signature.hash_algorithm());
+  if (nullptr == hash_info) {
+    throw unsupported_feature_error(-1, "Unsupported hash function.");
+  }
+
+  Entry entry;
+  entry.public_key = key.public_key_;
+  entry.hash_algorithm = signature.hash_algorithm();
+  memcpy(entry.hash_prefix.data(), signature.hash_left_16bits(), 2);
+  entry.well_formed = ReadEdDSASignature(signature, entry.signature.data());
+
+  if ((kHashSHA1 == entry.hash_algorithm
+       || kHashSHA256 == entry.hash_algorithm)
+      && data.length() <= kDeferredHashLimit) {
+    entry.message = data;
+    entry.message.append(signature.hashed_data().data(),
+                         signature.hashed_data().length());
+    if (4 == signature.version()) {
+      entry.message += ustring((const uint8_t*)"\x04\xFF", 2);
+      entry.message += WriteInteger(signature.hashed_data().length(), 4);
+    }
+  }
+  else {
+    EdDSAVerificationContext context(key.public_key_, signature, hash_info);
+    context.Update(data);
+    entry.digest = context.Finish();
+  }
+  entries_.push_back(entry);
+  return entries_.size() - 1;
+}
+
+std::vector<bool> EdDSABatchVerifier::Verify() {
+  TraceSpan span("verify", "eddsa_batch");
+  span.SetArgument("signatures", entries_.size());
+
+  // Hash the deferred messages together.
+  MultiHasher sha1(MultiHasher::kSHA1);
+  MultiHasher sha256(MultiHasher::kSHA256);
+  std::vector<std::size_t> sha1_entries;
+  std::vector<std::size_t> sha256_entries;
+  for (std::size_t i = 0; i < entries_.size(); i++) {
+    Entry& entry = entries_[i];
+    if (!entry.digest.empty()) {
+      continue;
+    }
+    MultiHasher& hasher = kHashSHA1 == entry.hash_algorithm ? sha1 : sha256;
+    hasher.Begin();
+    hasher.Update(entry.message.data(), entry.message.length());
+    (kHashSHA1 == entry.hash_algorithm ? sha1_entries : sha256_entries)
+        .push_back(i);
+  }
+  std::vector<ustring> sha1_digests = sha1.Finish();
+  std::vector<ustring> sha256_digests = sha256.Finish();
+  for (std::size_t i = 0; i < sha1_entries.size(); i++) {
+    entries_[sha1_entries[i]].digest.swap(sha1_digests[i]);
+  }
+  for (std::size_t i = 0; i < sha256_entries.size(); i++) {
+    entries_[sha256_entries[i]].digest.swap(sha256_digests[i]);
+  }
+
+  std::vector<bool> results(entries_.size(), false);
+  std::vector<ed25519::BatchEntry> batch;
+  std::vector<std::size_t> indices;
+  for (std::size_t i = 0; i < entries_.size(); i++) {
+    const Entry& entry = entries_[i];
+    if (!entry.well_formed
+        || entry.digest[0] != entry.hash_prefix[0]
+        || entry.digest[1] != entry.hash_prefix[1]) {
+      continue;
+    }
+    ed25519::BatchEntry batch_entry = {
+      entry.public_key.data(), entry.signature.data(),
+      entry.digest.data(), entry.digest.length()};
+    batch.push_back(batch_entry);
+    indices.push_back(i);
+  }
+
+  if (ed25519::VerifyBatch(batch)) {
+    for (auto i = indices.begin(); i != indices.end(); i++) {
+      results[*i] = true;
+    }
+  }
+  else {
+    // Find the culprits one by one.
+    for (std::size_t i = 0; i < batch.size(); i++) {
+      results[indices[i]] = ed25519::Verify(
+          batch[i].public_key, batch[i].signature,
+          batch[i].message, batch[i].message_length);
+    }
+  }
+
+  entries_.clear();
+  return results;
+}
+
+/// @endcond
+
+#ifdef INCLUDE_TESTS
+
+TEST(EdDSAKey, Verify) {
+  const ustring key_data((const uint8_t*)
+      "\x98\x33\x04\x6A\xD5\x41\x9A\x16\x09\x2B\x06\x01\x04\x01\xDA\x47"
+      "\x0F\x01\x01\x07\x40\x8D\x34\x30\x60\x24\xF1\x96\x7C\x00\x64\xF9"
+      "\x50\x39\x71\x76\xAB\x5C\x4E\xDE\xEE\x78\x87\x04\x1A\x63\x2C\x83"
+      "\x5D\xA6\xE5\x1D\x87", 53);
+  const ustring signature_data((const uint8_t*)
+      "\x88\x85\x04\x00\x16\x08\x00\x2D\x16\x21\x04\xE3\x7D\xE8\x87\xB6"
+      "\xA2\xB6\xEB\x70\x93\x1A\x6D\x23\xBF\xDA\x20\x17\xA2\xEE\x02\x05"
+      "\x02\x6A\xD5\x41\x9A\x0F\x1C\x65\x64\x40\x65\x78\x61\x6D\x70\x6C"
+      "\x65\x2E\x6F\x72\x67\x00\x0A\x09\x10\x23\xBF\xDA\x20\x17\xA2\xEE"
+      "\x02\xCE\x13\x01\x00\xA6\x24\x63\xC3\xCD\xCA\xD8\xAC\xCC\xCB\xCF"
+      "\x29\xC2\x4B\x5A\x82\x07\x26\xC8\xE9\x0B\x1A\x8B\xCF\x9C\x41\xFE"
+      "\x75\xD0\x5B\xE9\x3D\x01\x00\xF1\xA3\xD7\x0F\x24\xEF\x3C\xD1\x3C"
+      "\x78\xC7\xEE\xAD\x22\x80\x11\xE5\xC0\x50\x0C\xC3\x5F\xEE\x8D\xA7"
+      "\xBB\xD9\x4B\x45\xBB\x8A\x0F", 135);
+  const ustring data((const uint8_t*)"hello world\n", 12);
+  const ustring forged((const uint8_t*)"hello world!", 12);
+
+  std::shared_ptr<PublicKeyPacket> key_packet =
+      std::dynamic_pointer_cast<PublicKeyPacket>(parse(key_data).front());
+  std::shared_ptr<SignaturePacket> signature =
+      std::dynamic_pointer_cast<SignaturePacket>(
+          parse(signature_data).front());
+  ASSERT_TRUE(key_packet && signature);
+
+  std::unique_ptr<Key> key = Key::ParseKey(*key_packet);
+  std::unique_ptr<VerificationContext> context =
+      key->GetVerificationContext(*signature);
+  context->Update(data);
+  ASSERT_TRUE(context->Verify());
+
+  context = key->GetVerificationContext(*signature);
+  context->Update(forged);
+  ASSERT_FALSE(context->Verify());
+
+  // A bad signature in a batch is picked out without affecting the rest.
+  const EdDSAKey& eddsa_key = dynamic_cast<const EdDSAKey&>(*key);
+  EdDSABatchVerifier batch;
+  for (int i = 0; i < 8; i++) {
+    batch.Add(eddsa_key, *signature, 5 == i ? forged : data);
+  }
+  std::vector<bool> results = batch.Verify();
+  ASSERT_EQ(results.size(), 8);
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(results[i], 5 != i);
+  }
+
+  batch.Add(eddsa_key, *signature, data);
+  ASSERT_EQ(batch.Verify(), std::vector<bool>(1, true));
+}
+
+#endif  // INCLUDE_TESTS
+
+}
@@ -3,7 +3,10 @@
 #include "exceptions.h"
 #include "keys/key.h"
 #include "keys/rsakey.h"
+#include "keys/eddsakey.h"
+#include "keys/ecdsakey.h"
 #include "constants.h"
+#include "trace.h"
 
 namespace parse4880 {
 
@@ -19,22 +22,51 @@ VerificationContext::~VerificationContext() {
 Key::~Key() {
 }
 
+void VerificationContext::ChargeMemory(std::size_t bytes) {
+  memory_charge_.Reset(kMemoryVerificationContexts, 0, bytes);
+}
+
+void Key::ChargeMemory(std::size_t bytes) {
+  memory_charge_.Reset(kMemoryKeys, 0, bytes);
+}
+
 std::unique_ptr<Key> Key::ParseKey(const PublicKeyPacket& packet) {
-  std::unique_ptr<Key> parsed_key;
+  ParseResult<std::unique_ptr<Key>> result = TryParseKey(packet);
+  if (!result.ok()) {
+    ThrowParseError(result.error);
+  }
+  return std::move(result.value);
+}
+
+ParseResult<std::unique_ptr<Key>> Key::TryParseKey(
+    const PublicKeyPacket& packet) {
+  TraceSpan span("parse", "key");
+  span.SetArgument("algorithm", packet.public_key_algorithm());
+  PARSE4880_PROBE1(key, packet.public_key_algorithm());
+
+  ParseResult<std::unique_ptr<Key>> result;
   switch (packet.public_key_algorithm()) {
     case kPublicKeyRSAEncryptOrSign:
     case kPublicKeyRSAEncryptOnly:
     case kPublicKeyRSASignOnly:
-      parsed_key.reset(new RSAKey(packet));
-      if (nullptr == parsed_key) {
-        // FIXME: This should be a custom type.
-        throw std::runtime_error("Parsing failed.");
-      }
-      return parsed_key;
+      result.value.reset(new RSAKey(packet, &result.error));
+      break;
+    case kPublicKeyECDSA:
+      result.value.reset(new ECDSAKey(packet, &result.error));
+      break;
+    case kPublicKeyEdDSA:
+      result.value.reset(new EdDSAKey(packet, &result.error));
       break;
     default:
-      throw invalid_packet_error("Unsupported key type.");
+      result.error = ParseError(kParseInvalidPacket, -1,
+                                "Unsupported key type.");
+      break;
+  }
+
+  if (!result.ok()) {
+    result.value.reset();
   }
+  return result;
 }
 
 }
@@ -10,8 +10,10 @@
 #include "parser.h"
 #include "constants.h"
 #include "exceptions.h"
+#include "fields.h"
 #include "keys/rsakey.h"
 #include "packets/signature.h"
+#include "trace.h"
 
 namespace parse4880 {
 
@@ -62,52 +64,51 @@ class RSAVerificationContext : public VerificationContext {
  *
  * @param key_material    The public key to be parsed.
  * @param public_key_ctx  The public key context to be initialised.
+ *
+ * @return The status of the parse.
  */
-void ReadRSAPublicKey(ustring key_material,
-                      mbedtls_rsa_context* public_key) {
+ParseError ReadRSAPublicKey(ByteView key_material,
+                            mbedtls_rsa_context* public_key) {
+  const uint8_t* data = key_material.data();
+  const size_t length = key_material.length();
+
   /*
    * The public key format is simply two multiprecision integers.
    * We start by making sure that there is a length field...
    */
-  if (key_material.length() < 2) {
-    throw parse4880::invalid_packet_error("Packet too short to be RSA key");
+  if (length < 2) {
+    return ParseError(kParseInvalidPacket, -1,
+                      "Packet too short to be RSA key");
   }
 
-  // Then we read it and check that there are enough bits in the string.
-  size_t modulus_length = parse4880::ReadInteger(key_material.substr(0,2));
-
-  modulus_length = ((modulus_length+7) / 8);
-  if (key_material.length() < 4 + modulus_length) {
-    throw parse4880::invalid_packet_error("Packet too short for RSA modulus");
+  // Then we read it and check that there are enough bits in the string,
+  // leaving room for the exponent's length field.
+  size_t position = 0;
+  fields::Region modulus;
+  if (!fields::ReadPrefixed<fields::MPI>(data, length, &position, &modulus)
+      || length - position < 2) {
+    return ParseError(kParseInvalidPacket, -1,
+                      "Packet too short for RSA modulus");
   }
 
-  // First comes the modulus.  We extract and decode it.
-  const ustring modulus_encoded = key_material.substr(2, modulus_length);
-  assert(modulus_encoded.length() == modulus_length);
-  mbedtls_mpi_read_binary(
-      &public_key->N,
-      modulus_encoded.c_str(),
-      modulus_length);
+  // First comes the modulus, which we decode in place.
+  mbedtls_mpi_read_binary(&public_key->N, data + modulus.offset,
+                          modulus.length);
 
   // We need to set the key length too.
-  public_key->len = modulus_length;
+  public_key->len = modulus.length;
 
   // Now the exponent.  We have already checked that the header is there.
-  size_t exponent_length = parse4880::ReadInteger(
-      key_material.substr(2+modulus_length,2));
-  exponent_length = ((exponent_length +7) / 8);
-  if (key_material.length() < 4 + modulus_length + exponent_length) {
-    throw parse4880::invalid_packet_error("Packet too short for RSA exponent");
+  fields::Region exponent;
+  if (!fields::ReadPrefixed<fields::MPI>(data, length, &position, &exponent)) {
+    return ParseError(kParseInvalidPacket, -1,
+                      "Packet too short for RSA exponent");
   }
 
-  const ustring exponent_encoded =
-      key_material.substr(4+modulus_length, exponent_length);
-  assert(exponent_encoded.length() == exponent_length);
-  mbedtls_mpi_read_binary(
-      &public_key->E,
-      reinterpret_cast<const uint8_t*>(exponent_encoded.c_str()),
-      exponent_length);
+  mbedtls_mpi_read_binary(&public_key->E, data + exponent.offset,
+                          exponent.length);
 
+  return ParseError();
 }
 
 template <mbedtls_md_type_t hash_id>
@@ -122,6 +123,7 @@ RSAVerificationContext<hash_id>::RSAVerificationContext(
 
   mbedtls_rsa_init(&public_key_, MBEDTLS_RSA_PKCS_V15, 0);
   mbedtls_rsa_copy(&public_key_, &public_key);
+  ChargeMemory(sizeof(*this));
 }
 
 template <mbedtls_md_type_t hash_id>
@@ -133,6 +135,8 @@ RSAVerificationContext<hash_id>::~RSAVerificationContext() {
 template <mbedtls_md_type_t hash_id>
 void RSAVerificationContext<hash_id>::Update(const uint8_t* data,
                                              std::size_t len) {
+  TraceSpan span("verify", "hash");
+  span.SetArgument("length", len);
   mbedtls_md_update(&hash_ctx_, data, len);
 }
 
@@ -143,7 +147,12 @@ void RSAVerificationContext<hash_id>::Update(const ustring& data) {
 
 template <mbedtls_md_type_t hash_id>
 bool RSAVerificationContext<hash_id>::Verify() {
-  Update(signature_.hashed_data());
+  TraceSpan span("verify", "verify");
+  span.SetArgument("hash_algorithm", signature_.hash_algorithm());
+  PARSE4880_PROBE2(verify, signature_.public_key_algorithm(),
+                   signature_.hash_algorithm());
+
+  Update(signature_.hashed_data().data(), signature_.hashed_data().length());
 
   if (4 == signature_.version()) {
     const uint8_t trailer[]  = {0x04, 0xFF};
@@ -156,13 +165,22 @@ bool RSAVerificationContext<hash_id>::Verify() {
   mbedtls_md_finish(&hash_ctx_, hash.get());
   mbedtls_md_free(&hash_ctx_);
 
-  // Extract the signature itself from the packet.
-  ustring signature = signature_.signature().substr(2);
+  // A digest that fails the quick check need not go to the modexp.
+  if (!signature_.MatchesHashPrefix(hash.get())) {
+    return false;
+  }
+
+  // Extract the signature itself from the packet, skipping the MPI's
+  // bit count.
+  const ByteView mpi = signature_.signature();
+  if (mpi.length() < 2 || mpi.length() - 2 > public_key_.len) {
+    return false;
+  }
+  ustring signature = mpi.substr(2).str();
 
   // MbedTLS requires that the signature have the same length as
   // the key, so we pad it with zeros if it is less.
-  signature = ustring('\0', public_key_.len - signature.length())
-      + signature;
+  signature = ustring(public_key_.len - signature.length(), 0) + signature;
 
   int result = mbedtls_rsa_rsassa_pkcs1_v15_verify(
       &public_key_, NULL, NULL, MBEDTLS_RSA_PUBLIC, hash_id, hash_size,
@@ -176,12 +194,31 @@ bool RSAVerificationContext<hash_id>::Verify() {
 
 RSAKey::RSAKey(const PublicKeyPacket& rhs)
     : impl_(new impl) {
-  if (kPublicKeyRSAEncryptOrSign != rhs.public_key_algorithm()) {
-    throw wrong_algorithm_error();
+  mbedtls_rsa_init(&impl_->rsa_context, MBEDTLS_RSA_PKCS_V15, 0);
+
+  ParseError error = Load(rhs);
+  if (!error.ok()) {
+    mbedtls_rsa_free(&impl_->rsa_context);
+    ThrowParseError(error);
   }
+}
 
+RSAKey::RSAKey(const PublicKeyPacket& rhs, ParseError* error)
+    : impl_(new impl) {
   mbedtls_rsa_init(&impl_->rsa_context, MBEDTLS_RSA_PKCS_V15, 0);
-  ReadRSAPublicKey(rhs.key_material(), &(impl_->rsa_context));
+  *error = Load(rhs);
+}
+
+ParseError RSAKey::Load(const PublicKeyPacket& rhs) {
+  if (kPublicKeyRSAEncryptOrSign != rhs.public_key_algorithm()) {
+    return ParseError(kParseWrongAlgorithm, -1);
+  }
+
+  // The modulus and exponent take about as much space as their
+  // encodings do.
+  ChargeMemory(sizeof(RSAKey) + sizeof(impl) + rhs.key_material().size());
+
+  return ReadRSAPublicKey(rhs.key_material(), &(impl_->rsa_context));
 }
 
 RSAKey::~RSAKey() {
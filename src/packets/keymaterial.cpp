@@ -5,12 +5,13 @@
 
 #include <mbedtls/md.h>
 
-#include <boost/format.hpp>
-
 #include "parser_types.h"
 #include "exceptions.h"
 #include "parser.h"
 #include "packet.h"
+#include "fields.h"
+#include "hex.h"
+#include "multihash.h"
 
 namespace parse4880 {
 
@@ -32,6 +33,48 @@ uint8_t KeyMaterialPacket::public_key_algorithm() const {
 
 PublicKeyPacket::PublicKeyPacket(const ustring& data)
     : KeyMaterialPacket(data) {
+  ChargeMemory(kMemoryPackets, 6, sizeof(PublicKeyPacket));
+  ParseError error = Parse();
+  if (!error.ok()) {
+    ThrowParseError(error);
+  }
+}
+
+PublicKeyPacket::PublicKeyPacket(const ustring& data, ParseError* error)
+    : KeyMaterialPacket(data) {
+  ChargeMemory(kMemoryPackets, 6, sizeof(PublicKeyPacket));
+  *error = Parse();
+}
+
+PublicKeyPacket::PublicKeyPacket(const ustring& data,
+                                 const ustring& fingerprint,
+                                 ParseError* error)
+    : KeyMaterialPacket(data), fingerprint_(fingerprint) {
+  ChargeMemory(kMemoryPackets, 6, sizeof(PublicKeyPacket));
+  *error = Parse();
+}
+
+std::vector<ustring> PublicKeyPacket::FingerprintKeys(
+    const uint8_t* data,
+    const std::vector<std::pair<std::size_t, std::size_t>>& contents) {
+  // Each key is preceded by 0x99 and its two-octet length, as below.
+  std::vector<uint8_t> prefixes(3 * contents.size());
+  MultiHasher hasher(MultiHasher::kSHA1);
+  for (std::size_t i = 0; i < contents.size(); i++) {
+    prefixes[3*i]     = 0x99;
+    prefixes[3*i + 1] = static_cast<uint8_t>(contents[i].second >> 8);
+    prefixes[3*i + 2] = static_cast<uint8_t>(contents[i].second);
+    hasher.Begin();
+    hasher.Update(&prefixes[3*i], 3);
+    hasher.Update(data + contents[i].first, contents[i].second);
+  }
+  return hasher.Finish();
+}
+
+ParseError PublicKeyPacket::Parse() {
+  const ustring& data = contents();
+  key_material_offset_ = 0;
+
   /*
    * A public key packet contains the following:
    *
@@ -40,22 +83,32 @@ PublicKeyPacket::PublicKeyPacket(const ustring& data)
    *   [1] Public key algorithm
    *   [?] Key material
    */
+  typedef fields::Layout<fields::U8,   // Version
+                         fields::U32,  // Creation time
+                         fields::U8>   // Public key algorithm
+      V4Layout;
+
   if (data.length() < 1) {
-    throw invalid_packet_error("Empty public-key packet");
+    return ParseError(kParseInvalidPacket, -1, "Empty public-key packet");
   }
 
   version_ = data[0];
   if (version_ != 4) {
-    throw unsupported_feature_error(-1, "non-v4 keys");
+    return ParseError(kParseUnsupportedFeature, -1, "non-v4 keys");
   }
 
-  if (data.length() < 6) {
-    throw invalid_packet_error("v4 public key packet too short");
+  if (!V4Layout::Fits(data.length())) {
+    return ParseError(kParseInvalidPacket, -1,
+                      "v4 public key packet too short");
   }
 
-  creation_time_ = ReadInteger(data.substr(1,4));
-  public_key_algorithm_ = data[5];
-  key_material_ = data.substr(6);
+  creation_time_ = V4Layout::Get<1>(data.data());
+  public_key_algorithm_ = V4Layout::Get<2>(data.data());
+  key_material_offset_ = V4Layout::size();
+
+  if (!fingerprint_.empty()) {
+    return ParseError();
+  }
 
   /*
    * The fingerprint is calculated as the SHA-1 hash of the following:
@@ -81,6 +134,8 @@ PublicKeyPacket::PublicKeyPacket(const ustring& data)
   mbedtls_md_free(&md_ctx);
 
   fingerprint_ = ustring(digest.get(), digest_length);
+
+  return ParseError();
 }
 
 uint8_t PublicKeyPacket::tag() const {
@@ -88,39 +143,41 @@ uint8_t PublicKeyPacket::tag() const {
 }
 
 std::string PublicKeyPacket::str() const {
-  const ustring& key_fingerprint = fingerprint();
-  char key_id[41]; // Flawfinder: ignore (fingerprints have known length)
-  for(int i = 0; i < 20; i+=1) {
-    snprintf(key_id+i*2, 3, "%02X",
-             static_cast<unsigned char>(key_fingerprint[i]));
-  }
-  return (boost::format("Public key: %s")
-          % key_id).str();
+  return "Public key: " + hex_string(fingerprint(), true);
 }
 
 const ustring& PublicKeyPacket::fingerprint() const {
   return fingerprint_;
 }
 
-const ustring& PublicKeyPacket::key_material() const {
-  return key_material_;
+ByteView PublicKeyPacket::key_material() const {
+  return ByteView(contents()).substr(key_material_offset_);
 }
 
 PublicSubkeyPacket::PublicSubkeyPacket(ustring contents)
-    : PublicKeyPacket(contents) {}
+    : PublicKeyPacket(contents) {
+  ChargeMemory(kMemoryPackets, 14, sizeof(PublicSubkeyPacket));
+}
+
+PublicSubkeyPacket::PublicSubkeyPacket(const ustring& contents,
+                                       ParseError* error)
+    : PublicKeyPacket(contents, error) {
+  ChargeMemory(kMemoryPackets, 14, sizeof(PublicSubkeyPacket));
+}
+
+PublicSubkeyPacket::PublicSubkeyPacket(const ustring& contents,
+                                       const ustring& fingerprint,
+                                       ParseError* error)
+    : PublicKeyPacket(contents, fingerprint, error) {
+  ChargeMemory(kMemoryPackets, 14, sizeof(PublicSubkeyPacket));
+}
 
 uint8_t PublicSubkeyPacket::tag() const {
   return 14;
 }
 
 std::string PublicSubkeyPacket::str() const {
-  const ustring& key_fingerprint = fingerprint();
-  char key_id[41]; // Flawfinder: ignore (fingerprints have known length)
-  for(int i = 0; i < 20; i+=1) {
-    snprintf(key_id+i*2, 3, "%02X",
-             static_cast<unsigned char>(key_fingerprint[i]));
-  }
-  return (boost::format("Public subkey: %s") % key_id).str();
+  return "Public subkey: " + hex_string(fingerprint(), true);
 }
 
 }
@@ -0,0 +1,128 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#include "parser.h"
+#endif
+
+#include "packet.h"
+#include "parser_types.h"
+
+namespace parse4880 {
+
+/// @cond SHOW_INTERNAL
+
+namespace {
+
+const std::size_t kTagCount = 64;
+
+std::shared_ptr<PGPPacket> MakeUnknownPacket(uint8_t tag,
+                                             const ustring& contents,
+                                             const ParseLimits&,
+                                             ParseError* error) {
+  *error = ParseError();
+  return std::shared_ptr<PGPPacket>(new UnknownPGPPacket(tag, contents));
+}
+
+constexpr PacketFactory BuiltinFactory(uint8_t tag) {
+  return  2 == tag ? &make_limited_packet<SignaturePacket>
+       :  6 == tag ? &make_packet<PublicKeyPacket>
+       : 13 == tag ? &make_packet<UserIDPacket>
+       : 14 == tag ? &make_packet<PublicSubkeyPacket>
+       : &MakeUnknownPacket;
+}
+
+// Constant-initialised, so that applications can register their own
+// packet types from static constructors.
+#define PARSE4880_BUILTIN(tag) {BuiltinFactory(tag)}
+#define PARSE4880_BUILTIN8(tag) \
+  PARSE4880_BUILTIN(tag),     PARSE4880_BUILTIN(tag + 1), \
+  PARSE4880_BUILTIN(tag + 2), PARSE4880_BUILTIN(tag + 3), \
+  PARSE4880_BUILTIN(tag + 4), PARSE4880_BUILTIN(tag + 5), \
+  PARSE4880_BUILTIN(tag + 6), PARSE4880_BUILTIN(tag + 7)
+
+std::atomic<PacketFactory> factories[kTagCount] = {
+  PARSE4880_BUILTIN8(0),  PARSE4880_BUILTIN8(8),
+  PARSE4880_BUILTIN8(16), PARSE4880_BUILTIN8(24),
+  PARSE4880_BUILTIN8(32), PARSE4880_BUILTIN8(40),
+  PARSE4880_BUILTIN8(48), PARSE4880_BUILTIN8(56)
+};
+
+#undef PARSE4880_BUILTIN8
+#undef PARSE4880_BUILTIN
+
+}
+
+/// @endcond
+
+PacketFactory register_packet_type(uint8_t tag, PacketFactory factory) {
+  tag &= kTagCount - 1;
+  if (nullptr == factory) {
+    factory = BuiltinFactory(tag);
+  }
+  return factories[tag].exchange(factory, std::memory_order_acq_rel);
+}
+
+PacketFactory packet_factory(uint8_t tag) {
+  return factories[tag & (kTagCount - 1)].load(std::memory_order_acquire);
+}
+
+PacketFactory builtin_packet_factory(uint8_t tag) {
+  return BuiltinFactory(tag & (kTagCount - 1));
+}
+
+}
+
+#ifdef INCLUDE_TESTS
+
+namespace {
+
+/**
+ * A packet type from the private range, holding a single octet.
+ */
+class OctetPacket : public parse4880::PGPPacket {
+ public:
+  OctetPacket(const parse4880::ustring& contents,
+              parse4880::ParseError* error)
+      : PGPPacket(contents) {
+    if (1 != contents.length()) {
+      *error = parse4880::ParseError(parse4880::kParseInvalidPacket, 0,
+                                     "octet packet must be one octet long");
+    }
+  }
+
+  virtual uint8_t tag() const { return 60; }
+  virtual std::string str() const { return "Octet"; }
+};
+
+}
+
+namespace parse4880 {
+
+TEST(PacketRegistry, UserFactory) {
+  const ustring data{0xFC, 1, 42, 0xFC, 2, 0, 0};
+
+  std::list<std::shared_ptr<PGPPacket>> packets = parse(data);
+  ASSERT_EQ(packets.size(), 2);
+  ASSERT_NE(dynamic_cast<UnknownPGPPacket*>(packets.front().get()), nullptr);
+
+  ASSERT_EQ(register_packet_type(60, &make_packet<OctetPacket>),
+            builtin_packet_factory(60));
+  packets = parse(data);
+  ASSERT_EQ(packets.size(), 2);
+  ASSERT_NE(dynamic_cast<OctetPacket*>(packets.front().get()), nullptr);
+  ASSERT_EQ(packets.front()->contents(), ustring{42});
+  // The malformed packet falls back to an UnknownPGPPacket.
+  ASSERT_NE(dynamic_cast<UnknownPGPPacket*>(packets.back().get()), nullptr);
+  ASSERT_FALSE(PGPPacket::TryParsePacket(60, ustring{0, 0}).ok());
+
+  register_packet_type(60, nullptr);
+  ASSERT_EQ(packet_factory(60), builtin_packet_factory(60));
+  ASSERT_EQ(packet_factory(2), &make_limited_packet<SignaturePacket>);
+}
+
+}
+
+#endif
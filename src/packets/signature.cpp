@@ -1,27 +1,60 @@
+#include <string.h>
+
 #include <memory>
 #include <list>
-
-#include "boost/format.hpp"
+#include <string>
 
 #include "parser_types.h"
 #include "packet.h"
 #include "exceptions.h"
 #include "parser.h"
+#include "fields.h"
+#include "hex.h"
 
 namespace parse4880 {
 
-/**
- * @todo Copy the creation time.
- * @todo Copy the quick-check field.
- */
 SignaturePacket::SignaturePacket(ustring packet_data)
     : PGPPacket(packet_data) {
+  ChargeMemory(kMemoryPackets, 2, sizeof(SignaturePacket));
+  ParseError error = Parse(ParseLimits());
+  if (!error.ok()) {
+    ThrowParseError(error);
+  }
+}
+
+SignaturePacket::SignaturePacket(const ustring& packet_data, ParseError* error)
+    : PGPPacket(packet_data) {
+  ChargeMemory(kMemoryPackets, 2, sizeof(SignaturePacket));
+  *error = Parse(ParseLimits());
+}
+
+SignaturePacket::SignaturePacket(const ustring& packet_data,
+                                 const ParseLimits& limits, ParseError* error)
+    : PGPPacket(packet_data) {
+  ChargeMemory(kMemoryPackets, 2, sizeof(SignaturePacket));
+  *error = Parse(limits);
+}
+
+ParseError SignaturePacket::Parse(const ParseLimits& limits) {
+  const ustring& packet_data = contents();
+  const uint8_t* data = packet_data.data();
+  const size_t length = packet_data.length();
+
   // We need to parse a signature subpacket.  This could be either
   // a v3 or v4 signature, so we need to check first and switch on that.
-  if (packet_data.length() < 1) {
-    throw invalid_packet_error("Empty signature packet");
+  if (length < 1) {
+    return ParseError(kParseInvalidPacket, -1, "Empty signature packet");
   }
-  version_ = packet_data.at(0);
+  version_ = data[0];
+  has_key_id_ = false;
+  hashed_subpacket_count_ = 0;
+  hashed_subpacket_data_ = fields::Region();
+  unhashed_subpacket_data_ = fields::Region();
+  signature_ = fields::Region();
+  hashed_data_ = fields::Region();
+  creation_time_ = -1;
+  signature_expiration_time_ = 0;
+  key_expiration_time_ = 0;
   if (version_ == 3) {
     // A version three signature packet has the following:
     //
@@ -36,39 +69,48 @@ SignaturePacket::SignaturePacket(ustring packet_data)
     // [?] Signature
     //
     // This adds up to nineteen bytes plus the signature.
-    if (packet_data.length() < 19) {
-      throw invalid_packet_error("Signature packet too short");
+    typedef fields::Layout<fields::U8,          // Version
+                           fields::U8,          // Length of hashed material
+                           fields::U8,          // Signature type
+                           fields::U32,         // Creation time
+                           fields::Octets<8>,   // Key ID
+                           fields::U8,          // Public-key algorithm
+                           fields::U8,          // Hash algorithm
+                           fields::Octets<2> >  // Left sixteen bits
+        V3Layout;
+    static_assert(V3Layout::size() == 19, "v3 signature layout is 19 octets");
+
+    if (!V3Layout::Fits(length)) {
+      return ParseError(kParseInvalidPacket, -1, "Signature packet too short");
     }
 
     // There should always be five bytes of hashed material, so check
     // that the provided length is correct.
-    if (5 != packet_data.at(1)) {
-      throw invalid_packet_error("Wrong amount of hashed material for "
-                                 "v3 packet");
+    if (5 != V3Layout::Get<1>(data)) {
+      return ParseError(kParseInvalidPacket, -1,
+                        "Wrong amount of hashed material for v3 packet");
     }
 
     // We already know that the remainder of the data is there, so
     // we can just go ahead and copy it.
+    signature_type_ = V3Layout::Get<2>(data);
+    creation_time_ = V3Layout::Get<3>(data);
 
-    // Signature type (byte 2)
-    signature_type_ = packet_data.at(2);
-
-    // TODO: Copy the creation time (bytes 3--6)
-
-    // Key ID (bytes 7--14)
-    key_id_ = packet_data.substr(7,8).c_str();
+    memcpy(key_id_, V3Layout::Get<4>(data), 8);
+    has_key_id_ = true;
 
-    // Algorithms (bytes 14--15)
-    public_key_algorithm_ = packet_data.at(15);
-    hash_algorithm_ = packet_data.at(16);
+    public_key_algorithm_ = V3Layout::Get<5>(data);
+    hash_algorithm_ = V3Layout::Get<6>(data);
 
-    // TODO: Copy the hash quick-check field (bytes 17--18)
+    memcpy(hash_left_16bits_, V3Layout::Get<7>(data), 2);
 
     // The rest of the packet is the signature.
-    signature_ = packet_data.substr(19);
+    signature_.offset = V3Layout::size();
+    signature_.length = length - V3Layout::size();
 
-    // Finally, save the signature data to be hashed.
-    hashed_data_ = packet_data.substr(2, 5);
+    // Finally, note the signature data to be hashed.
+    hashed_data_.offset = V3Layout::offset<2>();
+    hashed_data_.length = 5;
   }
   else if(version_ == 4) {
     // A version four signature has the following:
@@ -83,46 +125,94 @@ SignaturePacket::SignaturePacket(ustring packet_data)
     //     [?] Unhashed subpacket data
     //   [2] Left sixteen bits of hash value
     //   [?] Signature
-
-    if (packet_data.length() < 10) {
-      throw invalid_packet_error("v4 packet too short");
+    typedef fields::Layout<fields::U8,   // Version number
+                           fields::U8,   // Signature type
+                           fields::U8,   // Public-key algorithm
+                           fields::U8>   // Hash algorithm
+        V4Layout;
+
+    if (length < 10) {
+      return ParseError(kParseInvalidPacket, -1, "v4 packet too short");
     }
 
-    signature_type_       = packet_data.at(1);
-    public_key_algorithm_ = packet_data.at(2);
-    hash_algorithm_       = packet_data.at(3);
-
-    size_t hashed_data_count = ReadInteger(packet_data.substr(4,2));
-    if (packet_data.length() < 10+hashed_data_count) {
-      throw invalid_packet_error("v4 packet too short for hashed subpackets");
+    signature_type_       = V4Layout::Get<1>(data);
+    public_key_algorithm_ = V4Layout::Get<2>(data);
+    hash_algorithm_       = V4Layout::Get<3>(data);
+
+    // Each subpacket area must leave room for the fields that follow it.
+    size_t position = V4Layout::size();
+    fields::Region hashed;
+    if (!fields::ReadPrefixed<fields::LengthPrefixed<2>>(
+            data, length, &position, &hashed)
+        || length - position < 4) {
+      return ParseError(kParseInvalidPacket, -1,
+                        "v4 packet too short for hashed subpackets");
     }
-    hashed_subpacket_data_ = packet_data.substr(6, hashed_data_count);
-    subpackets_ = parse_subpackets(hashed_subpacket_data_);
-
-    hashed_data_ = packet_data.substr(0, 6+hashed_data_count);
-
-    size_t unhashed_data_count =
-        ReadInteger(packet_data.substr(6+hashed_data_count, 2));
-
-    if (packet_data.length() < 10+hashed_data_count+unhashed_data_count) {
-      throw invalid_packet_error("v4 packet too short for unhashed subpackets");
+    hashed_subpacket_data_ = hashed;
+    ParseResult<std::list<std::shared_ptr<PGPPacket>>> hashed_subpackets =
+        try_parse_subpackets(packet_data.substr(hashed.offset,
+                                                hashed.length),
+                             limits);
+    if (!hashed_subpackets.ok()) {
+      return hashed_subpackets.error;
     }
-    unhashed_subpacket_data_ =
-        packet_data.substr(6+hashed_data_count+2, unhashed_data_count);
 
-    subpackets_.splice(subpackets_.end(),
-                       parse_subpackets(unhashed_subpacket_data_));
+    // Only times in the hashed area can be trusted.
+    for (auto i = hashed_subpackets.value.begin();
+         i != hashed_subpackets.value.end(); i++) {
+      if (4 != (*i)->contents().length()) {
+        continue;
+      }
+      switch ((*i)->tag() & 0x7F) {
+        case 2:
+          creation_time_ = ReadInteger((*i)->contents());
+          break;
+        case 3:
+          signature_expiration_time_ = ReadInteger((*i)->contents());
+          break;
+        case 9:
+          key_expiration_time_ = ReadInteger((*i)->contents());
+          break;
+      }
+    }
+    subpackets_ = std::move(hashed_subpackets.value);
+    hashed_subpacket_count_ = subpackets_.size();
+
+    hashed_data_.offset = 0;
+    hashed_data_.length = position;
+
+    fields::Region unhashed;
+    if (!fields::ReadPrefixed<fields::LengthPrefixed<2>>(
+            data, length, &position, &unhashed)
+        || length - position < 2) {
+      return ParseError(kParseInvalidPacket, -1,
+                        "v4 packet too short for unhashed subpackets");
+    }
+    unhashed_subpacket_data_ = unhashed;
+
+    // The two areas share a single limit on the number of subpackets.
+    ParseLimits unhashed_limits = limits;
+    unhashed_limits.max_subpackets -= subpackets_.size();
+    ParseResult<std::list<std::shared_ptr<PGPPacket>>> unhashed_subpackets =
+        try_parse_subpackets(packet_data.substr(unhashed.offset,
+                                                unhashed.length),
+                             unhashed_limits);
+    if (!unhashed_subpackets.ok()) {
+      return unhashed_subpackets.error;
+    }
+    subpackets_.splice(subpackets_.end(), unhashed_subpackets.value);
 
-    // TODO: Left sixteen bits
+    // We checked above that there is room for the quick-check field.
+    memcpy(hash_left_16bits_, data + position, 2);
 
-    signature_ = packet_data.substr(6 + hashed_data_count
-                                    + 2 + unhashed_data_count + 2);
+    signature_.offset = position + 2;
+    signature_.length = length - position - 2;
   }
   else {
-    throw unsupported_feature_error(-1, "non-v3/v4 signatures");
+    return ParseError(kParseUnsupportedFeature, -1, "non-v3/v4 signatures");
   }
 
-  SetSignaturePropertiesFromSubpackets();
+  return SetSignaturePropertiesFromSubpackets();
 }
 
 uint8_t SignaturePacket::tag() const {
@@ -130,16 +220,9 @@ uint8_t SignaturePacket::tag() const {
 }
 
 std::string SignaturePacket::str() const {
-  char uid_string[17]; // Flawfinder: ignore (uids have known length)
-  snprintf(uid_string, 17, "%02x%02x%02x%02x%02x%02x%02x%02x",
-           key_id_[0], key_id_[1], key_id_[2],
-           key_id_[3], key_id_[4], key_id_[5],
-           key_id_[6], key_id_[7]);
-  return (boost::format("Signature, version %d, type 0x%02x, "
-                        "uid %s")
-          % static_cast<int>(version_)
-          % static_cast<int>(signature_type_)
-          % uid_string).str();
+  return "Signature, version " + std::to_string(version_)
+      + ", type 0x" + hex_string(ByteView(&signature_type_, 1))
+      + ", uid " + hex_string(key_id());
 }
 
 uint8_t SignaturePacket::version() const {
@@ -158,27 +241,50 @@ uint8_t SignaturePacket::hash_algorithm() const {
   return hash_algorithm_;
 }
 
-const ustring& SignaturePacket::hashed_subpacket_data() const {
-  return hashed_subpacket_data_;
+ByteView SignaturePacket::hashed_subpacket_data() const {
+  return ByteView(contents()).substr(hashed_subpacket_data_.offset,
+                                     hashed_subpacket_data_.length);
+}
+
+ByteView SignaturePacket::unhashed_subpacket_data() const {
+  return ByteView(contents()).substr(unhashed_subpacket_data_.offset,
+                                     unhashed_subpacket_data_.length);
 }
 
-const ustring& SignaturePacket::unhashed_subpacket_data() const {
-  return unhashed_subpacket_data_;
+int64_t SignaturePacket::creation_time() const {
+  return creation_time_;
+}
+
+int64_t SignaturePacket::signature_expiration_time() const {
+  return signature_expiration_time_;
+}
+
+int64_t SignaturePacket::key_expiration_time() const {
+  return key_expiration_time_;
 }
 
 const uint8_t* SignaturePacket::hash_left_16bits() const {
   return hash_left_16bits_;
 }
 
-const ustring& SignaturePacket::signature() const {
-  return signature_;
+bool SignaturePacket::MatchesHashPrefix(const uint8_t* digest) const {
+  return digest[0] == hash_left_16bits_[0]
+      && digest[1] == hash_left_16bits_[1];
+}
+
+ByteView SignaturePacket::signature() const {
+  return ByteView(contents()).substr(signature_.offset, signature_.length);
+}
+
+std::size_t SignaturePacket::hashed_subpacket_count() const {
+  return hashed_subpacket_count_;
 }
 
-const ustring& SignaturePacket::key_id() const {
-  return key_id_;
+ByteView SignaturePacket::key_id() const {
+  return has_key_id_ ? ByteView(key_id_, 8) : ByteView();
 }
 
-void SignaturePacket::SetSignaturePropertiesFromSubpackets() {
+ParseError SignaturePacket::SetSignaturePropertiesFromSubpackets() {
   const std::list<std::shared_ptr<PGPPacket>>& subpackets = this->subpackets();
   for (auto current_subpacket_ptr  = subpackets.begin();
             current_subpacket_ptr != subpackets.end();
@@ -192,18 +298,22 @@ void SignaturePacket::SetSignaturePropertiesFromSubpackets() {
     }
 
     if (16 == subpacket->tag()) {
-      ustring subpacket_key_id = subpacket->contents();
+      const ustring& subpacket_key_id = subpacket->contents();
       if (8 != subpacket_key_id.length()) {
-        throw invalid_packet_error(
-            "Signature issuer subpacket has wrong length.");
+        return ParseError(kParseInvalidPacket, -1,
+                          "Signature issuer subpacket has wrong length.");
       }
-      key_id_ = subpacket_key_id;
+      memcpy(key_id_, subpacket_key_id.data(), 8);
+      has_key_id_ = true;
     }
   }
+
+  return ParseError();
 }
 
-const ustring& SignaturePacket::hashed_data() const {
-  return hashed_data_;
+ByteView SignaturePacket::hashed_data() const {
+  return ByteView(contents()).substr(hashed_data_.offset,
+                                     hashed_data_.length);
 }
 
 }
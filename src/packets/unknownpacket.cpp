@@ -2,8 +2,6 @@
 #include <memory>
 #include <list>
 
-#include "boost/format.hpp"
-
 #include "parser_types.h"
 #include "packet.h"
 #include "exceptions.h"
@@ -11,15 +9,18 @@
 
 namespace parse4880 {
 
-UnknownPGPPacket::UnknownPGPPacket(uint8_t tag, ustring contents)
-    : PGPPacket(contents), tag_(tag) {}
+UnknownPGPPacket::UnknownPGPPacket(uint8_t tag, ustring contents,
+                                   MemorySubsystem subsystem)
+    : PGPPacket(contents), tag_(tag) {
+  ChargeMemory(subsystem, tag, sizeof(UnknownPGPPacket));
+}
 
 uint8_t UnknownPGPPacket::tag() const {
   return tag_;
 }
 
 std::string UnknownPGPPacket::str() const {
-  return (boost::format("Type %1%") % static_cast<int>(tag_)).str();
+  return "Type " + std::to_string(tag_);
 }
 
 }
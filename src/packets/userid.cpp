@@ -1,4 +1,5 @@
-#include <boost/format.hpp>
+#include <string>
+#include <utility>
 
 #include "packet.h"
 #include "parser_types.h"
@@ -6,8 +7,13 @@
 namespace parse4880 {
 
 UserIDPacket::UserIDPacket(ustring contents)
-    : PGPPacket(contents) {
-  user_id_ = contents;
+    : PGPPacket(std::move(contents)) {
+  ChargeMemory(kMemoryPackets, 13, sizeof(UserIDPacket));
+}
+
+UserIDPacket::UserIDPacket(const ustring& contents, ParseError* error)
+    : UserIDPacket(contents) {
+  *error = ParseError();
 }
 
 uint8_t UserIDPacket::tag() const {
@@ -15,12 +21,11 @@ uint8_t UserIDPacket::tag() const {
 }
 
 std::string UserIDPacket::str() const {
-  return (boost::format("User ID: %s")
-          % std::string(user_id_.begin(), user_id_.end())).str();
+  return "User ID: " + user_id();
 }
 
 std::string UserIDPacket::user_id() const {
-  return std::string(user_id_.begin(), user_id_.end());
+  return std::string(contents().begin(), contents().end());
 }
 
 }
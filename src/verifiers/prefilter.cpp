@@ -0,0 +1,139 @@
+#include <cstdint>
+#include <limits>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "parser_types.h"
+#include "parser.h"
+#include "packet.h"
+#include "constants.h"
+#include "prefilter.h"
+
+namespace parse4880 {
+
+namespace {
+
+/**
+ * Map a public-key algorithm to the family of algorithms whose
+ * signatures it can make, or zero if it cannot sign.
+ */
+int SigningFamily(uint8_t algorithm) {
+  switch (algorithm) {
+    case kPublicKeyRSAEncryptOrSign:
+    case kPublicKeyRSASignOnly:
+      return kPublicKeyRSAEncryptOrSign;
+    case kPublicKeyRSAEncryptOnly:
+    case kPublicKeyElGamal:
+    case kPublicKeyECDH:
+      return 0;
+    default:
+      return algorithm;
+  }
+}
+
+}  // namespace
+
+SignaturePrefilter::SignaturePrefilter()
+    : not_after_(std::numeric_limits<int64_t>::max()) {
+}
+
+SignaturePrefilter& SignaturePrefilter::AcceptType(uint8_t signature_type) {
+  types_.set(signature_type);
+  return *this;
+}
+
+SignaturePrefilter& SignaturePrefilter::NotAfter(int64_t time) {
+  not_after_ = time;
+  return *this;
+}
+
+PrefilterResult SignaturePrefilter::Check(
+    const PublicKeyPacket& key, const SignaturePacket& signature) const {
+  // The key ID is the low 64 bits of a v4 fingerprint.
+  const ByteView key_id = signature.key_id();
+  const ustring& fingerprint = key.fingerprint();
+  if (8 == key_id.length() && fingerprint.length() >= 8
+      && ByteView(fingerprint).substr(fingerprint.length() - 8) != key_id) {
+    return kPrefilterKeyID;
+  }
+
+  int family = SigningFamily(key.public_key_algorithm());
+  if (0 == family
+      || family != SigningFamily(signature.public_key_algorithm())) {
+    return kPrefilterAlgorithm;
+  }
+
+  if (types_.any() && !types_.test(signature.signature_type())) {
+    return kPrefilterSignatureType;
+  }
+
+  int64_t creation_time = signature.creation_time();
+  if (creation_time < 0 || creation_time < key.creation_time()
+      || creation_time > not_after_) {
+    return kPrefilterCreationTime;
+  }
+
+  return kPrefilterPass;
+}
+
+const SignaturePrefilter& SignaturePrefilter::UserIDBinding() {
+  static const SignaturePrefilter prefilter = SignaturePrefilter()
+      .AcceptType(kSignatureCertificationGeneric)
+      .AcceptType(kSignatureCertificationPersona)
+      .AcceptType(kSignatureCertificationCasual)
+      .AcceptType(kSignatureCertificationPositive)
+      .AcceptType(kSignatureRevocationCertification);
+  return prefilter;
+}
+
+const SignaturePrefilter& SignaturePrefilter::SubkeyBinding() {
+  static const SignaturePrefilter prefilter = SignaturePrefilter()
+      .AcceptType(kSignatureSubkeyBinding)
+      .AcceptType(kSignatureRevocationSubkey);
+  return prefilter;
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(SignaturePrefilter, Rejections) {
+  // An RSA key created at time 0x100.
+  const PublicKeyPacket key(ustring((const uint8_t*)
+      "\x04\x00\x00\x01\x00\x01\x00\x01\x01\x00\x01\x01", 12));
+  const ustring issuer = key.fingerprint().substr(12);
+
+  // A v4 positive certification made at time 0x200 by that key.
+  auto make_signature = [&issuer](uint8_t type, uint8_t algorithm,
+                                  const ustring& key_id) {
+    ustring data((const uint8_t*)"\x04", 1);
+    data += type;
+    data += algorithm;
+    data += ustring((const uint8_t*)
+        "\x08\x00\x06\x05\x02\x00\x00\x02\x00\x00\x0A\x09\x10", 13);
+    data += key_id;
+    data += ustring((const uint8_t*)"\xAB\xCD\x00\x01\x01", 5);
+    return SignaturePacket(data);
+  };
+
+  const SignaturePrefilter& prefilter = SignaturePrefilter::UserIDBinding();
+  SignaturePacket good = make_signature(0x13, 1, issuer);
+  ASSERT_EQ(good.creation_time(), 0x200);
+  ASSERT_EQ(good.hash_left_16bits()[0], 0xAB);
+  ASSERT_EQ(prefilter.Check(key, good), kPrefilterPass);
+
+  ustring other_issuer = issuer;
+  other_issuer[0] ^= 1;
+  ASSERT_EQ(prefilter.Check(key, make_signature(0x13, 1, other_issuer)),
+            kPrefilterKeyID);
+  ASSERT_EQ(prefilter.Check(key, make_signature(0x13, 22, issuer)),
+            kPrefilterAlgorithm);
+  ASSERT_EQ(prefilter.Check(key, make_signature(0x18, 1, issuer)),
+            kPrefilterSignatureType);
+  ASSERT_EQ(SignaturePrefilter(prefilter).NotAfter(0x1FF).Check(key, good),
+            kPrefilterCreationTime);
+}
+
+#endif  // INCLUDE_TESTS
+
+}
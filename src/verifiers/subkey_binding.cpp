@@ -8,6 +8,9 @@
 #include "keys/key.h"
 #include "parser.h"
 #include "exceptions.h"
+#include "digest.h"
+#include "prefilter.h"
+#include "trace.h"
 
 namespace parse4880 {
 
@@ -31,11 +34,20 @@ void UpdateContextWithKey(VerificationContext& ctx,
   ctx.Update(key.contents());
 }
 
-}  // namespace
+/**
+ * Verify a key-to-subkey binding.
+ *
+ * @see verify_subkey_binding
+ */
+int CheckSubkeyBinding(const PublicKeyPacket&    key_packet,
+                       const PublicSubkeyPacket& subkey_packet,
+                       const SignaturePacket&    signature) {
+  // Throw out plainly mismatched signatures before touching the key.
+  if (kPrefilterPass
+      != SignaturePrefilter::SubkeyBinding().Check(key_packet, signature)) {
+    return 0;
+  }
 
-int verify_subkey_binding(const PublicKeyPacket&    key_packet,
-                           const PublicSubkeyPacket& subkey_packet,
-                           const SignaturePacket&    signature) {
   // First we need to get the primary key out of the packet.
   std::unique_ptr<Key> key = Key::ParseKey(key_packet);
 
@@ -64,13 +76,23 @@ int verify_subkey_binding(const PublicKeyPacket&    key_packet,
                    });
 
   if (subsignature_iterator != subpackets.end()) {
+    // Next, we parse the subkey and signature subpacket.  A malformed
+    // primary-key binding simply fails to verify.
+    ParseResult<std::unique_ptr<Key>> subkey = Key::TryParseKey(subkey_packet);
+    if (!subkey.ok()) {
+      return verifies;
+    }
+    ParseError subsignature_error;
+    SignaturePacket subsignature_packet((**subsignature_iterator).contents(),
+                                        &subsignature_error);
+    if (!subsignature_error.ok()) {
+      return verifies;
+    }
+
     try {
-      // Next, we parse the subkey and signature subpacket.
-      std::unique_ptr<Key> subkey = Key::ParseKey(subkey_packet);
-      SignaturePacket subsignature_packet((**subsignature_iterator).contents());
       // Finally, we can verify the signature.
       std::unique_ptr<VerificationContext> ctx_subsignature =
-          subkey->GetVerificationContext(subsignature_packet);
+          subkey.value->GetVerificationContext(subsignature_packet);
       if (ctx_subsignature == nullptr) {
         return 0;
       }
@@ -79,7 +101,7 @@ int verify_subkey_binding(const PublicKeyPacket&    key_packet,
 
       // We should signal somehow a verification failure.
       verifies += ctx_subsignature->Verify();
-    } catch(parse4880::parse4880_error e) {
+    } catch(const parse4880::parse4880_error& e) {
       return verifies;
     }
   }
@@ -87,4 +109,37 @@ int verify_subkey_binding(const PublicKeyPacket&    key_packet,
   return verifies;
 }
 
+}  // namespace
+
+int verify_subkey_binding(const PublicKeyPacket&    key_packet,
+                          const PublicSubkeyPacket& subkey_packet,
+                          const SignaturePacket&    signature) {
+  TraceSpan span("verify", "subkey_binding");
+  const int result = CheckSubkeyBinding(key_packet, subkey_packet, signature);
+  PARSE4880_PROBE1(subkey_binding, result);
+  return result;
+}
+
+int verify_subkey_binding(const PublicKeyPacket&    key_packet,
+                          const PublicSubkeyPacket& subkey_packet,
+                          const SignaturePacket&    signature,
+                          VerificationCache*        cache) {
+  static const ustring kDomain((const uint8_t*)"subkey-binding", 14);
+  ContentDigest cache_key =
+      DigestParts({&kDomain, &key_packet.contents(), &subkey_packet.contents(),
+                   &signature.contents()});
+
+  int outcome;
+  if (nullptr != cache && cache->Lookup(cache_key, &outcome)) {
+    return outcome;
+  }
+
+  outcome = verify_subkey_binding(key_packet, subkey_packet, signature);
+
+  if (nullptr != cache) {
+    cache->Insert(cache_key, outcome);
+  }
+  return outcome;
+}
+
 }  // namespace parse4880
@@ -4,11 +4,15 @@
 #include "packet.h"
 #include "keys/key.h"
 #include "parser.h"
+#include "digest.h"
+#include "prefilter.h"
+#include "trace.h"
 
 namespace parse4880 {
 
 bool verify_uid_binding(const PublicKeyPacket& key, const UserIDPacket& uid,
                         const Key& attester, const SignaturePacket& signature) {
+  TraceSpan span("verify", "uid_binding");
   std::unique_ptr<VerificationContext> ctx =
       attester.GetVerificationContext(signature);
 
@@ -20,7 +24,38 @@ bool verify_uid_binding(const PublicKeyPacket& key, const UserIDPacket& uid,
   ctx->Update(WriteInteger(uid.contents().length(), 4));
   ctx->Update(uid.contents());
 
-  return ctx->Verify();
+  const bool result = ctx->Verify();
+  PARSE4880_PROBE1(uid_binding, result);
+  return result;
+}
+
+bool verify_uid_binding(const PublicKeyPacket& key, const UserIDPacket& uid,
+                        const PublicKeyPacket& attester,
+                        const SignaturePacket& signature,
+                        VerificationCache* cache) {
+  // Throw out plainly mismatched signatures before touching the key.
+  if (kPrefilterPass
+      != SignaturePrefilter::UserIDBinding().Check(attester, signature)) {
+    return false;
+  }
+
+  static const ustring kDomain((const uint8_t*)"uid-binding", 11);
+  ContentDigest cache_key =
+      DigestParts({&kDomain, &attester.contents(), &key.contents(),
+                   &uid.contents(), &signature.contents()});
+
+  int outcome;
+  if (nullptr != cache && cache->Lookup(cache_key, &outcome)) {
+    return outcome;
+  }
+
+  std::unique_ptr<Key> attester_key = Key::ParseKey(attester);
+  outcome = verify_uid_binding(key, uid, *attester_key, signature);
+
+  if (nullptr != cache) {
+    cache->Insert(cache_key, outcome);
+  }
+  return outcome;
 }
 
 }  // namespace parse4880
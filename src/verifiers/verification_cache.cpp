@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <cstring>
+
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#ifdef INCLUDE_TESTS
+#include <gtest/gtest.h>
+#endif
+
+#include "exceptions.h"
+#include "verification_cache.h"
+
+namespace parse4880 {
+
+namespace {
+
+const char kCacheMagic[] = "P4880VC1";
+const std::size_t kHeaderLength = 16;
+const std::size_t kRecordLength = 40;
+
+}  // namespace
+
+VerificationCache::VerificationCache(const std::string& path,
+                                     std::size_t max_entries)
+    : path_(path), max_entries_(max_entries) {
+  std::ifstream existing(path_, std::ios::binary);
+  std::stringstream str_stream;
+  str_stream << existing.rdbuf();
+  const std::string contents = str_stream.str();
+  existing.close();
+
+  bool needs_rewrite = true;
+  if (contents.length() >= kHeaderLength
+      && 0 == memcmp(contents.data(), kCacheMagic, 8)) {
+    std::size_t record_count =
+        (contents.length() - kHeaderLength) / kRecordLength;
+    for (std::size_t i = 0; i < record_count; i++) {
+      if (entries_.size() >= max_entries_) {
+        break;
+      }
+      const char* record = contents.data() + kHeaderLength + i*kRecordLength;
+      ContentDigest key;
+      memcpy(key.data(), record, key.size());
+      entries_[key] = static_cast<int8_t>(record[key.size()]);
+    }
+
+    // We can simply append to the file so long as it ends on a record
+    // boundary and we have not dropped any of its entries.
+    needs_rewrite =
+        (contents.length() - kHeaderLength) % kRecordLength != 0
+        || record_count != entries_.size();
+  }
+
+  if (needs_rewrite) {
+    Rewrite();
+  }
+
+  file_.open(path_, std::ios::binary | std::ios::app);
+  if (!file_) {
+    throw cache_error(path_);
+  }
+}
+
+VerificationCache::~VerificationCache() {
+  Flush();
+}
+
+void VerificationCache::Rewrite() {
+  std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw cache_error(path_);
+  }
+
+  char header[kHeaderLength] = {0};
+  memcpy(header, kCacheMagic, 8);
+  file.write(header, kHeaderLength);
+
+  for (auto entry = entries_.begin(); entry != entries_.end(); entry++) {
+    char record[kRecordLength] = {0};
+    memcpy(record, entry->first.data(), entry->first.size());
+    record[entry->first.size()] = static_cast<char>(entry->second);
+    file.write(record, kRecordLength);
+  }
+}
+
+bool VerificationCache::Lookup(const ContentDigest& key, int* outcome) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto entry = entries_.find(key);
+  if (entry == entries_.end()) {
+    return false;
+  }
+  *outcome = entry->second;
+  return true;
+}
+
+bool VerificationCache::Insert(const ContentDigest& key, int outcome) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.count(key) != 0) {
+    return true;
+  }
+  if (entries_.size() >= max_entries_) {
+    return false;
+  }
+  entries_[key] = static_cast<int8_t>(outcome);
+
+  char record[kRecordLength] = {0};
+  memcpy(record, key.data(), key.size());
+  record[key.size()] = static_cast<char>(outcome);
+  file_.write(record, kRecordLength);
+  return true;
+}
+
+void VerificationCache::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_.flush();
+}
+
+std::size_t VerificationCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+#ifdef INCLUDE_TESTS
+
+TEST(VerificationCache, Persistence) {
+  const std::string path = "verification_cache_test.tmp";
+  std::remove(path.c_str());
+
+  const ustring first_part((const uint8_t*)"key", 3);
+  const ustring second_part((const uint8_t*)"signature", 9);
+  ContentDigest first_key = DigestParts({&first_part, &second_part});
+  ContentDigest second_key = DigestParts({&second_part, &first_part});
+
+  {
+    VerificationCache cache(path, 1);
+    ASSERT_TRUE(cache.Insert(first_key, 2));
+    ASSERT_FALSE(cache.Insert(second_key, 1));
+  }
+
+  VerificationCache cache(path, 1);
+  int outcome = 0;
+  ASSERT_EQ(cache.size(), 1);
+  ASSERT_TRUE(cache.Lookup(first_key, &outcome));
+  ASSERT_EQ(outcome, 2);
+  ASSERT_FALSE(cache.Lookup(second_key, &outcome));
+
+  std::remove(path.c_str());
+}
+
+#endif  // INCLUDE_TESTS
+
+}